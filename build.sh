@@ -438,8 +438,21 @@ run_static_analysis() {
         "src/VfsShell/vfs_common.cpp"
         "src/VfsShell/tag_system.cpp"
         "src/VfsShell/logic_engine.cpp"
+        "src/VfsShell/vfs_atom.cpp"
+        "src/VfsShell/vfs_children.cpp"
+        "src/VfsShell/vfs_arena.cpp"
+        "src/VfsShell/vfs_lock.cpp"
+        "src/VfsShell/vfs_journal.cpp"
+        "src/VfsShell/vfs_overlay_index.cpp"
+        "src/VfsShell/vfs_tag_index.cpp"
+        "src/VfsShell/vfs_blob_store.cpp"
+        "src/VfsShell/vfs_worker_pool.cpp"
         "src/VfsShell/vfs_core.cpp"
+        "src/VfsShell/vfs_walk.cpp"
+        "src/VfsShell/vfs_glob.cpp"
+        "src/VfsShell/vfs_remote.cpp"
         "src/VfsShell/vfs_mount.cpp"
+        "src/VfsShell/vfs_host_io.cpp"
         "src/VfsShell/sexp.cpp"
         "src/VfsShell/cpp_ast.cpp"
         "src/VfsShell/clang_parser.cpp"
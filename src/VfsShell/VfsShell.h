@@ -20,6 +20,7 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <variant>
 #include <vector>
@@ -31,16 +32,20 @@
 #include <regex>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <system_error>
 #include <limits>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <termios.h>
 #include <array>
+#include <bitset>
 #include <unordered_set>
 #include <queue>
 #include <cassert>
 #include <cerrno>
+#include <future>
 
 // System includes
 #include <dlfcn.h>
@@ -48,9 +53,21 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <dirent.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 // External library includes
 #include <blake3.h>
@@ -111,10 +128,23 @@
 
 #include "config.h"
 #include "vfs_common.h"
+#include "vfs_atom.h"
 #include "tag_system.h"
 #include "logic_engine.h"
+#include "vfs_children.h"
+#include "vfs_arena.h"
+#include "vfs_lock.h"
+#include "vfs_journal.h"
+#include "vfs_overlay_index.h"
+#include "vfs_tag_index.h"
+#include "vfs_blob_store.h"
+#include "vfs_worker_pool.h"
 #include "vfs_core.h"
+#include "vfs_walk.h"
+#include "vfs_glob.h"
+#include "vfs_remote.h"
 #include "vfs_mount.h"
+#include "vfs_host_io.h"
 #include "sexp.h"
 #include "cpp_ast.h"
 #include "clang_parser.h"
@@ -88,35 +88,25 @@ static void save_crash_recovery(Vfs& vfs, const AutosaveContext& autosave_ctx){
         // For now, just save the base overlay as crash recovery
         // TODO: extend to save multiple overlays if needed
         if(vfs.overlayCount() > 0){
-            auto root = vfs.overlayRoot(0);
+            // Frozen snapshot: walked without holding the Vfs lock
+            auto root = vfs.snapshotOverlay(0);
             if(root){
-                std::function<void(const std::shared_ptr<VfsNode>&, const std::string&)> dump;
-                dump = [&](const std::shared_ptr<VfsNode>& node, const std::string& path){
-                    if(!node) return;
-                    bool traverse = node->isDir();
+                TreeWalker().walk(root, "/", [&](const TreeWalker::Item& item){
+                    const auto& node = item.node;
                     if(node->kind == VfsNode::Kind::Dir){
-                        if(path != "/"){
-                            out << "D " << path << "\n";
+                        if(item.path != "/"){
+                            out << "D " << item.path << "\n";
                         }
                     } else if(node->kind == VfsNode::Kind::File){
                         auto data = node->read();
-                        out << "F " << path << " " << data.size() << "\n";
+                        out << "F " << item.path << " " << data.size() << "\n";
                         if(!data.empty()){
                             out.write(data.data(), static_cast<std::streamsize>(data.size()));
                         }
                         out << "\n";
-                        return;
                     }
-
-                    if(traverse){
-                        const auto& children = node->children();
-                        for(const auto& [name, child] : children){
-                            std::string childPath = join_path(path, name);
-                            dump(child, childPath);
-                        }
-                    }
-                };
-                dump(root, "/");
+                    return TreeWalker::Action::Descend;
+                });
             }
         }
     } catch(const std::exception&){
@@ -182,7 +172,7 @@ static void autosave_thread_func(Vfs* vfs_ptr, AutosaveContext* autosave_ctx){
     }
 }
 
-size_t mount_overlay_from_file(Vfs& vfs, const std::string& name, const std::string& hostPath){
+size_t mount_overlay_from_file(Vfs& vfs, const std::string& name, const std::string& hostPath, ArenaRef arena){
     TRACE_FN("name=", name, ", file=", hostPath);
     if(name.empty()) throw std::runtime_error("overlay: name required");
     std::ifstream in(hostPath, std::ios::binary);
@@ -195,6 +185,7 @@ size_t mount_overlay_from_file(Vfs& vfs, const std::string& name, const std::str
     if(trimmed == "# codex-vfs-overlay 1") version = 1;
     if(trimmed == "# codex-vfs-overlay 2") version = 2;
     if(trimmed == "# codex-vfs-overlay 3") version = 3;
+    if(trimmed == "# codex-vfs-overlay 4") version = 4;
     if(version == 0) throw std::runtime_error("overlay: invalid header");
 
     std::string source_file;
@@ -203,6 +194,7 @@ size_t mount_overlay_from_file(Vfs& vfs, const std::string& name, const std::str
     // Version 3 adds source file hash tracking
     if(version >= 3){
         std::string hash_line;
+        std::streampos after_header = in.tellg();
         if(std::getline(in, hash_line)){
             auto hash_trimmed = trim_copy(hash_line);
             if(!hash_trimmed.empty() && hash_trimmed[0] == 'H'){
@@ -211,79 +203,95 @@ size_t mount_overlay_from_file(Vfs& vfs, const std::string& name, const std::str
                 if(iss >> tag >> source_file >> source_hash){
                     // Successfully parsed hash line
                 } else {
-                    // Not a valid hash line, rewind if possible (though we can't easily)
-                    // For now, just proceed without hash
+                    // Not a valid hash line, proceed without hash
                 }
+            } else {
+                // No hash line; the line is the first entry
+                in.seekg(after_header);
             }
         }
     }
 
-    auto root = std::make_shared<DirNode>("/");
+    // Every node of the snapshot comes from one arena owned by the overlay
+    NodeArena::Scope arena_scope(arena.get());
+
+    auto root = make_node<DirNode>("/");
     root->name = "/";
     root->parent.reset();
 
+    // Only AST nodes are looked up by the fixups, so dirs and files stay out of path_map
     std::unordered_map<std::string, std::shared_ptr<VfsNode>> path_map;
     path_map["/"] = root;
     std::vector<std::function<void()>> ast_fixups;
 
-    auto ensure_dir = [&](const std::string& path) -> std::shared_ptr<DirNode> {
+    // Snapshots list entries directory by directory, so remember the last one
+    std::string last_dir_path;
+    std::shared_ptr<DirNode> last_dir;
+
+    auto ensure_dir = [&](std::string_view path) -> std::shared_ptr<DirNode> {
         if(path.empty() || path == "/") return root;
-        auto parts = Vfs::splitPath(path);
+        if(last_dir && path == last_dir_path) return last_dir;
         std::shared_ptr<VfsNode> cur = root;
-        std::string curPath = "/";
-        for(const auto& part : parts){
-            if(!cur->isDir()) throw std::runtime_error("overlay: conflicting node at " + path);
+        for(std::string_view part : PathParts(path)){
+            if(!cur->isDir()) throw std::runtime_error("overlay: conflicting node at " + std::string(path));
             auto& ch = cur->children();
             auto it = ch.find(part);
             if(it == ch.end()){
-                auto dir = std::make_shared<DirNode>(part);
+                auto dir = make_node<DirNode>(std::string(part));
                 dir->parent = cur;
                 ch[part] = dir;
                 cur = dir;
             } else {
                 cur = it->second;
             }
-            curPath = join_path(curPath, part);
-            path_map[curPath] = cur;
         }
-        if(!cur->isDir()) throw std::runtime_error("overlay: conflicting node at " + path);
-        return std::static_pointer_cast<DirNode>(cur);
+        if(!cur->isDir()) throw std::runtime_error("overlay: conflicting node at " + std::string(path));
+        last_dir_path.assign(path);
+        last_dir = std::static_pointer_cast<DirNode>(cur);
+        return last_dir;
     };
 
-    auto create_file = [&](const std::string& path, std::string content){
-        auto parts = Vfs::splitPath(path);
-        if(parts.empty()) throw std::runtime_error("overlay: invalid file path");
-        std::string namePart = parts.back();
-        parts.pop_back();
-        std::shared_ptr<DirNode> dir = root;
-        if(!parts.empty()){
-            std::string dirPath = "/";
-            for(const auto& part : parts) dirPath = join_path(dirPath, part);
-            dir = ensure_dir(dirPath);
-        }
+    auto attach = [&](const std::shared_ptr<DirNode>& dir, std::shared_ptr<VfsNode> node){
         auto& ch = dir->children();
-        auto file = std::make_shared<FileNode>(namePart, std::move(content));
-        file->parent = dir;
-        ch[namePart] = file;
-        path_map[path] = file;
+        if(ch.count(node->name)) last_dir.reset();  // may replace a directory we remembered
+        node->parent = dir;
+        ch[node->name] = std::move(node);
     };
 
-    auto create_ast = [&](const std::string& path, const std::string& type, std::string payload){
-        auto parts = Vfs::splitPath(path);
-        if(parts.empty()) throw std::runtime_error("overlay: invalid ast path");
-        std::string namePart = parts.back();
-        parts.pop_back();
-        std::shared_ptr<DirNode> dir = root;
-        if(!parts.empty()){
-            std::string dirPath = "/";
-            for(const auto& part : parts) dirPath = join_path(dirPath, part);
-            dir = ensure_dir(dirPath);
+    // Contents go through the blob store, so files other overlays hold too are shared
+    auto create_file = [&](const std::string& path, std::shared_ptr<std::string> content){
+        auto [dirPath, namePart] = Vfs::splitParentPath(path);
+        if(namePart.empty()) throw std::runtime_error("overlay: invalid file path");
+        auto dir = ensure_dir(dirPath);
+        attach(dir, make_node<FileNode>(std::string(namePart), std::move(content)));
+    };
+
+    // Version 4 stores repeated contents once as B entries that R entries refer to
+    std::unordered_map<std::string, std::shared_ptr<std::string>> blobs;
+
+    auto read_payload = [&](size_t size, const char* what){
+        std::string payload(size, '\0');
+        in.read(payload.data(), static_cast<std::streamsize>(size));
+        if(static_cast<size_t>(in.gcount()) != size)
+            throw std::runtime_error(std::string("overlay: truncated ") + what);
+        int term = in.peek();
+        if(term == '\r'){
+            in.get();
+            if(in.peek() == '\n') in.get();
+        } else if(term == '\n'){
+            in.get();
         }
+        return payload;
+    };
+
+    auto create_ast = [&](const std::string& path, const std::string& type, std::string payload){
+        auto [dirPath, namePart] = Vfs::splitParentPath(path);
+        if(namePart.empty()) throw std::runtime_error("overlay: invalid ast path");
+        auto dir = ensure_dir(dirPath);
         auto node = deserialize_ast_node(type, payload, path, ast_fixups, path_map);
-        node->name = namePart;
-        node->parent = dir;
-        dir->children()[namePart] = node;
+        if(node->name != namePart) node->name = namePart;
         path_map[path] = node;
+        attach(dir, std::move(node));
     };
 
     while(true){
@@ -311,18 +319,35 @@ size_t mount_overlay_from_file(Vfs& vfs, const std::string& name, const std::str
                 throw std::runtime_error("overlay: malformed file entry");
             if(path.empty() || path[0] != '/')
                 throw std::runtime_error("overlay: invalid file path");
-            std::string content(size, '\0');
-            in.read(content.data(), static_cast<std::streamsize>(size));
-            if(static_cast<size_t>(in.gcount()) != size)
-                throw std::runtime_error("overlay: truncated file content");
-            int term = in.peek();
-            if(term == '\r'){
-                in.get();
-                if(in.peek() == '\n') in.get();
-            } else if(term == '\n'){
-                in.get();
-            }
-            create_file(path, std::move(content));
+            create_file(path, vfs.blobs.intern(read_payload(size, "file content")));
+            continue;
+        }
+
+        if(line[0] == 'B' && line.size() > 1 && std::isspace(static_cast<unsigned char>(line[1]))){
+            if(version < 4) throw std::runtime_error("overlay: blob entry not supported before version 4");
+            std::istringstream meta(line);
+            char tag;
+            std::string digest;
+            size_t size = 0;
+            if(!(meta >> tag >> digest >> size))
+                throw std::runtime_error("overlay: malformed blob entry");
+            blobs[digest] = vfs.blobs.intern(read_payload(size, "blob content"));
+            continue;
+        }
+
+        if(line[0] == 'R' && line.size() > 1 && std::isspace(static_cast<unsigned char>(line[1]))){
+            if(version < 4) throw std::runtime_error("overlay: blob reference not supported before version 4");
+            std::istringstream meta(line);
+            char tag;
+            std::string path;
+            std::string digest;
+            if(!(meta >> tag >> path >> digest))
+                throw std::runtime_error("overlay: malformed blob reference");
+            if(path.empty() || path[0] != '/')
+                throw std::runtime_error("overlay: invalid file path");
+            auto it = blobs.find(digest);
+            if(it == blobs.end()) throw std::runtime_error("overlay: unknown blob " + digest + " for " + path);
+            create_file(path, it->second);
             continue;
         }
 
@@ -337,18 +362,7 @@ size_t mount_overlay_from_file(Vfs& vfs, const std::string& name, const std::str
                 throw std::runtime_error("overlay: malformed ast entry");
             if(path.empty() || path[0] != '/')
                 throw std::runtime_error("overlay: invalid ast path");
-            std::string payload(size, '\0');
-            in.read(payload.data(), static_cast<std::streamsize>(size));
-            if(static_cast<size_t>(in.gcount()) != size)
-                throw std::runtime_error("overlay: truncated ast payload");
-            int term = in.peek();
-            if(term == '\r'){
-                in.get();
-                if(in.peek() == '\n') in.get();
-            } else if(term == '\n'){
-                in.get();
-            }
-            create_ast(path, type, std::move(payload));
+            create_ast(path, type, read_payload(size, "ast payload"));
             continue;
         }
 
@@ -357,7 +371,7 @@ size_t mount_overlay_from_file(Vfs& vfs, const std::string& name, const std::str
 
     for(auto& fix : ast_fixups) fix();
 
-    auto id = vfs.registerOverlay(name, root);
+    auto id = vfs.registerOverlay(name, root, std::move(arena));
     vfs.setOverlaySource(id, hostPath);
 
     // Set source file and hash for version 3
@@ -397,8 +411,15 @@ size_t mount_overlay_from_file(Vfs& vfs, const std::string& name, const std::str
 
 void save_overlay_to_file(Vfs& vfs, size_t overlayId, const std::string& hostPath){
     TRACE_FN("overlayId=", overlayId, ", file=", hostPath);
-    auto root = vfs.overlayRoot(overlayId);
-    if(!root) throw std::runtime_error("overlay.save: overlay missing root");
+    // Serialized from a frozen snapshot, so edits on other threads neither
+    // block on nor tear the save
+    auto root = vfs.snapshotOverlay(overlayId);
+    std::string source_file, source_hash;
+    {
+        auto guard = vfs.readLock();
+        source_file = vfs.overlay_stack[overlayId].source_file;
+        source_hash = vfs.overlay_stack[overlayId].source_hash;
+    }
 
     std::filesystem::path outPath(hostPath);
     if(auto parent = outPath.parent_path(); !parent.empty()){
@@ -416,36 +437,82 @@ void save_overlay_to_file(Vfs& vfs, size_t overlayId, const std::string& hostPat
         std::cout << "note: backup creation failed: " << e.what() << "\n";
     }
 
+    // Contents held by more than one file are written once as a blob. Only
+    // files whose size repeats are hashed, and a buffer the files already
+    // share (interned) only once.
+    std::unordered_map<size_t, size_t> size_count;
+    std::vector<ContentRef> hashed_buffers;
+    TreeWalker::Options no_paths;
+    no_paths.paths = false;
+    TreeWalker files_walk(no_paths);
+    files_walk.walk(root, std::string(), [&](const TreeWalker::Item& item){
+        if(item.node->kind == VfsNode::Kind::File){
+            size_t n = item.node->size();
+            if(n >= BlobStore::MIN_SIZE) ++size_count[n];
+        }
+        return item.node->kind == VfsNode::Kind::Dir ? TreeWalker::Action::Descend : TreeWalker::Action::Skip;
+    });
+    std::unordered_map<const VfsNode*, std::string> file_digest;
+    std::unordered_map<const std::string*, std::string> buffer_digest;
+    std::unordered_map<std::string, size_t> digest_count;
+    files_walk.walk(root, std::string(), [&](const TreeWalker::Item& item){
+        const auto& node = item.node;
+        if(node->kind == VfsNode::Kind::Dir) return TreeWalker::Action::Descend;
+        if(node->kind != VfsNode::Kind::File) return TreeWalker::Action::Skip;
+        auto it = size_count.find(node->size());
+        if(it == size_count.end() || it->second < 2) return TreeWalker::Action::Skip;
+        ContentRef data = node->readShared();
+        auto [bd, fresh] = buffer_digest.try_emplace(data.get());
+        if(fresh){
+            bd->second = BlobStore::hex(BlobStore::digest(*data));
+            hashed_buffers.push_back(std::move(data));  // keeps the buffer address unique
+        }
+        file_digest[node.get()] = bd->second;
+        ++digest_count[bd->second];
+        return TreeWalker::Action::Skip;
+    });
+    for(auto it = file_digest.begin(); it != file_digest.end();){
+        if(digest_count[it->second] < 2) it = file_digest.erase(it);
+        else ++it;
+    }
+    std::unordered_set<std::string> written_blobs;
+
     std::ofstream out(hostPath, std::ios::binary | std::ios::trunc);
     if(!out) throw std::runtime_error("overlay.save: cannot open file for writing");
 
-    // Write version 3 header with optional hash
-    out << "# codex-vfs-overlay 3\n";
+    // Version 3 header with optional hash; version 4 when there are blobs
+    out << "# codex-vfs-overlay " << (file_digest.empty() ? 3 : 4) << "\n";
 
     // Write source file hash if available
-    if(overlayId < vfs.overlay_stack.size()){
-        const auto& overlay = vfs.overlay_stack[overlayId];
-        if(!overlay.source_file.empty() && !overlay.source_hash.empty()){
-            out << "H " << overlay.source_file << " " << overlay.source_hash << "\n";
-        }
+    if(!source_file.empty() && !source_hash.empty()){
+        out << "H " << source_file << " " << source_hash << "\n";
     }
 
-    std::function<void(const std::shared_ptr<VfsNode>&, const std::string&)> dump;
-    dump = [&](const std::shared_ptr<VfsNode>& node, const std::string& path){
-        if(!node) return;
-        bool traverse = node->isDir();
+    TreeWalker().walk(root, "/", [&](const TreeWalker::Item& item){
+        const auto& node = item.node;
+        const std::string& path = item.path;
         if(node->kind == VfsNode::Kind::Dir){
             if(path != "/"){
                 out << "D " << path << "\n";
             }
         } else if(node->kind == VfsNode::Kind::File){
-            auto data = node->read();
-            out << "F " << path << " " << data.size() << "\n";
-            if(!data.empty()){
-                out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            ContentRef data = node->readShared();
+            auto shared = file_digest.find(node.get());
+            if(shared != file_digest.end()){
+                if(written_blobs.insert(shared->second).second){
+                    out << "B " << shared->second << " " << data->size() << "\n";
+                    out.write(data->data(), static_cast<std::streamsize>(data->size()));
+                    out << "\n";
+                }
+                out << "R " << path << " " << shared->second << "\n";
+                return TreeWalker::Action::Skip;
+            }
+            out << "F " << path << " " << data->size() << "\n";
+            if(!data->empty()){
+                out.write(data->data(), static_cast<std::streamsize>(data->size()));
             }
             out << "\n";
-            return;
+            return TreeWalker::Action::Skip;
         } else if(node->kind == VfsNode::Kind::Ast){
             auto ast = std::dynamic_pointer_cast<AstNode>(node);
             if(!ast) throw std::runtime_error("overlay.save: ast node cast failed at " + path);
@@ -458,17 +525,8 @@ void save_overlay_to_file(Vfs& vfs, size_t overlayId, const std::string& hostPat
         } else {
             throw std::runtime_error("overlay.save: unsupported node type at " + path);
         }
-
-        if(traverse){
-            const auto& children = node->children();
-            for(const auto& [name, child] : children){
-                std::string childPath = join_path(path, name);
-                dump(child, childPath);
-            }
-        }
-    };
-
-    dump(root, "/");
+        return TreeWalker::Action::Descend;
+    });
     vfs.setOverlaySource(overlayId, hostPath);
     vfs.clearOverlayDirty(overlayId);
 }
@@ -579,7 +637,6 @@ bool load_solution_from_file(Vfs& vfs, WorkingDirectory& cwd, SolutionContext& s
     return true;
 }
 
-size_t mount_overlay_from_file(Vfs& vfs, const std::string& name, const std::string& hostPath);
 std::string unescape_meta(const std::string& s){
     std::string out; out.reserve(s.size());
     for(size_t i=0;i<s.size();++i){
@@ -663,7 +720,7 @@ std::shared_ptr<AstNode> deserialize_ast_node(const std::string& type,
         auto innerPayload = r.str();
         r.expect_eof();
         auto inner = deserialize_s_ast_node(innerType, innerPayload);
-        auto holder = std::make_shared<AstHolder>(basename, inner);
+        auto holder = make_node<AstHolder>(basename, inner);
         return holder;
     }
 
@@ -676,12 +733,12 @@ std::shared_ptr<AstNode> deserialize_ast_node(const std::string& type,
     if(type == "CppTranslationUnit"){
         BinaryReader r(payload);
         uint32_t includeCount = r.u32();
-        auto tu = std::make_shared<CppTranslationUnit>(basename);
+        auto tu = make_node<CppTranslationUnit>(basename);
         tu->includes.clear();
         for(uint32_t i = 0; i < includeCount; ++i){
             auto header = r.str();
             bool angled = r.u8() != 0;
-            tu->includes.push_back(std::make_shared<CppInclude>("include", header, angled));
+            tu->includes.push_back(make_node<CppInclude>("include", header, angled));
         }
         uint32_t funcCount = r.u32();
         std::vector<std::string> funcNames;
@@ -724,7 +781,7 @@ std::shared_ptr<AstNode> deserialize_ast_node(const std::string& type,
         }
         auto bodyName = r.str();
         r.expect_eof();
-        auto fn = std::make_shared<CppFunction>(basename, retType, fnName);
+        auto fn = make_node<CppFunction>(basename, retType, fnName);
         fn->retType = retType;
         fn->name = fnName;
         fn->params = std::move(params);
@@ -746,7 +803,7 @@ std::shared_ptr<AstNode> deserialize_ast_node(const std::string& type,
     }
 
     if(type == "CppCompound"){
-        auto compound = std::make_shared<CppCompound>(basename);
+        auto compound = make_node<CppCompound>(basename);
         deserialize_cpp_compound_into(payload, path, compound, fixups, path_map);
         return compound;
     }
@@ -757,7 +814,7 @@ std::shared_ptr<AstNode> deserialize_ast_node(const std::string& type,
         auto range = r.str();
         auto bodyName = r.str();
         r.expect_eof();
-        auto loop = std::make_shared<CppRangeFor>(basename, decl, range);
+        auto loop = make_node<CppRangeFor>(basename, decl, range);
         loop->body.reset();
         auto weakLoop = std::weak_ptr<CppRangeFor>(loop);
         fixups.push_back([weakLoop, path, bodyName, &path_map](){
@@ -779,7 +836,7 @@ std::shared_ptr<AstNode> deserialize_ast_node(const std::string& type,
     if(type == "PlanJobs"){
         BinaryReader r(payload);
         uint32_t count = r.u32();
-        auto jobs = std::make_shared<PlanJobs>(basename);
+        auto jobs = make_node<PlanJobs>(basename);
         for(uint32_t i = 0; i < count; ++i){
             PlanJob job;
             job.description = r.str();
@@ -795,7 +852,7 @@ std::shared_ptr<AstNode> deserialize_ast_node(const std::string& type,
     if(type == "PlanGoals"){
         BinaryReader r(payload);
         uint32_t count = r.u32();
-        auto goals = std::make_shared<PlanGoals>(basename);
+        auto goals = make_node<PlanGoals>(basename);
         for(uint32_t i = 0; i < count; ++i){
             goals->goals.push_back(r.str());
         }
@@ -806,7 +863,7 @@ std::shared_ptr<AstNode> deserialize_ast_node(const std::string& type,
     if(type == "PlanIdeas"){
         BinaryReader r(payload);
         uint32_t count = r.u32();
-        auto ideas = std::make_shared<PlanIdeas>(basename);
+        auto ideas = make_node<PlanIdeas>(basename);
         for(uint32_t i = 0; i < count; ++i){
             ideas->ideas.push_back(r.str());
         }
@@ -817,7 +874,7 @@ std::shared_ptr<AstNode> deserialize_ast_node(const std::string& type,
     if(type == "PlanDeps"){
         BinaryReader r(payload);
         uint32_t count = r.u32();
-        auto deps = std::make_shared<PlanDeps>(basename);
+        auto deps = make_node<PlanDeps>(basename);
         for(uint32_t i = 0; i < count; ++i){
             deps->dependencies.push_back(r.str());
         }
@@ -828,7 +885,7 @@ std::shared_ptr<AstNode> deserialize_ast_node(const std::string& type,
     if(type == "PlanImplemented"){
         BinaryReader r(payload);
         uint32_t count = r.u32();
-        auto impl = std::make_shared<PlanImplemented>(basename);
+        auto impl = make_node<PlanImplemented>(basename);
         for(uint32_t i = 0; i < count; ++i){
             impl->items.push_back(r.str());
         }
@@ -839,7 +896,7 @@ std::shared_ptr<AstNode> deserialize_ast_node(const std::string& type,
     if(type == "PlanResearch"){
         BinaryReader r(payload);
         uint32_t count = r.u32();
-        auto research = std::make_shared<PlanResearch>(basename);
+        auto research = make_node<PlanResearch>(basename);
         for(uint32_t i = 0; i < count; ++i){
             research->topics.push_back(r.str());
         }
@@ -851,28 +908,28 @@ std::shared_ptr<AstNode> deserialize_ast_node(const std::string& type,
         BinaryReader r(payload);
         auto content = r.str();
         r.expect_eof();
-        return std::make_shared<PlanRoot>(basename, content);
+        return make_node<PlanRoot>(basename, content);
     }
 
     if(type == "PlanSubPlan"){
         BinaryReader r(payload);
         auto content = r.str();
         r.expect_eof();
-        return std::make_shared<PlanSubPlan>(basename, content);
+        return make_node<PlanSubPlan>(basename, content);
     }
 
     if(type == "PlanStrategy"){
         BinaryReader r(payload);
         auto content = r.str();
         r.expect_eof();
-        return std::make_shared<PlanStrategy>(basename, content);
+        return make_node<PlanStrategy>(basename, content);
     }
 
     if(type == "PlanNotes"){
         BinaryReader r(payload);
         auto content = r.str();
         r.expect_eof();
-        return std::make_shared<PlanNotes>(basename, content);
+        return make_node<PlanNotes>(basename, content);
     }
 
     throw std::runtime_error("deserialize_ast_node: unsupported node type '" + type + "'");
@@ -945,13 +1002,13 @@ std::shared_ptr<AstNode> deserialize_s_ast_node(const std::string& type, const s
     BinaryReader r(payload);
     std::shared_ptr<AstNode> node;
     if(type == "AstInt"){
-        node = std::make_shared<AstInt>("<i>", r.i64());
+        node = make_node<AstInt>("<i>", r.i64());
     } else if(type == "AstBool"){
-        node = std::make_shared<AstBool>("<b>", r.u8() != 0);
+        node = make_node<AstBool>("<b>", r.u8() != 0);
     } else if(type == "AstStr"){
-        node = std::make_shared<AstStr>("<s>", r.str());
+        node = make_node<AstStr>("<s>", r.str());
     } else if(type == "AstSym"){
-        node = std::make_shared<AstSym>("<sym>", r.str());
+        node = make_node<AstSym>("<sym>", r.str());
     } else if(type == "AstIf"){
         auto cType = r.str(); auto cData = r.str();
         auto aType = r.str(); auto aData = r.str();
@@ -959,7 +1016,7 @@ std::shared_ptr<AstNode> deserialize_s_ast_node(const std::string& type, const s
         auto c = deserialize_s_ast_node(cType, cData);
         auto a = deserialize_s_ast_node(aType, aData);
         auto b = deserialize_s_ast_node(bType, bData);
-        node = std::make_shared<AstIf>("<if>", c, a, b);
+        node = make_node<AstIf>("<if>", c, a, b);
     } else if(type == "AstLambda"){
         uint32_t count = r.u32();
         std::vector<std::string> params;
@@ -968,7 +1025,7 @@ std::shared_ptr<AstNode> deserialize_s_ast_node(const std::string& type, const s
         auto bodyType = r.str();
         auto bodyData = r.str();
         auto body = deserialize_s_ast_node(bodyType, bodyData);
-        node = std::make_shared<AstLambda>("<lam>", params, body);
+        node = make_node<AstLambda>("<lam>", params, body);
     } else if(type == "AstCall"){
         auto fnType = r.str();
         auto fnData = r.str();
@@ -981,7 +1038,7 @@ std::shared_ptr<AstNode> deserialize_s_ast_node(const std::string& type, const s
             auto aData = r.str();
             args.push_back(deserialize_s_ast_node(aType, aData));
         }
-        node = std::make_shared<AstCall>("<call>", fn, args);
+        node = make_node<AstCall>("<call>", fn, args);
     } else {
         throw std::runtime_error("deserialize_s_ast_node: unsupported node type '" + type + "'");
     }
@@ -1022,18 +1079,18 @@ void deserialize_cpp_compound_into(const std::string& payload,
         switch(tag){
             case CppStmtTag::ExprStmt: {
                 auto expr = deserialize_cpp_expr(r);
-                parsed.push_back(std::make_shared<CppExprStmt>("expr", expr));
+                parsed.push_back(make_node<CppExprStmt>("expr", expr));
                 break;
             }
             case CppStmtTag::Return: {
                 bool hasExpr = r.u8() != 0;
                 std::shared_ptr<CppExpr> expr;
                 if(hasExpr) expr = deserialize_cpp_expr(r);
-                parsed.push_back(std::make_shared<CppReturn>("ret", expr));
+                parsed.push_back(make_node<CppReturn>("ret", expr));
                 break;
             }
             case CppStmtTag::Raw: {
-                parsed.push_back(std::make_shared<CppRawStmt>("stmt", r.str()));
+                parsed.push_back(make_node<CppRawStmt>("stmt", r.str()));
                 break;
             }
             case CppStmtTag::VarDecl: {
@@ -1042,7 +1099,7 @@ void deserialize_cpp_compound_into(const std::string& payload,
                 bool hasInit = r.u8() != 0;
                 std::string init;
                 if(hasInit) init = r.str();
-                parsed.push_back(std::make_shared<CppVarDecl>("var", type, name, init, hasInit));
+                parsed.push_back(make_node<CppVarDecl>("var", type, name, init, hasInit));
                 break;
             }
             case CppStmtTag::RangeForRef: {
@@ -1224,11 +1281,11 @@ std::shared_ptr<CppExpr> deserialize_cpp_expr(BinaryReader& r){
     auto tag = static_cast<CppExprTag>(r.u8());
     switch(tag){
         case CppExprTag::Id:
-            return std::make_shared<CppId>("id", r.str());
+            return make_node<CppId>("id", r.str());
         case CppExprTag::String:
-            return std::make_shared<CppString>("s", r.str());
+            return make_node<CppString>("s", r.str());
         case CppExprTag::Int:
-            return std::make_shared<CppInt>("i", r.i64());
+            return make_node<CppInt>("i", r.i64());
         case CppExprTag::Call: {
             auto fn = deserialize_cpp_expr(r);
             uint32_t argc = r.u32();
@@ -1237,23 +1294,23 @@ std::shared_ptr<CppExpr> deserialize_cpp_expr(BinaryReader& r){
             for(uint32_t i = 0; i < argc; ++i){
                 args.push_back(deserialize_cpp_expr(r));
             }
-            return std::make_shared<CppCall>("call", fn, args);
+            return make_node<CppCall>("call", fn, args);
         }
         case CppExprTag::BinOp: {
             auto op = r.str();
             auto a = deserialize_cpp_expr(r);
             auto b = deserialize_cpp_expr(r);
-            return std::make_shared<CppBinOp>("binop", op, a, b);
+            return make_node<CppBinOp>("binop", op, a, b);
         }
         case CppExprTag::StreamOut: {
             uint32_t count = r.u32();
             std::vector<std::shared_ptr<CppExpr>> chain;
             chain.reserve(count);
             for(uint32_t i = 0; i < count; ++i) chain.push_back(deserialize_cpp_expr(r));
-            return std::make_shared<CppStreamOut>("cout", chain);
+            return make_node<CppStreamOut>("cout", chain);
         }
         case CppExprTag::Raw:
-            return std::make_shared<CppRawExpr>("rexpr", r.str());
+            return make_node<CppRawExpr>("rexpr", r.str());
     }
     throw std::runtime_error("deserialize_cpp_expr: unknown tag");
 }
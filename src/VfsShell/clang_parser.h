@@ -106,7 +106,10 @@ bool is_solution_file(const std::filesystem::path& p);
 std::optional<std::filesystem::path> auto_detect_vfs_path();
 std::optional<std::filesystem::path> auto_detect_solution_path();
 std::string make_unique_overlay_name(Vfs& vfs, std::string base);
-size_t mount_overlay_from_file(Vfs& vfs, const std::string& name, const std::string& hostPath);
+// Nodes of the snapshot are allocated from arena, which the overlay keeps;
+// an empty ArenaRef allocates them one by one on the heap
+size_t mount_overlay_from_file(Vfs& vfs, const std::string& name, const std::string& hostPath,
+                               ArenaRef arena = NodeArena::create());
 void maybe_extend_context(Vfs& vfs, WorkingDirectory& cwd);
 bool solution_save(Vfs& vfs, SolutionContext& sol, bool quiet);
 void attach_solution_shortcut(Vfs& vfs, SolutionContext& sol);
@@ -163,13 +166,13 @@ struct SourceLocation {
 struct ClangAstNode : AstNode {
     SourceLocation location;
     std::string spelling;  // Name/identifier from clang_getCursorSpelling
-    std::map<std::string, std::shared_ptr<VfsNode>> ch;
+    ChildIndex ch;
 
     ClangAstNode(std::string n, SourceLocation loc, std::string spell)
         : AstNode(std::move(n)), location(std::move(loc)), spelling(std::move(spell)) {}
 
     bool isDir() const override { return true; }
-    std::map<std::string, std::shared_ptr<VfsNode>>& children() override { return ch; }
+    ChildIndex& children() override { return ch; }
     Value eval(std::shared_ptr<Env>) override { return Value::S(spelling); }
     std::string read() const override { return spelling; }
 
@@ -443,12 +443,12 @@ std::vector<std::string> get_all_commands(){
         "cd", "ls", "tree", "mkdir", "touch", "cat", "grep", "rg", "count",
         "history", "true", "false", "tail", "head", "uniq", "random", "echo",
         "rm", "mv", "link", "export", "parse", "eval", "ai", "ai.brief",
-        "discuss", "ai.discuss", "discuss.session", "tools", "overlay.list",
-        "overlay.use", "overlay.policy", "overlay.mount", "overlay.save",
+        "discuss", "ai.discuss", "discuss.session", "tools", "overlay.list", "blob.stats",
+        "overlay.stats", "overlay.budget", "overlay.use", "overlay.policy", "overlay.mount", "overlay.save",
         "overlay.unmount", "mount", "mount.lib", "mount.remote", "mount.list",
-        "mount.allow", "mount.disallow", "unmount", "tag.add", "tag.remove",
-        "tag.list", "tag.clear", "tag.has", "logic.init", "logic.infer",
-        "logic.check", "logic.explain", "logic.addrule", "logic.listrules",
+        "mount.allow", "mount.disallow", "unmount", "watch", "tag.add", "tag.remove",
+        "tag.list", "tag.clear", "tag.has", "tag.find", "logic.init",
+        "logic.infer", "logic.check", "logic.explain", "logic.addrule", "logic.listrules",
         "logic.assert", "logic.sat", "tag.mine.start", "tag.mine.feedback",
         "tag.mine.status", "plan.create", "plan.goto",
         "plan.forward", "plan.backward", "plan.context.add", "plan.context.remove",
@@ -118,13 +118,13 @@ bool ContextFilter::matches(VfsNode* node, const std::string& path, Vfs& vfs) co
             }
         }
         case Type::ContentMatch: {
-            std::string content = node->read();
-            return content.find(pattern) != std::string::npos;
+            ContentView content = node->readView();
+            return content.data.find(pattern) != std::string_view::npos;
         }
         case Type::ContentRegex: {
-            std::string content = node->read();
+            ContentView content = node->readView();
             try {
-                return std::regex_search(content, std::regex(pattern));
+                return std::regex_search(content.data.begin(), content.data.end(), std::regex(pattern));
             } catch(...) {
                 return false;
             }
@@ -138,7 +138,7 @@ bool ContextFilter::matches(VfsNode* node, const std::string& path, Vfs& vfs) co
 }
 
 // ContextEntry token estimation
-size_t ContextEntry::estimate_tokens(const std::string& text){
+size_t ContextEntry::estimate_tokens(std::string_view text){
     // Rough estimate: ~4 chars per token (GPT-style tokenization)
     return (text.size() + 3) / 4;
 }
@@ -157,21 +157,43 @@ void ContextBuilder::collect(){
 }
 
 void ContextBuilder::collectFromPath(const std::string& root_path){
+    // Held for the walk: the parallel one reads nodes from worker threads
+    auto guard = vfs.readLock();
+    // Custom predicates are not known to be safe to call from several threads
+    bool sequential = std::any_of(filters.begin(), filters.end(), [](const ContextFilter& f){
+        return f.type == ContextFilter::Type::Custom;
+    });
+
     // Use resolveMulti to handle multiple overlays
     auto hits = vfs.resolveMulti(root_path);
     for(const auto& hit : hits){
-        if(hit.node){
-            visitNode(root_path, hit.node.get());
+        if(!hit.node) continue;
+        if(sequential){
+            TreeWalker().walk(hit.node, root_path, [&](const TreeWalker::Item& item){
+                visitNode(item.path, item.node.get(), entries);
+                return TreeWalker::Action::Descend;
+            });
+            continue;
         }
+        ParallelWalk walk(hit.node, root_path);
+        std::vector<std::vector<ContextEntry>> lanes(walk.lanes());
+        walk.run([&](const TreeWalker::Item& item){
+            visitNode(item.path, item.node.get(), lanes[item.lane]);
+            return TreeWalker::Action::Descend;
+        });
+        for(auto& lane : lanes)
+            for(auto& entry : lane) entries.push_back(std::move(entry));
     }
 }
 
-void ContextBuilder::visitNode(const std::string& path, VfsNode* node){
+void ContextBuilder::visitNode(const std::string& path, VfsNode* node, std::vector<ContextEntry>& out) const {
     if(!node) return;
 
     // Check if node matches any filter
     if(matchesAnyFilter(path, node)){
-        std::string content = node->read();
+        // Shared, not viewed: the entry outlives this pass, and a mapped host
+        // file may be truncated meanwhile
+        ContentView content = node->readShared();
         int priority = 100;  // Default priority
 
         // Higher priority for tagged nodes with "important" or "critical"
@@ -183,19 +205,9 @@ void ContextBuilder::visitNode(const std::string& path, VfsNode* node){
             else if(tags->count(important_id) > 0) priority = 150;
         }
 
-        ContextEntry entry(path, node, content, priority);
+        ContextEntry entry(path, node, std::move(content), priority);
         if(tags) entry.tags = *tags;
-        entries.push_back(std::move(entry));
-    }
-
-    // Recurse into children
-    if(node->isDir()){
-        for(const auto& [name, child] : node->children()){
-            std::string child_path = path;
-            if(child_path.back() != '/') child_path += '/';
-            child_path += name;
-            visitNode(child_path, child.get());
-        }
+        out.push_back(std::move(entry));
     }
 }
 
@@ -225,7 +237,7 @@ std::string ContextBuilder::build(){
             }
             oss << "\n";
         }
-        oss << entry.content << "\n\n";
+        oss << entry.content() << "\n\n";
         current_tokens += entry.token_estimate;
     }
 
@@ -314,7 +326,7 @@ std::string ContextBuilder::buildWithOptions(const ContextOptions& opts){
                 }
                 oss << "\n";
             }
-            oss << entry.content << "\n\n";
+            oss << entry.content() << "\n\n";
             current_tokens += entry.token_estimate;
         }
     }
@@ -337,15 +349,10 @@ std::string ContextBuilder::summarizeEntry(const ContextEntry& entry, size_t /*
     TRACE_FN("entry.vfs_path=", entry.vfs_path);
 
     // Simple summarization: take first and last portions
-    std::string content = entry.content;
-    std::vector<std::string> lines;
-    std::istringstream iss(content);
-    std::string line;
-    while(std::getline(iss, line)){
-        lines.push_back(line);
-    }
+    std::string_view content = entry.content();
+    std::vector<std::string_view> lines = split_line_views(content).lines;
 
-    if(lines.size() <= 20) return content;  // Too small to summarize
+    if(lines.size() <= 20) return std::string(content);  // Too small to summarize
 
     // Take first 10 and last 10 lines
     std::ostringstream oss;
@@ -365,9 +372,19 @@ void ContextBuilder::deduplicateEntries(){
 
     std::vector<ContextEntry> unique_entries;
     for(auto& entry : entries){
-        std::string content_hash = compute_string_hash(entry.content);
-        if(seen_content.find(content_hash) == seen_content.end()){
-            seen_content.insert(content_hash);
+        std::string_view content = entry.content();
+        auto& same_print = seen_content[contentFingerprint(content)];
+        bool dup = false;
+        for(const auto& seen : same_print){
+            // The same buffer (one node reached twice, or shared chunks) needs no compare
+            bool same_buffer = seen.data.data() == content.data() && seen.data.size() == content.size();
+            if(same_buffer || seen.data == content){
+                dup = true;
+                break;
+            }
+        }
+        if(!dup){
+            same_print.push_back(entry.data);
             unique_entries.push_back(std::move(entry));
         }
     }
@@ -403,7 +420,7 @@ std::pair<std::string, std::string> ContextBuilder::buildHierarchical(){
     for(const auto& entry : entries){
         if(current_tokens + entry.token_estimate > max_tokens) break;
         details_oss << "\n--- " << entry.vfs_path << " ---\n";
-        details_oss << entry.content << "\n";
+        details_oss << entry.content() << "\n";
         current_tokens += entry.token_estimate;
     }
 
@@ -517,6 +534,8 @@ ReplacementStrategy ReplacementStrategy::commentOut(const std::string& path, con
 bool ReplacementStrategy::apply(Vfs& vfs) const {
     auto node = vfs.resolve(target_path);
     if(!node) return false;
+    // Edited in place below, so detach it from any overlay snapshot first
+    node = vfs.resolveForWrite(target_path, vfs.resolveMulti(target_path).front().overlay_id);
 
     std::string content = node->read();
     std::istringstream iss(content);
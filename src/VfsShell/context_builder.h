@@ -44,16 +44,20 @@ struct ContextFilter {
 struct ContextEntry {
     std::string vfs_path;
     VfsNode* node;
-    std::string content;
+    ContentView data;       // Node content, shared with the VFS rather than copied
     size_t token_estimate;  // Rough estimate of tokens
     int priority;           // Higher priority = more important
     TagSet tags;            // Tags associated with this node
 
+    ContextEntry(std::string path, VfsNode* n, ContentView c, int prio = 100)
+        : vfs_path(std::move(path)), node(n), data(std::move(c)),
+          token_estimate(estimate_tokens(data.data)), priority(prio) {}
     ContextEntry(std::string path, VfsNode* n, std::string c, int prio = 100)
-        : vfs_path(std::move(path)), node(n), content(std::move(c)),
-          token_estimate(estimate_tokens(content)), priority(prio) {}
+        : ContextEntry(std::move(path), n, std::make_shared<const std::string>(std::move(c)), prio) {}
 
-    static size_t estimate_tokens(const std::string& text);
+    std::string_view content() const { return data.data; }
+
+    static size_t estimate_tokens(std::string_view text);
 };
 
 // Context builder for AI calls with token budgets and smart selection
@@ -108,7 +112,7 @@ struct ContextBuilder {
     void addCompoundFilter(FilterLogic logic, const std::vector<ContextFilter>& subfilters);
 
     // Fast XOR-based content fingerprinting for deduplication
-    static uint64_t contentFingerprint(const std::string& content) {
+    static uint64_t contentFingerprint(std::string_view content) {
         uint64_t hash = 0xcbf29ce484222325ULL;  // FNV-1a basis
         const uint64_t prime = 0x100000001b3ULL;
 
@@ -139,10 +143,12 @@ struct ContextBuilder {
     }
 
 private:
-    void visitNode(const std::string& path, VfsNode* node);
+    // Adds the entry for node, if the filters take it, to out
+    void visitNode(const std::string& path, VfsNode* node, std::vector<ContextEntry>& out) const;
     bool matchesAnyFilter(const std::string& path, VfsNode* node) const;
-    std::unordered_set<std::string> seen_content;  // For deduplication (fallback)
-    std::unordered_set<uint64_t> seen_fingerprints;  // Fast hash-based deduplication
+    // Content seen by deduplicateEntries, by fingerprint; the buffers are
+    // shared with the entries, so keeping them costs no copies
+    std::unordered_map<uint64_t, std::vector<ContentView>> seen_content;
 };
 
 // Code replacement strategy for determining what statements to remove/modify
@@ -162,6 +162,28 @@ std::string CppCompound::dump(int indent) const {
     for(auto& st: stmts) s += st->dump(indent+2);
     s += ind(indent) + "}\n"; return s;
 }
+// Copies share the statements and child nodes, which are frozen with them;
+// only the containers listed in ch are ever changed after creation
+template<typename T>
+static std::shared_ptr<T> clone_ast(const T& from, std::shared_ptr<T> copy){
+    copy->ch = from.ch;
+    for(auto& kv : copy->ch) kv.second->frozen = true;
+    return copy;
+}
+
+template<typename T, typename U>
+static void replace_ptr(std::shared_ptr<T>& slot, const VfsNode* old, const std::shared_ptr<U>& copy){
+    if(slot.get() == old) slot = std::static_pointer_cast<T>(copy);
+}
+
+std::shared_ptr<VfsNode> CppCompound::cloneForWrite() const {
+    auto copy = clone_ast(*this, std::make_shared<CppCompound>(name.str()));
+    copy->stmts = stmts;
+    return copy;
+}
+void CppCompound::childReplaced(const VfsNode* old, const std::shared_ptr<VfsNode>& copy){
+    for(auto& st : stmts) replace_ptr(st, old, copy);
+}
 CppFunction::CppFunction(std::string n, std::string rt, std::string nm)
     : CppNode(std::move(n)), retType(std::move(rt)), name(std::move(nm)) { kind=Kind::Ast; body=std::make_shared<CppCompound>("body"); }
 std::string CppFunction::dump(int indent) const {
@@ -169,6 +191,15 @@ std::string CppFunction::dump(int indent) const {
     for(size_t i=0;i<params.size();++i){ if(i) s += ", "; s += params[i].type + " " + params[i].name; }
     s += ")\n"; s += body->dump(indent); return s;
 }
+std::shared_ptr<VfsNode> CppFunction::cloneForWrite() const {
+    auto copy = clone_ast(*this, std::make_shared<CppFunction>(VfsNode::name.str(), retType, name));
+    copy->params = params;
+    copy->body = body;
+    return copy;
+}
+void CppFunction::childReplaced(const VfsNode* old, const std::shared_ptr<VfsNode>& copy){
+    replace_ptr(body, old, copy);
+}
 CppRangeFor::CppRangeFor(std::string n, std::string d, std::string r)
     : CppStmt(std::move(n)), decl(std::move(d)), range(std::move(r)), body(std::make_shared<CppCompound>("body")) { kind=Kind::Ast; }
 std::string CppRangeFor::dump(int indent) const {
@@ -176,6 +207,14 @@ std::string CppRangeFor::dump(int indent) const {
     s += body->dump(indent);
     return s;
 }
+std::shared_ptr<VfsNode> CppRangeFor::cloneForWrite() const {
+    auto copy = clone_ast(*this, std::make_shared<CppRangeFor>(name.str(), decl, range));
+    copy->body = body;
+    return copy;
+}
+void CppRangeFor::childReplaced(const VfsNode* old, const std::shared_ptr<VfsNode>& copy){
+    replace_ptr(body, old, copy);
+}
 CppTranslationUnit::CppTranslationUnit(std::string n) : CppNode(std::move(n)) { kind=Kind::Ast; }
 std::string CppTranslationUnit::dump(int) const {
     std::string s;
@@ -185,6 +224,16 @@ std::string CppTranslationUnit::dump(int) const {
     return s;
 }
 
+std::shared_ptr<VfsNode> CppTranslationUnit::cloneForWrite() const {
+    auto copy = clone_ast(*this, std::make_shared<CppTranslationUnit>(name.str()));
+    copy->includes = includes;
+    copy->funcs = funcs;
+    return copy;
+}
+void CppTranslationUnit::childReplaced(const VfsNode* old, const std::shared_ptr<VfsNode>& copy){
+    for(auto& fn : funcs) replace_ptr(fn, old, copy);
+}
+
 std::shared_ptr<CppTranslationUnit> expect_tu(std::shared_ptr<VfsNode> n){
     auto tu = std::dynamic_pointer_cast<CppTranslationUnit>(n);
     if(!tu) throw std::runtime_error("not a CppTranslationUnit node");
@@ -201,6 +250,16 @@ std::shared_ptr<CppCompound> expect_block(std::shared_ptr<VfsNode> n){
     if(auto loop = std::dynamic_pointer_cast<CppRangeFor>(n)) return loop->body;
     throw std::runtime_error("node does not own a compound body");
 }
+std::shared_ptr<CppCompound> writable_block(Vfs& vfs, const std::string& path, size_t overlayId){
+    auto n = vfs.resolveForWrite(path, overlayId);
+    if(std::dynamic_pointer_cast<CppFunction>(n) || std::dynamic_pointer_cast<CppRangeFor>(n)){
+        // The body is listed as the "body" child when the shell built the node
+        auto& ch = n->children();
+        if(ch.find(std::string_view("body")) != ch.end())
+            n = vfs.resolveForWrite(path == "/" ? "/body" : path + "/body", overlayId);
+    }
+    return expect_block(n);
+}
 void vfs_add(Vfs& vfs, const std::string& path, std::shared_ptr<VfsNode> node, size_t overlayId){
     std::string dir = path.substr(0, path.find_last_of('/'));
     if(dir.empty()) dir = "/";
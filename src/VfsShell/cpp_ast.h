@@ -78,9 +78,11 @@ struct CppVarDecl : CppStmt {
 struct CppCompound : CppStmt {
     std::vector<std::shared_ptr<CppStmt>> stmts;
     explicit CppCompound(std::string n);
-    std::map<std::string, std::shared_ptr<VfsNode>> ch;
+    ChildIndex ch;
     bool isDir() const override { return true; }
-    std::map<std::string, std::shared_ptr<VfsNode>>& children() override { return ch; }
+    ChildIndex& children() override { return ch; }
+    std::shared_ptr<VfsNode> cloneForWrite() const override;
+    void childReplaced(const VfsNode* old, const std::shared_ptr<VfsNode>& copy) override;
     std::string dump(int indent) const override;
 };
 struct CppParam { std::string type, name; };
@@ -88,33 +90,42 @@ struct CppFunction : CppNode {
     std::string retType, name;
     std::vector<CppParam> params;
     std::shared_ptr<CppCompound> body;
-    std::map<std::string, std::shared_ptr<VfsNode>> ch;
+    ChildIndex ch;
     CppFunction(std::string n, std::string rt, std::string nm);
     bool isDir() const override { return true; }
-    std::map<std::string, std::shared_ptr<VfsNode>>& children() override { return ch; }
+    ChildIndex& children() override { return ch; }
+    std::shared_ptr<VfsNode> cloneForWrite() const override;
+    void childReplaced(const VfsNode* old, const std::shared_ptr<VfsNode>& copy) override;
     std::string dump(int indent) const override;
 };
 struct CppRangeFor : CppStmt {
     std::string decl;
     std::string range;
     std::shared_ptr<CppCompound> body;
-    std::map<std::string, std::shared_ptr<VfsNode>> ch;
+    ChildIndex ch;
     CppRangeFor(std::string n, std::string d, std::string r);
     bool isDir() const override { return true; }
-    std::map<std::string, std::shared_ptr<VfsNode>>& children() override { return ch; }
+    ChildIndex& children() override { return ch; }
+    std::shared_ptr<VfsNode> cloneForWrite() const override;
+    void childReplaced(const VfsNode* old, const std::shared_ptr<VfsNode>& copy) override;
     std::string dump(int indent) const override;
 };
 struct CppTranslationUnit : CppNode {
     std::vector<std::shared_ptr<CppInclude>> includes;
     std::vector<std::shared_ptr<CppFunction>> funcs;
-    std::map<std::string, std::shared_ptr<VfsNode>> ch;
+    ChildIndex ch;
     explicit CppTranslationUnit(std::string n);
     bool isDir() const override { return true; }
-    std::map<std::string, std::shared_ptr<VfsNode>>& children() override { return ch; }
+    ChildIndex& children() override { return ch; }
+    std::shared_ptr<VfsNode> cloneForWrite() const override;
+    void childReplaced(const VfsNode* old, const std::shared_ptr<VfsNode>& copy) override;
     std::string dump(int) const override;
 };
 
 std::shared_ptr<CppTranslationUnit> expect_tu(std::shared_ptr<VfsNode> n);
 std::shared_ptr<CppCompound> expect_block(std::shared_ptr<VfsNode> n);
+// The block at path (a function's or loop's body for those), copied first
+// where it is shared with a snapshot
+std::shared_ptr<CppCompound> writable_block(Vfs& vfs, const std::string& path, size_t overlayId);
 void cpp_dump_to_vfs(Vfs& vfs, size_t overlayId, const std::string& tuPath, const std::string& filePath);
 std::shared_ptr<CppFunction> expect_fn(std::shared_ptr<VfsNode> n);
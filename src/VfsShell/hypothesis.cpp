@@ -152,7 +152,8 @@ std::vector<std::string> HypothesisTester::findFunctionDefinitions(const std::st
     auto node = vfs.resolve(path);
     if(!node) return functions;
 
-    std::string content = node->read();
+    ContentRef shared = node->readShared();
+    const std::string& content = *shared;
 
     // Simple pattern matching for function definitions
     // Looks for: "type name(...)" patterns
@@ -170,14 +171,14 @@ std::vector<std::string> HypothesisTester::findFunctionDefinitions(const std::st
 }
 
 // Helper: Find return paths in function content
-std::vector<std::string> HypothesisTester::findReturnPaths(const std::string& function_content){
+std::vector<std::string> HypothesisTester::findReturnPaths(std::string_view function_content){
     TRACE_FN();
     std::vector<std::string> paths;
 
     // Find all return statements
     std::regex return_regex(R"(\breturn\s+([^;]+);)");
-    std::smatch match;
-    std::string::const_iterator search_start(function_content.cbegin());
+    std::match_results<std::string_view::const_iterator> match;
+    auto search_start = function_content.cbegin();
 
     while(std::regex_search(search_start, function_content.cend(), match, return_regex)){
         paths.push_back(match[1].str());
@@ -216,7 +217,7 @@ HypothesisResult HypothesisTester::testErrorHandlingAddition(const std::string&
                 result.addFinding("Found function '" + func + "' in " + entry.vfs_path);
 
                 // Analyze return paths
-                auto returns = findReturnPaths(entry.content);
+                auto returns = findReturnPaths(entry.content());
                 result.addFinding("Found " + std::to_string(returns.size()) + " return paths");
 
                 // Propose error handling strategy
@@ -246,28 +247,25 @@ HypothesisResult HypothesisTester::testErrorHandlingAddition(const std::string&
 }
 
 // Helper: Check if two content blocks are similar
-bool HypothesisTester::contentSimilar(const std::string& a, const std::string& b, size_t min_lines){
-    TRACE_FN("min_lines=", min_lines);
-
-    // Split into lines
-    auto split = [](const std::string& s) -> std::vector<std::string> {
-        std::vector<std::string> lines;
-        std::istringstream iss(s);
-        std::string line;
-        while(std::getline(iss, line)){
-            // Trim whitespace for comparison
-            line.erase(0, line.find_first_not_of(" \t"));
-            line.erase(line.find_last_not_of(" \t") + 1);
-            if(!line.empty()){
-                lines.push_back(line);
-            }
-        }
-        return lines;
-    };
-
-    auto lines_a = split(a);
-    auto lines_b = split(b);
+// Helper: Non-empty lines trimmed of blanks, as views into s
+std::vector<std::string_view> HypothesisTester::similarityLines(std::string_view s){
+    std::vector<std::string_view> lines;
+    std::string_view rest = s;
+    while(!rest.empty()){
+        size_t nl = rest.find('\n');
+        std::string_view line = rest.substr(0, nl);
+        rest = nl == std::string_view::npos ? std::string_view() : rest.substr(nl + 1);
+        size_t b = line.find_first_not_of(" \t");
+        if(b == std::string_view::npos) continue;
+        line = line.substr(b, line.find_last_not_of(" \t") + 1 - b);
+        lines.push_back(line);
+    }
+    return lines;
+}
 
+bool HypothesisTester::linesSimilar(const std::vector<std::string_view>& lines_a,
+                                    const std::vector<std::string_view>& lines_b, size_t min_lines){
+    TRACE_FN("min_lines=", min_lines);
     if(lines_a.size() < min_lines || lines_b.size() < min_lines){
         return false;
     }
@@ -299,11 +297,15 @@ std::vector<std::pair<std::string, std::string>> HypothesisTester::findDuplicate
     context_builder.addFilter(ContextFilter::nodeKind(VfsNode::Kind::File));
     context_builder.collect();
 
-    // Compare each pair of files
+    // Compare each pair of files; lines are split once per file and point
+    // into the entries' shared content
     const auto& entries = context_builder.entries;
+    std::vector<std::vector<std::string_view>> lines;
+    lines.reserve(entries.size());
+    for(const auto& entry : entries) lines.push_back(similarityLines(entry.content()));
     for(size_t i = 0; i < entries.size(); ++i){
         for(size_t j = i + 1; j < entries.size(); ++j){
-            if(contentSimilar(entries[i].content, entries[j].content, min_lines)){
+            if(linesSimilar(lines[i], lines[j], min_lines)){
                 duplicates.emplace_back(entries[i].vfs_path, entries[j].vfs_path);
             }
         }
@@ -423,12 +425,12 @@ HypothesisResult HypothesisTester::testArchitecturePattern(const std::string& pa
         bool has_inheritance = false;
 
         for(const auto& entry : context_builder.entries){
-            if(entry.content.find("struct") != std::string::npos &&
-               entry.content.find("Node") != std::string::npos){
+            if(entry.content().find("struct") != std::string::npos &&
+               entry.content().find("Node") != std::string::npos){
                 has_ast_nodes = true;
             }
-            if(entry.content.find(": public") != std::string::npos ||
-               entry.content.find(": VfsNode") != std::string::npos){
+            if(entry.content().find(": public") != std::string::npos ||
+               entry.content().find(": VfsNode") != std::string::npos){
                 has_inheritance = true;
             }
         }
@@ -115,11 +115,13 @@ struct HypothesisTester {
 private:
     // Helper methods
     std::vector<std::string> findFunctionDefinitions(const std::string& path);
-    std::vector<std::string> findReturnPaths(const std::string& function_content);
+    std::vector<std::string> findReturnPaths(std::string_view function_content);
     std::vector<std::pair<std::string, std::string>> findDuplicateBlocks(
         const std::string& path, size_t min_lines);
     std::vector<std::string> findErrorPaths(const std::string& path);
-    bool contentSimilar(const std::string& a, const std::string& b, size_t min_lines);
+    static std::vector<std::string_view> similarityLines(std::string_view s);
+    static bool linesSimilar(const std::vector<std::string_view>& lines_a,
+                             const std::vector<std::string_view>& lines_b, size_t min_lines);
 };
 
 // Hypothesis test suite for all 5 levels
@@ -64,7 +64,7 @@ R"(Commands:
   rm <path>
   mv <src> <dst>
   link <src> <dst>
-  export <vfs> <host>
+  export <vfs> <host> (a directory exports its whole tree)
   cat [paths...] (tai stdin jos ei polkuja)
   grep [-i] <pattern> [path]
   rg [-i] <pattern> [path]
@@ -87,6 +87,9 @@ R"(Commands:
   ai.brief <key> [extra...]
   tools
   overlay.list
+  blob.stats                    (file contents shared across files and overlays)
+  overlay.stats [name] [-r]     (nodes and bytes held per overlay; -r recounts)
+  overlay.budget <name> [<bytes>[K|M|G] [warn|reject] | off]
   overlay.mount <name> <file>
   overlay.save <name> <file>
   overlay.unmount <name>
@@ -94,19 +97,21 @@ R"(Commands:
   overlay.use <name>
   solution.save [file]
   # Filesystem mounts
-  mount <host-path> <vfs-path>
+  mount [--prefetch[=depth]] <host-path> <vfs-path>
   mount.lib <lib-path> <vfs-path>
   mount.remote <host> <port> <remote-vfs-path> <local-vfs-path>
   mount.list
   mount.allow
   mount.disallow
   unmount <vfs-path>
+  watch [path [since-seq]]      (changes recorded under path after since-seq)
   # Tags (metadata for nodes)
   tag.add <vfs-path> <tag-name> [tag-name...]
   tag.remove <vfs-path> <tag-name> [tag-name...]
   tag.list [vfs-path]
   tag.clear <vfs-path>
   tag.has <vfs-path> <tag-name>
+  tag.find <tag-name> [tag-name...] [--all]  (paths carrying any, or all, of the tags)
   # Registry (Windows Registry-like key-value store)
   reg.set <key> <value>        (set registry key value)
   reg.get <key>                (get registry key value)
@@ -241,6 +246,14 @@ int qwen_protocol_tests();
 int qwen_state_tests();
 #endif
 
+#ifdef VFS_BENCH_ENABLED
+int vfs_bench(int argc, char** argv);
+#endif
+
+#ifdef VFS_TESTS_ENABLED
+int vfs_core_tests();
+#endif
+
 #ifndef CODEX_NO_MAIN
 int main(int argc, char** argv){
 	using namespace i18n;
@@ -278,6 +291,12 @@ int main(int argc, char** argv){
         if(arg == "--qwen-echo-server")			return qwen_echo_server();
         if(arg == "--qwen-protocol-tests")		return qwen_protocol_tests();
         if(arg == "--qwen-state-tests")			return qwen_state_tests();
+#endif
+#ifdef VFS_BENCH_ENABLED
+        if(arg == "--vfs-bench")				return vfs_bench(argc, argv);
+#endif
+#ifdef VFS_TESTS_ENABLED
+        if(arg == "--vfs-core-tests")			return vfs_core_tests();
 #endif
         if(arg == "--solution" || arg == "-S"){
             if(i + 1 >= argc) return usage("--solution requires a file path");
@@ -655,12 +674,12 @@ int main(int argc, char** argv){
         CommandResult result;
         const std::string& cmd = inv.name;
 
-        auto read_path = [&](const std::string& operand) -> std::string {
+        auto node_for_path = [&](const std::string& operand) -> std::shared_ptr<VfsNode> {
             std::string abs = normalize_path(cwd.path, operand);
             if(auto node = vfs.tryResolveForOverlay(abs, cwd.primary_overlay)){
                 if(node->kind == VfsNode::Kind::Dir)
                     throw std::runtime_error("cannot read directory: " + operand);
-                return node->read();
+                return node;
             }
             auto hits = vfs.resolveMulti(abs);
             if(hits.empty()) throw std::runtime_error("path not found: " + operand);
@@ -674,7 +693,59 @@ int main(int argc, char** argv){
             size_t chosen = select_overlay(vfs, cwd, overlays);
             auto node = vfs.resolveForOverlay(abs, chosen);
             if(node->kind == VfsNode::Kind::Dir) throw std::runtime_error("cannot read directory: " + operand);
-            return node->read();
+            return node;
+        };
+
+        auto read_shared = [&](const std::string& operand) -> ContentRef {
+            auto node = node_for_path(operand);
+            auto guard = vfs.readLock();
+            return node->readShared();
+        };
+
+        auto read_path = [&](const std::string& operand) -> std::string {
+            return *read_shared(operand);
+        };
+
+        // Contents without a copy, for commands that only scan them
+        auto read_view = [&](const std::string& operand) -> ContentView {
+            auto node = node_for_path(operand);
+            auto guard = vfs.readLock();
+            return node->readView();
+        };
+
+        // First take lines of a file, read a chunk at a time
+        auto read_head = [&](const std::string& operand, size_t take) -> std::string {
+            auto node = node_for_path(operand);
+            auto guard = vfs.readLock();
+            const size_t total = node->size();
+            std::string data;
+            size_t newlines = 0;
+            while(data.size() < total && newlines < take){
+                std::string part = node->readRange(data.size(), FileNode::CHUNK);
+                if(part.empty()) break;
+                newlines += std::count(part.begin(), part.end(), '\n');
+                data += part;
+            }
+            return data;
+        };
+
+        // Last take lines of a file, read a chunk at a time from the end
+        auto read_tail = [&](const std::string& operand, size_t take) -> std::string {
+            auto node = node_for_path(operand);
+            auto guard = vfs.readLock();
+            const size_t total = node->size();
+            size_t begin = total;
+            size_t newlines = 0;
+            while(begin > 0 && newlines <= take){
+                size_t n = std::min(begin, FileNode::CHUNK);
+                begin -= n;
+                std::string part = node->readRange(begin, n);
+                newlines += std::count(part.begin(), part.end(), '\n');
+            }
+            std::string data = node->readRange(begin, total - begin);
+            // Drop the partial line the first chunk started in
+            if(begin > 0) data.erase(0, data.find('\n') + 1);
+            return data;
         };
 
         if(cmd == "pwd"){
@@ -812,9 +883,18 @@ int main(int argc, char** argv){
             if(inv.args.empty()){
                 result.output = stdin_data;
             } else {
+                // Remote reads go out together and are collected in order
+                std::vector<std::future<RemoteSession::Reply>> remote(inv.args.size());
+                for(size_t i = 0; i < inv.args.size(); ++i){
+                    auto node = node_for_path(inv.args[i]);
+                    if(auto r = std::dynamic_pointer_cast<RemoteNode>(node)) remote[i] = r->readAsync();
+                }
                 std::ostringstream oss;
                 for(size_t i = 0; i < inv.args.size(); ++i){
-                    std::string data = read_path(inv.args[i]);
+                    ContentView content = remote[i].valid()
+                        ? ContentView(std::make_shared<const std::string>(RemoteSession::replyData(std::move(remote[i]))))
+                        : read_view(inv.args[i]);
+                    std::string_view data = content.data;
                     oss << data;
                     if(data.empty() || data.back() != '\n') oss << '\n';
                 }
@@ -831,20 +911,23 @@ int main(int argc, char** argv){
                 if(idx >= inv.args.size()) throw std::runtime_error("grep [-i] <pattern> [path]");
             }
             std::string pattern = inv.args[idx++];
-            std::string data = idx < inv.args.size() ? read_path(inv.args[idx]) : stdin_data;
-            auto lines = split_lines(data);
+            ContentView file_data = idx < inv.args.size() ? read_view(inv.args[idx]) : ContentView(stdin_data, nullptr);
+            auto lines = split_line_views(file_data.data);
             std::ostringstream oss;
             bool matched = false;
             std::string needle = pattern;
             if(ignore_case){
                 std::transform(needle.begin(), needle.end(), needle.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
             }
+            std::string lowered;
             for(size_t i = 0; i < lines.lines.size(); ++i){
-                std::string hay = lines.lines[i];
+                std::string_view hay = lines.lines[i];
                 if(ignore_case){
-                    std::transform(hay.begin(), hay.end(), hay.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+                    lowered.assign(hay);
+                    std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+                    hay = lowered;
                 }
-                if(hay.find(needle) != std::string::npos){
+                if(hay.find(needle) != std::string_view::npos){
                     matched = true;
                     oss << lines.lines[i];
                     bool had_newline = (i < lines.lines.size() - 1) || lines.trailing_newline;
@@ -872,12 +955,12 @@ int main(int argc, char** argv){
             } catch(const std::regex_error& e){
                 throw std::runtime_error(std::string("rg regex error: ") + e.what());
             }
-            std::string data = idx < inv.args.size() ? read_path(inv.args[idx]) : stdin_data;
-            auto lines = split_lines(data);
+            ContentView file_data = idx < inv.args.size() ? read_view(inv.args[idx]) : ContentView(stdin_data, nullptr);
+            auto lines = split_line_views(file_data.data);
             std::ostringstream oss;
             bool matched = false;
             for(size_t i = 0; i < lines.lines.size(); ++i){
-                if(std::regex_search(lines.lines[i], re)){
+                if(std::regex_search(lines.lines[i].begin(), lines.lines[i].end(), re)){
                     matched = true;
                     oss << lines.lines[i];
                     bool had_newline = (i < lines.lines.size() - 1) || lines.trailing_newline;
@@ -888,8 +971,8 @@ int main(int argc, char** argv){
             result.success = matched;
 
         } else if(cmd == "count"){
-            std::string data = inv.args.empty() ? stdin_data : read_path(inv.args[0]);
-            size_t lines = count_lines(data);
+            ContentView file_data = inv.args.empty() ? ContentView(stdin_data, nullptr) : read_view(inv.args[0]);
+            size_t lines = count_lines(file_data.data);
             result.output = std::to_string(lines) + "\n";
 
         } else if(cmd == "history"){
@@ -994,7 +1077,7 @@ int main(int argc, char** argv){
                     ++idx;
                 }
             }
-            std::string data = idx < inv.args.size() ? read_path(inv.args[idx]) : stdin_data;
+            std::string data = idx < inv.args.size() ? read_tail(inv.args[idx], take) : stdin_data;
             auto lines = split_lines(data);
             size_t total = lines.lines.size();
             size_t begin = take >= total ? 0 : total - take;
@@ -1016,7 +1099,7 @@ int main(int argc, char** argv){
                     ++idx;
                 }
             }
-            std::string data = idx < inv.args.size() ? read_path(inv.args[idx]) : stdin_data;
+            std::string data = idx < inv.args.size() ? read_head(inv.args[idx], take) : stdin_data;
             auto lines = split_lines(data);
             size_t end = std::min(take, lines.lines.size());
             result.output = join_line_range(lines, 0, end);
@@ -1078,11 +1161,18 @@ int main(int argc, char** argv){
 
         } else if(cmd == "export"){
             if(inv.args.size() < 2) throw std::runtime_error("export <vfs> <host>");
-            std::string data = read_path(inv.args[0]);
-            std::ofstream out(inv.args[1], std::ios::binary);
-            if(!out) throw std::runtime_error("export: cannot open host file");
-            out.write(data.data(), static_cast<std::streamsize>(data.size()));
-            std::cout << "export -> " << inv.args[1] << "\n";
+            auto dir = vfs.tryResolveForOverlay(normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay);
+            if(dir && dir->isDir()){
+                auto result = export_tree(vfs, dir, inv.args[1]);
+                std::cout << "export -> " << inv.args[1] << " (" << result.files << " files, "
+                          << HostIoBatch::backendName(result.backend) << ")\n";
+            } else {
+                std::string data = read_path(inv.args[0]);
+                std::ofstream out(inv.args[1], std::ios::binary);
+                if(!out) throw std::runtime_error("export: cannot open host file");
+                out.write(data.data(), static_cast<std::streamsize>(data.size()));
+                std::cout << "export -> " << inv.args[1] << "\n";
+            }
 
         } else if(cmd == "parse"){
             if(inv.args.size() < 2) throw std::runtime_error("parse <src> <dst>");
@@ -1292,6 +1382,74 @@ int main(int argc, char** argv){
             std::cout << tools;
             if(tools.empty() || tools.back() != '\n') std::cout << '\n';
 
+        } else if(cmd == "blob.stats"){
+            auto st = vfs.blobs.stats();
+            auto kb = [](size_t b){ return std::to_string(b / 1024) + " KB"; };
+            std::cout << "blobs: " << st.blobs << " (" << kb(st.unique_bytes) << ")"
+                      << ", references: " << st.refs << " (" << kb(st.logical_bytes) << ")"
+                      << ", saved: " << kb(st.savedBytes()) << "\n";
+            std::cout << "interned: " << st.lookups << " lookups, " << st.hits << " hits\n";
+
+        } else if(cmd == "overlay.stats"){
+            bool recount = false;
+            std::optional<size_t> only;
+            for(const auto& arg : inv.args){
+                if(arg == "-r") recount = true;
+                else {
+                    only = vfs.findOverlayByName(arg);
+                    if(!only) throw std::runtime_error("overlay: unknown overlay");
+                }
+            }
+            auto kb = [](size_t b){ return std::to_string((b + 1023) / 1024) + " KB"; };
+            for(size_t i = 0; i < vfs.overlayCount(); ++i){
+                if(only && *only != i) continue;
+                auto u = recount ? vfs.recountOverlay(i) : vfs.overlayUsage(i);
+                std::cout << "[" << i << "] " << vfs.overlayName(i) << ": " << u.nodes << " nodes ("
+                          << u.dirs << " dirs, " << u.files << " files, " << u.ast_nodes << " ast)"
+                          << ", content " << kb(u.content_bytes) << ", ast " << kb(u.ast_bytes)
+                          << ", nodes " << kb(u.node_bytes) << ", tags " << u.tagged_nodes
+                          << " (" << kb(u.tag_bytes) << "), total " << kb(u.total());
+                auto budget = vfs.overlayBudget(i);
+                if(budget.limit){
+                    std::cout << ", budget " << kb(budget.limit)
+                              << (budget.policy == Vfs::BudgetPolicy::Reject ? " (reject)" : " (warn)");
+                }
+                std::cout << "\n";
+            }
+
+        } else if(cmd == "overlay.budget"){
+            if(inv.args.empty()) throw std::runtime_error("overlay.budget <name> [<bytes>[K|M|G] [warn|reject] | off]");
+            auto idOpt = vfs.findOverlayByName(inv.args[0]);
+            if(!idOpt) throw std::runtime_error("overlay: unknown overlay");
+            Vfs::OverlayBudget budget = vfs.overlayBudget(*idOpt);
+            if(inv.args.size() > 1){
+                std::string limit = inv.args[1];
+                if(limit == "off"){
+                    budget = Vfs::OverlayBudget();
+                } else {
+                    size_t unit = 1;
+                    char suffix = limit.empty() ? '\0' : static_cast<char>(std::toupper(static_cast<unsigned char>(limit.back())));
+                    if(suffix == 'K') unit = 1024;
+                    else if(suffix == 'M') unit = 1024 * 1024;
+                    else if(suffix == 'G') unit = 1024 * 1024 * 1024;
+                    if(unit != 1) limit.pop_back();
+                    budget.limit = parse_size_arg(limit, "budget") * unit;
+                    if(inv.args.size() > 2){
+                        if(inv.args[2] == "warn") budget.policy = Vfs::BudgetPolicy::Warn;
+                        else if(inv.args[2] == "reject") budget.policy = Vfs::BudgetPolicy::Reject;
+                        else throw std::runtime_error("overlay.budget: policy must be warn or reject");
+                    }
+                }
+                vfs.setOverlayBudget(*idOpt, budget);
+            }
+            if(budget.limit){
+                std::cout << "overlay " << inv.args[0] << " budget: " << budget.limit << " bytes ("
+                          << (budget.policy == Vfs::BudgetPolicy::Reject ? "reject" : "warn") << "), using "
+                          << vfs.overlayUsage(*idOpt).total() << "\n";
+            } else {
+                std::cout << "overlay " << inv.args[0] << " budget: none\n";
+            }
+
         } else if(cmd == "overlay.list"){
             for(size_t i = 0; i < vfs.overlayCount(); ++i){
                 bool in_scope = std::find(cwd.overlays.begin(), cwd.overlays.end(), i) != cwd.overlays.end();
@@ -1350,11 +1508,23 @@ int main(int argc, char** argv){
             adjust_context_after_unmount(vfs, cwd, *idOpt);
 
         } else if(cmd == "mount"){
-            if(inv.args.size() < 2) throw std::runtime_error("mount <host-path> <vfs-path>");
-            std::string host_path = inv.args[0];
-            std::string vfs_path = normalize_path(cwd.path, inv.args[1]);
+            const char* usage = "mount [--prefetch[=depth]] <host-path> <vfs-path>";
+            std::vector<std::string> paths;
+            std::optional<size_t> prefetch_depth;
+            for(const auto& arg : inv.args){
+                if(arg == "--prefetch") prefetch_depth = 0;
+                else if(arg.rfind("--prefetch=", 0) == 0) prefetch_depth = parse_size_arg(arg.substr(11), "prefetch depth");
+                else paths.push_back(arg);
+            }
+            if(paths.size() < 2) throw std::runtime_error(usage);
+            std::string host_path = paths[0];
+            std::string vfs_path = normalize_path(cwd.path, paths[1]);
             vfs.mountFilesystem(host_path, vfs_path, cwd.primary_overlay);
             std::cout << "mounted " << host_path << " -> " << vfs_path << "\n";
+            if(prefetch_depth){
+                vfs.prefetchMount(vfs_path, *prefetch_depth);
+                std::cout << "prefetching " << vfs_path << " in the background (progress in mount.list)\n";
+            }
 
         } else if(cmd == "mount.lib"){
             if(inv.args.size() < 2) throw std::runtime_error("mount.lib <lib-path> <vfs-path>");
@@ -1385,6 +1555,21 @@ int main(int argc, char** argv){
                         case Vfs::MountType::Remote: type_marker = "r "; break;
                     }
                     std::cout << type_marker << m.vfs_path << " <- " << m.host_path << "\n";
+                    if(m.prefetch){
+                        auto p = m.prefetch->progress();
+                        std::cout << "    prefetch " << (p.done ? "done" : "running") << ": " << p.dirs << " dirs, "
+                                  << p.files << " files, " << (p.bytes >> 10) << " KB read ahead";
+                        if(p.errors) std::cout << ", " << p.errors << " errors";
+                        std::cout << " (" << static_cast<long>(p.seconds * 1000) << " ms)\n";
+                    }
+                    if(auto remote = std::dynamic_pointer_cast<RemoteNode>(m.mount_node)){
+                        auto pool = remote->session->poolStats();
+                        auto cache = remote->session->cacheStats();
+                        std::cout << "    connections: " << pool.open << " open of " << pool.size << ", " << pool.requests
+                                  << " requests, " << pool.reconnects << " reconnects, " << pool.failed_checks
+                                  << " failed checks; cache: " << cache.hits << " hits, " << cache.misses << " misses, "
+                                  << cache.invalidations << " invalidations\n";
+                    }
                 }
             }
             std::cout << "mounting " << (vfs.isMountAllowed() ? "allowed" : "disabled") << "\n";
@@ -1403,6 +1588,19 @@ int main(int argc, char** argv){
             vfs.unmount(vfs_path);
             std::cout << "unmounted " << vfs_path << "\n";
 
+        } else if(cmd == "watch"){
+            std::string prefix = inv.args.empty() ? std::string("/") : normalize_path(cwd.path, inv.args[0]);
+            uint64_t since = inv.args.size() > 1 ? std::stoull(inv.args[1]) : 0;
+            if(since + 1 < vfs.journal.firstSeq())
+                std::cout << "# events before " << vfs.journal.firstSeq() << " dropped\n";
+            for(const auto& ev : vfs.journal.since(since, prefix)){
+                std::cout << ev.seq << " " << VfsEvent::kindName(ev.kind) << " " << ev.path;
+                if(!ev.to.empty()) std::cout << " -> " << ev.to;
+                if(ev.overlay < vfs.overlayCount()) std::cout << " [" << vfs.overlayName(ev.overlay) << "]";
+                std::cout << "\n";
+            }
+            std::cout << "# seq " << vfs.journal.lastSeq() << "\n";
+
         } else if(cmd == "tag.add"){
             if(inv.args.size() < 2) throw std::runtime_error("tag.add <vfs-path> <tag-name> [tag-name...]");
             std::string vfs_path = normalize_path(cwd.path, inv.args[0]);
@@ -1459,6 +1657,18 @@ int main(int argc, char** argv){
             bool has = vfs.nodeHasTag(vfs_path, inv.args[1]);
             std::cout << vfs_path << (has ? " has " : " does not have ") << "tag '" << inv.args[1] << "'\n";
 
+        } else if(cmd == "tag.find"){
+            bool match_all = false;
+            std::vector<std::string> names;
+            for(const auto& arg : inv.args){
+                if(arg == "--all") match_all = true;
+                else names.push_back(arg);
+            }
+            if(names.empty()) throw std::runtime_error("tag.find <tag-name> [tag-name...] [--all]");
+            auto paths = names.size() == 1 ? vfs.findNodesByTag(names[0])
+                                           : vfs.findNodesByTags(names, match_all);
+            for(const auto& path : paths) std::cout << path << "\n";
+
         } else if(cmd == "logic.init"){
             vfs.logic_engine.addHardcodedRules();
             std::cout << "initialized logic engine with " << vfs.logic_engine.rules.size() << " hardcoded rules\n";
@@ -2191,8 +2401,7 @@ int main(int argc, char** argv){
 
                         auto parent = vfs.tryResolveForOverlay(planner.current_path, cwd.primary_overlay);
                         if(parent && parent->isDir()){
-                            parent->children()[hyp_node->name] = hyp_node;
-                            hyp_node->parent = parent;
+                            vfs.addNode(planner.current_path, hyp_node, cwd.primary_overlay);
                             std::string hyp_path = planner.current_path + "/" + hyp_name;
                             std::cout << "✅ Created hypothesis node at: " << hyp_path << "\n";
                             planner.addToContext(hyp_path);
@@ -2531,9 +2740,8 @@ int main(int argc, char** argv){
             try {
                 if(plan_file.is_relative()) plan_file = std::filesystem::absolute(plan_file);
 
-                // Create a temporary overlay to hold the /plan tree
+                // Build the /plan tree first, then register it as a temporary overlay
                 auto temp_root = std::make_shared<DirNode>("/");
-                auto temp_overlay_id = vfs.registerOverlay("_plan_temp", temp_root);
 
                 // Copy /plan tree content to the temporary overlay
                 auto hits = vfs.resolveMulti("/plan");
@@ -2562,6 +2770,7 @@ int main(int argc, char** argv){
                     clone_tree("/plan", plan_node);
                 }
 
+                auto temp_overlay_id = vfs.registerOverlay("_plan_temp", temp_root);
                 save_overlay_to_file(vfs, temp_overlay_id, plan_file.string());
                 vfs.unregisterOverlay(temp_overlay_id);
                 std::cout << "saved plan tree to " << plan_file.string() << "\n";
@@ -2997,7 +3206,7 @@ int main(int argc, char** argv){
         } else if(cmd == "cpp.include"){
             if(inv.args.size() < 2) throw std::runtime_error("cpp.include <tu> <header> [angled]");
             std::string absTu = normalize_path(cwd.path, inv.args[0]);
-            auto tu = expect_tu(vfs.resolveForOverlay(absTu, cwd.primary_overlay));
+            auto tu = expect_tu(vfs.resolveForWrite(absTu, cwd.primary_overlay));
             int angled = 0;
             if(inv.args.size() > 2){
                 try{
@@ -3013,7 +3222,7 @@ int main(int argc, char** argv){
         } else if(cmd == "cpp.func"){
             if(inv.args.size() < 3) throw std::runtime_error("cpp.func <tu> <name> <ret>");
             std::string absTu = normalize_path(cwd.path, inv.args[0]);
-            auto tu = expect_tu(vfs.resolveForOverlay(absTu, cwd.primary_overlay));
+            auto tu = expect_tu(vfs.resolveForWrite(absTu, cwd.primary_overlay));
             auto fn = std::make_shared<CppFunction>(inv.args[1], inv.args[2], inv.args[1]);
             std::string fnPath = join_path(absTu, inv.args[1]);
             vfs_add(vfs, fnPath, fn, cwd.primary_overlay);
@@ -3023,13 +3232,13 @@ int main(int argc, char** argv){
 
         } else if(cmd == "cpp.param"){
             if(inv.args.size() < 3) throw std::runtime_error("cpp.param <fn> <type> <name>");
-            auto fn = expect_fn(vfs.resolveForOverlay(normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay));
+            auto fn = expect_fn(vfs.resolveForWrite(normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay));
             fn->params.push_back(CppParam{inv.args[1], inv.args[2]});
             std::cout << "+param " << inv.args[1] << " " << inv.args[2] << "\n";
 
         } else if(cmd == "cpp.print"){
             if(inv.args.empty()) throw std::runtime_error("cpp.print <scope> <text>");
-            auto block = expect_block(vfs.resolveForOverlay(normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay));
+            auto block = writable_block(vfs, normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay);
             std::string text = unescape_meta(join_args(inv.args, 1));
             auto s = std::make_shared<CppString>("s", text);
             auto chain = std::vector<std::shared_ptr<CppExpr>>{ s, std::make_shared<CppId>("endl", "std::endl") };
@@ -3039,14 +3248,14 @@ int main(int argc, char** argv){
 
         } else if(cmd == "cpp.returni"){
             if(inv.args.size() < 2) throw std::runtime_error("cpp.returni <scope> <int>");
-            auto block = expect_block(vfs.resolveForOverlay(normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay));
+            auto block = writable_block(vfs, normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay);
             long long value = std::stoll(inv.args[1]);
             block->stmts.push_back(std::make_shared<CppReturn>("ret", std::make_shared<CppInt>("i", value)));
             std::cout << "+return " << value << "\n";
 
         } else if(cmd == "cpp.return"){
             if(inv.args.empty()) throw std::runtime_error("cpp.return <scope> [expr]");
-            auto block = expect_block(vfs.resolveForOverlay(normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay));
+            auto block = writable_block(vfs, normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay);
             std::string trimmed = unescape_meta(trim_copy(join_args(inv.args, 1)));
             std::shared_ptr<CppExpr> expr;
             if(!trimmed.empty()) expr = std::make_shared<CppRawExpr>("rexpr", trimmed);
@@ -3055,13 +3264,13 @@ int main(int argc, char** argv){
 
         } else if(cmd == "cpp.expr"){
             if(inv.args.empty()) throw std::runtime_error("cpp.expr <scope> <expr>");
-            auto block = expect_block(vfs.resolveForOverlay(normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay));
+            auto block = writable_block(vfs, normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay);
             block->stmts.push_back(std::make_shared<CppExprStmt>("expr", std::make_shared<CppRawExpr>("rexpr", unescape_meta(join_args(inv.args, 1)))));
             std::cout << "+expr " << inv.args[0] << "\n";
 
         } else if(cmd == "cpp.vardecl"){
             if(inv.args.size() < 3) throw std::runtime_error("cpp.vardecl <scope> <type> <name> [init]");
-            auto block = expect_block(vfs.resolveForOverlay(normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay));
+            auto block = writable_block(vfs, normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay);
             std::string init = unescape_meta(trim_copy(join_args(inv.args, 3)));
             bool hasInit = !init.empty();
             block->stmts.push_back(std::make_shared<CppVarDecl>("var", inv.args[1], inv.args[2], init, hasInit));
@@ -3069,7 +3278,7 @@ int main(int argc, char** argv){
 
         } else if(cmd == "cpp.stmt"){
             if(inv.args.empty()) throw std::runtime_error("cpp.stmt <scope> <stmt>");
-            auto block = expect_block(vfs.resolveForOverlay(normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay));
+            auto block = writable_block(vfs, normalize_path(cwd.path, inv.args[0]), cwd.primary_overlay);
             block->stmts.push_back(std::make_shared<CppRawStmt>("stmt", unescape_meta(join_args(inv.args, 1))));
             std::cout << "+stmt " << inv.args[0] << "\n";
 
@@ -3082,7 +3291,7 @@ int main(int argc, char** argv){
             std::string range = unescape_meta(trim_copy(rest.substr(bar + 1)));
             if(decl.empty() || range.empty()) throw std::runtime_error("cpp.rangefor missing decl or range");
             std::string absScope = normalize_path(cwd.path, inv.args[0]);
-            auto block = expect_block(vfs.resolveForOverlay(absScope, cwd.primary_overlay));
+            auto block = writable_block(vfs, absScope, cwd.primary_overlay);
             auto loop = std::make_shared<CppRangeFor>(inv.args[1], decl, range);
             block->stmts.push_back(loop);
             std::string loopPath = join_path(absScope, inv.args[1]);
@@ -5431,21 +5640,26 @@ int main(int argc, char** argv){
         for(size_t i = 0; i < pipeline.commands.size(); ++i){
             last = execute_single(pipeline.commands[i], next_input);
             if(last.exit_requested) return last;
-            next_input = last.output;
+            // Hand the output on; only the last command's output is used after the loop
+            if(i + 1 < pipeline.commands.size()) next_input = std::move(last.output);
         }
 
         // Handle output redirection
         if(!pipeline.output_redirect.empty()){
             std::string abs_path = normalize_path(cwd.path, pipeline.output_redirect);
             if(pipeline.redirect_append){
-                // >> append to file
-                std::string existing;
-                try {
-                    existing = vfs.read(abs_path, std::nullopt);
-                } catch(...) {
-                    // File doesn't exist yet, that's ok
+                // >> append to file; a file only another overlay holds is
+                // copied into the primary one first
+                if(!vfs.tryResolveForOverlay(abs_path, cwd.primary_overlay)){
+                    std::optional<std::string> existing;
+                    try {
+                        existing = vfs.read(abs_path, std::nullopt);
+                    } catch(...) {
+                        // File doesn't exist yet, that's ok
+                    }
+                    if(existing) vfs.write(abs_path, *existing, cwd.primary_overlay);
                 }
-                vfs.write(abs_path, existing + last.output, cwd.primary_overlay);
+                vfs.append(abs_path, last.output, cwd.primary_overlay);
             } else {
                 // > overwrite file
                 vfs.write(abs_path, last.output, cwd.primary_overlay);
@@ -5,11 +5,11 @@
 //
 struct PlanNode : AstNode {
     std::string content;  // Text content for the plan node
-    std::map<std::string, std::shared_ptr<VfsNode>> ch;
+    ChildIndex ch;
 
     PlanNode(std::string n, std::string c = "") : AstNode(std::move(n)), content(std::move(c)) {}
     bool isDir() const override { return true; }
-    std::map<std::string, std::shared_ptr<VfsNode>>& children() override { return ch; }
+    ChildIndex& children() override { return ch; }
     Value eval(std::shared_ptr<Env>) override { return Value::S(content); }
     std::string read() const override { return content; }
     void write(const std::string& s) override { content = s; }
@@ -1410,30 +1410,74 @@ void QwenManager::stop_accounts_json_watcher() {
 // Thread function for watching ACCOUNTS.json file changes
 void QwenManager::accounts_json_watcher_thread() {
     // Initial delay of 10 seconds as specified
-    std::this_thread::sleep_for(std::chrono::seconds(10));
+    {
+        std::unique_lock<std::mutex> lock(watcher_mutex_);
+        if (stop_cv_.wait_for(lock, std::chrono::seconds(10), [this] { return !accounts_watcher_running_; })) {
+            return;
+        }
+    }
     
     std::string last_content;
+    VfsJournal::WatchId watch_id = 0;
+
+    // The VFS journal only sees edits made through the VFS; an edit of the
+    // host file (mounted, or the fallback load_instructions_from_file reads)
+    // is caught by a slow mtime poll
+    std::string host_path = "ACCOUNTS.json";
+    auto read_accounts = [this, &host_path]() {
+        if (vfs_) {
+            try {
+                return vfs_->read("ACCOUNTS.json");
+            } catch (const std::runtime_error&) {
+                // Not in the VFS, try the host file
+            }
+        }
+        std::ifstream file(host_path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    };
+    auto host_mtime = [&host_path]() {
+        std::error_code ec;
+        auto t = std::filesystem::last_write_time(host_path, ec);
+        return ec ? std::filesystem::file_time_type::min() : t;
+    };
 
     if (vfs_) {
-        try {
-            last_content = vfs_->read("ACCOUNTS.json");
-        } catch (const std::runtime_error&) {
-            // File doesn't exist yet
+        // Woken by VFS change events instead of rereading the file on a timer.
+        // The callback runs under the VFS write lock, so it only flags the change.
+        watch_id = vfs_->journal.watch("/ACCOUNTS.json", [this](const VfsEvent&) {
+            std::lock_guard<std::mutex> lock(watcher_mutex_);
+            accounts_changed_ = true;
+            stop_cv_.notify_all();
+        });
+        if (auto mount = std::dynamic_pointer_cast<MountNode>(vfs_->tryResolveForOverlay("/ACCOUNTS.json", 0))) {
+            host_path = mount->host_path;
         }
     }
+    last_content = read_accounts();
+    auto last_mtime = host_mtime();
     
     std::cout << "[QwenManager] ACCOUNTS.json watcher started\n";
     
     while (accounts_watcher_running_) {
-        // Check if the file has been modified
-        std::string current_content;
-        if (vfs_) {
-            try {
-                current_content = vfs_->read("ACCOUNTS.json");
-            } catch (const std::runtime_error&) {
-                // File doesn't exist yet
+        {
+            std::unique_lock<std::mutex> lock(watcher_mutex_);
+            bool woken = stop_cv_.wait_for(lock, std::chrono::seconds(5),
+                                           [this] { return !accounts_watcher_running_ || accounts_changed_; });
+            if (!accounts_watcher_running_) {
+                // Stop requested
+                break;
+            }
+            accounts_changed_ = false;
+            if (!woken) {
+                // Poll: reread only when the host file's mtime moved
+                auto mtime = host_mtime();
+                if (mtime == last_mtime) continue;
+                last_mtime = mtime;
             }
         }
+
+        // Check if the file has been modified
+        std::string current_content = read_accounts();
         
         if (current_content != last_content) {
             std::cout << "[QwenManager] ACCOUNTS.json has been modified, reloading configuration\n";
@@ -1450,15 +1494,11 @@ void QwenManager::accounts_json_watcher_thread() {
                 }
             }
         }
-        
-        // Check every 5 seconds
-        std::unique_lock<std::mutex> lock(watcher_mutex_);
-        if (stop_cv_.wait_for(lock, std::chrono::seconds(5), [this] { return !accounts_watcher_running_; })) {
-            // Stop requested
-            break;
-        }
     }
     
+    if (vfs_ && watch_id) {
+        vfs_->journal.unwatch(watch_id);
+    }
     std::cout << "[QwenManager] ACCOUNTS.json watcher stopped\n";
 }
 
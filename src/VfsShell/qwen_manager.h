@@ -228,6 +228,7 @@ private:
     std::condition_variable stop_cv_;
     std::mutex stop_mutex_;
     std::mutex watcher_mutex_;
+    bool accounts_changed_ = false;  // set by the VFS watch, guarded by watcher_mutex_
 
 
 
@@ -499,6 +499,13 @@ std::string QwenStateManager::store_file(const std::string& session_id, const st
     std::string file_path = files_dir + "/" + filename;
 
     try {
+        // The VFS interns the content, so versions and sessions holding the
+        // same file share one buffer; an unchanged file is not rewritten
+        try {
+            if (*vfs_->readShared(file_path, 0) == content) return file_path;
+        } catch (...) {
+            // Not stored yet
+        }
         vfs_->write(file_path, content, 0);
         session_dirty_ = true;
         return file_path;
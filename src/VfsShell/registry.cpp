@@ -257,6 +257,83 @@ void Registry::integrateWithVFS(Vfs& vfs) {
     
     // Sync from VFS to registry
     syncFromVFS(vfs);
+
+    // Keep following edits made through the VFS
+    watchVFS(vfs);
+}
+
+void Registry::watchVFS(Vfs& vfs, const std::string& registry_path) {
+    vfs.journal.watch(registry_path, [this, &vfs, registry_path](const VfsEvent& ev) {
+        if (!syncing_to_vfs) {
+            applyVFSEvent(vfs, ev, registry_path);
+        }
+    });
+}
+
+void Registry::applyVFSEvent(Vfs& vfs, const VfsEvent& ev, const std::string& registry_path) {
+    auto under = [&](const std::string& p) { return VfsJournal::underPrefix(p, registry_path); };
+    switch (ev.kind) {
+        case VfsEvent::Kind::Create:
+        case VfsEvent::Kind::Write:
+            if (under(ev.path)) {
+                loadFromVFS(vfs, ev.path, ev.overlay, registry_path);
+            }
+            break;
+        case VfsEvent::Kind::Remove:
+            if (under(ev.path)) {
+                forgetPath(ev.path.substr(registry_path.size()));
+            }
+            break;
+        case VfsEvent::Kind::Move:
+            if (under(ev.path)) {
+                forgetPath(ev.path.substr(registry_path.size()));
+            }
+            if (under(ev.to)) {
+                loadFromVFS(vfs, ev.to, ev.overlay, registry_path);
+            }
+            break;
+    }
+}
+
+void Registry::loadFromVFS(Vfs& vfs, const std::string& vfs_path, size_t overlay_id, const std::string& registry_path) {
+    auto node = vfs.tryResolveForOverlay(vfs_path, overlay_id);
+    if (!node) {
+        return;
+    }
+    std::string reg_path = vfs_path.substr(registry_path.size());
+    if (!node->isDir()) {
+        setValue(reg_path, node->read());
+        return;
+    }
+    // A directory is a key; load what it already holds, e.g. after a move
+    auto key = root;
+    std::stringstream ss(reg_path);
+    std::string item;
+    while (std::getline(ss, item, '/')) {
+        if (!item.empty()) {
+            key = key->addSubKey(item);
+        }
+    }
+    auto children = node->listing();
+    for (const auto& [name, child] : *children) {
+        loadFromVFS(vfs, vfs_path + "/" + name, overlay_id, registry_path);
+    }
+}
+
+void Registry::forgetPath(const std::string& reg_path) {
+    size_t slash = reg_path.find_last_of('/');
+    if (slash == std::string::npos) {
+        // The registry directory itself
+        root->values.clear();
+        root->subkeys.clear();
+        return;
+    }
+    auto key = root->navigateTo(reg_path.substr(0, slash));
+    if (key) {
+        std::string name = reg_path.substr(slash + 1);
+        key->values.erase(name);
+        key->subkeys.erase(name);
+    }
 }
 
 void Registry::syncFromVFS(Vfs& vfs, const std::string& registry_path) {
@@ -290,6 +367,12 @@ void Registry::syncFromVFS(Vfs& vfs, const std::string& registry_path) {
 }
 
 void Registry::syncToVFS(Vfs& vfs, const std::string& registry_path) const {
+    syncing_to_vfs = true;
+    struct Reset {
+        bool& flag;
+        ~Reset() { flag = false; }
+    } reset{syncing_to_vfs};
+
     // First ensure the registry path exists in VFS
     vfs.ensureDir(registry_path, 0);
     
@@ -299,38 +382,32 @@ void Registry::syncToVFS(Vfs& vfs, const std::string& registry_path) const {
         vfs.write(full_path, value_data, 0);
     }
     
-    // Recursively sync subkeys
+    // Sync subkeys
     for (const auto& [subkey_name, subkey] : root->subkeys) {
-        std::string sub_path = registry_path + "/" + subkey_name;
-        vfs.mkdir(sub_path, 0);
-        
-        // Add values in this subkey
-        for (const auto& [value_name, value_data] : subkey->values) {
-            std::string value_path = sub_path + "/" + value_name;
-            vfs.write(value_path, value_data, 0);
-        }
-        
-        // Recursively sync nested subkeys
-        for (const auto& [nested_name, nested_key] : subkey->subkeys) {
-            std::string nested_path = sub_path + "/" + nested_name;
-            syncSubKeyToVFS(vfs, nested_key, nested_path);
-        }
+        syncSubKeyToVFS(vfs, subkey, registry_path + "/" + subkey_name);
     }
 }
 
-// Helper method to recursively sync a subkey to VFS
+// Syncs a subkey and everything below it to VFS; nested keys are kept on an
+// explicit work stack rather than recursed into
 void Registry::syncSubKeyToVFS(Vfs& vfs, std::shared_ptr<RegistryKey> reg_key, const std::string& vfs_path) const {
-    vfs.mkdir(vfs_path, 0);
-    
-    // Add values in this key
-    for (const auto& [value_name, value_data] : reg_key->values) {
-        std::string value_path = vfs_path + "/" + value_name;
-        vfs.write(value_path, value_data, 0);
-    }
-    
-    // Recursively sync nested subkeys
-    for (const auto& [subkey_name, subkey] : reg_key->subkeys) {
-        std::string sub_path = vfs_path + "/" + subkey_name;
-        syncSubKeyToVFS(vfs, subkey, sub_path);
+    std::vector<std::pair<std::shared_ptr<RegistryKey>, std::string>> pending;
+    pending.emplace_back(std::move(reg_key), vfs_path);
+    while (!pending.empty()) {
+        auto [key, path] = std::move(pending.back());
+        pending.pop_back();
+        vfs.mkdir(path, 0);
+
+        // Add values in this key
+        for (const auto& [value_name, value_data] : key->values) {
+            vfs.write(path + "/" + value_name, value_data, 0);
+        }
+
+        // Nested subkeys, first one on top
+        size_t first = pending.size();
+        for (const auto& [subkey_name, subkey] : key->subkeys) {
+            pending.emplace_back(subkey, path + "/" + subkey_name);
+        }
+        std::reverse(pending.begin() + static_cast<std::ptrdiff_t>(first), pending.end());
     }
 }
\ No newline at end of file
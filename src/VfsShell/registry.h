@@ -47,8 +47,14 @@ struct Registry {
     void integrateWithVFS(Vfs& vfs);
     void syncFromVFS(Vfs& vfs, const std::string& registry_path = "/reg");
     void syncToVFS(Vfs& vfs, const std::string& registry_path = "/reg") const;
+    // Follows edits made under registry_path in the VFS via its change journal
+    void watchVFS(Vfs& vfs, const std::string& registry_path = "/reg");
     
 private:
+    void applyVFSEvent(Vfs& vfs, const VfsEvent& ev, const std::string& registry_path);
+    void loadFromVFS(Vfs& vfs, const std::string& vfs_path, size_t overlay_id, const std::string& registry_path);
+    void forgetPath(const std::string& reg_path);
+    mutable bool syncing_to_vfs = false;  // skip the events of our own writes
     std::pair<std::shared_ptr<RegistryKey>, std::string> parsePath(const std::string& full_path) const;
     void syncSubKeyToVFS(Vfs& vfs, std::shared_ptr<RegistryKey> reg_key, const std::string& vfs_path) const;
 };
\ No newline at end of file
@@ -167,6 +167,59 @@ FeatureMask FeatureMask::fromString(const std::string& s) {
 }
 
 // ScopeStore implementation
+namespace {
+
+std::shared_ptr<DirNode> snapshot_tree(const ScopeSnapshot& snap, const std::string& overlay) {
+    for (const auto& [name, root] : snap.trees) {
+        if (name == overlay) return root;
+    }
+    return nullptr;
+}
+
+// Changed paths across all overlays, sorted and unique
+std::vector<std::string> diff_snapshot_trees(const ScopeSnapshot& from, const ScopeSnapshot& to) {
+    std::vector<std::string> changed;
+    for (const auto& [name, root] : to.trees) {
+        Vfs::diffTrees(snapshot_tree(from, name), root, "/", changed);
+    }
+    for (const auto& [name, root] : from.trees) {
+        if (!snapshot_tree(to, name)) changed.push_back("/");
+    }
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    return changed;
+}
+
+// "overlay:path kind" per overlay, followed by the content of files. Larger
+// contents are named by digest and their bytes follow only the first time
+// the state holds them, so a file shared by many overlays is diffed once.
+std::string snapshot_path_state(const ScopeSnapshot& snap, const std::string& path,
+                                std::unordered_set<std::string>& seen_blobs) {
+    std::string out;
+    for (const auto& [name, root] : snap.trees) {
+        std::shared_ptr<VfsNode> node = root;
+        for (std::string_view part : PathParts(path)) {
+            if (!node->isDir()) { node = nullptr; break; }
+            auto& ch = node->children();
+            auto it = ch.find(part);
+            node = it == ch.end() ? nullptr : it->second;
+            if (!node) break;
+        }
+        out += name + ":" + path + " " + type_char(node) + "\n";
+        if (!node || node->isDir()) continue;
+        ContentRef data = node->readShared();
+        if (data->size() >= BlobStore::MIN_SIZE) {
+            std::string digest = BlobStore::hex(BlobStore::digest(*data));
+            out += "blob " + digest + "\n";
+            if (!seen_blobs.insert(digest).second) continue;
+        }
+        out += *data + "\n";
+    }
+    return out;
+}
+
+} // namespace
+
 uint64_t ScopeStore::createSnapshot(Vfs& vfs, const std::string& description) {
     TRACE_FN("desc=", description);
 
@@ -199,10 +252,18 @@ uint64_t ScopeStore::createSnapshot(Vfs& vfs, const std::string& description) {
         snapshot.uncompressed_size = current_state.size();
     }
 
-    // Track affected paths (simplified - all paths for now)
-    // TODO: Compute actual diff and track only changed paths
-    // TODO: Implement VFS traversal using actual Vfs API (listDir, etc.)
-    snapshot.affected_paths.push_back("/");
+    // Capture every overlay as a copy-on-write tree, O(1) each
+    for (size_t i = 0; i < vfs.overlayCount(); ++i) {
+        snapshot.trees.emplace_back(vfs.overlayName(i), vfs.snapshotOverlay(i));
+    }
+
+    // Affected paths: only subtrees no longer shared with the parent are walked
+    auto parent_it = snapshots.find(snapshot.parent_snapshot_id);
+    if (parent_it != snapshots.end() && !parent_it->second.trees.empty()) {
+        snapshot.affected_paths = diff_snapshot_trees(parent_it->second, snapshot);
+    } else {
+        snapshot.affected_paths.push_back("/");
+    }
 
     snapshots[snapshot.snapshot_id] = std::move(snapshot);
     current_snapshot_id = snapshot.snapshot_id;
@@ -217,6 +278,18 @@ bool ScopeStore::restoreSnapshot(Vfs& vfs, uint64_t snapshot_id) {
         return false;
     }
 
+    // In-memory snapshot: swap the overlay roots back, sharing every node
+    const auto& snap = snapshots[snapshot_id];
+    if (!snap.trees.empty()) {
+        for (const auto& [name, root] : snap.trees) {
+            if (auto id = vfs.findOverlayByName(name)) {
+                vfs.restoreOverlay(*id, root);
+            }
+        }
+        current_snapshot_id = snapshot_id;
+        return true;
+    }
+
     // Reconstruct VFS state by applying diffs from root
     std::vector<uint64_t> path_to_snapshot;
     uint64_t curr = snapshot_id;
@@ -275,6 +348,19 @@ std::vector<uint8_t> ScopeStore::computeDiff(uint64_t from_id, uint64_t to_id) {
         return {};
     }
 
+    // Both in memory: compare the trees directly and diff only what changed
+    const auto& from = snapshots[from_id];
+    const auto& to = snapshots[to_id];
+    if (!from.trees.empty() && !to.trees.empty()) {
+        std::string from_state, to_state;
+        std::unordered_set<std::string> from_blobs, to_blobs;
+        for (const auto& path : diff_snapshot_trees(from, to)) {
+            from_state += snapshot_path_state(from, path, from_blobs);
+            to_state += snapshot_path_state(to, path, to_blobs);
+        }
+        return BinaryDiff::compute(from_state, to_state);
+    }
+
     // Reconstruct both states
     Vfs temp_vfs;
 
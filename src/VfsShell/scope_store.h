@@ -91,6 +91,10 @@ struct ScopeSnapshot {
     // Paths affected by this snapshot
     std::vector<std::string> affected_paths;
 
+    // Copy-on-write overlay trees (name, root), shared with the live VFS and
+    // other snapshots; empty for snapshots loaded from disk
+    std::vector<std::pair<std::string, std::shared_ptr<DirNode>>> trees;
+
     ScopeSnapshot() : snapshot_id(0), timestamp(0), parent_snapshot_id(0),
                       uncompressed_size(0) {}
 };
@@ -249,7 +249,8 @@ void install_builtins(std::shared_ptr<Env> g){
         auto n = G_VFS->resolveForOverlay(std::get<std::string>(av[0].v), 0);
         if(!n->isDir()) throw std::runtime_error("vfs-ls: not dir");
         Value::List entries;
-        for(auto& kv : n->children()){
+        auto children = n->listing();
+        for(auto& kv : *children){
             const std::string& name = kv.first;
             auto& node = kv.second;
             std::string t = node->kind==VfsNode::Kind::Dir? "dir" : (node->kind==VfsNode::Kind::File? "file" : "ast");
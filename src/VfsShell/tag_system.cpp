@@ -2,101 +2,119 @@
 
 // ====== Tag Registry & Storage ======
 TagId TagRegistry::registerTag(const std::string& name){
-    auto it = name_to_id.find(name);
+    Atom atom(name);
+    auto it = name_to_id.find(atom);
     if(it != name_to_id.end()) return it->second;
     TagId id = next_id++;
-    name_to_id[name] = id;
-    id_to_name[id] = name;
+    name_to_id[atom] = id;
+    id_to_name[id] = atom;
     return id;
 }
 
 TagId TagRegistry::getTagId(const std::string& name) const {
-    auto it = name_to_id.find(name);
+    auto atom = Atom::lookup(name);
+    if(!atom) return TAG_INVALID;
+    auto it = name_to_id.find(*atom);
     return it != name_to_id.end() ? it->second : TAG_INVALID;
 }
 
 std::string TagRegistry::getTagName(TagId id) const {
     auto it = id_to_name.find(id);
-    return it != id_to_name.end() ? it->second : "";
+    return it != id_to_name.end() ? it->second.str() : "";
 }
 
 bool TagRegistry::hasTag(const std::string& name) const {
-    return name_to_id.find(name) != name_to_id.end();
+    return getTagId(name) != TAG_INVALID;
 }
 
 std::vector<std::string> TagRegistry::allTags() const {
     std::vector<std::string> tags;
     tags.reserve(name_to_id.size());
     for(const auto& pair : name_to_id){
-        tags.push_back(pair.first);
+        tags.push_back(pair.first.str());
     }
+    std::sort(tags.begin(), tags.end());
     return tags;
 }
 
 void TagStorage::addTag(VfsNode* node, TagId tag){
     if(!node || tag == TAG_INVALID) return;
-    node_tags[node].insert(tag);
+    node_tags[node->serial].insert(tag);
+    tag_nodes[tag].insert(node->serial);
 }
 
 void TagStorage::removeTag(VfsNode* node, TagId tag){
     if(!node) return;
-    auto it = node_tags.find(node);
+    auto it = node_tags.find(node->serial);
     if(it != node_tags.end()){
         it->second.erase(tag);
         if(it->second.empty()) node_tags.erase(it);
     }
+    auto nodes = tag_nodes.find(tag);
+    if(nodes != tag_nodes.end()){
+        nodes->second.erase(node->serial);
+        if(nodes->second.empty()) tag_nodes.erase(nodes);
+    }
 }
 
-bool TagStorage::hasTag(VfsNode* node, TagId tag) const {
+bool TagStorage::hasTag(const VfsNode* node, TagId tag) const {
     if(!node) return false;
-    auto it = node_tags.find(node);
+    auto it = node_tags.find(node->serial);
     if(it == node_tags.end()) return false;
     return it->second.count(tag) > 0;
 }
 
-const TagSet* TagStorage::getTags(VfsNode* node) const {
+const TagSet* TagStorage::getTags(const VfsNode* node) const {
     if(!node) return nullptr;
-    auto it = node_tags.find(node);
+    auto it = node_tags.find(node->serial);
     return it != node_tags.end() ? &it->second : nullptr;
 }
 
 void TagStorage::clearTags(VfsNode* node){
-    if(node) node_tags.erase(node);
+    if(!node) return;
+    auto it = node_tags.find(node->serial);
+    if(it == node_tags.end()) return;
+    TagSet tags = it->second;
+    for(TagId tag : tags) removeTag(node, tag);
 }
 
-std::vector<VfsNode*> TagStorage::findByTag(TagId tag) const {
-    std::vector<VfsNode*> result;
-    for(const auto& pair : node_tags){
-        if(pair.second.count(tag) > 0){
-            result.push_back(pair.first);
-        }
-    }
-    return result;
+void TagStorage::copyTags(VfsNode* from, VfsNode* to){
+    if(!from || !to) return;
+    auto it = node_tags.find(from->serial);
+    if(it == node_tags.end()) return;
+    TagSet tags = it->second;
+    for(TagId tag : tags) addTag(to, tag);
 }
 
-std::vector<VfsNode*> TagStorage::findByTags(const TagSet& tags, bool match_all) const {
-    std::vector<VfsNode*> result;
-    for(const auto& pair : node_tags){
-        if(match_all){
-            // All tags must be present
-            bool has_all = true;
-            for(TagId tag : tags){
-                if(pair.second.count(tag) == 0){
-                    has_all = false;
-                    break;
-                }
-            }
-            if(has_all) result.push_back(pair.first);
-        } else {
-            // Any tag can be present
-            bool has_any = false;
-            for(TagId tag : tags){
-                if(pair.second.count(tag) > 0){
-                    has_any = true;
-                    break;
-                }
+std::vector<uint64_t> TagStorage::findByTag(TagId tag) const {
+    auto it = tag_nodes.find(tag);
+    if(it == tag_nodes.end()) return {};
+    return std::vector<uint64_t>(it->second.begin(), it->second.end());
+}
+
+std::vector<uint64_t> TagStorage::findByTags(const TagSet& tags, bool match_all) const {
+    std::vector<uint64_t> result;
+    if(match_all){
+        // Candidates from the rarest tag, checked against the others
+        const std::unordered_set<uint64_t>* rarest = nullptr;
+        for(TagId tag : tags){
+            auto it = tag_nodes.find(tag);
+            if(it == tag_nodes.end()) return result;
+            if(!rarest || it->second.size() < rarest->size()) rarest = &it->second;
+        }
+        if(!rarest) return result;
+        for(uint64_t node : *rarest){
+            if(tags.isSubsetOf(node_tags.at(node))) result.push_back(node);
+        }
+    } else {
+        // Any tag can be present
+        std::unordered_set<uint64_t> seen;
+        for(TagId tag : tags){
+            auto it = tag_nodes.find(tag);
+            if(it == tag_nodes.end()) continue;
+            for(uint64_t node : it->second){
+                if(seen.insert(node).second) result.push_back(node);
             }
-            if(has_any) result.push_back(pair.first);
         }
     }
     return result;
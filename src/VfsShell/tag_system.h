@@ -129,6 +129,9 @@ public:
         return total;
     }
 
+    // Heap memory held by the bit vector
+    size_t heapBytes() const { return chunks.capacity() * sizeof(uint64_t); }
+
     bool empty() const {
         for(uint64_t chunk : chunks) {
             if(chunk != 0) return false;
@@ -307,8 +310,8 @@ public:
 };
 
 struct TagRegistry {
-    std::map<std::string, TagId> name_to_id;
-    std::map<TagId, std::string> id_to_name;
+    std::unordered_map<Atom, TagId> name_to_id;
+    std::map<TagId, Atom> id_to_name;
     TagId next_id = 1;
 
     TagId registerTag(const std::string& name);
@@ -320,16 +323,25 @@ struct TagRegistry {
 //
 // Tag Storage (must be declared after VfsNode)
 //
+// Tag the nodes of a Vfs through Vfs::addTag, which also records where they
+// are so Vfs::findNodesByTag can return their paths. Tags are keyed by node
+// serial, so a node allocated where a tagged one was freed starts untagged.
+//
 struct TagStorage {
-    std::unordered_map<VfsNode*, TagSet> node_tags;
+    std::unordered_map<uint64_t, TagSet> node_tags;
+    // The inverse, so a query costs its result rather than every tagged node
+    std::unordered_map<TagId, std::unordered_set<uint64_t>> tag_nodes;
 
     void addTag(VfsNode* node, TagId tag);
     void removeTag(VfsNode* node, TagId tag);
-    bool hasTag(VfsNode* node, TagId tag) const;
-    const TagSet* getTags(VfsNode* node) const;
+    bool hasTag(const VfsNode* node, TagId tag) const;
+    const TagSet* getTags(const VfsNode* node) const;
     void clearTags(VfsNode* node);
-    std::vector<VfsNode*> findByTag(TagId tag) const;
-    std::vector<VfsNode*> findByTags(const TagSet& tags, bool match_all) const;
+    // Tags to with all tags of from, e.g. a copy replacing it
+    void copyTags(VfsNode* from, VfsNode* to);
+    // Serials of the nodes carrying the tags
+    std::vector<uint64_t> findByTag(TagId tag) const;
+    std::vector<uint64_t> findByTags(const TagSet& tags, bool match_all) const;
 };
 
 // Tag Mining Session
@@ -645,17 +645,20 @@ void UppAssembly::create_vfs_structure(Vfs& vfs, size_t overlay_id) {
         return;
     }
     
+    // Build the whole tree in one batch: one lock, one dirty mark
+    auto tx = vfs.transaction(overlay_id);
+
     // Create /upp/ directory in VFS
     std::string upp_path = "/upp";
-    vfs.ensureDir(upp_path, overlay_id);
+    tx.mkdir(upp_path);
     
     // Create workspace directory
     std::string ws_path = "/upp/" + workspace->name;
-    vfs.ensureDir(ws_path, overlay_id);
+    tx.mkdir(ws_path);
     
     // Create packages directory
     std::string packages_path = ws_path + "/packages";
-    vfs.ensureDir(packages_path, overlay_id);
+    tx.mkdir(packages_path);
     
     // Add each package
     for (const auto& pkg_pair : workspace->packages) {
@@ -663,14 +666,14 @@ void UppAssembly::create_vfs_structure(Vfs& vfs, size_t overlay_id) {
         
         // Create package directory
         std::string pkg_path = packages_path + "/" + pkg->name;
-        vfs.ensureDir(pkg_path, overlay_id);
+        tx.mkdir(pkg_path);
         
         // Add package files
         for (const auto& file : pkg->files) {
             std::string filename = file.substr(file.find_last_of("/\\") + 1);
             std::string content = "// U++ Package file: " + file + "\n";
             std::string file_path = pkg_path + "/" + filename;
-            vfs.write(file_path, content, overlay_id);
+            tx.write(file_path, content);
         }
         
         // Add package metadata
@@ -682,7 +685,7 @@ void UppAssembly::create_vfs_structure(Vfs& vfs, size_t overlay_id) {
                                                          return a + (a.empty() ? "" : ",") + b;
                                                      }) + "\n";
         std::string metadata_path = pkg_path + "/package.info";
-        vfs.write(metadata_path, metadata, overlay_id);
+        tx.write(metadata_path, metadata);
     }
     
     // Add workspace metadata
@@ -690,7 +693,8 @@ void UppAssembly::create_vfs_structure(Vfs& vfs, size_t overlay_id) {
     ws_metadata += "assembly_path=" + workspace->assembly_path + "\n";
     ws_metadata += "primary_package=" + workspace->primary_package + "\n";
     std::string ws_metadata_path = ws_path + "/workspace.info";
-    vfs.write(ws_metadata_path, ws_metadata, overlay_id);
+    tx.write(ws_metadata_path, ws_metadata);
+    tx.commit();
 }
 
 // Implementation of UppAssemblyGui methods
@@ -129,7 +129,7 @@ bool has_cmd(const std::string& c){
     return r==0;
 }
 
-size_t count_lines(const std::string& s){
+size_t count_lines(std::string_view s){
     if(s.empty()) return 0;
     size_t n = std::count(s.begin(), s.end(), '\n');
     if(s.back() != '\n') ++n;
@@ -157,6 +157,19 @@ LineSplit split_lines(const std::string& s){
     return result;
 }
 
+LineViews split_line_views(std::string_view s){
+    LineViews result;
+    size_t start = 0;
+    for(size_t nl; (nl = s.find('\n', start)) != std::string_view::npos; start = nl + 1){
+        result.lines.push_back(s.substr(start, nl - start));
+    }
+    if(start < s.size()){
+        result.lines.push_back(s.substr(start));
+    }
+    result.trailing_newline = !s.empty() && s.back() == '\n';
+    return result;
+}
+
 size_t parse_size_arg(const std::string& s, const char* ctx){
     if(s.empty()) throw std::runtime_error(std::string(ctx) + " must be non-negative integer");
     size_t idx = 0;
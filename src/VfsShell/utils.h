@@ -23,7 +23,15 @@ struct LineSplit{
 };
 
 LineSplit split_lines(const std::string& s);
-size_t count_lines(const std::string& s);
+
+// Same split as split_lines, as views into s
+struct LineViews{
+	std::vector<std::string_view> lines;
+	bool trailing_newline;
+};
+
+LineViews split_line_views(std::string_view s);
+size_t count_lines(std::string_view s);
 size_t parse_size_arg(const std::string& s, const char* ctx);
 long long parse_int_arg(const std::string& s, const char* ctx);
 std::string join_line_range(const LineSplit& split, size_t begin, size_t end);
@@ -0,0 +1,90 @@
+#include "VfsShell.h"
+
+// ====== NodeArena ======
+
+namespace {
+thread_local NodeArena* g_current_arena = nullptr;
+}
+
+NodeArena::Scope::Scope(NodeArena* arena) : prev(g_current_arena) {
+    bool usable = arena && arena->owner == std::this_thread::get_id();
+    g_current_arena = usable ? arena : nullptr;
+}
+
+NodeArena::Scope::~Scope(){
+    g_current_arena = prev;
+}
+
+ArenaRef NodeArena::create(){
+    return ArenaRef(new NodeArena());
+}
+
+NodeArena* NodeArena::current(){
+    return g_current_arena;
+}
+
+NodeArena::~NodeArena(){
+    for(char* slab : slabs) munmap(slab, SLAB_BYTES);
+}
+
+void* NodeArena::allocate(size_t bytes, size_t align){
+    // Only reached through make_node, which Scope restricts to the owner thread
+    if(!small(bytes, align)){
+        void* p = ::operator new(bytes);
+        retain();
+        return p;
+    }
+    size_t cls = (bytes + GRAIN - 1) / GRAIN - 1;
+    void* head = free_lists[cls];
+    if(!head) head = remote_frees[cls].exchange(nullptr, std::memory_order_acquire);
+    if(head){
+        free_lists[cls] = *static_cast<void**>(head);
+        retain();
+        return head;
+    }
+    size_t rounded = (cls + 1) * GRAIN;
+    if(bump_left < rounded){
+        // Mapped directly so dropping the arena returns the pages to the OS; the
+        // tail of the previous slab (under MAX_SMALL bytes) is abandoned
+        slabs.reserve(slabs.size() + 1);
+        void* slab = mmap(nullptr, SLAB_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(slab == MAP_FAILED) throw std::bad_alloc();
+        bump = static_cast<char*>(slab);
+        bump_left = SLAB_BYTES;
+        slabs.push_back(bump);
+    }
+    void* p = bump;
+    bump += rounded;
+    bump_left -= rounded;
+    retain();
+    return p;
+}
+
+void NodeArena::deallocate(void* p, size_t bytes, size_t align) noexcept {
+    if(!p) return;
+    if(!small(bytes, align)){
+        ::operator delete(p);
+    } else {
+        size_t cls = (bytes + GRAIN - 1) / GRAIN - 1;
+        if(std::this_thread::get_id() == owner){
+            *static_cast<void**>(p) = free_lists[cls];
+            free_lists[cls] = p;
+        } else {
+            // Single consumer takes the whole stack at once, so a plain CAS push is ABA-safe
+            void* head = remote_frees[cls].load(std::memory_order_relaxed);
+            do {
+                *static_cast<void**>(p) = head;
+            } while(!remote_frees[cls].compare_exchange_weak(head, p,
+                        std::memory_order_release, std::memory_order_relaxed));
+        }
+    }
+    release();
+}
+
+NodeArena::Stats NodeArena::stats() const {
+    Stats s;
+    s.slabs = slabs.size();
+    s.reserved_bytes = slabs.size() * SLAB_BYTES;
+    s.pins = pins.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+//
+// Per-overlay node arena
+//
+// Overlays loaded in bulk (.vfs snapshots and the AST nodes inside them) allocate
+// each node together with its shared_ptr control block from size-class slabs
+// owned by a NodeArena, instead of one malloc per node. Freed blocks go back to
+// a per-class free list and are reused by later nodes of the same size.
+//
+// The thread that created the arena owns the slabs and allocates and frees
+// without locking. Other threads may release nodes at any time; their blocks are
+// pushed onto lock-free per-class stacks that the owner drains when it runs dry.
+//
+// The arena is intrusively refcounted: ArenaRef handles (the overlay holds one)
+// and every live block each keep it alive, so it outlives all nodes it produced
+// no matter where they end up. When the overlay is dropped and the last node
+// released, all slabs are unmapped in one step.
+//
+// Node code keeps using std::shared_ptr<VfsNode>; only the creation site changes.
+// make_node<T>(...) allocates from the arena installed by the innermost
+// NodeArena::Scope on the current thread and falls back to make_shared otherwise.
+//
+class ArenaRef;
+
+class NodeArena {
+public:
+    static constexpr size_t SLAB_BYTES = 256 * 1024;
+    static constexpr size_t GRAIN = 16;
+    static constexpr size_t MAX_SMALL = 512;  // larger blocks go to the heap
+
+    struct Stats {
+        size_t slabs = 0;
+        size_t reserved_bytes = 0;  // slab memory held
+        size_t pins = 0;            // live blocks plus ArenaRef handles
+    };
+
+    // Installs an arena as the make_node target; ignored off the owner thread
+    class Scope {
+        NodeArena* prev;
+    public:
+        explicit Scope(NodeArena* arena);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    static ArenaRef create();
+    static NodeArena* current();
+
+    void* allocate(size_t bytes, size_t align);
+    void deallocate(void* p, size_t bytes, size_t align) noexcept;
+    Stats stats() const;  // owner thread only
+
+    void retain() noexcept { pins.fetch_add(1, std::memory_order_relaxed); }
+    void release() noexcept {
+        if(pins.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+    }
+
+private:
+    NodeArena() = default;
+    ~NodeArena();
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    static bool small(size_t bytes, size_t align) { return bytes <= MAX_SMALL && align <= GRAIN; }
+
+    static constexpr size_t CLASSES = MAX_SMALL / GRAIN;
+
+    const std::thread::id owner = std::this_thread::get_id();
+    std::vector<char*> slabs;
+    char* bump = nullptr;
+    size_t bump_left = 0;
+    std::array<void*, CLASSES> free_lists{};                // owner only
+    std::array<std::atomic<void*>, CLASSES> remote_frees{};  // pushed by other threads
+    std::atomic<size_t> pins{0};  // every block, small or large, pins the arena
+};
+
+class ArenaRef {
+    NodeArena* p = nullptr;
+public:
+    ArenaRef() = default;
+    explicit ArenaRef(NodeArena* a) : p(a) { if(p) p->retain(); }
+    ArenaRef(const ArenaRef& o) : p(o.p) { if(p) p->retain(); }
+    ArenaRef(ArenaRef&& o) noexcept : p(o.p) { o.p = nullptr; }
+    ArenaRef& operator=(ArenaRef o) noexcept { std::swap(p, o.p); return *this; }
+    ~ArenaRef() { if(p) p->release(); }
+
+    NodeArena* get() const { return p; }
+    NodeArena* operator->() const { return p; }
+    explicit operator bool() const { return p != nullptr; }
+};
+
+// Holds a plain pointer: allocated blocks, not allocator copies, keep the arena alive
+template<typename T>
+struct NodeArenaAllocator {
+    using value_type = T;
+    NodeArena* arena;
+
+    explicit NodeArenaAllocator(NodeArena* a) : arena(a) {}
+    template<typename U>
+    NodeArenaAllocator(const NodeArenaAllocator<U>& o) : arena(o.arena) {}
+
+    T* allocate(size_t n){ return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T* p, size_t n) noexcept { arena->deallocate(p, n * sizeof(T), alignof(T)); }
+
+    template<typename U>
+    bool operator==(const NodeArenaAllocator<U>& o) const { return arena == o.arena; }
+    template<typename U>
+    bool operator!=(const NodeArenaAllocator<U>& o) const { return !(*this == o); }
+};
+
+template<typename T, typename... Args>
+std::shared_ptr<T> make_node(Args&&... args){
+    if(NodeArena* arena = NodeArena::current())
+        return std::allocate_shared<T>(NodeArenaAllocator<T>(arena), std::forward<Args>(args)...);
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
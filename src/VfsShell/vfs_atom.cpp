@@ -0,0 +1,240 @@
+#include "VfsShell.h"
+
+// ====== Atom table ======
+
+namespace {
+
+// Strings live in fixed-size chunks that never move, so str() can index them
+// without a lock. The id index is an open-addressing table that is rebuilt into
+// a larger copy when it fills; readers keep probing whichever copy they loaded,
+// and retired copies are kept alive because a reader may still hold one.
+struct AtomTable {
+    static constexpr size_t CHUNK_BITS = 12;
+    static constexpr size_t CHUNK = size_t(1) << CHUNK_BITS;
+    static constexpr size_t MAX_CHUNKS = size_t(1) << 14;
+
+    // A slot packs the name hash (high half) with the atom id (low half, 0 = empty)
+    // so mismatches are rejected without touching the string.
+    struct Index {
+        size_t mask;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+        explicit Index(size_t n) : mask(n - 1), slots(new std::atomic<uint64_t>[n]) {
+            for(size_t i = 0; i < n; ++i) slots[i].store(0, std::memory_order_relaxed);
+        }
+    };
+
+    std::array<std::atomic<std::string*>, MAX_CHUNKS> chunks{};
+    std::atomic<Index*> index{nullptr};
+    std::atomic<uint32_t> used{1};
+    std::mutex mtx;
+    std::vector<std::unique_ptr<Index>> indices;  // current one last
+
+    AtomTable(){
+        chunks[0].store(new std::string[CHUNK], std::memory_order_relaxed);  // id 0 is ""
+        indices.push_back(std::make_unique<Index>(1024));
+        index.store(indices.back().get(), std::memory_order_release);
+    }
+
+    static uint32_t hashOf(std::string_view s){
+        uint32_t h = 2166136261u;  // FNV-1a, as ChildIndex used for names
+        for(unsigned char c : s){
+            h ^= c;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    const std::string& str(uint32_t id) const {
+        return chunks[id >> CHUNK_BITS].load(std::memory_order_acquire)[id & (CHUNK - 1)];
+    }
+
+    uint32_t find(const Index& idx, std::string_view s, uint32_t h) const {
+        for(size_t i = h & idx.mask;; i = (i + 1) & idx.mask){
+            uint64_t slot = idx.slots[i].load(std::memory_order_acquire);
+            uint32_t id = static_cast<uint32_t>(slot);
+            if(id == 0) return 0;
+            if(static_cast<uint32_t>(slot >> 32) == h && str(id) == s) return id;
+        }
+    }
+
+    static void place(Index& idx, uint32_t id, uint32_t h){
+        size_t i = h & idx.mask;
+        while(idx.slots[i].load(std::memory_order_relaxed) != 0) i = (i + 1) & idx.mask;
+        idx.slots[i].store((uint64_t(h) << 32) | id, std::memory_order_release);
+    }
+
+    uint32_t intern(std::string_view s){
+        const uint32_t h = hashOf(s);
+        if(uint32_t id = find(*index.load(std::memory_order_acquire), s, h)) return id;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        Index* idx = index.load(std::memory_order_relaxed);
+        if(uint32_t id = find(*idx, s, h)) return id;
+        // A name only pinned so far keeps its id, now for good, so that no
+        // text ever has two atoms
+        if(Transient* t = findTransient(s)){
+            t->pins = FOREVER;
+            return t->id;
+        }
+
+        uint32_t id = used.load(std::memory_order_relaxed);
+        size_t chunk = id >> CHUNK_BITS;
+        if(chunk >= MAX_CHUNKS) throw std::runtime_error("atom table full");
+        std::string* slots = chunks[chunk].load(std::memory_order_relaxed);
+        if(!slots){
+            slots = new std::string[CHUNK];
+            chunks[chunk].store(slots, std::memory_order_release);
+        }
+        slots[id & (CHUNK - 1)].assign(s.data(), s.size());
+
+        if((size_t(id) + 1) * 4 > (idx->mask + 1) * 3){
+            auto grown = std::make_unique<Index>((idx->mask + 1) * 2);
+            for(size_t i = 0; i <= idx->mask; ++i){
+                uint64_t slot = idx->slots[i].load(std::memory_order_relaxed);
+                if(slot) place(*grown, static_cast<uint32_t>(slot), static_cast<uint32_t>(slot >> 32));
+            }
+            idx = grown.get();
+            indices.push_back(std::move(grown));
+            place(*idx, id, h);
+            index.store(idx, std::memory_order_release);
+        } else {
+            place(*idx, id, h);
+        }
+        used.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    // Transient atoms (Atom::pin) name the children of host and remote
+    // listings, which come and go with the host. Their ids have the top bit
+    // set and hold a slot and the slot's reuse count, so an id still in a
+    // caller's hands after its name was released does not match the slot's
+    // next name. Slots are found by text under the lock and by id without it.
+    static constexpr uint32_t TRANSIENT = 0x80000000u;
+    static constexpr uint32_t SLOT_BITS = 24;
+    static constexpr uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+    static constexpr uint32_t FOREVER = UINT32_MAX;  // pins of a name interned for good
+
+    struct Transient {
+        std::string text;
+        uint32_t id = 0;
+        uint32_t pins = 0;
+    };
+
+    std::array<std::atomic<std::atomic<Transient*>*>, (SLOT_MASK + 1) / CHUNK> transient_chunks{};
+    std::unordered_map<std::string_view, Transient*> transients;  // keyed by the text they own
+    std::vector<uint32_t> free_slots;
+    std::vector<uint8_t> reuses;  // per slot
+    std::atomic<size_t> live_transients{0};
+
+    std::atomic<Transient*>& transientSlot(uint32_t slot) const {
+        return transient_chunks[slot >> CHUNK_BITS].load(std::memory_order_acquire)[slot & (CHUNK - 1)];
+    }
+
+    const std::string& transientStr(uint32_t id) const {
+        static const std::string released;
+        Transient* t = transientSlot(id & SLOT_MASK).load(std::memory_order_acquire);
+        return t && t->id == id ? t->text : released;
+    }
+
+    // Under mtx: the transient atom named s, if one is live
+    Transient* findTransient(std::string_view s) const {
+        if(live_transients.load(std::memory_order_relaxed) == 0) return nullptr;
+        auto it = transients.find(s);
+        return it == transients.end() ? nullptr : it->second;
+    }
+
+    uint32_t pin(std::string_view s){
+        const uint32_t h = hashOf(s);
+        if(uint32_t id = find(*index.load(std::memory_order_acquire), s, h)) return id;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if(uint32_t id = find(*index.load(std::memory_order_relaxed), s, h)) return id;
+        if(Transient* t = findTransient(s)){
+            if(t->pins != FOREVER) ++t->pins;
+            return t->id;
+        }
+
+        uint32_t slot;
+        if(!free_slots.empty()){
+            slot = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(reuses.size());
+            if(slot > SLOT_MASK) throw std::runtime_error("atom table full");
+            reuses.push_back(0);
+            if(!transient_chunks[slot >> CHUNK_BITS].load(std::memory_order_relaxed)){
+                auto* chunk = new std::atomic<Transient*>[CHUNK];
+                for(size_t i = 0; i < CHUNK; ++i) chunk[i].store(nullptr, std::memory_order_relaxed);
+                transient_chunks[slot >> CHUNK_BITS].store(chunk, std::memory_order_release);
+            }
+        }
+        auto* t = new Transient{std::string(s), TRANSIENT | (uint32_t(reuses[slot] & 0x7f) << SLOT_BITS) | slot, 1};
+        transients.emplace(t->text, t);
+        transientSlot(slot).store(t, std::memory_order_release);
+        live_transients.fetch_add(1, std::memory_order_relaxed);
+        return t->id;
+    }
+
+    void unpin(uint32_t id){
+        std::lock_guard<std::mutex> lock(mtx);
+        const uint32_t slot = id & SLOT_MASK;
+        Transient* t = transientSlot(slot).load(std::memory_order_relaxed);
+        if(!t || t->id != id || t->pins == FOREVER || --t->pins > 0) return;
+        transients.erase(t->text);
+        transientSlot(slot).store(nullptr, std::memory_order_release);
+        ++reuses[slot];
+        free_slots.push_back(slot);
+        live_transients.fetch_sub(1, std::memory_order_relaxed);
+        delete t;  // nothing can still read it: every holder of the name held a pin
+    }
+};
+
+AtomTable& atom_table(){
+    static AtomTable* table = new AtomTable();  // outlives static destructors that still hold atoms
+    return *table;
+}
+
+} // namespace
+
+Atom::Atom(std::string_view s) : v(s.empty() ? 0 : atom_table().intern(s)) {}
+
+Atom Atom::pin(std::string_view s){
+    Atom a;
+    if(!s.empty()) a.v = atom_table().pin(s);
+    return a;
+}
+
+void Atom::unpin(Atom a){
+    if(a.transient()) atom_table().unpin(a.v);
+}
+
+std::optional<Atom> Atom::lookup(std::string_view s){
+    if(s.empty()) return Atom();
+    auto& table = atom_table();
+    uint32_t id = table.find(*table.index.load(std::memory_order_acquire), s, AtomTable::hashOf(s));
+    if(id == 0 && table.live_transients.load(std::memory_order_relaxed) > 0){
+        std::lock_guard<std::mutex> lock(table.mtx);
+        if(auto* t = table.findTransient(s)) id = t->id;
+    }
+    if(id == 0) return std::nullopt;
+    Atom a;
+    a.v = id;
+    return a;
+}
+
+size_t Atom::count(){
+    return atom_table().used.load(std::memory_order_acquire);
+}
+
+size_t Atom::pinned(){
+    return atom_table().live_transients.load(std::memory_order_relaxed);
+}
+
+bool Atom::transient() const {
+    return (v & AtomTable::TRANSIENT) != 0;
+}
+
+const std::string& Atom::str() const {
+    auto& table = atom_table();
+    return transient() ? table.transientStr(v) : table.str(v);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+//
+// Interned strings
+//
+// An Atom is a 32-bit id into a process-wide, append-only string table, so node
+// names, child index keys and tag names are stored once however many nodes share
+// them. Atoms compare and hash by id; the text is only consulted for ordering
+// and output. Atom() is the empty string.
+//
+// Interning takes a lock; Atom::lookup() and str() never do, so resolving a path
+// costs one probe per component and no allocation. Interned atoms are never
+// released.
+//
+// Names read from outside, such as host and remote directory listings, are
+// pinned instead: the atom lives until the last pin on it is dropped, and a
+// node pinning its name drops the pin when it is destroyed. A pinned atom must
+// not be kept beyond the pin (it is no child index key once its node is gone);
+// interning the same text turns it into an interned atom for good. lookup()
+// takes the lock only for a name that is not interned while pins are held.
+//
+class Atom {
+public:
+    Atom() = default;
+    explicit Atom(std::string_view s);
+
+    // The atom for s if it was ever interned; a name that was never interned
+    // cannot be the key of any child index.
+    static std::optional<Atom> lookup(std::string_view s);
+    static size_t count();  // atoms interned so far, including the empty one
+
+    // The interned atom for s if there is one, else a pinned atom; every
+    // pin() is paired with an unpin() of its result
+    static Atom pin(std::string_view s);
+    static void unpin(Atom a);
+    static size_t pinned();  // pinned atoms currently live
+    bool transient() const;
+
+    uint32_t id() const { return v; }
+    const std::string& str() const;
+    std::string_view view() const { return str(); }
+    operator const std::string&() const { return str(); }
+
+    bool empty() const { return v == 0; }
+    size_t size() const { return str().size(); }
+    const char* c_str() const { return str().c_str(); }
+    char operator[](size_t i) const { return str()[i]; }
+
+    Atom& operator=(std::string_view s) { *this = Atom(s); return *this; }
+
+    friend bool operator==(Atom a, Atom b) { return a.v == b.v; }
+    friend bool operator!=(Atom a, Atom b) { return a.v != b.v; }
+    friend bool operator==(Atom a, std::string_view b) { return a.view() == b; }
+    friend bool operator!=(Atom a, std::string_view b) { return a.view() != b; }
+    friend bool operator==(std::string_view a, Atom b) { return a == b.view(); }
+    friend bool operator!=(std::string_view a, Atom b) { return a != b.view(); }
+    friend bool operator<(Atom a, Atom b) { return a.v != b.v && a.str() < b.str(); }
+
+    friend std::string operator+(Atom a, const std::string& b) { return a.str() + b; }
+    friend std::string operator+(const std::string& a, Atom b) { return a + b.str(); }
+    friend std::string operator+(Atom a, const char* b) { return a.str() + b; }
+    friend std::string operator+(const char* a, Atom b) { return a + b.str(); }
+    friend std::ostream& operator<<(std::ostream& os, Atom a) { return os << a.str(); }
+
+private:
+    uint32_t v = 0;
+};
+
+namespace std {
+template<> struct hash<Atom> {
+    size_t operator()(Atom a) const noexcept { return static_cast<size_t>(a.id()) * 0x9E3779B97F4A7C15ull; }
+};
+}
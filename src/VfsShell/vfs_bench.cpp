@@ -0,0 +1,1272 @@
+#include "VfsShell.h"
+
+#ifdef VFS_BENCH_ENABLED
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// ============================================================================
+// VFS micro-benchmarks (make vfs-bench && ./vfs_bench --vfs-bench [entries])
+// ============================================================================
+
+std::shared_ptr<VfsNode> traverse_optional(const Vfs::Overlay& overlay, std::string_view path);
+
+// Heap allocation counters, so benchmarks can report allocations per operation
+static std::atomic<size_t> g_bench_allocs{0};
+static std::atomic<size_t> g_bench_alloc_bytes{0};
+
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new(size_t size){
+    g_bench_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_bench_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    if(void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using BenchClock = std::chrono::steady_clock;
+
+template<typename F>
+double bench_ms(F&& fn){
+    auto start = BenchClock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+void bench_report(const std::string& label, double baseline_ms, double current_ms,
+                  const char* baseline = "std::map", const char* current = "ChildIndex"){
+    std::cout << "  " << std::left << std::setw(28) << label
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << baseline_ms << " ms (" << baseline << ")"
+              << std::setw(10) << current_ms << " ms (" << current << ")"
+              << "  x" << std::setprecision(2) << (current_ms > 0 ? baseline_ms / current_ms : 0.0)
+              << "\n";
+}
+
+// Baseline: the pre-ChildIndex layout, one std::map per directory
+using MapChildren = std::map<std::string, std::shared_ptr<VfsNode>>;
+struct MapDir {
+    std::map<std::string, std::shared_ptr<MapDir>> dirs;
+    MapChildren ch;
+};
+
+std::shared_ptr<VfsNode> map_traverse(const MapDir& root, const std::string& path){
+    auto parts = Vfs::splitPath(path);
+    if(parts.size() != 2) return nullptr;
+    auto d = root.dirs.find(parts[0]);
+    if(d == root.dirs.end()) return nullptr;
+    auto it = d->second->ch.find(parts[1]);
+    return it == d->second->ch.end() ? nullptr : it->second;
+}
+
+template<typename Children>
+size_t bench_listing(const Children& ch){
+    Vfs::DirListing listing;
+    for(auto& kv : ch){
+        auto& entry = listing[kv.first];
+        entry.overlays.push_back(0);
+        entry.nodes.push_back(kv.second);
+        entry.types.insert(type_char(kv.second));
+    }
+    return listing.size();
+}
+
+std::string bench_name(size_t i){
+    // Identifier-like names with a shared prefix, like AST and source trees
+    return "entry_" + std::to_string(i * 2654435761u % 1000003u) + "_" + std::to_string(i);
+}
+
+void bench_child_index(size_t entries, size_t lookups){
+    std::cout << "\n=== ChildIndex vs std::map (" << entries << " entries/dir) ===\n";
+
+    std::vector<std::string> names;
+    names.reserve(entries);
+    for(size_t i = 0; i < entries; ++i) names.push_back(bench_name(i));
+
+    // Two-level tree: /d<k>/<name> with 4 big directories, same nodes in both layouts
+    MapDir map_root;
+    Vfs vfs;
+    std::vector<std::shared_ptr<VfsNode>> files;
+    files.reserve(names.size());
+    for(const auto& n : names) files.push_back(std::make_shared<FileNode>(n, ""));
+
+    double map_build = bench_ms([&]{
+        for(int d = 0; d < 4; ++d){
+            auto dir = std::make_shared<MapDir>();
+            for(const auto& f : files) dir->ch[f->name] = f;
+            map_root.dirs["d" + std::to_string(d)] = dir;
+        }
+    });
+    double idx_build = bench_ms([&]{
+        for(int d = 0; d < 4; ++d){
+            auto& ch = vfs.ensureDir("/d" + std::to_string(d))->children();
+            for(const auto& f : files) ch[f->name] = f;
+        }
+    });
+    bench_report("build", map_build, idx_build);
+
+    std::vector<std::string> paths;
+    std::mt19937 rng(42);
+    for(size_t i = 0; i < lookups; ++i){
+        paths.push_back("/d" + std::to_string(rng() % 4) + "/" + names[rng() % names.size()]);
+    }
+
+    size_t found_map = 0, found_idx = 0;
+    double map_resolve = bench_ms([&]{
+        for(const auto& p : paths) if(map_traverse(map_root, p)) ++found_map;
+    });
+    double idx_resolve = bench_ms([&]{
+        for(const auto& p : paths) if(traverse_optional(vfs.overlay_stack[0], p)) ++found_idx;
+    });
+    bench_report("resolve x" + std::to_string(lookups), map_resolve, idx_resolve);
+
+    const int listings = 20;
+    size_t listed_map = 0, listed_idx = 0;
+    double map_list = bench_ms([&]{
+        for(int r = 0; r < listings; ++r)
+            listed_map += bench_listing(map_root.dirs["d" + std::to_string(r % 4)]->ch);
+    });
+    double idx_list = bench_ms([&]{
+        for(int r = 0; r < listings; ++r)
+            listed_idx += vfs.listDir("/d" + std::to_string(r % 4), {0}).size();
+    });
+    bench_report("listDir x" + std::to_string(listings), map_list, idx_list);
+}
+
+void bench_resolve_cache(size_t lookups){
+    std::cout << "\n=== Resolve cache (hot paths) ===\n";
+    Vfs vfs;
+    std::vector<std::string> hot;
+    for(int s = 0; s < 8; ++s){
+        for(int m = 0; m < 8; ++m){
+            std::string p = "/qwen/history/session" + std::to_string(s) + "/msg" + std::to_string(m);
+            vfs.write(p, "x");
+            hot.push_back(p);
+        }
+        hot.push_back("/plan/goals/g" + std::to_string(s) + "/missing");
+    }
+
+    auto run = [&](const char* label, auto&& resolve){
+        size_t found = 0;
+        size_t allocs_before = g_bench_allocs.load();
+        double ms = bench_ms([&]{
+            for(size_t i = 0; i < lookups; ++i) if(resolve(hot[i % hot.size()])) ++found;
+        });
+        size_t allocs = g_bench_allocs.load() - allocs_before;
+        std::cout << "  " << std::left << std::setw(28) << label << std::right
+                  << std::fixed << std::setprecision(2) << std::setw(10) << ms << " ms"
+                  << std::setw(12) << allocs << " allocs  (" << found << " found)\n";
+    };
+    run("splitPath + walk", [&](const std::string& p){
+        auto parts = Vfs::splitPath(p);
+        std::shared_ptr<VfsNode> cur = vfs.root;
+        for(const auto& part : parts){
+            auto& ch = cur->children();
+            auto it = ch.find(part);
+            if(it == ch.end()) return std::shared_ptr<VfsNode>();
+            cur = it->second;
+        }
+        return cur;
+    });
+    run("string_view walk", [&](const std::string& p){ return traverse_optional(vfs.overlay_stack[0], p); });
+    run("tryResolveForOverlay", [&](const std::string& p){ return vfs.tryResolveForOverlay(p, 0); });
+}
+
+size_t bench_rss_bytes(){
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+struct OverlayLoadSample {
+    double load_ms = 0;
+    double drop_ms = 0;
+    size_t rss_delta = 0;
+    size_t rss_retained = 0;  // still resident after the overlay is dropped
+    size_t allocs = 0;
+};
+
+// Loads the snapshot in a forked child so each mode starts from a clean heap
+bool bench_overlay_load_child(const std::string& file, bool use_arena, OverlayLoadSample& out){
+    int fds[2];
+    if(pipe(fds) != 0) return false;
+    pid_t pid = fork();
+    if(pid < 0){ close(fds[0]); close(fds[1]); return false; }
+    if(pid == 0){
+        close(fds[0]);
+        OverlayLoadSample s;
+        Vfs vfs;
+#ifdef __GLIBC__
+        malloc_trim(0);  // don't count heap pages left over from earlier benchmarks
+#endif
+        size_t rss_before = bench_rss_bytes();
+        size_t allocs_before = g_bench_allocs.load();
+        size_t id = 0;
+        s.load_ms = bench_ms([&]{
+            id = mount_overlay_from_file(vfs, "bench", file, use_arena ? NodeArena::create() : ArenaRef());
+        });
+        s.allocs = g_bench_allocs.load() - allocs_before;
+        size_t rss_after = bench_rss_bytes();
+        s.rss_delta = rss_after > rss_before ? rss_after - rss_before : 0;
+        s.drop_ms = bench_ms([&]{ vfs.unregisterOverlay(id); });
+        size_t rss_dropped = bench_rss_bytes();
+        s.rss_retained = rss_dropped > rss_before ? rss_dropped - rss_before : 0;
+        ssize_t w = write(fds[1], &s, sizeof(s));
+        _exit(w == static_cast<ssize_t>(sizeof(s)) ? 0 : 1);
+    }
+    close(fds[1]);
+    ssize_t r = read(fds[0], &out, sizeof(out));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return r == static_cast<ssize_t>(sizeof(out)) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void bench_overlay_arena(size_t nodes){
+    std::cout << "\n=== Overlay load: make_shared vs NodeArena (" << nodes << " nodes) ===\n";
+    auto file = (std::filesystem::temp_directory_path() / "vfs_bench_overlay.vfs").string();
+    {
+        // Source-tree shaped snapshot: small files plus S-expression AST leaves
+        Vfs vfs;
+        for(size_t i = 0; i < nodes; ++i){
+            std::string dir = "/src/m" + std::to_string(i % 64) + "/d" + std::to_string(i % 997);
+            if(i % 2) vfs.write(dir + "/" + bench_name(i), "x");
+            else vfs.addNode(dir, std::make_shared<AstInt>(bench_name(i), static_cast<int64_t>(i)));
+        }
+        save_overlay_to_file(vfs, 0, file);
+    }
+
+    OverlayLoadSample heap, arena;
+    if(!bench_overlay_load_child(file, false, heap) || !bench_overlay_load_child(file, true, arena)){
+        std::cout << "  [WARN] overlay load child failed\n";
+        std::filesystem::remove(file);
+        return;
+    }
+    bench_report("mount_overlay_from_file", heap.load_ms, arena.load_ms, "make_shared", "NodeArena");
+    bench_report("unregisterOverlay", heap.drop_ms, arena.drop_ms, "make_shared", "NodeArena");
+    std::cout << "  " << std::left << std::setw(28) << "RSS delta (KiB)" << std::right
+              << std::setw(10) << heap.rss_delta / 1024 << std::setw(24) << arena.rss_delta / 1024 << "\n";
+    std::cout << "  " << std::left << std::setw(28) << "RSS after drop (KiB)" << std::right
+              << std::setw(10) << heap.rss_retained / 1024 << std::setw(24) << arena.rss_retained / 1024 << "\n";
+    std::cout << "  " << std::left << std::setw(28) << "heap allocations" << std::right
+              << std::setw(10) << heap.allocs << std::setw(24) << arena.allocs << "\n";
+    std::filesystem::remove(file);
+}
+
+std::shared_ptr<VfsNode> bench_deep_copy(const std::shared_ptr<VfsNode>& node){
+    if(node->kind == VfsNode::Kind::File) return std::make_shared<FileNode>(node->name.str(), node->read());
+    auto dir = std::make_shared<DirNode>(node->name.str());
+    for(auto& kv : node->children()) dir->ch[kv.first] = bench_deep_copy(kv.second);
+    return dir;
+}
+
+void bench_overlay_snapshot(size_t files, size_t writes){
+    std::cout << "\n=== Overlay snapshots (" << files << " files, " << writes << " writes) ===\n";
+    Vfs vfs;
+    std::vector<std::string> paths;
+    for(size_t i = 0; i < files; ++i){
+        paths.push_back("/src/m" + std::to_string(i % 64) + "/d" + std::to_string(i % 997) + "/" + bench_name(i));
+        vfs.write(paths.back(), "v0");
+    }
+
+    std::shared_ptr<VfsNode> copy;
+    std::shared_ptr<DirNode> snap;
+    double copy_ms = bench_ms([&]{ copy = bench_deep_copy(vfs.overlayRoot(0)); });
+    double snap_ms = bench_ms([&]{ snap = vfs.snapshotOverlay(0); });
+    bench_report("take snapshot", copy_ms, snap_ms, "deep copy", "COW");
+
+    // Writes after a snapshot copy the path to each file once, then run in place
+    Vfs plain;
+    for(const auto& p : paths) plain.write(p, "v0");
+    double plain_ms = bench_ms([&]{ for(size_t i = 0; i < writes; ++i) plain.write(paths[i * 7919 % files], "v1"); });
+    double cow_ms = bench_ms([&]{ for(size_t i = 0; i < writes; ++i) vfs.write(paths[i * 7919 % files], "v1"); });
+    bench_report("write after snapshot", plain_ms, cow_ms, "no snapshot", "COW");
+
+    std::vector<std::string> changed;
+    double full_ms = bench_ms([&]{ Vfs::diffTrees(copy, vfs.overlayRoot(0), "/", changed); });
+    changed.clear();
+    double diff_ms = bench_ms([&]{ Vfs::diffTrees(snap, vfs.overlayRoot(0), "/", changed); });
+    bench_report("diff vs snapshot", full_ms, diff_ms, "deep copy", "COW");
+    std::cout << "  changed paths: " << changed.size() << "\n";
+}
+
+void bench_overlay_index(size_t overlays, size_t lookups){
+    std::cout << "\n=== Merged overlay index (" << overlays << " overlays, " << lookups << " lookups) ===\n";
+    Vfs vfs;
+    std::vector<std::string> paths;
+    for(size_t o = 1; o <= overlays; ++o){
+        auto root = std::make_shared<DirNode>("/");
+        size_t id = vfs.registerOverlay("ov" + std::to_string(o), root);
+        for(size_t i = 0; i < 200; ++i){
+            std::string p = "/pkg" + std::to_string(o) + "/src/" + bench_name(i);
+            vfs.write(p, "x", id);
+            if(i % 20 == 0) paths.push_back(p);
+        }
+        // A few overlays share a directory, as chained .cxpkg overlays do
+        if(o % 8 == 0) vfs.write("/shared/" + bench_name(o), "y", id);
+    }
+    paths.push_back("/shared");
+
+    // What resolveMulti did before: one lookup per overlay
+    size_t brute_hits = 0, index_hits = 0;
+    double brute_ms = bench_ms([&]{
+        for(size_t i = 0; i < lookups; ++i){
+            const auto& p = paths[i % paths.size()];
+            for(size_t o = 0; o < vfs.overlayCount(); ++o){
+                if(vfs.tryResolveForOverlay(p, o)) ++brute_hits;
+            }
+        }
+    });
+    double index_ms = bench_ms([&]{
+        for(size_t i = 0; i < lookups; ++i) index_hits += vfs.resolveMulti(paths[i % paths.size()]).size();
+    });
+    bench_report("resolveMulti", brute_ms, index_ms, "every overlay", "index");
+
+    std::vector<size_t> all;
+    for(size_t o = 0; o < vfs.overlayCount(); ++o) all.push_back(o);
+    size_t listed = 0;
+    double list_ms = bench_ms([&]{
+        for(size_t i = 0; i < lookups / 10; ++i) listed += vfs.listDir(paths[i % paths.size()], all).size();
+    });
+    std::cout << "  listDir over " << all.size() << " overlays: " << std::fixed << std::setprecision(2)
+              << list_ms << " ms  hits " << index_hits << "\n";
+}
+
+void bench_file_rope(size_t mb, size_t appends){
+    std::cout << "\n=== Chunked files (" << mb << " MB file, " << appends << " appends) ===\n";
+    const std::string line(80, 'l');
+    Vfs vfs;
+    vfs.write("/log/big", std::string(mb << 20, 'x'));
+
+    // What >> did: read the whole file and write it back longer
+    double rewrite_ms = bench_ms([&]{
+        for(size_t i = 0; i < appends; ++i) vfs.write("/log/big", vfs.read("/log/big", 0) + line);
+    });
+    double append_ms = bench_ms([&]{ for(size_t i = 0; i < appends; ++i) vfs.append("/log/big", line); });
+    bench_report("append line", rewrite_ms, append_ms, "read+write", "append");
+
+    double tail_full_ms = bench_ms([&]{ for(size_t i = 0; i < appends; ++i) vfs.read("/log/big", 0).substr((mb << 20) - 100); });
+    double tail_range_ms = bench_ms([&]{
+        for(size_t i = 0; i < appends; ++i) vfs.readRange("/log/big", vfs.size("/log/big", 0) - 100, 100, 0);
+    });
+    bench_report("read last 100 bytes", tail_full_ms, tail_range_ms, "read", "readRange");
+}
+
+void bench_shared_content(size_t files, size_t file_size){
+    std::cout << "\n=== Shared content buffers (" << files << " files x " << file_size / 1024 << " KB) ===\n";
+    Vfs vfs;
+    for(size_t i = 0; i < files; ++i){
+        // Every fourth file repeats another one, as vendored copies do
+        std::string body(file_size, static_cast<char>('a' + (i % 4 == 3 ? i - 1 : i) % 26));
+        body += std::to_string(i % 4 == 3 ? i - 1 : i);
+        vfs.write("/src/m" + std::to_string(i % 16) + "/" + bench_name(i), body);
+    }
+
+    // What context building did: a copy per entry, plus one per dedupe key
+    size_t copied = 0, baseline_bytes = 0, baseline_unique = 0;
+    double copy_ms = bench_ms([&]{
+        size_t before = g_bench_alloc_bytes.load();
+        std::vector<std::string> contents;
+        std::unordered_set<std::string> seen;
+        for(const auto& [dir, dnode] : vfs.overlayRoot(0)->children().find("src")->second->children()){
+            for(const auto& [name, file] : dnode->children()){
+                contents.push_back(file->read());
+                if(seen.insert(contents.back()).second) ++baseline_unique;
+            }
+        }
+        copied = contents.size();
+        baseline_bytes = g_bench_alloc_bytes.load() - before;
+    });
+
+    size_t shared_bytes = 0, shared_unique = 0;
+    double shared_ms = bench_ms([&]{
+        size_t before = g_bench_alloc_bytes.load();
+        ContextBuilder builder(vfs, vfs.tag_storage, vfs.tag_registry);
+        builder.addFilter(ContextFilter::nodeKind(VfsNode::Kind::File));
+        builder.collect();
+        builder.deduplicateEntries();
+        shared_unique = builder.entryCount();
+        shared_bytes = g_bench_alloc_bytes.load() - before;
+    });
+    bench_report("collect + dedupe", copy_ms, shared_ms, "copies", "shared");
+    std::cout << "  allocated: " << baseline_bytes / (1 << 20) << " MB (copies)  "
+              << shared_bytes / (1 << 20) << " MB (shared)  " << copied << " entries, "
+              << shared_unique << " unique\n";
+}
+
+void bench_blob_store(size_t overlays, size_t headers){
+    std::cout << "\n=== Blob store (" << overlays << " overlays x " << headers << " shared headers) ===\n";
+    std::vector<std::string> bodies;
+    for(size_t i = 0; i < headers; ++i)
+        bodies.push_back("#pragma once\n// " + bench_name(i) + "\n" + std::string(8192, static_cast<char>('a' + i % 26)));
+
+    // Overlay chains repeat the same headers, plus one file of their own
+    Vfs vfs;
+    size_t logical = 0;
+    double write_ms = bench_ms([&]{
+        for(size_t o = 1; o <= overlays; ++o){
+            size_t id = vfs.registerOverlay("chain" + std::to_string(o), std::make_shared<DirNode>("/"));
+            for(size_t i = 0; i < headers; ++i){
+                vfs.write("/include/h" + std::to_string(i) + ".h", bodies[i], id);
+                logical += bodies[i].size();
+            }
+            vfs.write("/src/own.cpp", std::string(4096, 'o') + std::to_string(o), id);
+        }
+    });
+    auto st = vfs.blobs.stats();
+    std::cout << "  write " << std::fixed << std::setprecision(2) << write_ms << " ms  blobs " << st.blobs
+              << "  held " << st.unique_bytes / 1024 << " KB of " << st.logical_bytes / 1024 << " KB"
+              << "  saved " << st.savedBytes() / 1024 << " KB\n";
+
+    // A saved overlay writes each repeated content once
+    Vfs dup;
+    for(size_t i = 0; i < headers; ++i){
+        dup.write("/a/h" + std::to_string(i) + ".h", bodies[i]);
+        dup.write("/b/h" + std::to_string(i) + ".h", bodies[i]);
+    }
+    auto file = (std::filesystem::temp_directory_path() / "vfs_bench_blobs.vfs").string();
+    save_overlay_to_file(dup, 0, file);
+    size_t saved_size = std::filesystem::file_size(file);
+    std::cout << "  overlay file " << saved_size / 1024 << " KB for " << 2 * headers * 8 << " KB of files\n";
+    std::filesystem::remove(file);
+}
+
+void bench_overlay_usage(size_t ops){
+    std::cout << "\n=== Overlay usage accounting (" << ops << " random mutations) ===\n";
+    Vfs vfs;
+    size_t id = vfs.registerOverlay("usage", std::make_shared<DirNode>("/"));
+    std::mt19937 rng(7);
+    auto path = [&](size_t depth){
+        std::string p;
+        for(size_t d = 0; d < depth; ++d) p += "/d" + std::to_string(rng() % 6);
+        return p + "/f" + std::to_string(rng() % 40);
+    };
+    std::shared_ptr<DirNode> snap;
+    size_t failed = 0;
+    double mutate_ms = bench_ms([&]{
+        for(size_t i = 0; i < ops; ++i){
+            std::string p = path(1 + rng() % 3);
+            try{
+                switch(rng() % 9){
+                case 0: case 1: vfs.write(p, std::string(rng() % 2048, 'w'), id); break;
+                case 2: vfs.append(p, std::string(rng() % 512, 'a'), id); break;
+                case 3: vfs.writeRange(p, rng() % 1024, std::string(rng() % 256, 'r'), id); break;
+                case 4: vfs.rm(rng() % 8 ? p : p.substr(0, p.rfind('/')), id); break;
+                case 5: vfs.mv(p, path(1), id); break;
+                case 6: vfs.addNode(p.substr(0, p.rfind('/')), std::make_shared<FileNode>("n" + std::to_string(i % 7), "node"), id); break;
+                case 7: {
+                    auto tx = vfs.transaction(id);
+                    tx.write(path(2), std::string(300, 't'));
+                    tx.write(path(2) + "/below", "x");  // fails when its parent is a file
+                    tx.commit();
+                    break;
+                }
+                case 8:
+                    if(snap && rng() % 2) vfs.restoreOverlay(id, snap);
+                    else snap = vfs.snapshotOverlay(id);
+                    break;
+                }
+            } catch(const std::exception&){
+                ++failed;
+            }
+        }
+    });
+    auto running = vfs.overlayUsage(id);
+    Vfs::OverlayUsage measured;
+    double measure_ms = bench_ms([&]{ measured = Vfs::measureTree(vfs.overlayRoot(id)); });
+    double query_ms = bench_ms([&]{ running = vfs.overlayUsage(id); });
+    bench_report("usage query", measure_ms, query_ms, "full walk", "running");
+    std::cout << "  " << std::fixed << std::setprecision(2) << mutate_ms << " ms for mutations (" << failed
+              << " failed)  nodes " << running.nodes << "  content " << running.content_bytes / 1024 << " KB\n";
+}
+
+void bench_tree_walk(size_t fanout){
+    const size_t nodes = 1 + fanout + fanout * fanout + fanout * fanout * fanout;
+    std::cout << "\n=== Tree traversal (" << nodes << " nodes, " << WorkerPool::shared().size() << " workers) ===\n";
+    auto root = std::make_shared<DirNode>("/");
+    for(size_t a = 0; a < fanout; ++a){
+        auto da = std::make_shared<DirNode>("a" + std::to_string(a));
+        root->children()[da->name] = da;
+        for(size_t b = 0; b < fanout; ++b){
+            auto db = std::make_shared<DirNode>("b" + std::to_string(b));
+            da->children()[db->name] = db;
+            for(size_t c = 0; c < fanout; ++c){
+                auto f = std::make_shared<FileNode>("f" + std::to_string(c), std::string(c % 64, 'x'));
+                db->children()[f->name] = f;
+            }
+        }
+    }
+
+    // Baseline: the recursive walkers the engine replaced
+    size_t rec_nodes = 0, rec_bytes = 0;
+    std::function<void(const std::shared_ptr<VfsNode>&, const std::string&)> recurse =
+        [&](const std::shared_ptr<VfsNode>& node, const std::string& path){
+            ++rec_nodes;
+            if(!node->isDir()){
+                rec_bytes += node->size() + path.size();
+                return;
+            }
+            for(const auto& [name, child] : node->children()) recurse(child, join_path(path, name));
+        };
+    double rec_ms = bench_ms([&]{ recurse(root, "/"); });
+
+    size_t seq_nodes = 0, seq_bytes = 0;
+    double seq_ms = bench_ms([&]{
+        TreeWalker().walk(root, "/", [&](const TreeWalker::Item& item){
+            ++seq_nodes;
+            if(!item.node->isDir()) seq_bytes += item.node->size() + item.path.size();
+            return TreeWalker::Action::Descend;
+        });
+    });
+    bench_report("walk with paths", rec_ms, seq_ms, "recursive", "TreeWalker");
+
+    struct Lane { size_t nodes = 0, bytes = 0; };
+    std::vector<Lane> lanes;
+    double par_ms = bench_ms([&]{
+        ParallelWalk walk(root, "/");
+        lanes.assign(walk.lanes(), Lane());
+        walk.run([&](const TreeWalker::Item& item){
+            Lane& lane = lanes[item.lane];
+            ++lane.nodes;
+            if(!item.node->isDir()) lane.bytes += item.node->size() + item.path.size();
+            return TreeWalker::Action::Descend;
+        });
+    });
+    bench_report("walk with paths", seq_ms, par_ms, "TreeWalker", "ParallelWalk");
+
+    // A chain far deeper than the call stack allows
+    const size_t depth = 200000;
+    auto chain = std::make_shared<DirNode>("/");
+    auto cur = chain;
+    for(size_t i = 0; i < depth; ++i){
+        auto next = std::make_shared<DirNode>("d");
+        cur->children()[next->name] = next;
+        cur = next;
+    }
+    size_t deepest = 0;
+    TreeWalker::Options no_paths;
+    no_paths.paths = false;
+    double deep_ms = bench_ms([&]{
+        TreeWalker(no_paths).walk(chain, std::string(), [&](const TreeWalker::Item& item){
+            deepest = std::max(deepest, item.depth);
+            return TreeWalker::Action::Descend;
+        });
+    });
+    // Taken apart top down: dropping the root would recurse as deep
+    for(std::shared_ptr<VfsNode> n = chain; n && !n->children().empty();){
+        auto child = n->children().begin()->second;
+        n->children().clear();
+        n = child;
+    }
+
+    std::cout << "  " << lanes.size() << " lanes  depth " << deepest << " chain " << std::fixed << std::setprecision(2)
+              << deep_ms << " ms\n";
+}
+
+// Paths in every overlay whose node carries the tag, found by walking them all
+std::vector<std::string> bench_tagged_by_walk(Vfs& vfs, TagId tag){
+    auto guard = vfs.readLock();
+    std::vector<std::string> out;
+    TreeWalker::Options opts;
+    opts.mounts = false;
+    for(size_t id = 0; id < vfs.overlayCount(); ++id){
+        TreeWalker(opts).walk(vfs.overlayRoot(id), "/", [&](const TreeWalker::Item& item){
+            if(vfs.tag_storage.hasTag(item.node.get(), tag)) out.push_back(item.path);
+            return TreeWalker::Action::Descend;
+        });
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+void bench_tag_paths(size_t files){
+    std::cout << "\n=== Tag queries (" << files << " files, every 100th tagged) ===\n";
+    Vfs vfs;
+    {
+        auto tx = vfs.transaction();
+        for(size_t i = 0; i < files; ++i)
+            tx.write("/src/m" + std::to_string(i % 32) + "/d" + std::to_string(i % 211) + "/" + bench_name(i), "x");
+        tx.commit();
+    }
+    for(size_t i = 0; i < files; i += 100)
+        vfs.addTag("/src/m" + std::to_string(i % 32) + "/d" + std::to_string(i % 211) + "/" + bench_name(i), "hot");
+    TagId hot = vfs.getTagId("hot");
+    std::vector<std::string> walked, indexed;
+    double walk_ms = bench_ms([&]{ walked = bench_tagged_by_walk(vfs, hot); });
+    double index_ms = bench_ms([&]{ indexed = vfs.findNodesByTag("hot"); });
+    bench_report("findNodesByTag", walk_ms, index_ms, "full walk", "path index");
+}
+
+// The matcher VfsVisitor used before patterns were compiled: reads the
+// pattern again for every name and backtracks to the last *
+bool bench_glob_interpreted(const std::string& name, const std::string& pattern){
+    size_t n = 0, p = 0, star = std::string::npos, mark = 0;
+    while(n < name.size()){
+        if(p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])){
+            ++n;
+            ++p;
+        } else if(p < pattern.size() && pattern[p] == '*'){
+            star = p++;
+            mark = n;
+        } else if(star != std::string::npos){
+            p = star + 1;
+            n = ++mark;
+        } else {
+            return false;
+        }
+    }
+    while(p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+void bench_find(size_t files){
+    std::cout << "\n=== Glob find (" << files << " files, " << WorkerPool::shared().size() << " workers) ===\n";
+    Vfs vfs;
+    {
+        const char* exts[] = {".cpp", ".h", ".txt", ".cc", ".md"};
+        auto tx = vfs.transaction();
+        for(size_t i = 0; i < files; ++i)
+            tx.write("/co/m" + std::to_string(i % 16) + "/d" + std::to_string(i % 997) + "/" + bench_name(i) + exts[i % 5], "");
+        tx.commit();
+    }
+    std::vector<std::shared_ptr<VfsNode>> before;
+    double before_ms = bench_ms([&]{
+        auto guard = vfs.readLock();
+        TreeWalker::Options opts;
+        opts.paths = false;
+        TreeWalker(opts).walk(vfs.resolve("/co"), std::string(), [&](const TreeWalker::Item& item){
+            if(item.depth > 0 && bench_glob_interpreted(item.node->name, "*.cpp")) before.push_back(item.node);
+            return TreeWalker::Action::Descend;
+        });
+    });
+    VfsVisitor visitor(&vfs);
+    double after_ms = bench_ms([&]{ visitor.find("/co", "*.cpp"); });
+    bench_report("find *.cpp", before_ms, after_ms, "interpreted", "compiled");
+    double path_ms = bench_ms([&]{ visitor.find("/co", "m1/**/*.h"); });
+    std::cout << "  path glob m1/**/*.h " << std::fixed << std::setprecision(2) << path_ms << " ms, "
+              << visitor.count() << " hits\n";
+
+    // The same through a host mount
+    namespace fs = std::filesystem;
+    auto host = fs::temp_directory_path() / "vfs_bench_find";
+    fs::remove_all(host);
+    const size_t host_files = std::min<size_t>(files / 10, 20000);
+    for(size_t i = 0; i < host_files; ++i){
+        auto d = host / ("d" + std::to_string(i % 50));
+        if(i < 50) fs::create_directories(d);
+        std::ofstream(d / (bench_name(i) + (i % 3 ? ".cpp" : ".h")));
+    }
+    vfs.mountFilesystem(host.string(), "/host");
+    double mount_ms = bench_ms([&]{ visitor.find("/host", "*.cpp"); });
+    size_t mounted = visitor.count();
+    vfs.unmount("/host");
+    fs::remove_all(host);
+    std::cout << "  mounted checkout (" << host_files << " files) " << mount_ms << " ms, " << mounted << " hits\n";
+}
+
+void bench_mount_cache(size_t files){
+    namespace fs = std::filesystem;
+    std::cout << "\n=== Host mount cache (" << files << " files) ===\n";
+    auto host = fs::temp_directory_path() / "vfs_bench_mount";
+    fs::remove_all(host);
+    for(size_t i = 0; i < files; ++i){
+        auto d = host / ("d" + std::to_string(i % 64)) / ("s" + std::to_string(i % 7));
+        if(i < 64 * 7) fs::create_directories(d);
+        std::ofstream(d / (bench_name(i) + ".cpp")) << "x";
+    }
+    auto walk = [](Vfs& vfs){
+        size_t n = 0, bytes = 0;
+        auto guard = vfs.readLock();
+        TreeWalker::Options opts;
+        opts.paths = false;
+        TreeWalker(opts).walk(vfs.resolve("/host"), std::string(), [&](const TreeWalker::Item& item){
+            ++n;
+            if(!item.node->isDir()) bytes += item.node->size();
+            return TreeWalker::Action::Descend;
+        });
+        return n + bytes;
+    };
+    // A fresh mount lists and stats everything, as every walk used to
+    Vfs vfs;
+    vfs.mountFilesystem(host.string(), "/host");
+    size_t first = 0, again = 0;
+    double first_ms = bench_ms([&]{ first = walk(vfs); });
+    double again_ms = bench_ms([&]{ again = walk(vfs); });
+    bench_report("walk + size", first_ms, again_ms, "uncached", "cached");
+
+    vfs.unmount("/host");
+    fs::remove_all(host);
+}
+
+void bench_mount_prefetch(size_t files){
+    namespace fs = std::filesystem;
+    std::cout << "\n=== Mount prefetch (" << files << " files) ===\n";
+    auto host = fs::temp_directory_path() / "vfs_bench_prefetch";
+    fs::remove_all(host);
+    for(size_t i = 0; i < files; ++i){
+        auto d = host / ("d" + std::to_string(i % 32)) / ("s" + std::to_string(i % 5));
+        if(i < 32 * 5) fs::create_directories(d);
+        std::ofstream(d / (bench_name(i) + ".h")) << "#pragma once\n";
+    }
+    auto walk = [](Vfs& vfs){
+        size_t n = 0;
+        auto guard = vfs.readLock();
+        TreeWalker::Options opts;
+        opts.paths = false;
+        TreeWalker(opts).walk(vfs.resolve("/host"), std::string(), [&](const TreeWalker::Item& item){
+            if(!item.node->isDir()) n += item.node->size();
+            return TreeWalker::Action::Descend;
+        });
+        return n;
+    };
+    // The first interactive walk over a fresh mount lists and stats everything
+    Vfs cold;
+    cold.mountFilesystem(host.string(), "/host");
+    size_t cold_bytes = 0;
+    double cold_ms = bench_ms([&]{ cold_bytes = walk(cold); });
+
+    Vfs warm;
+    warm.mountFilesystem(host.string(), "/host");
+    warm.prefetchMount("/host");
+    auto prefetch = warm.listMounts().front().prefetch;
+    double prefetch_ms = bench_ms([&]{ prefetch->wait(); });
+    size_t warm_bytes = 0;
+    double warm_ms = bench_ms([&]{ warm_bytes = walk(warm); });
+    bench_report("first walk + size", cold_ms, warm_ms, "cold", "prefetched");
+    auto p = prefetch->progress();
+    std::cout << "  prefetch " << std::fixed << std::setprecision(2) << prefetch_ms << " ms in the background, "
+              << p.dirs << " dirs, " << p.files << " files\n";
+
+    fs::remove_all(host);
+}
+
+void bench_mount_read(size_t mb){
+    namespace fs = std::filesystem;
+    std::cout << "\n=== Host file reads (" << mb << " MB log, 3 x 1 KB sources) ===\n";
+    auto host = fs::temp_directory_path() / "vfs_bench_read";
+    fs::remove_all(host);
+    fs::create_directories(host);
+    {
+        std::ofstream log(host / "build.log", std::ios::binary);
+        for(size_t i = 0; log.tellp() < static_cast<std::streamoff>(mb << 20); ++i)
+            log << "[" << i << "] compiling " << bench_name(i) << ".cpp\n";
+    }
+    for(int i = 0; i < 3; ++i) std::ofstream(host / ("s" + std::to_string(i) + ".h")) << std::string(1000, 'a' + i);
+    Vfs vfs;
+    vfs.mountFilesystem(host.string(), "/host");
+    auto node = vfs.resolve("/host/build.log");
+    const int rounds = 5;
+
+    // What MountNode::read did: an ifstream copied through an ostringstream
+    size_t legacy_lines = 0, legacy_bytes = 0;
+    double legacy_ms = bench_ms([&]{
+        size_t before = g_bench_alloc_bytes.load();
+        for(int r = 0; r < rounds; ++r){
+            std::ifstream ifs(host / "build.log", std::ios::binary);
+            std::ostringstream oss;
+            oss << ifs.rdbuf();
+            legacy_lines += count_lines(oss.str());
+        }
+        legacy_bytes = g_bench_alloc_bytes.load() - before;
+    });
+    size_t pread_lines = 0, pread_bytes = 0;
+    double pread_ms = bench_ms([&]{
+        size_t before = g_bench_alloc_bytes.load();
+        for(int r = 0; r < rounds; ++r) pread_lines += count_lines(node->read());
+        pread_bytes = g_bench_alloc_bytes.load() - before;
+    });
+    size_t view_lines = 0, view_bytes = 0;
+    double view_ms = bench_ms([&]{
+        size_t before = g_bench_alloc_bytes.load();
+        for(int r = 0; r < rounds; ++r) view_lines += count_lines(node->readView().data);
+        view_bytes = g_bench_alloc_bytes.load() - before;
+    });
+    bench_report("read + count lines", legacy_ms, pread_ms, "ifstream", "pread");
+    bench_report("read + count lines", legacy_ms, view_ms, "ifstream", "mmap view");
+    std::cout << "  allocated: " << legacy_bytes / (1 << 20) << " MB (ifstream)  "
+              << pread_bytes / (1 << 20) << " MB (pread)  " << view_bytes / (1 << 20) << " MB (mmap view)\n";
+
+    vfs.unmount("/host");
+    node.reset();
+    fs::remove_all(host);
+}
+
+void bench_export(size_t files){
+    namespace fs = std::filesystem;
+    std::cout << "\n=== Export to host (" << files << " files) ===\n";
+    Vfs vfs;
+    for(size_t i = 0; i < files; ++i)
+        vfs.write("/pkg/p" + std::to_string(i % 100) + "/" + bench_name(i) + ".cpp", "int f" + std::to_string(i) + "();\n");
+    auto tree = vfs.resolve("/pkg");
+    auto host = fs::temp_directory_path() / "vfs_bench_export";
+    fs::remove_all(host);
+
+    // What export did per file: resolve, read, open an ofstream and write
+    double serial_ms = bench_ms([&]{
+        auto guard = vfs.readLock();
+        TreeWalker().walk(tree, (host / "serial").string(), [&](const TreeWalker::Item& item){
+            if(item.node->isDir()){
+                fs::create_directories(item.path);
+                return TreeWalker::Action::Descend;
+            }
+            std::string data = item.node->read();
+            std::ofstream out(item.path, std::ios::binary);
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            return TreeWalker::Action::Skip;
+        });
+    });
+    ExportResult uring;
+    double uring_ms = bench_ms([&]{
+        uring = export_tree(vfs, tree, (host / "uring").string(), HostIoBatch::Backend::Uring);
+    });
+    double thread_ms = bench_ms([&]{
+        export_tree(vfs, tree, (host / "threads").string(), HostIoBatch::Backend::Threads);
+    });
+    bench_report("export", serial_ms, uring_ms, "ofstream", HostIoBatch::backendName(uring.backend));
+    bench_report("export", serial_ms, thread_ms, "ofstream", "thread pool");
+    fs::remove_all(host);
+}
+
+// The daemon's server behind an ephemeral localhost port
+struct BenchRemoteServer {
+    int listen_fd = -1;
+    int port = 0;
+    std::unique_ptr<RemoteServer> server;
+    std::thread loop;
+
+    explicit BenchRemoteServer(size_t workers = 0, size_t max_running = 0){
+        listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        ::bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+        ::listen(listen_fd, SOMAXCONN);
+        ::getsockname(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), &len);
+        port = ntohs(addr.sin_port);
+        server = std::make_unique<RemoteServer>(listen_fd, workers, max_running);
+        loop = std::thread([this]{ server->run(); });
+    }
+    ~BenchRemoteServer(){
+        server->stop();
+        loop.join();
+        server.reset();
+        ::close(listen_fd);
+    }
+};
+
+void bench_remote_cat(size_t files){
+    namespace fs = std::filesystem;
+    std::cout << "\n=== Remote cat over localhost (" << files << " files) ===\n";
+    auto host = fs::temp_directory_path() / "vfs_bench_remote";
+    fs::remove_all(host);
+    fs::create_directories(host);
+    auto content = [](size_t i){
+        return "// file " + std::to_string(i) + "\nint f" + std::to_string(i) + "();\n\tstruct S { char c = '\\0'; };\n";
+    };
+    for(size_t i = 0; i < files; ++i) std::ofstream(host / (bench_name(i) + ".h"), std::ios::binary) << content(i);
+    // More lines than one recv() brings in
+    std::string big;
+    for(size_t i = 0; big.size() < (1 << 20); ++i) big += "line " + std::to_string(i) + "\n";
+    std::ofstream(host / "big.txt", std::ios::binary) << big;
+
+    auto server = std::make_unique<BenchRemoteServer>();
+    int port = server->port;
+
+    std::vector<std::string> paths;
+    for(size_t i = 0; i < files; ++i) paths.push_back((host / (bench_name(i) + ".h")).string());
+    size_t exec_big = 0, bytes = 0;
+    {
+        // What cat did before: one EXEC "cat" round trip per file
+        RemoteSession legacy("127.0.0.1", port, false);
+        double exec_ms = bench_ms([&]{
+            for(size_t i = 0; i < files; ++i) bytes += legacy.exec("cat " + paths[i]).size();
+        });
+        // The reply was taken to end with the first recv() holding a newline
+        exec_big = legacy.exec("cat " + (host / "big.txt").string()).size();
+        Vfs vfs;
+        vfs.mountRemote("127.0.0.1", port, host.string(), "/remote");
+        // Each run starts with the listing leased and no file contents cached
+        auto session_of_mount = std::static_pointer_cast<RemoteNode>(vfs.resolve("/remote"))->session;
+        auto cold = [&]{
+            session_of_mount->setLeaseTtl(std::chrono::seconds(30));
+            vfs.resolve("/remote")->children();
+        };
+        cold();
+        double seq_ms = bench_ms([&]{
+            for(size_t i = 0; i < files; ++i) bytes += vfs.read("/remote/" + bench_name(i) + ".h").size();
+        });
+        // As cat does now, every READ sent before the first reply is read
+        cold();
+        double pipe_ms = bench_ms([&]{
+            std::vector<std::future<RemoteSession::Reply>> replies;
+            for(size_t i = 0; i < files; ++i)
+                replies.push_back(std::static_pointer_cast<RemoteNode>(vfs.resolve("/remote/" + bench_name(i) + ".h"))->readAsync());
+            for(size_t i = 0; i < files; ++i) bytes += RemoteSession::replyData(std::move(replies[i])).size();
+        });
+        bench_report("cat", exec_ms, seq_ms, "EXEC", "VFSB");
+        bench_report("cat", exec_ms, pipe_ms, "EXEC", "VFSB pipelined");
+        vfs.unmount("/remote");
+    }
+    server.reset();
+    fs::remove_all(host);
+    std::cout << "  big.txt over EXEC: " << exec_big << " of " << big.size() << " bytes; "
+              << bytes / (1 << 10) << " KB read\n";
+}
+
+void bench_remote_listing(size_t entries){
+    namespace fs = std::filesystem;
+    std::cout << "\n=== Remote directory listing (" << entries << " entries) ===\n";
+    auto host = fs::temp_directory_path() / "vfs_bench_remote_ls";
+    fs::remove_all(host);
+    fs::create_directories(host);
+    for(size_t i = 0; i < entries; ++i){
+        if(i % 10 == 0) fs::create_directories(host / bench_name(i));
+        else std::ofstream(host / (bench_name(i) + ".h")) << std::string(i % 100, 'x');
+    }
+    BenchRemoteServer server;
+    auto stat_all = [](const std::shared_ptr<VfsNode>& dir){
+        size_t dirs = 0, bytes = 0;
+        for(auto& kv : dir->children()){
+            if(kv.second->isDir()) ++dirs;
+            else bytes += kv.second->size();
+        }
+        return dirs * 1000000 + bytes;
+    };
+    {
+        // What ls did: the listing, then a "test -d" round trip per entry. The
+        // names come from READDIR, as EXEC cuts a listing this long short.
+        RemoteSession session("127.0.0.1", server.port);
+        RemoteSession legacy("127.0.0.1", server.port, false);
+        size_t exec_dirs = 0;
+        double exec_ms = bench_ms([&]{
+            for(auto& e : session.readDir(host.string()))
+                exec_dirs += legacy.exec("test -d " + (host / e.name).string() + " && echo yes || echo no") == "yes\n";
+        });
+        // VFSB before READDIRPLUS: the listing, then a STAT per entry
+        size_t stat_sum = 0;
+        double stat_ms = bench_ms([&]{
+            for(auto& e : session.readDir(host.string())){
+                auto st = session.stat((host / e.name).string());
+                stat_sum += st.type == RemoteEntry::Type::Dir ? 1000000 : st.size;
+            }
+        });
+        Vfs vfs;
+        vfs.mountRemote("127.0.0.1", server.port, host.string(), "/remote");
+        size_t plus_sum = 0;
+        double plus_ms = bench_ms([&]{ plus_sum = stat_all(vfs.resolve("/remote")); });
+        bench_report("list + type + size", exec_ms, plus_ms, "EXEC", "READDIRPLUS");
+        bench_report("list + type + size", stat_ms, plus_ms, "STAT each", "READDIRPLUS");
+        vfs.unmount("/remote");
+        std::cout << "  " << exec_dirs << " directories, " << stat_sum % 1000000 << " bytes by STAT, "
+                  << plus_sum % 1000000 << " by READDIRPLUS\n";
+    }
+    fs::remove_all(host);
+}
+
+void bench_remote_lease(size_t files, size_t rounds){
+    namespace fs = std::filesystem;
+    std::cout << "\n=== Remote lease cache (" << files << " files x " << rounds << " reads) ===\n";
+    auto host = fs::temp_directory_path() / "vfs_bench_remote_lease";
+    fs::remove_all(host);
+    fs::create_directories(host);
+    for(size_t i = 0; i < files; ++i) std::ofstream(host / (bench_name(i) + ".h")) << "v0 " << i << "\n";
+    BenchRemoteServer server;
+    double notice_ms = -1;
+    RemoteSession::CacheStats stats;
+    {
+        Vfs vfs;
+        vfs.mountRemote("127.0.0.1", server.port, host.string(), "/remote");
+        auto session = std::static_pointer_cast<RemoteNode>(vfs.resolve("/remote"))->session;
+        auto read_all = [&]{
+            for(size_t r = 0; r < rounds; ++r)
+                for(size_t i = 0; i < files; ++i) vfs.read("/remote/" + bench_name(i) + ".h");
+        };
+        session->setLeaseTtl(std::chrono::milliseconds(0));
+        double remote_ms = bench_ms(read_all);
+        session->setLeaseTtl(std::chrono::seconds(30));
+        double leased_ms = bench_ms(read_all);
+        bench_report("hot reads", remote_ms, leased_ms, "uncached", "leased");
+
+        // Changes on the server reach the cache without waiting out the TTL
+        auto wait_for = [&](const std::function<bool()>& seen){
+            auto start = BenchClock::now();
+            while(!seen()){
+                if(BenchClock::now() - start > std::chrono::seconds(5)) return -1.0;
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+        };
+        std::string first = "/remote/" + bench_name(0) + ".h";
+        std::ofstream(host / (bench_name(0) + ".h")) << "v1\n";
+        notice_ms = wait_for([&]{ return vfs.read(first) == "v1\n"; });
+        stats = session->cacheStats();
+        vfs.unmount("/remote");
+    }
+    fs::remove_all(host);
+    std::cout << "  server change seen after " << std::fixed << std::setprecision(2) << notice_ms << " ms; "
+              << stats.hits << " hits, " << stats.misses << " misses, " << stats.invalidations << " invalidations\n";
+}
+
+void bench_remote_pool(size_t dirs, size_t files, size_t threads){
+    namespace fs = std::filesystem;
+    std::cout << "\n=== Remote connection pool (" << dirs << " mounts x " << files << " files, " << threads << " threads) ===\n";
+    auto host = fs::temp_directory_path() / "vfs_bench_remote_pool";
+    fs::remove_all(host);
+    std::vector<std::string> paths;
+    for(size_t d = 0; d < dirs; ++d){
+        fs::create_directories(host / ("d" + std::to_string(d)));
+        for(size_t i = 0; i < files; ++i){
+            paths.push_back((host / ("d" + std::to_string(d)) / (bench_name(i) + ".h")).string());
+            std::ofstream(paths.back()) << paths.back();
+        }
+    }
+    BenchRemoteServer server;
+    // Every thread reads every file of every mount, uncached
+    auto read_all = [&](const std::function<RemoteSession&(size_t)>& session_of){
+        std::vector<std::thread> workers;
+        for(size_t t = 0; t < threads; ++t)
+            workers.emplace_back([&, t]{
+                for(size_t k = 0; k < paths.size(); ++k){
+                    size_t i = (k + t * files) % paths.size();
+                    session_of(i / files).read(paths[i]);
+                }
+            });
+        for(auto& w : workers) w.join();
+    };
+
+    // Baseline: a session, and so a connection, per mount
+    std::vector<std::unique_ptr<RemoteSession>> own;
+    for(size_t d = 0; d < dirs; ++d){
+        own.push_back(std::make_unique<RemoteSession>("127.0.0.1", server.port));
+        own.back()->setPoolSize(1);
+        own.back()->setLeaseTtl(std::chrono::milliseconds(0));
+    }
+    double own_ms = bench_ms([&]{ read_all([&](size_t d) -> RemoteSession& { return *own[d]; }); });
+    size_t own_open = 0;
+    for(auto& s : own) own_open += s->poolStats().open;
+    own.clear();
+
+    RemoteSession::PoolStats pool;
+    {
+        Vfs vfs;
+        for(size_t d = 0; d < dirs; ++d)
+            vfs.mountRemote("127.0.0.1", server.port, (host / ("d" + std::to_string(d))).string(), "/r" + std::to_string(d));
+        auto session = std::static_pointer_cast<RemoteNode>(vfs.resolve("/r0"))->session;
+        session->setLeaseTtl(std::chrono::milliseconds(0));
+        double shared_ms = bench_ms([&]{ read_all([&](size_t) -> RemoteSession& { return *session; }); });
+        pool = session->poolStats();
+        bench_report("read", own_ms, shared_ms, "session per mount", "shared pool");
+        std::cout << "  connections: " << own_open << " (session per mount)  " << pool.open << " (shared pool, "
+                  << pool.requests << " requests)\n";
+        for(size_t d = 0; d < dirs; ++d) vfs.unmount("/r" + std::to_string(d));
+    }
+
+    fs::remove_all(host);
+}
+
+void bench_remote_daemon(size_t clients, size_t rounds){
+    namespace fs = std::filesystem;
+    // Each client is a socket at both ends of the connection
+    struct rlimit files;
+    if(::getrlimit(RLIMIT_NOFILE, &files) == 0){
+        if(files.rlim_cur < files.rlim_max){
+            files.rlim_cur = files.rlim_max;
+            ::setrlimit(RLIMIT_NOFILE, &files);
+        }
+        if(files.rlim_cur != RLIM_INFINITY) clients = std::min<size_t>(clients, (files.rlim_cur - 256) / 2);
+    }
+    auto host = fs::temp_directory_path() / "vfs_bench_remote_daemon";
+    fs::remove_all(host);
+    fs::create_directories(host);
+    std::vector<std::string> paths;
+    for(size_t i = 0; i < 64; ++i){
+        paths.push_back((host / (bench_name(i) + ".h")).string());
+        std::ofstream(paths.back()) << paths.back();
+    }
+    auto server = std::make_unique<BenchRemoteServer>();
+    std::cout << "\n=== Daemon server (" << clients << " clients x " << rounds << " rounds, "
+              << server->server->workers() << " workers) ===\n";
+
+    // As many processes mounting the daemon would, with a connection each
+    std::vector<std::unique_ptr<RemoteSession>> sessions;
+    double connect_ms = bench_ms([&]{
+        for(size_t i = 0; i < clients; ++i){
+            sessions.push_back(std::make_unique<RemoteSession>("127.0.0.1", server->port));
+            sessions.back()->setPoolSize(1);
+            sessions.back()->setLeaseTtl(std::chrono::milliseconds(0));
+            sessions.back()->binary();
+        }
+    });
+
+    // Every client has a READ outstanding at once, round after round
+    std::vector<double> round_ms;
+    double total_ms = bench_ms([&]{
+        for(size_t r = 0; r < rounds; ++r){
+            auto start = BenchClock::now();
+            std::vector<std::future<RemoteSession::Reply>> replies;
+            for(size_t i = 0; i < clients; ++i)
+                replies.push_back(sessions[i]->request(RemoteSession::Op::Read, paths[(i + r) % paths.size()]));
+            for(size_t i = 0; i < clients; ++i) RemoteSession::replyData(std::move(replies[i]));
+            round_ms.push_back(std::chrono::duration<double, std::milli>(BenchClock::now() - start).count());
+        }
+    });
+    std::sort(round_ms.begin(), round_ms.end());
+    std::cout << "  connect: " << connect_ms << " ms  round p50: " << round_ms[round_ms.size() / 2]
+              << " ms  max: " << round_ms.back() << " ms  "
+              << static_cast<long>(clients * rounds * 1000.0 / std::max(total_ms, 0.001)) << " requests/s\n";
+
+    sessions.clear();
+    server.reset();
+    fs::remove_all(host);
+}
+
+void bench_transaction(size_t files){
+    std::cout << "\n=== Batched transactions (" << files << " files) ===\n";
+    std::vector<std::string> paths;
+    for(size_t i = 0; i < files; ++i)
+        paths.push_back("/pkg/p" + std::to_string(i / 100) + "/src/" + bench_name(i));
+
+    Vfs single;
+    single.registerOverlay("batch", std::make_shared<DirNode>("/"));
+    double single_ms = bench_ms([&]{ for(const auto& p : paths) single.write(p, "x", 1); });
+
+    Vfs batched;
+    batched.registerOverlay("batch", std::make_shared<DirNode>("/"));
+    double batch_ms = bench_ms([&]{
+        auto tx = batched.transaction(1);
+        for(const auto& p : paths) tx.write(p, "x");
+        tx.commit();
+    });
+    bench_report("write files", single_ms, batch_ms, "one by one", "one commit");
+}
+
+void bench_journal(size_t writes){
+    std::cout << "\n=== Change journal (" << writes << " writes) ===\n";
+    std::vector<std::string> paths;
+    for(size_t i = 0; i < 1000; ++i) paths.push_back("/w/d" + std::to_string(i % 10) + "/" + bench_name(i));
+
+    // Watches on unrelated prefixes only cost the prefix test per event
+    Vfs quiet;
+    double quiet_ms = bench_ms([&]{ for(size_t i = 0; i < writes; ++i) quiet.write(paths[i % paths.size()], "x"); });
+    Vfs watched;
+    size_t seen = 0;
+    for(int i = 0; i < 8; ++i) watched.journal.watch("/other" + std::to_string(i), [&](const VfsEvent&){ ++seen; });
+    watched.journal.watch("/w/d3", [&](const VfsEvent&){ ++seen; });
+    double watched_ms = bench_ms([&]{ for(size_t i = 0; i < writes; ++i) watched.write(paths[i % paths.size()], "x"); });
+    bench_report("write", quiet_ms, watched_ms, "no watches", "9 watches");
+
+    std::cout << "  events: " << watched.journal.lastSeq() << "  watch hits: " << seen << "\n";
+}
+
+// Readers hammer read/listDir/resolve while one writer rewrites, creates and
+// removes files; every file holds its own path so a reader can check what it got
+double bench_concurrency_round(size_t readers, size_t ops){
+    Vfs vfs;
+    std::vector<std::string> paths;
+    for(size_t i = 0; i < 512; ++i){
+        paths.push_back("/c/d" + std::to_string(i % 16) + "/" + bench_name(i));
+        vfs.write(paths.back(), paths.back());
+    }
+    std::atomic<bool> stop{false};
+    std::thread writer([&]{
+        for(size_t i = 0; !stop.load(std::memory_order_relaxed); ++i){
+            const auto& p = paths[i * 31 % paths.size()];
+            try{
+                if(i % 7 == 0) vfs.rm(p, 0);
+                else vfs.write(p, p, 0);
+                if(i % 97 == 0) vfs.snapshotOverlay(0);
+            } catch(const std::exception&){
+                // already removed
+            }
+            // An editing session, not a flood: writers take priority over readers
+            if(i % 8 == 7) std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    });
+    std::vector<std::thread> pool;
+    double ms = bench_ms([&]{
+        for(size_t t = 0; t < readers; ++t){
+            pool.emplace_back([&, t]{
+                for(size_t i = 0; i < ops; ++i){
+                    const auto& p = paths[(i * 13 + t * 101) % paths.size()];
+                    switch(i % 3){
+                    case 0:
+                        try{
+                            vfs.read(p, 0);
+                        } catch(const std::runtime_error&){
+                            // removed by the writer
+                        }
+                        break;
+                    case 1:
+                        vfs.listDir(p.substr(0, p.rfind('/')), {0});
+                        break;
+                    default:
+                        vfs.tryResolveForOverlay(p, 0);
+                    }
+                }
+            });
+        }
+        for(auto& th : pool) th.join();
+    });
+    stop = true;
+    writer.join();
+    return ms;
+}
+
+void bench_concurrency(size_t max_threads, size_t ops){
+    std::cout << "\n=== Concurrent readers + 1 writer (" << ops << " ops/reader) ===\n";
+    for(size_t n = 1; n <= max_threads; n *= 2){
+        double ms = bench_concurrency_round(n, ops);
+        std::cout << "  " << std::left << std::setw(28) << (std::to_string(n) + " reader(s)") << std::right
+                  << std::fixed << std::setprecision(2) << std::setw(10) << ms << " ms"
+                  << std::setw(12) << static_cast<size_t>(n * ops / (ms > 0 ? ms : 1)) << " ops/ms\n";
+    }
+}
+
+} // namespace
+
+int vfs_bench(int argc, char** argv){
+    size_t entries = 20000;
+    for(int i = 1; i < argc; ++i){
+        std::string arg = argv[i];
+        if(arg == "--vfs-bench") continue;
+        if(!arg.empty() && std::isdigit(static_cast<unsigned char>(arg[0]))) entries = std::stoul(arg);
+    }
+    std::cout << "VFS Benchmark Suite" << std::endl;
+    std::cout << "===================" << std::endl;
+    bench_child_index(entries, 200000);
+    bench_resolve_cache(1000000);
+    bench_overlay_arena(entries * 25);
+    bench_overlay_snapshot(entries * 10, 10000);
+    bench_overlay_index(32, 200000);
+    bench_file_rope(16, 20);
+    bench_shared_content(400, 256 * 1024);
+    bench_blob_store(16, 200);
+    bench_overlay_usage(entries * 5);
+    bench_tree_walk(100);
+    bench_tag_paths(entries * 10);
+    bench_find(entries * 25);
+    bench_mount_cache(entries * 5);
+    bench_mount_prefetch(entries * 5);
+    bench_mount_read(64);
+    bench_export(50000);
+    bench_remote_cat(2000);
+    bench_remote_listing(2000);
+    bench_remote_lease(200, 50);
+    bench_remote_pool(16, 64, 8);
+    bench_remote_daemon(1000, 20);
+    bench_transaction(entries * 5);
+    bench_journal(entries * 10);
+    bench_concurrency(std::max<size_t>(4, std::thread::hardware_concurrency()), 100000);
+    return 0;
+}
+
+#endif // VFS_BENCH_ENABLED
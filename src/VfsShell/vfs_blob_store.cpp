@@ -0,0 +1,87 @@
+#include "VfsShell.h"
+
+// ====== BlobStore ======
+
+BlobStore::Digest BlobStore::digest(std::string_view data){
+    blake3_hasher hasher;
+    blake3_hasher_init(&hasher);
+    blake3_hasher_update(&hasher, data.data(), data.size());
+    Digest out;
+    blake3_hasher_finalize(&hasher, out.data(), out.size());
+    return out;
+}
+
+std::string BlobStore::hex(const Digest& d){
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(d.size() * 2);
+    for(uint8_t b : d){
+        out.push_back(digits[b >> 4]);
+        out.push_back(digits[b & 0xf]);
+    }
+    return out;
+}
+
+BlobStore::Key BlobStore::keyOf(std::string_view data){
+    // 128 bits of the digest; hits are confirmed by content anyway
+    Digest d = digest(data);
+    Key k;
+    std::memcpy(&k.lo, d.data(), sizeof(k.lo));
+    std::memcpy(&k.hi, d.data() + sizeof(k.lo), sizeof(k.hi));
+    return k;
+}
+
+template<typename Make>
+std::shared_ptr<std::string> BlobStore::internWith(std::string_view data, Make&& make){
+    if(data.size() < MIN_SIZE) return make();
+    Key key = keyOf(data);  // hashed outside the lock
+    std::lock_guard<std::mutex> lock(mtx);
+    ++lookups;
+    auto& slot = blobs[key];
+    if(auto blob = slot.lock()){
+        if(*blob == data){
+            ++hits;
+            return blob;
+        }
+    }
+    auto blob = make();
+    slot = blob;
+    if(blobs.size() >= sweep_at){
+        for(auto it = blobs.begin(); it != blobs.end();){
+            if(it->second.expired()) it = blobs.erase(it);
+            else ++it;
+        }
+        sweep_at = std::max<size_t>(1024, blobs.size() * 2);
+    }
+    return blob;
+}
+
+std::shared_ptr<std::string> BlobStore::intern(std::string_view data){
+    return internWith(data, [&]{ return std::shared_ptr<std::string>(new std::string(data), Deleter()); });
+}
+
+std::shared_ptr<std::string> BlobStore::intern(std::string&& data){
+    std::string_view view(data);
+    return internWith(view, [&]{ return std::shared_ptr<std::string>(new std::string(std::move(data)), Deleter()); });
+}
+
+bool BlobStore::interned(const std::shared_ptr<std::string>& buf){
+    return std::get_deleter<Deleter>(buf) != nullptr;
+}
+
+BlobStore::Stats BlobStore::stats() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    Stats s;
+    s.lookups = lookups;
+    s.hits = hits;
+    for(const auto& kv : blobs){
+        auto blob = kv.second.lock();
+        if(!blob) continue;
+        size_t holders = static_cast<size_t>(blob.use_count()) - 1;  // minus ours
+        ++s.blobs;
+        s.unique_bytes += blob->size();
+        s.refs += holders;
+        s.logical_bytes += blob->size() * holders;
+    }
+    return s;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+//
+// Content-addressed blob store
+//
+// File contents are interned by BLAKE3 digest, so the same header or
+// generated file in many overlays (solution chains, AST source overlays,
+// qwen file versions) is held once and shared by every FileNode with that
+// content. The store only keeps weak references: a blob lives as long as some
+// node or reader holds it. A hit is confirmed by comparing the bytes.
+//
+// Stored buffers are never changed, even by their last holder, as the store
+// may be comparing one while another thread writes: check interned() before
+// writing a buffer in place, and write a copy instead (FileNode::ownChunk).
+//
+class BlobStore {
+public:
+    // Smaller contents are not worth hashing
+    static constexpr size_t MIN_SIZE = 256;
+    using Digest = std::array<uint8_t, BLAKE3_OUT_LEN>;
+
+    struct Stats {
+        size_t blobs = 0;          // distinct contents alive
+        size_t unique_bytes = 0;   // bytes they hold
+        size_t refs = 0;           // holders of those contents
+        size_t logical_bytes = 0;  // bytes the holders would need unshared
+        size_t lookups = 0;
+        size_t hits = 0;
+        size_t savedBytes() const { return logical_bytes - unique_bytes; }
+    };
+
+    BlobStore() = default;
+    // Copies start with an empty store of their own
+    BlobStore(const BlobStore&) : BlobStore() {}
+    BlobStore& operator=(const BlobStore&) { return *this; }
+
+    static Digest digest(std::string_view data);
+    static std::string hex(const Digest& d);
+
+    // The stored buffer equal to data, storing a new one when there is none
+    std::shared_ptr<std::string> intern(std::string_view data);
+    std::shared_ptr<std::string> intern(std::string&& data);
+    // Whether buf came from intern() of some store, and so must not be changed
+    static bool interned(const std::shared_ptr<std::string>& buf);
+    Stats stats() const;
+
+private:
+    struct Key {
+        uint64_t lo, hi;
+        bool operator==(const Key& o) const { return lo == o.lo && hi == o.hi; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const { return static_cast<size_t>(k.lo); }
+    };
+    // Stored buffers are allocated with this deleter, which marks them
+    struct Deleter {
+        void operator()(std::string* p) const { delete p; }
+    };
+    mutable std::mutex mtx;
+    std::unordered_map<Key, std::weak_ptr<std::string>, KeyHash> blobs;
+    size_t lookups = 0;
+    size_t hits = 0;
+    size_t sweep_at = 1024;  // drop expired entries when the map reaches this
+
+    static Key keyOf(std::string_view data);
+    template<typename Make>
+    std::shared_ptr<std::string> internWith(std::string_view data, Make&& make);
+};
@@ -0,0 +1,236 @@
+#include "VfsShell.h"
+
+// ====== ChildIndex ======
+
+uint64_t ChildIndex::nextGeneration(){
+    static std::atomic<uint64_t> counter{0};
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+// Copies and moves get a fresh generation so no cached lookup can mistake the
+// destination for the index it was recorded against. A copy only takes the
+// sorted order once it is complete; a reader may be building it right now.
+ChildIndex::ChildIndex(const ChildIndex& other)
+    : entries(other.entries), slots(other.slots), gen(nextGeneration()) {
+    copyOrder(other);
+}
+
+ChildIndex& ChildIndex::operator=(const ChildIndex& other){
+    if(this != &other){
+        entries = other.entries;
+        slots = other.slots;
+        copyOrder(other);
+        touch();
+    }
+    return *this;
+}
+
+void ChildIndex::copyOrder(const ChildIndex& other){
+    if(other.order_valid.load(std::memory_order_acquire)){
+        order = other.order;
+        order_valid.store(true, std::memory_order_relaxed);
+    } else {
+        order.clear();
+        order_valid.store(false, std::memory_order_relaxed);
+    }
+}
+
+ChildIndex::ChildIndex(ChildIndex&& other) noexcept
+    : entries(std::move(other.entries)), slots(std::move(other.slots)), order(std::move(other.order)),
+      order_valid(other.order_valid.load()), gen(nextGeneration()) {
+    other.clear();
+}
+
+ChildIndex& ChildIndex::operator=(ChildIndex&& other) noexcept {
+    if(this != &other){
+        entries = std::move(other.entries);
+        slots = std::move(other.slots);
+        order = std::move(other.order);
+        order_valid = other.order_valid.load();
+        touch();
+        other.clear();
+    }
+    return *this;
+}
+
+void ChildIndex::clear(){
+    entries.clear();
+    dropHash();
+    touch();
+}
+
+void ChildIndex::reserve(size_t n){
+    entries.reserve(n);
+    if(hashed() && n * 4 > slots.size() * 3) buildHash(n);
+}
+
+size_t ChildIndex::lookup(Atom key) const {
+    if(!hashed()){
+        // At most HASH_THRESHOLD ids to compare, cheaper than a name binary search
+        for(size_t i = 0; i < entries.size(); ++i) if(entries[i].first == key) return i;
+        return NPOS;
+    }
+    const size_t mask = slots.size() - 1;
+    for(size_t i = hashKey(key) & mask;; i = (i + 1) & mask){
+        uint32_t s = slots[i];
+        if(s == 0) return NPOS;
+        if(entries[s - 1].first == key) return s - 1;
+    }
+}
+
+ChildIndex::iterator ChildIndex::find(Atom key){
+    size_t idx = lookup(key);
+    if(idx == NPOS) return end();
+    return iterator(this, idx, true);
+}
+
+ChildIndex::const_iterator ChildIndex::find(Atom key) const {
+    size_t idx = lookup(key);
+    if(idx == NPOS) return end();
+    return const_iterator(this, idx, true);
+}
+
+ChildIndex::iterator ChildIndex::find(std::string_view key){
+    auto atom = Atom::lookup(key);
+    return atom ? find(*atom) : end();
+}
+
+ChildIndex::const_iterator ChildIndex::find(std::string_view key) const {
+    auto atom = Atom::lookup(key);
+    return atom ? find(*atom) : end();
+}
+
+size_t ChildIndex::count(std::string_view key) const {
+    auto atom = Atom::lookup(key);
+    return atom ? count(*atom) : 0;
+}
+
+std::shared_ptr<VfsNode>& ChildIndex::operator[](Atom key){
+    // The returned reference may be assigned through, so always count as a mutation
+    touch();
+    size_t idx = lookup(key);
+    if(idx == NPOS) idx = insertNew(key);
+    return entries[idx].second;
+}
+
+size_t ChildIndex::erase(Atom key){
+    size_t idx = lookup(key);
+    if(idx == NPOS) return 0;
+    eraseAt(idx);
+    touch();
+    return 1;
+}
+
+size_t ChildIndex::erase(std::string_view key){
+    auto atom = Atom::lookup(key);
+    return atom ? erase(*atom) : 0;
+}
+
+ChildIndex::iterator ChildIndex::erase(const_iterator it){
+    size_t idx = it.raw ? it.pos : sortedSlot(it.pos);
+    const std::string& key = entries[idx].first.str();  // atom text outlives the entry
+    eraseAt(idx);
+    touch();
+    // Return the first entry ordered after the erased key
+    ensureOrder();
+    size_t lo = 0, hi = entries.size();
+    while(lo < hi){
+        size_t mid = (lo + hi) / 2;
+        if(entries[sortedSlot(mid)].first.str() < key) lo = mid + 1; else hi = mid;
+    }
+    return iterator(this, lo, false);
+}
+
+size_t ChildIndex::insertNew(Atom key){
+    if(!hashed()){
+        const std::string& name = key.str();
+        auto it = std::lower_bound(entries.begin(), entries.end(), name,
+            [](const value_type& e, const std::string& k){ return e.first.str() < k; });
+        size_t idx = static_cast<size_t>(it - entries.begin());
+        entries.emplace(it, key, nullptr);
+        if(entries.size() > HASH_THRESHOLD) buildHash(entries.size() * 2);
+        return idx;
+    }
+    entries.emplace_back(key, nullptr);
+    order_valid = false;
+    size_t idx = entries.size() - 1;
+    if(entries.size() * 4 > slots.size() * 3) buildHash(entries.size() * 2);
+    else slotInsert(idx);
+    return idx;
+}
+
+void ChildIndex::eraseAt(size_t idx){
+    if(!hashed()){
+        entries.erase(entries.begin() + static_cast<std::ptrdiff_t>(idx));
+        return;
+    }
+    const size_t mask = slots.size() - 1;
+    auto slotOf = [&](size_t entry){
+        size_t i = hashKey(entries[entry].first) & mask;
+        while(slots[i] != entry + 1) i = (i + 1) & mask;
+        return i;
+    };
+
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    size_t hole = slotOf(idx);
+    for(size_t j = (hole + 1) & mask; slots[j] != 0; j = (j + 1) & mask){
+        size_t home = hashKey(entries[slots[j] - 1].first) & mask;
+        bool movable = (hole <= j) ? (home <= hole || home > j)
+                                   : (home <= hole && home > j);
+        if(movable){
+            slots[hole] = slots[j];
+            hole = j;
+        }
+    }
+    slots[hole] = 0;
+
+    // Swap-remove from the entry vector and repoint the moved entry's slot
+    size_t last = entries.size() - 1;
+    if(idx != last){
+        size_t s = slotOf(last);
+        entries[idx] = std::move(entries[last]);
+        slots[s] = static_cast<uint32_t>(idx + 1);
+    }
+    entries.pop_back();
+    order_valid = false;
+
+    if(entries.size() <= HASH_THRESHOLD / 2){
+        std::sort(entries.begin(), entries.end(),
+            [](const value_type& a, const value_type& b){ return a.first.str() < b.first.str(); });
+        dropHash();
+    }
+}
+
+void ChildIndex::buildHash(size_t capacity){
+    size_t n = 16;
+    while(n * 3 < capacity * 4) n <<= 1;
+    slots.assign(n, 0);
+    for(size_t i = 0; i < entries.size(); ++i) slotInsert(i);
+    order_valid = false;
+}
+
+void ChildIndex::dropHash(){
+    slots.clear();
+    order.clear();
+    order_valid = true;
+}
+
+void ChildIndex::slotInsert(size_t idx){
+    const size_t mask = slots.size() - 1;
+    size_t i = hashKey(entries[idx].first) & mask;
+    while(slots[i] != 0) i = (i + 1) & mask;
+    slots[i] = static_cast<uint32_t>(idx + 1);
+}
+
+void ChildIndex::ensureOrder() const {
+    if(!hashed() || order_valid.load(std::memory_order_acquire)) return;
+    // Readers under the Vfs read lock may list the same directory at once
+    static std::mutex order_mtx;
+    std::lock_guard<std::mutex> lock(order_mtx);
+    if(order_valid.load(std::memory_order_relaxed)) return;
+    order.resize(entries.size());
+    for(size_t i = 0; i < order.size(); ++i) order[i] = static_cast<uint32_t>(i);
+    std::sort(order.begin(), order.end(),
+        [this](uint32_t a, uint32_t b){ return entries[a].first.str() < entries[b].first.str(); });
+    order_valid.store(true, std::memory_order_release);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+struct VfsNode;
+
+//
+// Child index for directory-like nodes
+//
+// Keys are interned Atoms and are matched by id. Small directories keep their
+// entries in a name-sorted flat vector and scan it for the id. Once a directory
+// grows past HASH_THRESHOLD entries, an open-addressing hash index over the ids
+// (linear probing, backward-shift deletion) is built on top of the entry vector
+// and entries are appended unsorted; the sorted iteration order is then rebuilt
+// lazily the next time the directory is listed. Iteration always yields entries
+// in name order, so ls/tree output is unchanged.
+//
+// Every structural mutation (operator[], erase, clear) stamps the index with a
+// fresh, process-wide unique generation. Vfs uses the generations of the indices
+// walked during a lookup to validate its resolve cache. Replace children through
+// operator[], never by assigning through an iterator.
+//
+// Lookups and iteration may run on several threads at once (the lazy rebuild of
+// the sorted order is synchronized); mutations need exclusive access.
+//
+class ChildIndex {
+public:
+    using key_type = Atom;
+    using mapped_type = std::shared_ptr<VfsNode>;
+    using value_type = std::pair<Atom, std::shared_ptr<VfsNode>>;
+    using size_type = size_t;
+
+    static constexpr size_t HASH_THRESHOLD = 32;
+
+    template<bool Const>
+    class Iter {
+        using Owner = std::conditional_t<Const, const ChildIndex, ChildIndex>;
+        Owner* owner = nullptr;
+        size_t pos = 0;
+        bool raw = false;  // pos indexes entries directly (find() result)
+        friend class ChildIndex;
+        Iter(Owner* o, size_t p, bool r) : owner(o), pos(p), raw(r) {}
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ChildIndex::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+
+        Iter() = default;
+        template<bool C = Const, typename = std::enable_if_t<C>>
+        Iter(const Iter<false>& other) : owner(other.owner), pos(other.pos), raw(other.raw) {}
+
+        reference operator*() const { return owner->entries[raw ? pos : owner->sortedSlot(pos)]; }
+        pointer operator->() const { return &**this; }
+        Iter& operator++() { ++pos; return *this; }
+        Iter operator++(int) { Iter tmp = *this; ++pos; return tmp; }
+        bool operator==(const Iter& o) const { return pos == o.pos && owner == o.owner; }
+        bool operator!=(const Iter& o) const { return !(*this == o); }
+
+        template<bool> friend class Iter;
+    };
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    ChildIndex() = default;
+    ChildIndex(const ChildIndex& other);
+    ChildIndex& operator=(const ChildIndex& other);
+    ChildIndex(ChildIndex&& other) noexcept;
+    ChildIndex& operator=(ChildIndex&& other) noexcept;
+
+    iterator begin() { ensureOrder(); return iterator(this, 0, false); }
+    iterator end() { return iterator(this, entries.size(), false); }
+    const_iterator begin() const { ensureOrder(); return const_iterator(this, 0, false); }
+    const_iterator end() const { return const_iterator(this, entries.size(), false); }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    bool hashed() const { return !slots.empty(); }
+    uint64_t generation() const { return gen; }
+    void clear();
+    void reserve(size_t n);
+
+    iterator find(Atom key);
+    const_iterator find(Atom key) const;
+    iterator find(std::string_view key);
+    const_iterator find(std::string_view key) const;
+    size_t count(Atom key) const { return lookup(key) != NPOS ? 1 : 0; }
+    size_t count(std::string_view key) const;
+
+    std::shared_ptr<VfsNode>& operator[](Atom key);
+    std::shared_ptr<VfsNode>& operator[](std::string_view key) { return (*this)[Atom(key)]; }
+    size_t erase(Atom key);
+    size_t erase(std::string_view key);
+    iterator erase(const_iterator it);
+
+private:
+    static constexpr size_t NPOS = static_cast<size_t>(-1);
+
+    std::vector<value_type> entries;      // sorted by name while !hashed()
+    std::vector<uint32_t> slots;          // entry index + 1, 0 = empty
+    mutable std::vector<uint32_t> order;  // sorted permutation of entries when hashed()
+    mutable std::atomic<bool> order_valid{true};
+    uint64_t gen = 0;
+
+    static uint32_t hashKey(Atom key) { return key.id() * 0x9E3779B1u; }
+    static uint64_t nextGeneration();
+    void touch() { gen = nextGeneration(); }
+    size_t lookup(Atom key) const;
+    size_t insertNew(Atom key);
+    void eraseAt(size_t idx);
+    void buildHash(size_t capacity);
+    void dropHash();
+    void slotInsert(size_t idx);
+    void ensureOrder() const;
+    void copyOrder(const ChildIndex& other);
+    size_t sortedSlot(size_t pos) const { return hashed() ? order[pos] : pos; }
+};
@@ -8,19 +8,139 @@ MetricsCollector* G_METRICS_COLLECTOR = nullptr;
 RulePatchStaging* G_PATCH_STAGING = nullptr;
 FeedbackLoop* G_FEEDBACK_LOOP = nullptr;
 
-std::shared_ptr<VfsNode> traverse_optional(const Vfs::Overlay& overlay, const std::vector<std::string>& parts){
+namespace {
+
+// The child of dir named name, or nullptr; a regenerated listing is held
+// while it is searched
+std::shared_ptr<VfsNode> child_named(VfsNode& dir, std::string_view name){
+    if(!dir.stableChildren()){
+        auto held = dir.listing();
+        auto it = held->find(name);
+        return it == held->end() ? nullptr : it->second;
+    }
+    auto& ch = dir.children();
+    auto it = ch.find(name);
+    return it == ch.end() ? nullptr : it->second;
+}
+
+} // namespace
+
+std::shared_ptr<VfsNode> traverse_optional(const Vfs::Overlay& overlay, std::string_view path){
     std::shared_ptr<VfsNode> cur = overlay.root;
-    if(parts.empty()) return cur;
-    for(const auto& part : parts){
+    for(std::string_view part : PathParts(path)){
         if(!cur->isDir()) return nullptr;
-        auto& ch = cur->children();
-        auto it = ch.find(part);
-        if(it == ch.end()) return nullptr;
-        cur = it->second;
+        cur = child_named(*cur, part);
+        if(!cur) return nullptr;
     }
     return cur;
 }
 
+namespace {
+
+// Hash of the normalized form of a path ("/a//b/" == "/a/b"), salted by overlay
+uint64_t resolve_cache_hash(std::string_view path, size_t overlayId){
+    uint64_t h = 1469598103934665603ULL ^ (overlayId * 0x9E3779B97F4A7C15ULL);
+    for(std::string_view part : PathParts(path)){
+        h = (h ^ '/') * 1099511628211ULL;
+        for(unsigned char c : part) h = (h ^ c) * 1099511628211ULL;
+    }
+    return h;
+}
+
+bool resolve_cache_path_equals(const std::string& normalized, std::string_view path){
+    size_t pos = 0;
+    for(std::string_view part : PathParts(path)){
+        if(pos >= normalized.size() || normalized[pos] != '/') return false;
+        ++pos;
+        if(normalized.compare(pos, part.size(), part) != 0) return false;
+        pos += part.size();
+    }
+    return pos == normalized.size();
+}
+
+// Normalized absolute path for journal events
+std::string event_path(std::string_view path, std::string_view name = {}){
+    std::string out;
+    for(std::string_view part : PathParts(path)){
+        out += '/';
+        out.append(part.data(), part.size());
+    }
+    if(!name.empty()){
+        out += '/';
+        out.append(name.data(), name.size());
+    }
+    return out.empty() ? std::string("/") : out;
+}
+
+// One node's share of an overlay's usage; children are not included
+Vfs::OverlayUsage node_usage(const std::shared_ptr<VfsNode>& node){
+    Vfs::OverlayUsage u;
+    u.nodes = 1;
+    if(auto file = std::dynamic_pointer_cast<FileNode>(node)){
+        u.files = 1;
+        u.node_bytes = sizeof(FileNode);
+        u.content_bytes = file->size();
+    } else if(node->kind == VfsNode::Kind::Ast){
+        u.ast_nodes = 1;
+        u.node_bytes = sizeof(AstNode);
+        if(auto ast = std::dynamic_pointer_cast<AstNode>(node)){
+            try{
+                u.ast_bytes = serialize_ast_node(ast).second.size();
+            } catch(const std::exception&){
+                // types overlay.save cannot write hold no payload either
+            }
+        }
+    } else if(std::dynamic_pointer_cast<DirNode>(node)){
+        u.dirs = 1;
+        u.node_bytes = sizeof(DirNode);
+    } else {
+        u.node_bytes = sizeof(VfsNode);  // mounts: their contents live on the host
+    }
+    return u;
+}
+
+// Usage counts only what the tree itself holds
+TreeWalker::Options usage_walk(){
+    TreeWalker::Options opts;
+    opts.paths = false;
+    opts.mounts = false;
+    return opts;
+}
+
+std::shared_ptr<VfsNode> node_at(const std::shared_ptr<VfsNode>& root, std::string_view path){
+    std::shared_ptr<VfsNode> cur = root;
+    for(std::string_view part : PathParts(path)){
+        if(!cur->isDir()) return nullptr;
+        cur = child_named(*cur, part);
+        if(!cur) return nullptr;
+    }
+    return cur;
+}
+
+// Current size of the file named name in dir, none when there is no such file
+std::optional<size_t> file_size_in(const std::shared_ptr<DirNode>& dir, std::string_view name){
+    auto& ch = dir->children();
+    auto it = ch.find(name);
+    if(it == ch.end() || it->second->kind != VfsNode::Kind::File) return std::nullopt;
+    return it->second->size();
+}
+
+// Bytes a write leaving a file end bytes long adds to its overlay
+size_t write_growth(std::optional<size_t> old_size, size_t end){
+    if(!old_size) return sizeof(FileNode) + end;
+    return end > *old_size ? end - *old_size : 0;
+}
+
+// Tag query results: a node linked at several paths, or one path in several
+// overlays, is listed once
+std::vector<std::string> sorted_unique(std::vector<std::string> paths){
+    std::sort(paths.begin(), paths.end());
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+    return paths;
+}
+
+} // namespace
+
 char type_char(const std::shared_ptr<VfsNode>& node){
     if(!node) return '?';
     if(node->kind == VfsNode::Kind::Dir) return 'd';
@@ -31,6 +151,166 @@ char type_char(const std::shared_ptr<VfsNode>& node){
 }
 
 
+std::shared_ptr<const ChildIndex> VfsNode::listing(){
+    // A stable index lives as long as its node
+    return std::shared_ptr<const ChildIndex>(weak_from_this().lock(), &children());
+}
+
+uint64_t VfsNode::nextSerial(){
+    static std::atomic<uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::shared_ptr<VfsNode> DirNode::cloneForWrite() const {
+    auto copy = std::make_shared<DirNode>(name.str());
+    copy->ch = ch;
+    for(auto& kv : copy->ch) kv.second->frozen = true;  // now reachable from both
+    return copy;
+}
+
+std::string VfsNode::readRange(size_t offset, size_t len) const {
+    std::string s = read();
+    if(offset >= s.size()) return {};
+    return s.substr(offset, len);
+}
+
+void VfsNode::writeRange(size_t offset, const std::string& s){
+    std::string cur = read();
+    if(cur.size() < offset + s.size()) cur.resize(offset + s.size(), '\0');
+    cur.replace(offset, s.size(), s);
+    write(cur);
+}
+
+FileNode::FileNode(std::string n, std::string c) : VfsNode(std::move(n), Kind::File) {
+    if(c.size() < SMALL) small = std::move(c);
+    else assign(std::make_shared<std::string>(std::move(c)));
+}
+
+FileNode::FileNode(std::string n, std::shared_ptr<std::string> c) : VfsNode(std::move(n), Kind::File) {
+    assign(std::move(c));
+}
+
+std::shared_ptr<VfsNode> FileNode::cloneForWrite() const {
+    auto copy = std::make_shared<FileNode>(name.str());
+    copy->small = small;
+    copy->chunks = chunks;  // the chunks are copied when either side writes them
+    copy->ends = ends;
+    return copy;
+}
+
+void FileNode::assign(std::shared_ptr<std::string> c){
+    chunks.clear();
+    ends.clear();
+    small.clear();
+    if(!c) return;
+    if(c->size() < SMALL){
+        small = *c;
+        return;
+    }
+    ends.push_back(c->size());
+    chunks.push_back(std::move(c));
+}
+
+void FileNode::write(const std::string& s){
+    if(s.size() < SMALL){
+        assign(nullptr);
+        small = s;
+        return;
+    }
+    assign(std::make_shared<std::string>(s));
+}
+
+std::string FileNode::read() const {
+    if(chunks.empty()) return small;
+    if(chunks.size() == 1) return *chunks[0];
+    std::string out;
+    out.reserve(size());
+    for(const auto& c : chunks) out += *c;
+    return out;
+}
+
+ContentRef FileNode::readShared() const {
+    static const ContentRef empty = std::make_shared<const std::string>();
+    if(chunks.empty()) return small.empty() ? empty : std::make_shared<const std::string>(small);
+    if(chunks.size() == 1) return chunks[0];
+    return std::make_shared<const std::string>(read());  // appended to; no single buffer to share
+}
+
+void FileNode::promote(){
+    if(!chunks.empty() || small.empty()) return;
+    ends.push_back(small.size());
+    chunks.push_back(std::make_shared<std::string>(std::move(small)));
+    small.clear();
+}
+
+size_t FileNode::chunkAt(size_t offset) const {
+    return std::upper_bound(ends.begin(), ends.end(), offset) - ends.begin();
+}
+
+std::string& FileNode::ownChunk(size_t i){
+    // Interned buffers stay as stored even when no one else holds them
+    if(chunks[i].use_count() > 1 || BlobStore::interned(chunks[i])) chunks[i] = std::make_shared<std::string>(*chunks[i]);
+    return *chunks[i];
+}
+
+std::string FileNode::readRange(size_t offset, size_t len) const {
+    const size_t total = size();
+    if(offset >= total) return {};
+    len = std::min(len, total - offset);
+    if(chunks.empty()) return small.substr(offset, len);
+    std::string out;
+    out.reserve(len);
+    for(size_t i = chunkAt(offset); out.size() < len; ++i){
+        size_t start = i ? ends[i - 1] : 0;
+        size_t from = offset + out.size() - start;
+        out.append(*chunks[i], from, std::min(chunks[i]->size() - from, len - out.size()));
+    }
+    return out;
+}
+
+void FileNode::append(const std::string& s){
+    if(chunks.empty()){
+        if(small.size() + s.size() < SMALL){
+            small += s;
+            return;
+        }
+        promote();
+    }
+    size_t pos = 0;
+    if(!chunks.empty() && chunks.back()->size() < CHUNK && !s.empty()){
+        size_t n = std::min(CHUNK - chunks.back()->size(), s.size());
+        ownChunk(chunks.size() - 1).append(s, 0, n);
+        ends.back() += n;
+        pos = n;
+    }
+    while(pos < s.size()){
+        size_t n = std::min(CHUNK, s.size() - pos);
+        chunks.push_back(std::make_shared<std::string>(s, pos, n));
+        ends.push_back(size() + n);
+        pos += n;
+    }
+}
+
+void FileNode::writeRange(size_t offset, const std::string& s){
+    if(chunks.empty() && offset + s.size() < SMALL){
+        if(small.size() < offset + s.size()) small.resize(offset + s.size(), '\0');
+        small.replace(offset, s.size(), s);
+        return;
+    }
+    promote();
+    const size_t total = size();
+    if(offset > total) append(std::string(offset - total, '\0'));
+    size_t pos = 0;
+    for(size_t i = chunkAt(offset); pos < s.size() && i < chunks.size(); ++i){
+        size_t start = i ? ends[i - 1] : 0;
+        size_t from = offset + pos - start;
+        size_t n = std::min(chunks[i]->size() - from, s.size() - pos);
+        ownChunk(i).replace(from, n, s, pos, n);
+        pos += n;
+    }
+    if(pos < s.size()) append(s.substr(pos));
+}
+
 #ifndef CODEX_UI_NCURSES
 bool run_ncurses_editor(Vfs& vfs, const std::string& vfs_path, std::vector<std::string>& lines,
                         bool file_exists, size_t overlay_id) {
@@ -40,7 +320,7 @@ bool run_ncurses_editor(Vfs& vfs, const std::string& vfs_path, std::vector<std::
 
 Vfs::Vfs() : logic_engine(&tag_registry) {
     TRACE_FN();
-    overlay_stack.push_back(Overlay{ "base", root, "", "" });
+    overlay_stack.push_back(Overlay{ "base", root, "", "", ArenaRef(), measureTree(root), OverlayBudget(), false });
     overlay_dirty.push_back(false);
     overlay_source.emplace_back();
     G_VFS = this;
@@ -48,82 +328,331 @@ Vfs::Vfs() : logic_engine(&tag_registry) {
 
 std::vector<std::string> Vfs::splitPath(const std::string& p){
     TRACE_FN("p=", p);
-    std::vector<std::string> parts; std::string cur;
-    for(char c: p){ if(c=='/'){ if(!cur.empty()){ parts.push_back(cur); cur.clear(); } } else cur.push_back(c); }
-    if(!cur.empty()) parts.push_back(cur);
+    std::vector<std::string> parts;
+    for(std::string_view part : PathParts(p)) parts.emplace_back(part);
     return parts;
 }
+
+std::pair<std::string_view, std::string_view> Vfs::splitParentPath(std::string_view p){
+    size_t end = p.size();
+    while(end > 0 && p[end - 1] == '/') --end;
+    if(end == 0) return {"/", {}};
+    size_t slash = p.rfind('/', end - 1);
+    if(slash == std::string_view::npos) return {"/", p.substr(0, end)};
+    std::string_view name = p.substr(slash + 1, end - slash - 1);
+    while(slash > 0 && p[slash - 1] == '/') --slash;
+    if(slash == 0) return {"/", name};
+    return {p.substr(0, slash), name};
+}
+
+std::shared_ptr<VfsNode> Vfs::lookupPath(std::string_view path, size_t overlayId) const {
+    const Overlay& overlay = overlay_stack[overlayId];
+    const uint64_t h = resolve_cache_hash(path, overlayId);
+    const size_t slot = h & (RESOLVE_CACHE_SLOTS - 1);
+    auto& stripe = resolve_cache[slot % RESOLVE_CACHE_STRIPES];
+    {
+        std::lock_guard<std::mutex> lock(stripe.mtx);
+        if(stripe.entries.empty()) stripe.entries.resize(RESOLVE_CACHE_SLOTS / RESOLVE_CACHE_STRIPES);
+        const auto& e = stripe.entries[slot / RESOLVE_CACHE_STRIPES];
+        if(e.hash == h && e.overlay_id == overlayId && e.root == overlay.root.get() &&
+           resolve_cache_path_equals(e.path, path)){
+            // Checked root-down: an unchanged index keeps the next one's owner alive
+            bool valid = true;
+            for(const auto& [index, gen] : e.chain){
+                if(index->generation() != gen){ valid = false; break; }
+            }
+            if(valid){
+                if(!e.found){ ++stripe.stats.hits; return nullptr; }
+                if(auto node = e.node.lock()){ ++stripe.stats.hits; return node; }
+            }
+        }
+    }
+
+    // Miss: walk the overlay, recording every child index and its generation
+    thread_local std::vector<std::pair<const ChildIndex*, uint64_t>> chain;
+    chain.clear();
+    bool cacheable = true;
+    std::shared_ptr<VfsNode> cur = overlay.root;
+    for(std::string_view part : PathParts(path)){
+        if(!cur->isDir()){ cur = nullptr; break; }
+        if(!cur->stableChildren()){
+            cacheable = false;
+            cur = child_named(*cur, part);
+            if(!cur) break;
+            continue;
+        }
+        auto& ch = cur->children();
+        chain.emplace_back(&ch, ch.generation());
+        auto it = ch.find(part);
+        if(it == ch.end()){ cur = nullptr; break; }
+        cur = it->second;
+    }
+
+    std::lock_guard<std::mutex> lock(stripe.mtx);
+    if(!cacheable){
+        ++stripe.stats.uncacheable;
+        return cur;
+    }
+    ++stripe.stats.misses;
+    auto& e = stripe.entries[slot / RESOLVE_CACHE_STRIPES];
+    e.hash = h;
+    e.overlay_id = overlayId;
+    e.root = overlay.root.get();
+    e.found = cur != nullptr;
+    e.path.clear();
+    for(std::string_view part : PathParts(path)){
+        e.path += '/';
+        e.path.append(part);
+    }
+    e.node = cur;
+    e.chain.assign(chain.begin(), chain.end());
+    return cur;
+}
+
+Vfs::ResolveCacheStats Vfs::resolveCacheStats() const {
+    ResolveCacheStats total;
+    for(auto& stripe : resolve_cache){
+        std::lock_guard<std::mutex> lock(stripe.mtx);
+        total.hits += stripe.stats.hits;
+        total.misses += stripe.stats.misses;
+        total.uncacheable += stripe.stats.uncacheable;
+    }
+    return total;
+}
+
+void Vfs::clearResolveCache(){
+    for(auto& stripe : resolve_cache){
+        std::lock_guard<std::mutex> lock(stripe.mtx);
+        stripe.entries.clear();
+    }
+}
+
 size_t Vfs::overlayCount() const {
+    auto guard = readLock();
     return overlay_stack.size();
 }
 
 const std::string& Vfs::overlayName(size_t id) const {
+    auto guard = readLock();
     if(id >= overlay_stack.size()) throw std::out_of_range("overlay id");
     return overlay_stack[id].name;
 }
 
 std::shared_ptr<DirNode> Vfs::overlayRoot(size_t id) const {
+    auto guard = readLock();
     if(id >= overlay_stack.size()) throw std::out_of_range("overlay id");
     return overlay_stack[id].root;
 }
 
 bool Vfs::overlayDirty(size_t id) const {
+    auto guard = readLock();
     if(id >= overlay_dirty.size()) throw std::out_of_range("overlay id");
     return overlay_dirty[id];
 }
 
 const std::string& Vfs::overlaySource(size_t id) const {
+    auto guard = readLock();
     if(id >= overlay_source.size()) throw std::out_of_range("overlay id");
     return overlay_source[id];
 }
 
 void Vfs::clearOverlayDirty(size_t id){
+    auto guard = writeLock();
     if(id >= overlay_dirty.size()) throw std::out_of_range("overlay id");
     overlay_dirty[id] = false;
 }
 
 void Vfs::setOverlaySource(size_t id, std::string path){
+    auto guard = writeLock();
     if(id >= overlay_source.size()) throw std::out_of_range("overlay id");
     overlay_source[id] = std::move(path);
 }
 
 void Vfs::markOverlayDirty(size_t id){
+    auto guard = writeLock();
     if(id >= overlay_dirty.size()) throw std::out_of_range("overlay id");
+    if(batch_overlay == id){
+        batch_dirty = true;  // published once when the transaction commits
+        return;
+    }
     if(id == 0) return; // base overlay does not participate in auto-saving
     overlay_dirty[id] = true;
 }
 
 std::optional<size_t> Vfs::findOverlayByName(const std::string& name) const {
+    auto guard = readLock();
     for(size_t i = 0; i < overlay_stack.size(); ++i){
         if(overlay_stack[i].name == name) return i;
     }
     return std::nullopt;
 }
 
-size_t Vfs::registerOverlay(std::string name, std::shared_ptr<DirNode> overlayRoot){
+size_t Vfs::registerOverlay(std::string name, std::shared_ptr<DirNode> overlayRoot, ArenaRef arena){
     TRACE_FN("name=", name);
+    auto guard = writeLock();
     if(name.empty()) throw std::runtime_error("overlay name required");
     if(findOverlayByName(name)) throw std::runtime_error("overlay name already in use");
     if(!overlayRoot) overlayRoot = std::make_shared<DirNode>("/");
     overlayRoot->name = "/";
     overlayRoot->parent.reset();
-    overlay_stack.push_back(Overlay{std::move(name), overlayRoot, "", ""});
+    auto usage = adoptTree(overlay_stack.size(), "/", overlayRoot);
+    overlay_stack.push_back(Overlay{std::move(name), overlayRoot, "", "", std::move(arena),
+                                    usage, OverlayBudget(), false});
     overlay_dirty.push_back(false);
     overlay_source.emplace_back();
+    clearResolveCache();
+    overlay_index.addTree(overlay_stack.size() - 1, "/", overlayRoot);
     return overlay_stack.size() - 1;
 }
 
 void Vfs::unregisterOverlay(size_t overlayId){
     TRACE_FN("overlayId=", overlayId);
+    auto guard = writeLock();
     if(overlayId == 0) throw std::runtime_error("cannot remove base overlay");
     if(overlayId >= overlay_stack.size()) throw std::out_of_range("overlay id");
     overlay_stack.erase(overlay_stack.begin() + static_cast<std::ptrdiff_t>(overlayId));
     overlay_dirty.erase(overlay_dirty.begin() + static_cast<std::ptrdiff_t>(overlayId));
     overlay_source.erase(overlay_source.begin() + static_cast<std::ptrdiff_t>(overlayId));
+    clearResolveCache();  // overlay ids above the removed one shift down
+    overlay_index.eraseOverlay(overlayId);
+    tag_paths.eraseOverlay(overlayId);
+    // The first unindexed overlay, if any, just moved into the indexed range
+    const size_t last = OverlayIndex::MAX_OVERLAYS - 1;
+    if(overlayId <= last && last < overlay_stack.size())
+        overlay_index.addTree(last, "/", overlay_stack[last].root);
+}
+
+Vfs::OverlayUsage& Vfs::OverlayUsage::operator+=(const OverlayUsage& o){
+    nodes += o.nodes;
+    dirs += o.dirs;
+    files += o.files;
+    ast_nodes += o.ast_nodes;
+    content_bytes += o.content_bytes;
+    ast_bytes += o.ast_bytes;
+    node_bytes += o.node_bytes;
+    tagged_nodes += o.tagged_nodes;
+    tag_bytes += o.tag_bytes;
+    return *this;
+}
+
+Vfs::OverlayUsage& Vfs::OverlayUsage::operator-=(const OverlayUsage& o){
+    // Clamped at zero: nodes changed behind the Vfs's back may have grown
+    auto sub = [](size_t& a, size_t b){ a = a > b ? a - b : 0; };
+    sub(nodes, o.nodes);
+    sub(dirs, o.dirs);
+    sub(files, o.files);
+    sub(ast_nodes, o.ast_nodes);
+    sub(content_bytes, o.content_bytes);
+    sub(ast_bytes, o.ast_bytes);
+    sub(node_bytes, o.node_bytes);
+    sub(tagged_nodes, o.tagged_nodes);
+    sub(tag_bytes, o.tag_bytes);
+    return *this;
+}
+
+Vfs::OverlayUsage Vfs::measureTree(const std::shared_ptr<VfsNode>& node){
+    if(!node) return OverlayUsage();
+    if(!node->isDir()) return node_usage(node);  // most creations: no walk needed
+    OverlayUsage u;
+    TreeWalker(usage_walk()).walk(node, std::string(), [&](const TreeWalker::Item& item){
+        u += node_usage(item.node);
+        return TreeWalker::Action::Descend;
+    });
+    return u;
+}
+
+Vfs::OverlayUsage Vfs::adoptTree(size_t overlayId, const std::string& path, const std::shared_ptr<VfsNode>& node){
+    if(!node) return OverlayUsage();
+    if(tag_storage.node_tags.empty()) return measureTree(node);
+    // Usage and tagged nodes in one walk; paths only matter when there are tags
+    OverlayUsage u;
+    TreeWalker::Options opts = usage_walk();
+    opts.paths = true;
+    TreeWalker(opts).walk(node, path, [&](const TreeWalker::Item& item){
+        u += node_usage(item.node);
+        if(tag_storage.getTags(item.node.get())) tag_paths.add(overlayId, item.path, item.node.get());
+        return TreeWalker::Action::Descend;
+    });
+    return u;
+}
+
+Vfs::OverlayUsage Vfs::overlayUsage(size_t overlayId) const {
+    TRACE_FN("overlay=", overlayId);
+    auto guard = readLock();
+    if(overlayId >= overlay_stack.size()) throw std::out_of_range("overlay id");
+    OverlayUsage u = overlay_stack[overlayId].usage;
+    if(tag_storage.node_tags.empty()) return u;
+    // Tags are keyed by node, wherever it is, so find the overlay's tagged ones
+    TreeWalker(usage_walk()).walk(overlay_stack[overlayId].root, std::string(), [&](const TreeWalker::Item& item){
+        auto it = tag_storage.node_tags.find(item.node->serial);
+        if(it != tag_storage.node_tags.end()){
+            ++u.tagged_nodes;
+            u.tag_bytes += sizeof(*it) + sizeof(uint64_t) + it->second.heapBytes();
+        }
+        return TreeWalker::Action::Descend;
+    });
+    return u;
+}
+
+Vfs::OverlayUsage Vfs::recountOverlay(size_t overlayId){
+    TRACE_FN("overlay=", overlayId);
+    auto guard = writeLock();
+    if(overlayId >= overlay_stack.size()) throw std::out_of_range("overlay id");
+    // Whole overlays can be large: walked in parallel, summed per lane
+    ParallelWalk walk(overlay_stack[overlayId].root, std::string(), usage_walk());
+    std::vector<OverlayUsage> lanes(walk.lanes());
+    walk.run([&](const TreeWalker::Item& item){
+        lanes[item.lane] += node_usage(item.node);
+        return TreeWalker::Action::Descend;
+    });
+    OverlayUsage total;
+    for(const auto& lane : lanes) total += lane;
+    overlay_stack[overlayId].usage = total;
+    overlay_stack[overlayId].over_budget = false;
+    accountUsage(overlayId, {}, {});  // warns again if still over
+    return overlayUsage(overlayId);
+}
+
+Vfs::OverlayBudget Vfs::overlayBudget(size_t overlayId) const {
+    auto guard = readLock();
+    if(overlayId >= overlay_stack.size()) throw std::out_of_range("overlay id");
+    return overlay_stack[overlayId].budget;
+}
+
+void Vfs::setOverlayBudget(size_t overlayId, OverlayBudget budget){
+    TRACE_FN("overlay=", overlayId, ", limit=", budget.limit);
+    auto guard = writeLock();
+    if(overlayId >= overlay_stack.size()) throw std::out_of_range("overlay id");
+    overlay_stack[overlayId].budget = budget;
+    overlay_stack[overlayId].over_budget = false;
+}
+
+void Vfs::checkBudget(size_t overlayId, size_t growth) const {
+    const Overlay& o = overlay_stack[overlayId];
+    if(!o.budget.limit || o.budget.policy != BudgetPolicy::Reject || !growth) return;
+    size_t used = o.usage.total();
+    if(used + growth > o.budget.limit)
+        throw std::runtime_error("overlay budget exceeded: " + o.name + " uses " + std::to_string(used) +
+                                 " of " + std::to_string(o.budget.limit) + " bytes, write needs " +
+                                 std::to_string(growth) + " more");
+}
+
+void Vfs::accountUsage(size_t overlayId, const OverlayUsage& added, const OverlayUsage& dropped){
+    Overlay& o = overlay_stack[overlayId];
+    o.usage += added;
+    o.usage -= dropped;
+    if(!o.budget.limit || o.budget.policy != BudgetPolicy::Warn) return;
+    const bool over = o.usage.total() > o.budget.limit;
+    if(over && !o.over_budget){
+        std::cerr << "warning: overlay " << o.name << " is over its budget ("
+                  << o.usage.total() << " of " << o.budget.limit << " bytes)\n";
+    }
+    o.over_budget = over;
 }
 
 std::vector<size_t> Vfs::overlaysForPath(const std::string& path) const {
     TRACE_FN("path=", path);
+    auto guard = readLock();
     auto hits = resolveMulti(path);
     std::vector<size_t> ids;
     ids.reserve(hits.size());
@@ -134,32 +663,36 @@ std::vector<size_t> Vfs::overlaysForPath(const std::string& path) const {
 }
 
 std::vector<Vfs::OverlayHit> Vfs::resolveMulti(const std::string& path) const {
-    std::vector<size_t> all;
-    all.reserve(overlay_stack.size());
-    for(size_t i = 0; i < overlay_stack.size(); ++i) all.push_back(i);
-    return resolveMulti(path, all);
+    auto guard = readLock();
+    return resolveMulti(path, {});  // empty allow-list means every overlay
 }
 
 std::vector<Vfs::OverlayHit> Vfs::resolveMulti(const std::string& path, const std::vector<size_t>& allowed) const {
     TRACE_FN("path=", path);
+    auto guard = readLock();
     if(path.empty() || path[0] != '/') throw std::runtime_error("abs path required");
-    auto parts = splitPath(path);
     std::vector<OverlayHit> hits;
+    const OverlayIndex::Mask candidates = overlay_index.candidates(path);
     auto visit = [&](size_t idx){
         if(idx >= overlay_stack.size()) return;
-        auto node = traverse_optional(overlay_stack[idx], parts);
+        auto node = lookupPath(path, idx);
         if(node) hits.push_back(OverlayHit{idx, node});
     };
     if(allowed.empty()){
-        for(size_t i = 0; i < overlay_stack.size(); ++i) visit(i);
+        // Only the overlays the index says may hold the path, in id order
+        for(OverlayIndex::Mask m = candidates; m; m &= m - 1) visit(static_cast<size_t>(__builtin_ctzll(m)));
+        for(size_t i = OverlayIndex::MAX_OVERLAYS; i < overlay_stack.size(); ++i) visit(i);
     } else {
-        for(size_t idx : allowed) visit(idx);
+        for(size_t idx : allowed){
+            if(mayHold(candidates, idx)) visit(idx);
+        }
     }
     return hits;
 }
 
 std::shared_ptr<VfsNode> Vfs::resolve(const std::string& path){
     TRACE_FN("path=", path);
+    auto guard = readLock();
     auto hits = resolveMulti(path);
     if(hits.empty()) throw std::runtime_error("not found: " + path);
     if(hits.size() > 1){
@@ -176,110 +709,390 @@ std::shared_ptr<VfsNode> Vfs::resolve(const std::string& path){
 
 std::shared_ptr<VfsNode> Vfs::resolveForOverlay(const std::string& path, size_t overlayId){
     TRACE_FN("path=", path, ", overlay=", overlayId);
+    auto guard = readLock();
     if(path.empty() || path[0] != '/') throw std::runtime_error("abs path required");
     if(overlayId >= overlay_stack.size()) throw std::out_of_range("overlay id");
-    auto parts = splitPath(path);
-    auto node = traverse_optional(overlay_stack[overlayId], parts);
+    auto node = lookupPath(path, overlayId);
     if(!node) throw std::runtime_error("not found in overlay");
     return node;
 }
 
 std::shared_ptr<VfsNode> Vfs::tryResolveForOverlay(const std::string& path, size_t overlayId) const {
+    auto guard = readLock();
     if(path.empty() || path[0] != '/') return nullptr;
     if(overlayId >= overlay_stack.size()) return nullptr;
-    auto parts = splitPath(path);
-    return traverse_optional(overlay_stack[overlayId], parts);
+    return lookupPath(path, overlayId);
 }
 
-std::shared_ptr<DirNode> Vfs::ensureDir(const std::string& path, size_t overlayId){
+std::shared_ptr<DirNode> Vfs::ensureDir(std::string_view path, size_t overlayId){
+    auto guard = writeLock();
     return ensureDirForOverlay(path, overlayId);
 }
 
-std::shared_ptr<DirNode> Vfs::ensureDirForOverlay(const std::string& path, size_t overlayId){
+std::shared_ptr<DirNode> Vfs::ensureDirForOverlay(std::string_view path, size_t overlayId){
     TRACE_FN("path=", path, ", overlay=", overlayId);
+    auto guard = writeLock();
     if(overlayId >= overlay_stack.size()) throw std::out_of_range("overlay id");
     if(path.empty() || path[0] != '/') throw std::runtime_error("abs path required");
-    if(path == "/") return overlay_stack[overlayId].root;
-    auto parts = splitPath(path);
-    std::shared_ptr<VfsNode> cur = overlay_stack[overlayId].root;
-    for(const auto& part : parts){
-        if(!cur->isDir()) throw std::runtime_error("not dir: " + part);
+    // Always walked from the root: callers modify the result, so every
+    // snapshot-shared directory on the way has to be copied first
+    return writableDir(path, overlayId, true);
+}
+
+std::shared_ptr<VfsNode> Vfs::resolveForWrite(const std::string& path, size_t overlayId){
+    TRACE_FN("path=", path, ", overlay=", overlayId);
+    auto guard = writeLock();
+    if(path.empty() || path[0] != '/') throw std::runtime_error("abs path required");
+    if(overlayId >= overlay_stack.size()) throw std::out_of_range("overlay id");
+    auto [dir, name] = splitParentPath(path);
+    if(name.empty()) return writableRoot(overlayId);
+    auto parent = writableContainer(dir, overlayId, false);
+    if(!parent) throw std::runtime_error("not found in overlay");
+    auto it = parent->children().find(name);
+    if(it == parent->children().end()) throw std::runtime_error("not found in overlay");
+    return writableChild(parent, it, overlayId, path);
+}
+
+std::shared_ptr<DirNode> Vfs::writableRoot(size_t overlayId){
+    auto& slot = overlay_stack[overlayId].root;
+    if(!slot->frozen) return slot;
+    const bool aliased = overlayId == 0 && root == slot;
+    if(slot.use_count() == (aliased ? 2 : 1)){
+        slot->frozen = false;  // every snapshot of it is gone
+        return slot;
+    }
+    auto copy = std::static_pointer_cast<DirNode>(slot->cloneForWrite());
+    carryTags(overlayId, "/", slot.get(), copy.get());
+    slot = copy;
+    if(aliased) root = slot;
+    return slot;
+}
+
+std::shared_ptr<VfsNode> Vfs::writableChild(const std::shared_ptr<VfsNode>& dir, ChildIndex::iterator it,
+                                            size_t overlayId, std::string_view path){
+    std::shared_ptr<VfsNode>& slot = it->second;
+    if(!slot->frozen) return slot;
+    if(slot.use_count() == 1){
+        slot->frozen = false;  // only this (writable) directory holds it
+        return slot;
+    }
+    auto copy = slot->cloneForWrite();
+    if(!copy) return slot;  // shared with snapshots as is
+    Atom name = it->first;
+    const VfsNode* old = slot.get();  // kept alive by the snapshot
+    copy->parent = dir;
+    carryTags(overlayId, path, slot.get(), copy.get());
+    dir->children()[name] = copy;  // via operator[] so cached lookups see the change
+    dir->childReplaced(old, copy);
+    return copy;
+}
+
+void Vfs::carryTags(size_t overlayId, std::string_view path, VfsNode* from, VfsNode* to){
+    if(!tag_storage.getTags(from)) return;
+    // The snapshot keeps the original and its tags; the overlay's path now
+    // leads to the copy
+    tag_storage.copyTags(from, to);
+    tag_paths.add(overlayId, event_path(path), to);
+}
+
+std::shared_ptr<DirNode> Vfs::writableDir(std::string_view path, size_t overlayId, bool create){
+    return std::static_pointer_cast<DirNode>(writableContainer(path, overlayId, create));
+}
+
+std::shared_ptr<VfsNode> Vfs::writableContainer(std::string_view path, size_t overlayId, bool create){
+    std::shared_ptr<VfsNode> cur = writableRoot(overlayId);
+    for(std::string_view part : PathParts(path)){
+        if(!cur->isDir()) throw std::runtime_error("not dir: " + std::string(part));
         auto& ch = cur->children();
         auto it = ch.find(part);
         if(it == ch.end()){
-            auto dir = std::make_shared<DirNode>(part);
+            if(!create) return nullptr;
+            checkBudget(overlayId, sizeof(DirNode));
+            auto dir = std::make_shared<DirNode>(std::string(part));
             dir->parent = cur;
             ch[part] = dir;
             markOverlayDirty(overlayId);
+            journalEvent(VfsEvent::Kind::Create, overlayId,
+                         event_path(path.substr(0, part.data() + part.size() - path.data())), {}, dir);
             cur = dir;
         } else {
-            cur = it->second;
+            cur = writableChild(cur, it, overlayId, path.substr(0, part.data() + part.size() - path.data()));
         }
     }
     if(!cur->isDir()) throw std::runtime_error("exists but not dir");
-    return std::static_pointer_cast<DirNode>(cur);
+    return cur;
+}
+
+std::shared_ptr<DirNode> Vfs::snapshotOverlay(size_t overlayId){
+    TRACE_FN("overlay=", overlayId);
+    auto guard = writeLock();
+    if(overlayId >= overlay_stack.size()) throw std::out_of_range("overlay id");
+    overlay_stack[overlayId].root->frozen = true;
+    return overlay_stack[overlayId].root;
+}
+
+void Vfs::restoreOverlay(size_t overlayId, std::shared_ptr<DirNode> snapshot){
+    TRACE_FN("overlay=", overlayId);
+    auto guard = writeLock();
+    if(overlayId >= overlay_stack.size()) throw std::out_of_range("overlay id");
+    if(!snapshot) throw std::runtime_error("null snapshot");
+    snapshot->frozen = true;  // stays restorable after the overlay changes again
+    if(overlayId == 0 && root == overlay_stack[0].root) root = snapshot;
+    auto previous = std::move(overlay_stack[overlayId].root);
+    overlay_stack[overlayId].root = std::move(snapshot);
+    reindexOverlay(overlayId, previous);
+    markOverlayDirty(overlayId);
+    journalEvent(VfsEvent::Kind::Write, overlayId, "/");  // anything may have changed
+}
+
+void Vfs::diffTrees(const std::shared_ptr<VfsNode>& a, const std::shared_ptr<VfsNode>& b,
+                    const std::string& path, std::vector<std::string>& changed){
+    if(a == b) return;  // shared subtree
+    if(!a || !b || a->kind != b->kind || a->isDir() != b->isDir()){
+        changed.push_back(path);
+        return;
+    }
+    if(!a->isDir()){
+        if(a->read() != b->read()) changed.push_back(path);
+        return;
+    }
+    if(!a->stableChildren() || !b->stableChildren()){
+        changed.push_back(path);  // mount contents are not part of the tree
+        return;
+    }
+    auto child_path = [&](Atom name){ return path == "/" ? "/" + name : path + "/" + name; };
+    auto& ca = a->children();
+    auto& cb = b->children();
+    auto ia = ca.begin();
+    auto ib = cb.begin();
+    while(ia != ca.end() || ib != cb.end()){
+        if(ib == cb.end() || (ia != ca.end() && ia->first < ib->first)){
+            changed.push_back(child_path(ia->first));
+            ++ia;
+        } else if(ia == ca.end() || ib->first < ia->first){
+            changed.push_back(child_path(ib->first));
+            ++ib;
+        } else {
+            diffTrees(ia->second, ib->second, child_path(ia->first), changed);
+            ++ia;
+            ++ib;
+        }
+    }
+}
+
+std::shared_ptr<DirNode> Vfs::ensureParentDir(std::string_view path, size_t overlayId, std::string_view& name){
+    auto [dir, leaf] = splitParentPath(path);
+    if(leaf.empty()) throw std::runtime_error("bad path");
+    name = leaf;
+    if(dir.front() != '/') return ensureDirForOverlay("/" + std::string(dir), overlayId);
+    return ensureDirForOverlay(dir, overlayId);
 }
 
 void Vfs::mkdir(const std::string& path, size_t overlayId){
     TRACE_FN("path=", path, ", overlay=", overlayId);
+    auto guard = writeLock();
     ensureDirForOverlay(path, overlayId);
 }
 
 void Vfs::touch(const std::string& path, size_t overlayId){
     TRACE_FN("path=", path, ", overlay=", overlayId);
-    auto parts = splitPath(path);
-    if(parts.empty()) throw std::runtime_error("bad path");
-    std::string fname = parts.back();
-    parts.pop_back();
-    std::string dir = "/";
-    for(const auto& part : parts) dir = join_path(dir, part);
-    auto dirNode = ensureDirForOverlay(dir, overlayId);
-    auto& ch = dirNode->children();
+    auto guard = writeLock();
+    std::string_view fname;
+    auto dirNode = ensureParentDir(path, overlayId, fname);
+    touchIn(dirNode, path, overlayId);
+}
+
+void Vfs::write(const std::string& path, const std::string& data, size_t overlayId){
+    TRACE_FN("path=", path, ", overlay=", overlayId, ", size=", data.size());
+    auto guard = writeLock();
+    std::string_view fname;
+    auto dirNode = ensureParentDir(path, overlayId, fname);
+    writeIn(dirNode, path, data, overlayId);
+}
+
+void Vfs::touchIn(const std::shared_ptr<DirNode>& dir, std::string_view path, size_t overlayId){
+    std::string_view fname = splitParentPath(path).second;
+    auto& ch = dir->children();
     auto it = ch.find(fname);
     if(it == ch.end()){
-        auto file = std::make_shared<FileNode>(fname, "");
-        file->parent = dirNode;
+        checkBudget(overlayId, sizeof(FileNode));
+        auto file = std::make_shared<FileNode>(std::string(fname), "");
+        file->parent = dir;
         ch[fname] = file;
         markOverlayDirty(overlayId);
+        journalEvent(VfsEvent::Kind::Create, overlayId, event_path(path), {}, file);
     } else if(it->second->kind != VfsNode::Kind::File){
         throw std::runtime_error("touch non-file");
     }
 }
 
-void Vfs::write(const std::string& path, const std::string& data, size_t overlayId){
-    TRACE_FN("path=", path, ", overlay=", overlayId, ", size=", data.size());
-    auto parts = splitPath(path);
-    if(parts.empty()) throw std::runtime_error("bad path");
-    std::string fname = parts.back();
-    parts.pop_back();
-    std::string dir = "/";
-    for(const auto& part : parts) dir = join_path(dir, part);
-    auto dirNode = ensureDirForOverlay(dir, overlayId);
-    auto& ch = dirNode->children();
-    std::shared_ptr<VfsNode> node;
+std::shared_ptr<VfsNode> Vfs::fileIn(const std::shared_ptr<DirNode>& dir, std::string_view path, size_t overlayId, bool& created){
+    std::string_view fname = splitParentPath(path).second;
+    auto& ch = dir->children();
     auto it = ch.find(fname);
-    if(it == ch.end()){
-        auto file = std::make_shared<FileNode>(fname, "");
-        file->parent = dirNode;
+    created = it == ch.end();
+    if(created){
+        auto file = std::make_shared<FileNode>(std::string(fname), "");
+        file->parent = dir;
         ch[fname] = file;
-        node = file;
-        markOverlayDirty(overlayId);
-    } else {
-        node = it->second;
+        return file;
     }
+    auto node = writableChild(dir, it, overlayId, path);
     if(node->kind != VfsNode::Kind::File && node->kind != VfsNode::Kind::Ast)
         throw std::runtime_error("write non-file");
-    node->write(data);
+    return node;
+}
+
+void Vfs::writeIn(const std::shared_ptr<DirNode>& dir, std::string_view path, const std::string& data, size_t overlayId){
+    checkBudget(overlayId, write_growth(file_size_in(dir, splitParentPath(path).second), data.size()));
+    bool created = false;
+    auto node = fileIn(dir, path, overlayId, created);
+    auto before = created ? OverlayUsage() : node_usage(node);
+    if(auto file = std::dynamic_pointer_cast<FileNode>(node)) file->assign(blobs.intern(std::string_view(data)));
+    else node->write(data);
+    if(!created) accountUsage(overlayId, node_usage(node), before);
+    markOverlayDirty(overlayId);
+    journalEvent(created ? VfsEvent::Kind::Create : VfsEvent::Kind::Write, overlayId, event_path(path), {}, node);
+}
+
+void Vfs::append(const std::string& path, const std::string& data, size_t overlayId){
+    TRACE_FN("path=", path, ", overlay=", overlayId, ", size=", data.size());
+    auto guard = writeLock();
+    std::string_view fname;
+    auto dirNode = ensureParentDir(path, overlayId, fname);
+    auto old_size = file_size_in(dirNode, fname);
+    checkBudget(overlayId, write_growth(old_size, old_size.value_or(0) + data.size()));
+    bool created = false;
+    auto node = fileIn(dirNode, path, overlayId, created);
+    auto before = created ? OverlayUsage() : node_usage(node);
+    node->append(data);
+    if(!created) accountUsage(overlayId, node_usage(node), before);
     markOverlayDirty(overlayId);
+    journalEvent(created ? VfsEvent::Kind::Create : VfsEvent::Kind::Write, overlayId, event_path(path), {}, node);
+}
+
+void Vfs::writeRange(const std::string& path, size_t offset, const std::string& data, size_t overlayId){
+    TRACE_FN("path=", path, ", overlay=", overlayId, ", offset=", offset, ", size=", data.size());
+    auto guard = writeLock();
+    std::string_view fname;
+    auto dirNode = ensureParentDir(path, overlayId, fname);
+    auto old_size = file_size_in(dirNode, fname);
+    checkBudget(overlayId, write_growth(old_size, std::max(old_size.value_or(0), offset + data.size())));
+    bool created = false;
+    auto node = fileIn(dirNode, path, overlayId, created);
+    auto before = created ? OverlayUsage() : node_usage(node);
+    node->writeRange(offset, data);
+    if(!created) accountUsage(overlayId, node_usage(node), before);
+    markOverlayDirty(overlayId);
+    journalEvent(created ? VfsEvent::Kind::Create : VfsEvent::Kind::Write, overlayId, event_path(path), {}, node);
+}
+
+void Vfs::replaceChild(const std::shared_ptr<DirNode>& dir, std::string_view name,
+                       const std::shared_ptr<VfsNode>& node, size_t overlayId){
+    auto& ch = dir->children();
+    auto it = ch.find(name);
+    OverlayUsage replaced = it == ch.end() ? OverlayUsage() : measureTree(it->second);
+    const OverlayBudget& budget = overlay_stack[overlayId].budget;
+    if(budget.limit && budget.policy == BudgetPolicy::Reject){
+        size_t adding = measureTree(node).total();
+        checkBudget(overlayId, adding > replaced.total() ? adding - replaced.total() : 0);
+    }
+    ch[name] = node;
+    accountUsage(overlayId, {}, replaced);
+}
+
+void Vfs::journalEvent(VfsEvent::Kind kind, size_t overlayId, std::string path, std::string to,
+                       const std::shared_ptr<VfsNode>& node){
+    // The merged index and the overlay's usage follow every structural change
+    // right away, even inside a transaction; a rolled back one reindexes the
+    // overlay
+    switch(kind){
+    case VfsEvent::Kind::Create: {
+        auto created = node ? node : lookupPath(path, overlayId);
+        overlay_index.addTree(overlayId, path, created);
+        tag_paths.removeTree(overlayId, path);
+        accountUsage(overlayId, adoptTree(overlayId, path, created), {});
+        break;
+    }
+    case VfsEvent::Kind::Remove:
+        overlay_index.removeTree(overlayId, path);
+        tag_paths.removeTree(overlayId, path);
+        if(node) accountUsage(overlayId, {}, measureTree(node));
+        break;
+    case VfsEvent::Kind::Move:
+        overlay_index.removeTree(overlayId, path);
+        overlay_index.addTree(overlayId, to, node ? node : lookupPath(to, overlayId));
+        tag_paths.moveTree(overlayId, path, to);
+        break;
+    case VfsEvent::Kind::Write:
+        break;
+    }
+
+    VfsEvent ev;
+    ev.kind = kind;
+    ev.overlay = overlayId;
+    ev.path = std::move(path);
+    ev.to = std::move(to);
+    if(batch_overlay == overlayId){
+        batch_events.push_back(std::move(ev));  // published if the transaction commits
+        return;
+    }
+    journal.record(std::move(ev));
+}
+
+void Vfs::reindexOverlay(size_t overlayId, const std::shared_ptr<DirNode>& previous){
+    // Only the paths that differ; subtrees the two roots share are skipped
+    std::vector<std::string> changed;
+    diffTrees(previous, overlay_stack[overlayId].root, "/", changed);
+    OverlayUsage added, dropped;
+    for(const auto& path : changed){
+        overlay_index.removeTree(overlayId, path);
+        tag_paths.removeTree(overlayId, path);
+        if(auto node = lookupPath(path, overlayId)){
+            overlay_index.addTree(overlayId, path, node);
+            added += adoptTree(overlayId, path, node);
+        }
+        dropped += measureTree(node_at(previous, path));
+    }
+    accountUsage(overlayId, added, dropped);
 }
 
 std::string Vfs::read(const std::string& path, std::optional<size_t> overlayId) const {
     TRACE_FN("path=", path);
+    auto guard = readLock();
+    return readTarget(path, overlayId)->read();
+}
+
+ContentRef Vfs::readShared(const std::string& path, std::optional<size_t> overlayId) const {
+    TRACE_FN("path=", path);
+    auto guard = readLock();
+    return readTarget(path, overlayId)->readShared();
+}
+
+ContentView Vfs::readView(const std::string& path, std::optional<size_t> overlayId) const {
+    TRACE_FN("path=", path);
+    auto guard = readLock();
+    return readTarget(path, overlayId)->readView();
+}
+
+size_t Vfs::size(const std::string& path, std::optional<size_t> overlayId) const {
+    TRACE_FN("path=", path);
+    auto guard = readLock();
+    return readTarget(path, overlayId)->size();
+}
+
+std::string Vfs::readRange(const std::string& path, size_t offset, size_t len, std::optional<size_t> overlayId) const {
+    TRACE_FN("path=", path, ", offset=", offset, ", len=", len);
+    auto guard = readLock();
+    return readTarget(path, overlayId)->readRange(offset, len);
+}
+
+std::shared_ptr<VfsNode> Vfs::readTarget(const std::string& path, std::optional<size_t> overlayId) const {
     if(overlayId){
         auto node = tryResolveForOverlay(path, *overlayId);
         if(!node) throw std::runtime_error("not found: " + path);
         if(node->kind != VfsNode::Kind::File) throw std::runtime_error("read non-file");
-        return node->read();
+        return node;
     }
     auto hits = resolveMulti(path);
     if(hits.empty()) throw std::runtime_error("not found: " + path);
@@ -294,77 +1107,221 @@ std::string Vfs::read(const std::string& path, std::optional<size_t> overlayId)
         }
     }
     if(!target) throw std::runtime_error("read non-file");
-    return target->read();
+    return target;
 }
 
 void Vfs::addNode(const std::string& dirpath, std::shared_ptr<VfsNode> n, size_t overlayId){
     TRACE_FN("dirpath=", dirpath, ", overlay=", overlayId);
+    auto guard = writeLock();
     if(!n) throw std::runtime_error("null node");
     auto dirNode = ensureDirForOverlay(dirpath.empty() ? std::string("/") : dirpath, overlayId);
     n->parent = dirNode;
-    dirNode->children()[n->name] = n;
+    replaceChild(dirNode, n->name.view(), n, overlayId);
     markOverlayDirty(overlayId);
+    journalEvent(VfsEvent::Kind::Create, overlayId, event_path(dirpath, n->name.view()), {}, n);
 }
 
 void Vfs::rm(const std::string& path, size_t overlayId){
     TRACE_FN("path=", path, ", overlay=", overlayId);
+    auto guard = writeLock();
     if(path == "/") throw std::runtime_error("rm / not allowed");
-    auto node = resolveForOverlay(path, overlayId);
-    auto parent = node->parent.lock();
+    resolveForOverlay(path, overlayId);
+    // Removed from the directory named by the path, which a snapshot may share
+    auto [dir, name] = splitParentPath(path);
+    auto parent = name.empty() ? nullptr : writableDir(dir, overlayId, false);
     if(!parent) throw std::runtime_error("parent missing");
-    parent->children().erase(node->name);
+    auto it = parent->children().find(name);
+    auto removed = it == parent->children().end() ? nullptr : it->second;
+    parent->children().erase(name);
     markOverlayDirty(overlayId);
+    journalEvent(VfsEvent::Kind::Remove, overlayId, event_path(path), {}, removed);
 }
 
 void Vfs::mv(const std::string& src, const std::string& dst, size_t overlayId){
     TRACE_FN("src=", src, ", dst=", dst, ", overlay=", overlayId);
-    auto node = resolveForOverlay(src, overlayId);
-    auto parent = node->parent.lock();
+    auto guard = writeLock();
+    resolveForOverlay(src, overlayId);
+    auto [dir, src_name] = splitParentPath(src);
+    auto parent = src_name.empty() ? nullptr : writableDir(dir, overlayId, false);
     if(!parent) throw std::runtime_error("parent missing");
-    parent->children().erase(node->name);
-
-    auto parts = splitPath(dst);
-    if(parts.empty()) throw std::runtime_error("bad path");
-    std::string name = parts.back();
-    parts.pop_back();
-    std::string dir = "/";
-    for(const auto& part : parts) dir = join_path(dir, part);
-    auto dirNode = ensureDirForOverlay(dir, overlayId);
-    node->name = name;
+    // Renaming changes the node itself, so a snapshot-shared one is copied first
+    auto node = writableChild(parent, parent->children().find(src_name), overlayId, src);
+    parent->children().erase(src_name);
+
+    std::string_view name;
+    auto dirNode = ensureParentDir(dst, overlayId, name);
+    node->name = std::string(name);
     node->parent = dirNode;
-    dirNode->children()[name] = node;
+    auto& ch = dirNode->children();
+    auto it = ch.find(name);
+    if(it != ch.end()) accountUsage(overlayId, {}, measureTree(it->second));  // overwritten
+    ch[name] = node;
     markOverlayDirty(overlayId);
+    journalEvent(VfsEvent::Kind::Move, overlayId, event_path(src), event_path(dst), node);
 }
 
 void Vfs::link(const std::string& src, const std::string& dst, size_t overlayId){
     TRACE_FN("src=", src, ", dst=", dst, ", overlay=", overlayId);
-    auto node = resolveForOverlay(src, overlayId);
-    auto parts = splitPath(dst);
-    if(parts.empty()) throw std::runtime_error("bad path");
-    std::string name = parts.back();
-    parts.pop_back();
-    std::string dir = "/";
-    for(const auto& part : parts) dir = join_path(dir, part);
-    auto dirNode = ensureDirForOverlay(dir, overlayId);
-    dirNode->children()[name] = node;
+    auto guard = writeLock();
+    // Both paths then share a node no snapshot can see
+    resolveForOverlay(src, overlayId);
+    auto node = resolveForWrite(src, overlayId);
+    std::string_view name;
+    auto dirNode = ensureParentDir(dst, overlayId, name);
+    replaceChild(dirNode, name, node, overlayId);
     markOverlayDirty(overlayId);
+    journalEvent(VfsEvent::Kind::Create, overlayId, event_path(dst), {}, node);
+    if(node->isDir()){
+        // Changes under either name show up under the other one
+        overlay_index.markOpaque(overlayId, src);
+        overlay_index.markOpaque(overlayId, dst);
+    }
+}
+
+Vfs::Transaction::Transaction(Vfs& v, size_t overlayId) : vfs(v), overlay(overlayId) {}
+
+void Vfs::Transaction::mkdir(const std::string& path){
+    ops.push_back(Op{Op::Mkdir, path, {}, nullptr});
+}
+
+void Vfs::Transaction::touch(const std::string& path){
+    ops.push_back(Op{Op::Touch, path, {}, nullptr});
+}
+
+void Vfs::Transaction::write(const std::string& path, std::string data){
+    ops.push_back(Op{Op::Write, path, std::move(data), nullptr});
+}
+
+void Vfs::Transaction::addNode(const std::string& dirpath, std::shared_ptr<VfsNode> node){
+    if(!node) throw std::runtime_error("null node");
+    ops.push_back(Op{Op::AddNode, dirpath.empty() ? std::string("/") : dirpath, {}, std::move(node)});
+}
+
+void Vfs::Transaction::rm(const std::string& path){
+    ops.push_back(Op{Op::Rm, path, {}, nullptr});
+}
+
+void Vfs::Transaction::commit(){
+    TRACE_FN("ops=", ops.size(), ", overlay=", overlay);
+    if(ops.empty()) return;
+    auto guard = vfs.writeLock();
+    if(overlay >= vfs.overlay_stack.size()) throw std::out_of_range("overlay id");
+    if(vfs.batch_overlay != NO_BATCH) throw std::runtime_error("nested transaction commit");
+
+    // O(1) rollback point; the ops below copy only the paths they touch
+    auto before = vfs.snapshotOverlay(overlay);
+    vfs.batch_overlay = overlay;
+    vfs.batch_dirty = false;
+    vfs.batch_events.clear();
+
+    // Writable directories by path; valid until an rm or a replacing addNode
+    // may detach one. Batches usually fill one directory at a time, so check
+    // the last first.
+    std::unordered_map<std::string, std::shared_ptr<DirNode>> dirs;
+    std::string last_key;
+    std::shared_ptr<DirNode> last_dir;
+    auto dirFor = [&](std::string_view path){
+        if(last_dir && path == last_key) return last_dir;
+        std::string key = path.front() == '/' ? std::string(path) : "/" + std::string(path);
+        auto it = dirs.find(key);
+        if(it == dirs.end()) it = dirs.emplace(key, vfs.writableDir(key, overlay, true)).first;
+        last_key = std::move(key);
+        last_dir = it->second;
+        return last_dir;
+    };
+    auto parentOf = [&](const std::string& path, std::string_view& name){
+        auto [dir, leaf] = splitParentPath(path);
+        if(leaf.empty()) throw std::runtime_error("bad path");
+        name = leaf;
+        return dirFor(dir);
+    };
+
+    try{
+        for(const Op& op : ops){
+            std::string_view name;
+            switch(op.kind){
+            case Op::Mkdir:
+                if(op.path.empty() || op.path[0] != '/') throw std::runtime_error("abs path required");
+                dirFor(op.path);
+                break;
+            case Op::Touch:
+                vfs.touchIn(parentOf(op.path, name), op.path, overlay);
+                break;
+            case Op::Write:
+                vfs.writeIn(parentOf(op.path, name), op.path, op.data, overlay);
+                break;
+            case Op::AddNode: {
+                if(op.path[0] != '/') throw std::runtime_error("abs path required");
+                auto dir = dirFor(op.path);
+                auto& ch = dir->children();
+                bool replaces = ch.find(op.node->name.view()) != ch.end();
+                op.node->parent = dir;
+                vfs.replaceChild(dir, op.node->name.view(), op.node, overlay);
+                vfs.markOverlayDirty(overlay);
+                vfs.journalEvent(VfsEvent::Kind::Create, overlay, event_path(op.path, op.node->name.view()), {}, op.node);
+                // The replaced node may be a cached directory, or hold some
+                if(replaces){
+                    dirs.clear();
+                    last_dir.reset();
+                }
+                break;
+            }
+            case Op::Rm:
+                vfs.rm(op.path, overlay);
+                dirs.clear();
+                last_dir.reset();
+                break;
+            }
+        }
+    } catch(...){
+        vfs.batch_overlay = NO_BATCH;
+        vfs.batch_events.clear();
+        auto& slot = vfs.overlay_stack[overlay].root;
+        if(overlay == 0 && vfs.root == slot) vfs.root = before;
+        auto failed = std::move(slot);
+        slot = before;
+        vfs.reindexOverlay(overlay, failed);
+        ops.clear();
+        throw;
+    }
+    vfs.batch_overlay = NO_BATCH;
+    if(vfs.batch_dirty) vfs.markOverlayDirty(overlay);
+    auto events = std::move(vfs.batch_events);
+    vfs.batch_events.clear();
+    for(auto& ev : events) vfs.journal.record(std::move(ev));
+    ops.clear();
 }
 
 Vfs::DirListing Vfs::listDir(const std::string& p, const std::vector<size_t>& overlays) const {
     TRACE_FN("path=", p);
+    auto guard = readLock();
     DirListing listing;
     std::vector<size_t> allowed = overlays;
     if(allowed.empty()) allowed.push_back(0);
+    // Children iterate in name order, so the first overlay appends at the end of
+    // the listing; later overlays find names already listed by atom id.
+    std::unordered_map<Atom, DirListingEntry*> by_atom;
+    const OverlayIndex::Mask candidates = overlay_index.candidates(p);
     for(size_t overlayId : allowed){
-        if(overlayId >= overlay_stack.size()) continue;
+        if(overlayId >= overlay_stack.size() || !mayHold(candidates, overlayId)) continue;
         auto node = tryResolveForOverlay(p, overlayId);
         if(!node || !node->isDir()) continue;
-        for(auto& kv : node->children()){
-            auto child = kv.second;
-            auto& entry = listing[kv.first];
-            entry.overlays.push_back(overlayId);
-            entry.nodes.push_back(child);
-            entry.types.insert(type_char(child));
+        const bool merging = !listing.empty();
+        auto children = node->listing();
+        for(auto& kv : *children){
+            const auto& child = kv.second;
+            DirListingEntry* entry;
+            if(!merging){
+                entry = &listing.emplace_hint(listing.end(), kv.first.str(), DirListingEntry())->second;
+            } else if(auto it = by_atom.find(kv.first); it != by_atom.end()){
+                entry = it->second;
+            } else {
+                entry = &listing[kv.first];
+            }
+            if(allowed.size() > 1) by_atom.emplace(kv.first, entry);
+            entry->overlays.push_back(overlayId);
+            entry->nodes.push_back(child);
+            entry->types.insert(type_char(child));
         }
     }
     return listing;
@@ -372,12 +1329,14 @@ Vfs::DirListing Vfs::listDir(const std::string& p, const std::vector<size_t>& ov
 
 void Vfs::ls(const std::string& p){
     TRACE_FN("p=", p);
+    auto guard = readLock();
     auto node = resolveForOverlay(p, 0);
     if(!node->isDir()){
         std::cout << p << "\n";
         return;
     }
-    for(auto& kv : node->children()){
+    auto children = node->listing();
+    for(auto& kv : *children){
         auto& child = kv.second;
         std::cout << type_char(child) << " " << kv.first << "\n";
     }
@@ -385,13 +1344,14 @@ void Vfs::ls(const std::string& p){
 
 void Vfs::tree(std::shared_ptr<VfsNode> n, std::string pref){
     TRACE_FN("node=", n ? n->name : std::string("<root>"), ", pref=", pref);
+    auto guard = readLock();
     if(!n) n = root;
-    std::cout << pref << type_char(n) << " " << n->name << "\n";
-    if(n->isDir()){
-        for(auto& kv : n->children()){
-            tree(kv.second, pref + "  ");
-        }
-    }
+    TreeWalker::Options opts;
+    opts.paths = false;
+    TreeWalker(opts).walk(n, std::string(), [&](const TreeWalker::Item& item){
+        std::cout << pref << std::string(item.depth * 2, ' ') << type_char(item.node) << " " << item.node->name << "\n";
+        return TreeWalker::Action::Descend;
+    });
 }
 
 // Advanced tree visualization with options
@@ -421,8 +1381,7 @@ std::string Vfs::formatTreeNode(VfsNode* node, const std::string& /* path */, co
 
     // Show size/token estimate
     if(opts.show_sizes && !node->isDir()){
-        std::string content = node->read();
-        size_t tokens = ContextEntry::estimate_tokens(content);
+        size_t tokens = ContextEntry::estimate_tokens(*node->readShared());
         oss << " (" << tokens << " tok)";
     }
 
@@ -447,57 +1406,40 @@ std::string Vfs::formatTreeNode(VfsNode* node, const std::string& /* path */, co
 void Vfs::treeAdvanced(std::shared_ptr<VfsNode> n, const std::string& path,
                       const TreeOptions& opts, int depth, bool is_last){
     TRACE_FN("path=", path, ", depth=", depth);
+    auto guard = readLock();
 
     if(!n) return;
-    if(opts.max_depth >= 0 && depth > opts.max_depth) return;
-
-    // Apply filter
-    if(!opts.filter_pattern.empty()){
-        if(path.find(opts.filter_pattern) == std::string::npos){
-            return;
-        }
-    }
-
-    // Build prefix with box-drawing characters
-    std::string prefix;
-    if(depth > 0){
-        if(opts.use_box_chars){
-            prefix = (is_last ? "└─ " : "├─ ");
-        } else {
-            prefix = std::string(depth * 2, ' ');
-        }
-    }
-
-    // Print current node
-    std::cout << prefix << formatTreeNode(n.get(), path, opts) << "\n";
-
-    // Recurse into children
-    if(n->isDir()){
-        auto& ch = n->children();
-        std::vector<std::pair<std::string, std::shared_ptr<VfsNode>>> entries(ch.begin(), ch.end());
-
-        // Sort if requested
-        if(opts.sort_entries){
-            std::sort(entries.begin(), entries.end(),
-                [](const auto& a, const auto& b){ return a.first < b.first; });
-        }
-
-        for(size_t i = 0; i < entries.size(); ++i){
-            const auto& [name, child] = entries[i];
-            std::string child_path = path;
-            if(child_path.back() != '/') child_path += '/';
-            child_path += name;
-
-            bool child_is_last = (i == entries.size() - 1);
-
-            // Recurse into child
-            treeAdvanced(child, child_path, opts, depth + 1, child_is_last);
+    // Children are visited in name order, so sort_entries needs no extra work
+    TreeWalker::Options walk_opts;
+    if(opts.max_depth >= 0) walk_opts.max_depth = static_cast<size_t>(opts.max_depth);
+    TreeWalker::Item top;
+    top.node = std::move(n);
+    top.path = path;
+    top.depth = static_cast<size_t>(std::max(depth, 0));
+    top.last = is_last;
+    TreeWalker(walk_opts).walk(std::move(top), [&](const TreeWalker::Item& item){
+        if(item.depth > walk_opts.max_depth) return TreeWalker::Action::Skip;
+        // Apply filter
+        if(!opts.filter_pattern.empty() && item.path.find(opts.filter_pattern) == std::string::npos)
+            return TreeWalker::Action::Skip;
+
+        // Build prefix with box-drawing characters
+        std::string prefix;
+        if(item.depth > 0){
+            if(opts.use_box_chars){
+                prefix = (item.last ? "└─ " : "├─ ");
+            } else {
+                prefix = std::string(item.depth * 2, ' ');
+            }
         }
-    }
+        std::cout << prefix << formatTreeNode(item.node.get(), item.path, opts) << "\n";
+        return TreeWalker::Action::Descend;
+    });
 }
 
 void Vfs::treeAdvanced(const std::string& path, const TreeOptions& opts){
     TRACE_FN("path=", path);
+    auto guard = readLock();
     auto node = resolve(path);
     if(!node){
         std::cout << "error: path not found: " << path << "\n";
@@ -506,42 +1448,103 @@ void Vfs::treeAdvanced(const std::string& path, const TreeOptions& opts){
     treeAdvanced(node, path, opts, 0, true);
 }
 
+void VfsVisitor::find(const std::string& start_path, const std::string& pattern){
+    collect(start_path, pattern, false);
+}
+
+void VfsVisitor::findext(const std::string& start_path, const std::string& extension){
+    collect(start_path, extension, true);
+}
+
+void VfsVisitor::collect(const std::string& start_path, const std::string& pattern, bool is_extension){
+    TRACE_FN("start=", start_path, ", pattern=", pattern);
+    auto guard = vfs->readLock();
+    results.clear();
+    current_index = 0;
+    std::string suffix = pattern;
+    if(is_extension && !suffix.empty() && suffix[0] != '.') suffix.insert(suffix.begin(), '.');
+    const GlobMatcher glob(is_extension ? std::string_view() : std::string_view(pattern));
+    // Patterns with a slash match the path below the start, others the name
+    const bool by_path = !is_extension && glob.hasSlash();
+    TreeWalker::Options opts;
+    opts.paths = by_path;
+    ParallelWalk walk(vfs->resolve(start_path), std::string(), opts);
+    std::vector<std::vector<std::shared_ptr<VfsNode>>> lanes(walk.lanes());
+    walk.run([&](const TreeWalker::Item& item){
+        if(item.depth == 0) return TreeWalker::Action::Descend;
+        const std::string& name = item.node->name;
+        bool hit = is_extension
+            ? name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0
+            : glob.matches(by_path ? std::string_view(item.path).substr(1) : std::string_view(name));
+        if(hit) lanes[item.lane].push_back(item.node);
+        return TreeWalker::Action::Descend;
+    });
+    // Lanes are in walk order, so the results come out as a sequential walk's
+    for(auto& lane : lanes){
+        results.insert(results.end(), std::make_move_iterator(lane.begin()), std::make_move_iterator(lane.end()));
+    }
+}
+
+std::string VfsVisitor::name() const {
+    return isend() ? std::string() : results[current_index]->name.str();
+}
+
+bool VfsVisitor::isend() const {
+    return current_index >= results.size();
+}
+
+void VfsVisitor::next(){
+    if(!isend()) ++current_index;
+}
+
 TagId Vfs::registerTag(const std::string& name){
+    auto guard = writeLock();
     return tag_registry.registerTag(name);
 }
 
 TagId Vfs::getTagId(const std::string& name) const {
+    auto guard = readLock();
     return tag_registry.getTagId(name);
 }
 
 std::string Vfs::getTagName(TagId id) const {
+    auto guard = readLock();
     return tag_registry.getTagName(id);
 }
 
 bool Vfs::hasTagRegistered(const std::string& name) const {
+    auto guard = readLock();
     return tag_registry.hasTag(name);
 }
 
 std::vector<std::string> Vfs::allRegisteredTags() const {
+    auto guard = readLock();
     return tag_registry.allTags();
 }
 
 void Vfs::addTag(const std::string& vfs_path, const std::string& tag_name){
+    auto guard = writeLock();
     auto node = resolve(vfs_path);
     if(!node) throw std::runtime_error("tag.add: path not found: " + vfs_path);
     TagId tag_id = tag_registry.registerTag(tag_name);
     tag_storage.addTag(node.get(), tag_id);
+    for(const auto& hit : resolveMulti(vfs_path)){
+        if(hit.node == node) tag_paths.add(hit.overlay_id, event_path(vfs_path), node.get());
+    }
 }
 
 void Vfs::removeTag(const std::string& vfs_path, const std::string& tag_name){
+    auto guard = writeLock();
     auto node = resolve(vfs_path);
     if(!node) throw std::runtime_error("tag.remove: path not found: " + vfs_path);
     TagId tag_id = tag_registry.getTagId(tag_name);
     if(tag_id == TAG_INVALID) return;  // Tag doesn't exist, nothing to remove
     tag_storage.removeTag(node.get(), tag_id);
+    if(!tag_storage.getTags(node.get())) tag_paths.forgetNode(node.get());
 }
 
 bool Vfs::nodeHasTag(const std::string& vfs_path, const std::string& tag_name) const {
+    auto guard = readLock();
     auto node = const_cast<Vfs*>(this)->resolve(vfs_path);
     if(!node) return false;
     TagId tag_id = tag_registry.getTagId(tag_name);
@@ -550,6 +1553,7 @@ bool Vfs::nodeHasTag(const std::string& vfs_path, const std::string& tag_name) c
 }
 
 std::vector<std::string> Vfs::getNodeTags(const std::string& vfs_path) const {
+    auto guard = readLock();
     auto node = const_cast<Vfs*>(this)->resolve(vfs_path);
     if(!node) return {};
     const TagSet* tags = tag_storage.getTags(node.get());
@@ -564,33 +1568,36 @@ std::vector<std::string> Vfs::getNodeTags(const std::string& vfs_path) const {
 }
 
 void Vfs::clearNodeTags(const std::string& vfs_path){
+    auto guard = writeLock();
     auto node = resolve(vfs_path);
     if(!node) throw std::runtime_error("tag.clear: path not found: " + vfs_path);
     tag_storage.clearTags(node.get());
+    tag_paths.forgetNode(node.get());
 }
 
 std::vector<std::string> Vfs::findNodesByTag(const std::string& tag_name) const {
+    auto guard = readLock();
     TagId tag_id = tag_registry.getTagId(tag_name);
     if(tag_id == TAG_INVALID) return {};
 
-    auto nodes = tag_storage.findByTag(tag_id);
+    // Nodes no longer in any overlay have no paths and drop out
     std::vector<std::string> result;
-    // TODO: Need reverse path lookup - this is a known limitation for now
-    // For MVP, we'll need to implement path tracking or traverse the VFS tree
-    return result;
+    for(uint64_t node : tag_storage.findByTag(tag_id)) tag_paths.pathsOf(node, result);
+    return sorted_unique(std::move(result));
 }
 
 std::vector<std::string> Vfs::findNodesByTags(const std::vector<std::string>& tag_names, bool match_all) const {
+    auto guard = readLock();
     TagSet tag_ids;
     for(const auto& name : tag_names){
         TagId id = tag_registry.getTagId(name);
         if(id != TAG_INVALID) tag_ids.insert(id);
+        else if(match_all) return {};  // nothing carries an unknown tag
     }
     if(tag_ids.empty()) return {};
 
-    auto nodes = tag_storage.findByTags(tag_ids, match_all);
     std::vector<std::string> result;
-    // TODO: Need reverse path lookup - this is a known limitation for now
-    return result;
+    for(uint64_t node : tag_storage.findByTags(tag_ids, match_all)) tag_paths.pathsOf(node, result);
+    return sorted_unique(std::move(result));
 }
 
@@ -5,47 +5,199 @@
 //
 // VFS perus
 //
+// Directory trees are persistent: a snapshot of an overlay is its root marked
+// frozen, taken in O(1). A frozen node may be reachable from a snapshot and is
+// never modified; Vfs mutations copy the frozen nodes on the path they change
+// (path copying) and the copies share all untouched children. Copying a
+// directory freezes its children, so frozenness spreads one level per copy.
+// DirNode, FileNode and the C++ AST containers copy themselves; AST leaves,
+// mount and library nodes are shared with snapshots by reference. Nodes that
+// hold a child outside children() as well (an AST function's body) follow the
+// copy through childReplaced(). parent is a hint and may point into a
+// snapshot after its directory was copied.
+//
+
+// Immutable content buffer shared between a node and its readers
+using ContentRef = std::shared_ptr<const std::string>;
+
+// Read-only view of a node's contents; the bytes stay valid and unchanged for
+// as long as owner is held. Large host files are viewed in their mapping.
+struct ContentView {
+    std::string_view data;
+    std::shared_ptr<const void> owner;
+    ContentView() = default;
+    ContentView(ContentRef c) : data(c ? std::string_view(*c) : std::string_view()), owner(std::move(c)) {}
+    ContentView(std::string_view d, std::shared_ptr<const void> o) : data(d), owner(std::move(o)) {}
+};
+
 struct VfsNode : std::enable_shared_from_this<VfsNode> {
     enum class Kind { Dir, File, Ast, Mount, Library };
-    std::string name;
+    Atom name;
     std::weak_ptr<VfsNode> parent;
     Kind kind;
+    bool frozen = false;  // possibly shared with a snapshot; copy before changing
+    // Never reused, unlike the node's address once it is freed; keys the tags
+    const uint64_t serial = nextSerial();
     explicit VfsNode(std::string n, Kind k) : name(std::move(n)), kind(k) {}
+    VfsNode(Atom n, Kind k) : name(n), kind(k) {}
+    // A copy is another node with a serial of its own
+    VfsNode(const VfsNode& o) : std::enable_shared_from_this<VfsNode>(o), name(o.name), parent(o.parent),
+                                kind(o.kind), frozen(o.frozen) {}
     virtual ~VfsNode() = default;
     virtual bool isDir() const { return kind == Kind::Dir; }
     virtual std::string read() const { return ""; }
     virtual void write(const std::string&) {}
-    virtual std::map<std::string, std::shared_ptr<VfsNode>>& children() {
-        static std::map<std::string, std::shared_ptr<VfsNode>> empty;
+    // Contents as a shared buffer that stays valid and unchanged after the
+    // node is written; file nodes hand out their own storage without copying
+    virtual ContentRef readShared() const { return std::make_shared<const std::string>(read()); }
+    // Contents without a copy where the node can avoid one; defaults to readShared().
+    // May map a host file (MountNode), so only for one pass over the contents:
+    // keep readShared() instead.
+    virtual ContentView readView() const { return readShared(); }
+    // Ranged access. The defaults go through read()/write(); nodes holding
+    // large contents override them.
+    virtual size_t size() const { return read().size(); }
+    virtual std::string readRange(size_t offset, size_t len) const;
+    virtual void append(const std::string& s) { write(read() + s); }
+    // Overwrites from offset on, zero-filling a gap past the end
+    virtual void writeRange(size_t offset, const std::string& s);
+    // Unfrozen copy sharing the children, or nullptr if the node is shared as is
+    virtual std::shared_ptr<VfsNode> cloneForWrite() const { return nullptr; }
+    // children() now holds copy where it held old (copy-on-write of a child)
+    virtual void childReplaced(const VfsNode* old, const std::shared_ptr<VfsNode>& copy) { (void)old; (void)copy; }
+    virtual ChildIndex& children() {
+        static ChildIndex empty;
         return empty;
     }
+    // False when children() is regenerated from an external source on every call
+    // (host mounts, remote mounts); such subtrees bypass the Vfs resolve cache.
+    virtual bool stableChildren() const { return true; }
+    // children() held for as long as the result is. A regenerated listing is
+    // replaced by a later call, possibly on another thread, so code reading
+    // the children of any node it did not create holds this instead.
+    virtual std::shared_ptr<const ChildIndex> listing();
+
+private:
+    static uint64_t nextSerial();
 };
 
 struct DirNode : VfsNode {
-    std::map<std::string, std::shared_ptr<VfsNode>> ch;
+    ChildIndex ch;
     explicit DirNode(std::string n) : VfsNode(std::move(n), Kind::Dir) {}
     bool isDir() const override { return true; }
-    std::map<std::string, std::shared_ptr<VfsNode>>& children() override { return ch; }
+    ChildIndex& children() override { return ch; }
+    std::shared_ptr<VfsNode> cloneForWrite() const override;
 };
 
+//
+// File contents are a rope of chunks, so appending costs the appended bytes
+// and a ranged read or write only touches the chunks it covers. Contents
+// written whole are one chunk, which readShared() hands out as is; appends
+// add chunks of at most CHUNK bytes. Chunks are shared with the node's
+// snapshot copies and readers, and changed in place only while this node is
+// their sole owner and they are not interned in a BlobStore. Contents below
+// SMALL bytes are kept inline instead, as most files in source and AST trees
+// are tiny.
+//
 struct FileNode : VfsNode {
-    std::string content;
-    FileNode(std::string n, std::string c = "")
-        : VfsNode(std::move(n), Kind::File), content(std::move(c)) {}
-    std::string read() const override { return content; }
-    void write(const std::string& s) override { const_cast<std::string&>(content) = s; }
+    static constexpr size_t CHUNK = 64 * 1024;
+    static constexpr size_t SMALL = BlobStore::MIN_SIZE;
+    FileNode(std::string n, std::string c = "");
+    FileNode(std::string n, std::shared_ptr<std::string> c);
+    // Takes c as the whole contents, sharing it (e.g. an interned blob)
+    void assign(std::shared_ptr<std::string> c);
+    std::string read() const override;
+    void write(const std::string& s) override;
+    ContentRef readShared() const override;
+    size_t size() const override { return ends.empty() ? small.size() : ends.back(); }
+    std::string readRange(size_t offset, size_t len) const override;
+    void append(const std::string& s) override;
+    void writeRange(size_t offset, const std::string& s) override;
+    std::shared_ptr<VfsNode> cloneForWrite() const override;
+    size_t chunkCount() const { return chunks.size(); }
+private:
+    std::string small;  // the contents while chunks is empty
+    std::vector<std::shared_ptr<std::string>> chunks;
+    std::vector<size_t> ends;  // end offset of each chunk in the file
+    void promote();  // moves small into the first chunk
+    size_t chunkAt(size_t offset) const;
+    std::string& ownChunk(size_t i);
+};
+
+
+//
+// Allocation-free path tokenizer: iterates the non-empty '/'-separated
+// components of a path as views into the original string.
+//
+class PathParts {
+    std::string_view path;
+public:
+    class iterator {
+        std::string_view path;
+        size_t b = 0, e = 0;
+        void skip(){
+            b = e;
+            while(b < path.size() && path[b] == '/') ++b;
+            e = b;
+            while(e < path.size() && path[e] != '/') ++e;
+        }
+        friend class PathParts;
+        iterator(std::string_view p, size_t pos) : path(p), e(pos) { skip(); }
+    public:
+        std::string_view operator*() const { return path.substr(b, e - b); }
+        iterator& operator++() { skip(); return *this; }
+        bool operator==(const iterator& o) const { return b == o.b; }
+        bool operator!=(const iterator& o) const { return b != o.b; }
+    };
+    explicit PathParts(std::string_view p) : path(p) {}
+    iterator begin() const { return iterator(path, 0); }
+    iterator end() const { return iterator(path, path.size()); }
+    bool empty() const { return begin() == end(); }
 };
 
+class MountPrefetch;
 
 //
 // VFS
 //
 struct Vfs {
+    // Memory held by one overlay's tree. Every mutation made through the Vfs
+    // adjusts it by what it added or dropped, so reading it is O(1). Contents
+    // count in full in each overlay holding them (blob.stats shows how much is
+    // shared), a directory linked under two names counts under both, and host
+    // mounts count as one node. Trees edited directly rather than through the
+    // Vfs, like ASTs a parser fills in place, are only seen by a recount.
+    struct OverlayUsage {
+        size_t nodes = 0;
+        size_t dirs = 0;
+        size_t files = 0;
+        size_t ast_nodes = 0;
+        size_t content_bytes = 0;  // file contents
+        size_t ast_bytes = 0;      // serialized AST payloads, as overlay.save writes them
+        size_t node_bytes = 0;     // the node objects themselves
+        size_t tagged_nodes = 0;   // tags are filled in by overlayUsage() only
+        size_t tag_bytes = 0;
+        size_t total() const { return content_bytes + ast_bytes + node_bytes + tag_bytes; }
+        OverlayUsage& operator+=(const OverlayUsage& o);
+        OverlayUsage& operator-=(const OverlayUsage& o);
+    };
+    // A limit on an overlay's usage total; writes that would grow it past the
+    // limit are refused (Reject) or go through with a warning (Warn)
+    enum class BudgetPolicy { Warn, Reject };
+    struct OverlayBudget {
+        size_t limit = 0;  // bytes, 0 for none
+        BudgetPolicy policy = BudgetPolicy::Warn;
+    };
+
     struct Overlay {
         std::string name;
         std::shared_ptr<DirNode> root;
         std::string source_file;  // path to original source file (e.g., "foo.cpp")
         std::string source_hash;  // BLAKE3 hash of source file
+        ArenaRef arena;           // node arena when loaded in bulk, else empty
+        OverlayUsage usage;
+        OverlayBudget budget;
+        bool over_budget = false; // warned already; reset once back under
     };
     struct OverlayHit {
         size_t overlay_id;
@@ -69,9 +221,16 @@ struct Vfs {
     LogicEngine logic_engine;
     std::optional<TagMiningSession> mining_session;
 
+    // Create/write/remove/move events of every overlay, in commit order
+    VfsJournal journal;
+    // Contents written through the Vfs or loaded from overlay files, by digest
+    BlobStore blobs;
+
     Vfs();
 
     static std::vector<std::string> splitPath(const std::string& p);
+    // Splits "/a/b/c" into ("/a/b", "c"); the name is empty for "/"
+    static std::pair<std::string_view, std::string_view> splitParentPath(std::string_view p);
 
     size_t overlayCount() const;
     const std::string& overlayName(size_t id) const;
@@ -82,22 +241,112 @@ struct Vfs {
     void clearOverlayDirty(size_t id);
     void setOverlaySource(size_t id, std::string path);
     void markOverlayDirty(size_t id);
-    size_t registerOverlay(std::string name, std::shared_ptr<DirNode> overlayRoot);
+    size_t registerOverlay(std::string name, std::shared_ptr<DirNode> overlayRoot, ArenaRef arena = ArenaRef());
     void unregisterOverlay(size_t overlayId);
 
+    OverlayUsage overlayUsage(size_t overlayId) const;
+    // Measures the overlay's tree again, replacing the running counts
+    OverlayUsage recountOverlay(size_t overlayId);
+    OverlayBudget overlayBudget(size_t overlayId) const;
+    void setOverlayBudget(size_t overlayId, OverlayBudget budget);
+    static OverlayUsage measureTree(const std::shared_ptr<VfsNode>& node);
+
     std::vector<size_t> overlaysForPath(const std::string& path) const;
     std::vector<OverlayHit> resolveMulti(const std::string& path) const;
     std::vector<OverlayHit> resolveMulti(const std::string& path, const std::vector<size_t>& allowed) const;
     std::shared_ptr<VfsNode> resolve(const std::string& path);
     std::shared_ptr<VfsNode> resolveForOverlay(const std::string& path, size_t overlayId);
     std::shared_ptr<VfsNode> tryResolveForOverlay(const std::string& path, size_t overlayId) const;
-    std::shared_ptr<DirNode> ensureDir(const std::string& path, size_t overlayId = 0);
-    std::shared_ptr<DirNode> ensureDirForOverlay(const std::string& path, size_t overlayId);
+    std::shared_ptr<DirNode> ensureDir(std::string_view path, size_t overlayId = 0);
+    std::shared_ptr<DirNode> ensureDirForOverlay(std::string_view path, size_t overlayId);
+    // Like resolveForOverlay, but first copies any snapshot-shared node on the
+    // path so the result can be modified in place
+    std::shared_ptr<VfsNode> resolveForWrite(const std::string& path, size_t overlayId);
+
+    // Snapshots: O(1) copy-on-write captures of an overlay's tree. A snapshot
+    // root is read-only; restoring one makes it the overlay's tree again, and
+    // the first later change copies it. diffTrees lists the paths where two
+    // trees differ, skipping subtrees they still share.
+    std::shared_ptr<DirNode> snapshotOverlay(size_t overlayId);
+    void restoreOverlay(size_t overlayId, std::shared_ptr<DirNode> snapshot);
+    static void diffTrees(const std::shared_ptr<VfsNode>& a, const std::shared_ptr<VfsNode>& b,
+                          const std::string& path, std::vector<std::string>& changed);
+
+    // Resolve cache: (normalized path, overlay) -> weak node. An entry records the
+    // generation of every ChildIndex walked to produce it and is only trusted while
+    // all of them are unchanged, so a mutation invalidates just the paths below the
+    // directory it touched. Misses are cached the same way.
+    struct ResolveCacheStats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t uncacheable = 0;
+    };
+    ResolveCacheStats resolveCacheStats() const;
+    void clearResolveCache();
+
+    // Concurrency: every public member function locks the Vfs itself, shared
+    // for lookups and listings and exclusive for mutations, so any number of
+    // threads may read while writers are serialized. Code that walks nodes
+    // returned by a lookup, or touches the public fields, holds a guard for
+    // the duration. Guards nest (see vfs_lock.h). Long read-only walks such as
+    // overlay serialization can instead snapshotOverlay() and walk the frozen
+    // tree with no lock: writers copy frozen nodes rather than change them.
+    // Remote directories rebuild their listing when read and are not safe to
+    // list from several threads at once; host mount directories keep theirs
+    // until the host changes (see MountWatch).
+    //
+    // A read guard cannot be raised to a write guard. While holding one, do
+    // not call the entry points that take a write guard: mkdir, touch, write,
+    // writeRange, append, addNode, rm, mv, link, resolveForWrite, ensureDir,
+    // the overlay calls that change one (register, unregister, snapshot,
+    // restore, recount, budget, source, dirty flag), registerTag, tag
+    // add/remove/clear, and Transaction::commit. Take writeLock() instead
+    // when a walk leads to a change.
+    VfsRwLock::Shared readLock() const { return VfsRwLock::Shared(rw_lock); }
+    VfsRwLock::Exclusive writeLock() const { return VfsRwLock::Exclusive(rw_lock); }
+
+    // Batched mutations on one overlay. Operations are buffered and commit()
+    // applies them in order under one write lock, walking each parent
+    // directory once. If one fails the overlay is rolled back to its state
+    // before the commit (AST nodes written in place excepted) and the error
+    // rethrown, so no reader or autosave ever sees half of a batch. The
+    // overlay is marked dirty once per commit.
+    class Transaction {
+    public:
+        explicit Transaction(Vfs& vfs, size_t overlayId = 0);
+        void mkdir(const std::string& path);
+        void touch(const std::string& path);
+        void write(const std::string& path, std::string data);
+        void addNode(const std::string& dirpath, std::shared_ptr<VfsNode> node);
+        void rm(const std::string& path);
+        size_t size() const { return ops.size(); }
+        void discard() { ops.clear(); }
+        void commit();
+    private:
+        struct Op {
+            enum Kind { Mkdir, Touch, Write, AddNode, Rm } kind;
+            std::string path;
+            std::string data;
+            std::shared_ptr<VfsNode> node;
+        };
+        Vfs& vfs;
+        size_t overlay;
+        std::vector<Op> ops;
+    };
+    Transaction transaction(size_t overlayId = 0) { return Transaction(*this, overlayId); }
 
     void mkdir(const std::string& p, size_t overlayId = 0);
     void touch(const std::string& p, size_t overlayId = 0);
     void write(const std::string& p, const std::string& data, size_t overlayId = 0);
     std::string read(const std::string& p, std::optional<size_t> overlayId = std::nullopt) const;
+    // Ranged counterparts of read/write; they resolve the path like them
+    ContentRef readShared(const std::string& p, std::optional<size_t> overlayId = std::nullopt) const;
+    ContentView readView(const std::string& p, std::optional<size_t> overlayId = std::nullopt) const;
+    size_t size(const std::string& p, std::optional<size_t> overlayId = std::nullopt) const;
+    std::string readRange(const std::string& p, size_t offset, size_t len,
+                          std::optional<size_t> overlayId = std::nullopt) const;
+    void append(const std::string& p, const std::string& data, size_t overlayId = 0);
+    void writeRange(const std::string& p, size_t offset, const std::string& data, size_t overlayId = 0);
     void addNode(const std::string& dirpath, std::shared_ptr<VfsNode> n, size_t overlayId = 0);
     void rm(const std::string& p, size_t overlayId = 0);
     void mv(const std::string& src, const std::string& dst, size_t overlayId = 0);
@@ -131,6 +380,7 @@ struct Vfs {
         std::string host_path;  // For filesystem/library, or "host:port" for remote
         std::shared_ptr<VfsNode> mount_node;
         MountType type;
+        std::shared_ptr<MountPrefetch> prefetch;  // background warm-up, if one was started
     };
     std::vector<MountInfo> mounts;
     bool mount_allowed = true;
@@ -139,6 +389,8 @@ struct Vfs {
     void mountLibrary(const std::string& lib_path, const std::string& vfs_path, size_t overlayId = 0);
     void mountRemote(const std::string& host, int port, const std::string& remote_path, const std::string& vfs_path, size_t overlayId = 0);
     void unmount(const std::string& vfs_path);
+    // Warms a filesystem mount in the background (see MountPrefetch)
+    void prefetchMount(const std::string& vfs_path, size_t depth = 0);
     std::vector<MountInfo> listMounts() const;
     void setMountAllowed(bool allowed);
     bool isMountAllowed() const;
@@ -161,8 +413,88 @@ struct Vfs {
     bool nodeHasTag(const std::string& vfs_path, const std::string& tag_name) const;
     std::vector<std::string> getNodeTags(const std::string& vfs_path) const;
     void clearNodeTags(const std::string& vfs_path);
+    // Paths of the nodes carrying the tag(s), sorted; costs the size of the
+    // result, not of the tree
     std::vector<std::string> findNodesByTag(const std::string& tag_name) const;
     std::vector<std::string> findNodesByTags(const std::vector<std::string>& tag_names, bool match_all) const;
+
+private:
+    struct ResolveCacheEntry {
+        uint64_t hash = 0;
+        size_t overlay_id = static_cast<size_t>(-1);
+        const DirNode* root = nullptr;
+        bool found = false;
+        std::string path;  // normalized, e.g. "/a/b"
+        std::weak_ptr<VfsNode> node;
+        std::vector<std::pair<const ChildIndex*, uint64_t>> chain;
+    };
+    static constexpr size_t RESOLVE_CACHE_SLOTS = 4096;
+    static constexpr size_t RESOLVE_CACHE_STRIPES = 64;
+    // Keeps Vfs copy/move-assignable; the cached chains stay valid because the
+    // overlay roots are shared, only the lock is per instance.
+    struct ResolveCacheMutex : std::mutex {
+        ResolveCacheMutex() = default;
+        ResolveCacheMutex(const ResolveCacheMutex&) : std::mutex() {}
+        ResolveCacheMutex& operator=(const ResolveCacheMutex&) { return *this; }
+    };
+    // Slots are striped over independent locks so concurrent readers resolving
+    // different paths do not contend; stripe k holds slots k, k + STRIPES, ...
+    struct alignas(64) ResolveCacheStripe {
+        ResolveCacheMutex mtx;
+        std::vector<ResolveCacheEntry> entries;
+        ResolveCacheStats stats;
+    };
+    mutable std::array<ResolveCacheStripe, RESOLVE_CACHE_STRIPES> resolve_cache;
+    mutable VfsRwLock rw_lock;
+    // Overlay of the transaction being committed; its dirty flag is deferred
+    static constexpr size_t NO_BATCH = static_cast<size_t>(-1);
+    size_t batch_overlay = NO_BATCH;
+    bool batch_dirty = false;
+    std::vector<VfsEvent> batch_events;
+    // Which overlays hold which paths; narrows resolveMulti and listDir
+    OverlayIndex overlay_index;
+    // Where the tagged nodes are, for findNodesByTag
+    TagPathIndex tag_paths;
+
+    std::shared_ptr<VfsNode> lookupPath(std::string_view path, size_t overlayId) const;
+    std::shared_ptr<DirNode> ensureParentDir(std::string_view path, size_t overlayId, std::string_view& name);
+    std::shared_ptr<DirNode> writableRoot(size_t overlayId);
+    // path names the child, for the tagged-path index
+    std::shared_ptr<VfsNode> writableChild(const std::shared_ptr<VfsNode>& dir, ChildIndex::iterator it,
+                                           size_t overlayId, std::string_view path);
+    // Moves the tags and tagged path of a node at path to its writable copy
+    void carryTags(size_t overlayId, std::string_view path, VfsNode* from, VfsNode* to);
+    std::shared_ptr<DirNode> writableDir(std::string_view path, size_t overlayId, bool create);
+    // writableDir for any directory-like node, e.g. an AST container
+    std::shared_ptr<VfsNode> writableContainer(std::string_view path, size_t overlayId, bool create);
+    void touchIn(const std::shared_ptr<DirNode>& dir, std::string_view path, size_t overlayId);
+    void writeIn(const std::shared_ptr<DirNode>& dir, std::string_view path, const std::string& data, size_t overlayId);
+    // Writable file node at path in dir, created when missing
+    std::shared_ptr<VfsNode> fileIn(const std::shared_ptr<DirNode>& dir, std::string_view path, size_t overlayId,
+                                    bool& created);
+    std::shared_ptr<VfsNode> readTarget(const std::string& path, std::optional<size_t> overlayId) const;
+    // Puts node in dir under name, dropping what the name held from the
+    // overlay's usage; the Create event the caller journals counts the node
+    void replaceChild(const std::shared_ptr<DirNode>& dir, std::string_view name,
+                      const std::shared_ptr<VfsNode>& node, size_t overlayId);
+    // Records a change in the journal, the overlay index and the overlay's
+    // usage; node is the one created, moved or removed, looked up again when
+    // not given (removals are then not subtracted)
+    void journalEvent(VfsEvent::Kind kind, size_t overlayId, std::string path, std::string to = {},
+                      const std::shared_ptr<VfsNode>& node = nullptr);
+    // Usage of node, which now sits at path in the overlay; the tagged nodes
+    // in it are recorded in tag_paths
+    OverlayUsage adoptTree(size_t overlayId, const std::string& path, const std::shared_ptr<VfsNode>& node);
+    // Re-syncs the overlay index and usage after the overlay's root was
+    // swapped for another version of it
+    void reindexOverlay(size_t overlayId, const std::shared_ptr<DirNode>& previous);
+    // Throws when growing the overlay by growth bytes breaks a Reject budget
+    void checkBudget(size_t overlayId, size_t growth) const;
+    // Applies a change to the overlay's usage, warning when it goes over a Warn budget
+    void accountUsage(size_t overlayId, const OverlayUsage& added, const OverlayUsage& dropped);
+    bool mayHold(OverlayIndex::Mask candidates, size_t overlayId) const {
+        return !OverlayIndex::indexed(overlayId) || (candidates >> overlayId) & 1;
+    }
 };
 extern Vfs* G_VFS; // glob aputinta varten
 
@@ -176,7 +508,9 @@ struct VfsVisitor {
 
     VfsVisitor(Vfs* v) : vfs(v), current_index(0) {}
 
-    // Commands
+    // Commands. find matches a glob (see GlobMatcher) against every name
+    // below start_path, or against the path below it when the pattern has a
+    // slash; results are in walk order however many threads walked.
     void find(const std::string& start_path, const std::string& pattern);
     void findext(const std::string& start_path, const std::string& extension);
     std::string name() const;
@@ -186,9 +520,7 @@ struct VfsVisitor {
     size_t count() const { return results.size(); }
 
 private:
-    void findRecursive(std::shared_ptr<VfsNode> node, const std::string& path,
-                      const std::string& pattern, bool is_extension);
-    bool matchesPattern(const std::string& name, const std::string& pattern) const;
+    void collect(const std::string& start_path, const std::string& pattern, bool is_extension);
 };
 
 char type_char(const std::shared_ptr<VfsNode>& node);
@@ -0,0 +1,1928 @@
+#include "VfsShell.h"
+
+#ifdef VFS_TESTS_ENABLED
+
+// ============================================================================
+// VFS core tests (make vfs-tests && ./vfs_tests --vfs-core-tests)
+// ============================================================================
+
+// Simple test framework; CHECK rather than assert, so that release builds test too
+#define TEST(name) static void test_##name()
+#define CHECK(cond) do { \
+    if(!(cond)) throw std::runtime_error(std::string(__FILE__ ":") + std::to_string(__LINE__) + ": " #cond); \
+} while(0)
+#define RUN_TEST(name) do { \
+    std::cout << "Running " #name "... "; \
+    try { \
+        test_##name(); \
+        std::cout << "PASS\n"; \
+        passed++; \
+    } catch (const std::exception& e) { \
+        std::cout << "FAIL: " << e.what() << "\n"; \
+        failed++; \
+    } \
+    total++; \
+} while(0)
+
+static int total = 0;
+static int passed = 0;
+static int failed = 0;
+
+static std::string test_name(size_t i){
+    return "entry_" + std::to_string(i * 2654435761u % 1000003u) + "_" + std::to_string(i);
+}
+
+// ============================================================================
+// ChildIndex
+// ============================================================================
+
+TEST(child_index_matches_map) {
+    // Past HASH_THRESHOLD and back, with the same operations on a std::map
+    ChildIndex idx;
+    std::map<std::string, std::shared_ptr<VfsNode>> ref;
+    std::mt19937 rng(7);
+    for(size_t step = 0; step < 4000; ++step){
+        std::string name = test_name(rng() % 100);
+        if(rng() % 3){
+            auto node = std::make_shared<FileNode>(name, "");
+            idx[name] = node;
+            ref[name] = node;
+        } else {
+            CHECK(idx.erase(name) == ref.erase(name));
+        }
+        CHECK(idx.size() == ref.size());
+    }
+    CHECK(idx.size() > ChildIndex::HASH_THRESHOLD && idx.hashed());
+    auto it = ref.begin();
+    for(const auto& kv : idx){
+        CHECK(it != ref.end());
+        CHECK(kv.first == it->first);
+        CHECK(kv.second == it->second);
+        ++it;
+    }
+    CHECK(it == ref.end());
+    for(size_t i = 0; i < 100; ++i){
+        std::string name = test_name(i);
+        auto found = idx.find(name);
+        CHECK((found != idx.end()) == (ref.count(name) == 1));
+        if(found != idx.end()) CHECK(found->second == ref[name]);
+    }
+}
+
+TEST(child_index_generation) {
+    ChildIndex idx;
+    uint64_t g0 = idx.generation();
+    idx["a"] = std::make_shared<FileNode>("a", "");
+    uint64_t g1 = idx.generation();
+    CHECK(g1 != g0);
+    CHECK(idx.find("a") != idx.end());
+    CHECK(idx.generation() == g1);  // lookups leave it alone
+    idx.erase("a");
+    CHECK(idx.generation() != g1);
+    ChildIndex copy = idx;
+    copy["b"];
+    CHECK(copy.generation() != idx.generation());
+}
+
+// ============================================================================
+// Resolve cache
+// ============================================================================
+
+TEST(resolve_cache_follows_mutations) {
+    Vfs vfs;
+    vfs.write("/plan/a/f", "1");
+    vfs.write("/plan/b/g", "2");
+    CHECK(vfs.tryResolveForOverlay("/plan/a/f", 0));
+    CHECK(!vfs.tryResolveForOverlay("/plan/a/missing", 0));
+
+    // A cached miss must see the node once it exists, and a cached hit must
+    // not outlive rm or mv
+    vfs.write("/plan/a/missing", "3");
+    CHECK(vfs.tryResolveForOverlay("/plan/a/missing", 0));
+    vfs.rm("/plan/a/f");
+    CHECK(!vfs.tryResolveForOverlay("/plan/a/f", 0));
+    vfs.mv("/plan/b", "/plan/c");
+    CHECK(!vfs.tryResolveForOverlay("/plan/b/g", 0));
+    auto g = vfs.tryResolveForOverlay("/plan/c/g", 0);
+    CHECK(g && g->read() == "2");
+    CHECK(vfs.tryResolveForOverlay("//plan/c//g/", 0) == g);
+}
+
+TEST(resolve_cache_invalidates_only_below) {
+    Vfs vfs;
+    std::vector<std::string> paths;
+    for(int s = 0; s < 4; ++s)
+        for(int m = 0; m < 4; ++m){
+            paths.push_back("/qwen/history/s" + std::to_string(s) + "/m" + std::to_string(m));
+            vfs.write(paths.back(), "x");
+        }
+    for(const auto& p : paths) CHECK(vfs.tryResolveForOverlay(p, 0));
+    auto warm = vfs.resolveCacheStats();
+    for(const auto& p : paths) CHECK(vfs.tryResolveForOverlay(p, 0));
+    auto hot = vfs.resolveCacheStats();
+    CHECK(hot.misses == warm.misses);
+    CHECK(hot.hits - warm.hits == paths.size());
+
+    vfs.mkdir("/qwen/history/s0/extra");
+    for(const auto& p : paths) CHECK(vfs.tryResolveForOverlay(p, 0));
+    auto after = vfs.resolveCacheStats();
+    CHECK(after.misses - hot.misses == 4);  // only the paths under s0
+}
+
+// ============================================================================
+// Overlay index
+// ============================================================================
+
+TEST(overlay_index_matches_every_overlay) {
+    Vfs vfs;
+    std::vector<std::string> paths{"/", "/shared", "/shared/none", "/missing"};
+    for(int o = 1; o <= 12; ++o){
+        size_t id = vfs.registerOverlay("ov" + std::to_string(o), std::make_shared<DirNode>("/"));
+        for(int i = 0; i < 20; ++i){
+            std::string p = "/pkg" + std::to_string(o % 5) + "/src/" + test_name(i);
+            vfs.write(p, "x", id);
+            if(i % 5 == 0) paths.push_back(p);
+        }
+        if(o % 4 == 0) vfs.write("/shared/" + test_name(o), "y", id);
+        paths.push_back("/pkg" + std::to_string(o % 5));
+    }
+    vfs.rm("/pkg1/src/" + test_name(5), 1);
+    vfs.mv("/pkg2", "/moved", 2);
+    paths.push_back("/moved/src");
+
+    std::vector<size_t> all;
+    for(size_t o = 0; o < vfs.overlayCount(); ++o) all.push_back(o);
+    for(const auto& p : paths){
+        std::vector<size_t> expected, got;
+        std::set<std::string> names;
+        for(size_t o = 0; o < vfs.overlayCount(); ++o){
+            auto node = vfs.tryResolveForOverlay(p, o);
+            if(!node) continue;
+            expected.push_back(o);
+            if(node->isDir()) for(const auto& kv : node->children()) names.insert(kv.first.str());
+        }
+        for(const auto& hit : vfs.resolveMulti(p)) got.push_back(hit.overlay_id);
+        CHECK(got == expected);
+        std::set<std::string> listed;
+        if(!expected.empty() && vfs.tryResolveForOverlay(p, expected[0])->isDir())
+            for(const auto& kv : vfs.listDir(p, all)) listed.insert(kv.first);
+        CHECK(listed == names);
+    }
+}
+
+// ============================================================================
+// Node arena
+// ============================================================================
+
+TEST(node_arena_reuses_blocks_freed_elsewhere) {
+    ArenaRef arena = NodeArena::create();
+    std::vector<std::shared_ptr<FileNode>> nodes;
+    std::set<const VfsNode*> first;
+    {
+        NodeArena::Scope scope(arena.get());
+        for(size_t i = 0; i < 2000; ++i){
+            nodes.push_back(make_node<FileNode>(test_name(i), "x"));
+            first.insert(nodes.back().get());
+        }
+    }
+    auto before = arena->stats();
+    CHECK(before.pins == 1 + nodes.size());
+
+    // Released on another thread, the blocks go to the remote stacks...
+    std::thread([&]{ nodes.clear(); }).join();
+    CHECK(arena->stats().pins == 1);
+
+    // ...which the owner takes over once its own free lists run dry
+    {
+        NodeArena::Scope scope(arena.get());
+        for(size_t i = 0; i < 2000; ++i){
+            nodes.push_back(make_node<FileNode>(test_name(i), "y"));
+            CHECK(first.count(nodes.back().get()) == 1);
+        }
+    }
+    CHECK(arena->stats().slabs == before.slabs);
+    nodes.clear();
+    CHECK(arena->stats().pins == 1);  // just this handle: no block is live
+
+    // A scope off the owner thread installs nothing
+    std::thread([&]{
+        NodeArena::Scope scope(arena.get());
+        nodes.push_back(make_node<FileNode>("heap", "z"));
+    }).join();
+    CHECK(arena->stats().pins == 1);
+}
+
+TEST(node_arena_outlives_its_overlay) {
+    auto file = (std::filesystem::temp_directory_path() / ("vfs_core_test_arena_" + std::to_string(::getpid()) + ".vfs")).string();
+    {
+        Vfs vfs;
+        for(size_t i = 0; i < 500; ++i) vfs.write("/src/d" + std::to_string(i % 7) + "/" + test_name(i), "body " + std::to_string(i));
+        save_overlay_to_file(vfs, 0, file);
+    }
+    Vfs vfs;
+    size_t id = mount_overlay_from_file(vfs, "loaded", file);
+    ArenaRef arena = vfs.overlay_stack[id].arena;
+    CHECK(arena);
+    CHECK(arena->stats().pins > 500);
+
+    // A node still held keeps its block, and so the arena, past the overlay
+    std::string path = "/src/d3/" + test_name(3);
+    auto held = vfs.resolveForOverlay(path, id);
+    vfs.unregisterOverlay(id);
+    CHECK(held->read() == "body 3");
+    CHECK(arena->stats().pins > 1);
+    held.reset();
+    CHECK(arena->stats().pins == 1);  // just this handle
+    std::filesystem::remove(file);
+}
+
+// ============================================================================
+// Chunked files
+// ============================================================================
+
+TEST(file_chunks_match_string) {
+    // Ranged edits against a plain string, across snapshots sharing chunks
+    std::mt19937 rng(7);
+    std::string model;
+    Vfs vfs;
+    vfs.write("/f", "");
+    std::vector<std::pair<std::shared_ptr<DirNode>, std::string>> snaps;
+    for(size_t i = 0; i < 1000; ++i){
+        size_t off = model.empty() ? 0 : rng() % (model.size() + 1000);
+        std::string data(rng() % (3 * FileNode::CHUNK / 2), static_cast<char>('a' + i % 26));
+        switch(rng() % 3){
+        case 0:
+            vfs.append("/f", data);
+            model += data;
+            break;
+        case 1:
+            vfs.writeRange("/f", off, data);
+            if(model.size() < off + data.size()) model.resize(off + data.size(), '\0');
+            model.replace(off, data.size(), data);
+            break;
+        default:
+            CHECK(vfs.readRange("/f", off, data.size() + 1, 0) ==
+                  (off < model.size() ? model.substr(off, data.size() + 1) : std::string()));
+            break;
+        }
+        if(model.size() > (8u << 20)){
+            vfs.write("/f", "");
+            model.clear();
+        }
+        if(i % 100 == 0) snaps.emplace_back(vfs.snapshotOverlay(0), model);
+        CHECK(vfs.size("/f", 0) == model.size());
+    }
+    for(const auto& [snap, content] : snaps) CHECK(snap->children().find("f")->second->read() == content);
+    CHECK(vfs.read("/f", 0) == model);
+}
+
+TEST(context_entries_share_content) {
+    Vfs vfs;
+    const size_t size = 4 * FileNode::SMALL;
+    for(int i = 0; i < 40; ++i){
+        // Every fourth file repeats the one before it
+        int body = i % 4 == 3 ? i - 1 : i;
+        vfs.write("/src/m" + std::to_string(i % 4) + "/" + test_name(i), std::string(size, 'a' + body % 26) + std::to_string(body));
+    }
+    ContextBuilder builder(vfs, vfs.tag_storage, vfs.tag_registry);
+    builder.addFilter(ContextFilter::nodeKind(VfsNode::Kind::File));
+    builder.collect();
+    CHECK(builder.entryCount() == 40);
+    for(const auto& entry : builder.entries){
+        // A view of the node's own buffer, not a copy
+        CHECK(entry.content().data() == entry.node->readView().data.data());
+        CHECK(entry.content() == vfs.read(entry.vfs_path, 0));
+    }
+    builder.deduplicateEntries();
+    CHECK(builder.entryCount() == 30);
+}
+
+// ============================================================================
+// Snapshots (copy-on-write)
+// ============================================================================
+
+TEST(snapshot_restore_files) {
+    Vfs vfs;
+    for(int i = 0; i < 20; ++i) vfs.write("/src/d" + std::to_string(i % 3) + "/f" + std::to_string(i), "v0");
+    auto snap = vfs.snapshotOverlay(0);
+    vfs.write("/src/d0/f0", "v1");
+    vfs.write("/src/d1/new", "n");
+    vfs.rm("/src/d2/f2");
+    CHECK(vfs.read("/src/d0/f0", 0) == "v1");
+
+    std::vector<std::string> changed;
+    Vfs::diffTrees(snap, vfs.overlayRoot(0), "/", changed);
+    std::sort(changed.begin(), changed.end());
+    CHECK((changed == std::vector<std::string>{"/src/d0/f0", "/src/d1/new", "/src/d2/f2"}));
+
+    // The written path was copied; its untouched siblings are shared
+    CHECK(snap->children().find("src")->second != vfs.overlayRoot(0)->children().find("src")->second);
+    auto f3 = [](const std::shared_ptr<VfsNode>& root){
+        return root->children().find("src")->second->children().find("d0")->second->children().find("f3")->second;
+    };
+    CHECK(f3(snap) == f3(vfs.overlayRoot(0)));
+
+    vfs.restoreOverlay(0, snap);
+    CHECK(vfs.read("/src/d0/f0", 0) == "v0");
+    CHECK(!vfs.tryResolveForOverlay("/src/d1/new", 0));
+    CHECK(vfs.read("/src/d2/f2", 0) == "v0");
+}
+
+TEST(snapshot_restore_cpp_ast) {
+    Vfs vfs;
+    auto tu = std::make_shared<CppTranslationUnit>("tu");
+    vfs_add(vfs, "/tu", tu, 0);
+    auto fn = std::make_shared<CppFunction>("main", "int", "main");
+    vfs_add(vfs, "/tu/main", fn, 0);
+    tu->funcs.push_back(fn);
+    vfs_add(vfs, "/tu/main/body", fn->body, 0);
+    writable_block(vfs, "/tu/main", 0)->stmts.push_back(std::make_shared<CppRawStmt>("stmt", "int a = 1;"));
+    const std::string before = tu->dump(0);
+
+    auto snap = vfs.snapshotOverlay(0);
+    writable_block(vfs, "/tu/main", 0)->stmts.push_back(std::make_shared<CppReturn>("ret", std::make_shared<CppInt>("i", 7)));
+    expect_fn(vfs.resolveForWrite("/tu/main", 0))->params.push_back(CppParam{"int", "argc"});
+    auto now = expect_tu(vfs.resolveForOverlay("/tu", 0));
+    CHECK(now != tu);  // copied, the snapshot keeps the original
+    CHECK(now->dump(0).find("return 7;") != std::string::npos);
+    CHECK(now->dump(0).find("int argc") != std::string::npos);
+    CHECK(tu->dump(0) == before);
+
+    vfs.restoreOverlay(0, snap);
+    CHECK(expect_tu(vfs.resolveForOverlay("/tu", 0))->dump(0) == before);
+}
+
+// ============================================================================
+// Transactions
+// ============================================================================
+
+TEST(transaction_commits_once) {
+    Vfs vfs;
+    size_t id = vfs.registerOverlay("batch", std::make_shared<DirNode>("/"));
+    vfs.clearOverlayDirty(id);
+    auto tx = vfs.transaction(id);
+    tx.mkdir("/pkg/empty");
+    for(int i = 0; i < 10; ++i) tx.write("/pkg/src/" + test_name(i), std::to_string(i));
+    tx.touch("/pkg/src/touched");
+    CHECK(!vfs.tryResolveForOverlay("/pkg", id));  // nothing before the commit
+    tx.commit();
+    CHECK(vfs.overlayDirty(id));
+    CHECK(vfs.read("/pkg/src/" + test_name(3), id) == "3");
+    CHECK(vfs.tryResolveForOverlay("/pkg/empty", id)->isDir());
+    CHECK(vfs.tryResolveForOverlay("/pkg/src/touched", id));
+
+    // Writes after an addNode replacing a directory land in the new one
+    vfs.mkdir("/a/x", id);
+    auto tx2 = vfs.transaction(id);
+    tx2.mkdir("/a/x");
+    tx2.addNode("/a", std::make_shared<DirNode>("x"));
+    tx2.write("/a/x/f", "in the new x");
+    tx2.commit();
+    CHECK(vfs.read("/a/x/f", id) == "in the new x");
+}
+
+TEST(transaction_rolls_back_on_failure) {
+    Vfs vfs;
+    size_t id = vfs.registerOverlay("batch", std::make_shared<DirNode>("/"));
+    vfs.write("/pkg/file", "x", id);
+    vfs.clearOverlayDirty(id);
+    auto before = vfs.overlayRoot(id);
+
+    auto tx = vfs.transaction(id);
+    tx.write("/pkg/new", "y");
+    tx.write("/pkg/file", "changed");
+    tx.write("/pkg/file/below_a_file", "y");
+    bool threw = false;
+    try { tx.commit(); } catch(const std::exception&){ threw = true; }
+    CHECK(threw);
+
+    std::vector<std::string> changed;
+    Vfs::diffTrees(before, vfs.overlayRoot(id), "/", changed);
+    CHECK(changed.empty());
+    CHECK(!vfs.overlayDirty(id));
+    CHECK(vfs.read("/pkg/file", id) == "x");
+    CHECK(!vfs.tryResolveForOverlay("/pkg/new", id));
+
+    // A replaced directory comes back with what it held
+    vfs.write("/pkg/dir/kept", "k", id);
+    auto tx2 = vfs.transaction(id);
+    tx2.mkdir("/pkg/dir");
+    tx2.addNode("/pkg", std::make_shared<DirNode>("dir"));
+    tx2.write("/pkg/dir/f", "y");
+    tx2.write("/pkg/file/below_a_file", "y");
+    threw = false;
+    try { tx2.commit(); } catch(const std::exception&){ threw = true; }
+    CHECK(threw);
+    CHECK(vfs.read("/pkg/dir/kept", id) == "k");
+    CHECK(!vfs.tryResolveForOverlay("/pkg/dir/f", id));
+}
+
+// ============================================================================
+// Journal
+// ============================================================================
+
+TEST(journal_watch_sees_its_prefix) {
+    Vfs vfs;
+    size_t hits = 0, sibling = 0, others = 0;
+    vfs.journal.watch("/w/d3", [&](const VfsEvent&){ ++hits; });
+    vfs.journal.watch("/w/d30", [&](const VfsEvent&){ ++sibling; });
+    vfs.journal.watch("/other", [&](const VfsEvent&){ ++others; });
+    for(int i = 0; i < 100; ++i) vfs.write("/w/d" + std::to_string(i % 10) + "/" + test_name(i), "x");
+    CHECK(hits == 10 + 2);  // the files, and creating /w and /w/d3 (ancestors are seen too)
+    CHECK(sibling == 1);    // creating /w only
+    CHECK(others == 0);
+}
+
+TEST(journal_transaction_events) {
+    Vfs vfs;
+    vfs.write("/w/keep", "x");
+    uint64_t before = vfs.journal.lastSeq();
+    auto bad = vfs.transaction();
+    bad.write("/w/new", "y");
+    bad.rm("/w/missing");
+    bool threw = false;
+    try { bad.commit(); } catch(const std::exception&){ threw = true; }
+    CHECK(threw);
+    CHECK(vfs.journal.lastSeq() == before);  // rolled back, nothing published
+
+    auto tx = vfs.transaction();
+    tx.write("/w/a", "1");
+    tx.rm("/w/a");
+    CHECK(vfs.journal.lastSeq() == before);  // published on commit
+    tx.commit();
+    auto events = vfs.journal.since(before, "/w/a");
+    CHECK(events.size() == 2);
+    CHECK(events[0].kind == VfsEvent::Kind::Create);
+    CHECK(events[1].kind == VfsEvent::Kind::Remove);
+}
+
+// ============================================================================
+// Overlay usage
+// ============================================================================
+
+TEST(overlay_usage_matches_recount) {
+    Vfs vfs;
+    size_t id = vfs.registerOverlay("usage", std::make_shared<DirNode>("/"));
+    std::mt19937 rng(7);
+    auto path = [&](size_t depth){
+        std::string p;
+        for(size_t d = 0; d < depth; ++d) p += "/d" + std::to_string(rng() % 4);
+        return p + "/f" + std::to_string(rng() % 20);
+    };
+    std::shared_ptr<DirNode> snap;
+    for(size_t i = 0; i < 2000; ++i){
+        std::string p = path(1 + rng() % 3);
+        try{
+            switch(rng() % 9){
+            case 0: case 1: vfs.write(p, std::string(rng() % 2048, 'w'), id); break;
+            case 2: vfs.append(p, std::string(rng() % 512, 'a'), id); break;
+            case 3: vfs.writeRange(p, rng() % 1024, std::string(rng() % 256, 'r'), id); break;
+            case 4: vfs.rm(rng() % 8 ? p : p.substr(0, p.rfind('/')), id); break;
+            case 5: vfs.mv(p, path(1), id); break;
+            case 6: vfs.addNode(p.substr(0, p.rfind('/')), std::make_shared<FileNode>("n" + std::to_string(i % 7), "node"), id); break;
+            case 7: {
+                auto tx = vfs.transaction(id);
+                tx.write(path(2), std::string(300, 't'));
+                tx.write(path(2) + "/below", "x");  // fails when its parent is a file
+                tx.commit();
+                break;
+            }
+            case 8:
+                if(snap && rng() % 2) vfs.restoreOverlay(id, snap);
+                else snap = vfs.snapshotOverlay(id);
+                break;
+            }
+        } catch(const std::exception&){
+            // paths already gone or blocked by a file
+        }
+        if(i % 50 == 0){
+            auto running = vfs.overlayUsage(id);
+            auto measured = Vfs::measureTree(vfs.overlayRoot(id));
+            CHECK(running.nodes == measured.nodes);
+            CHECK(running.files == measured.files);
+            CHECK(running.dirs == measured.dirs);
+            CHECK(running.content_bytes == measured.content_bytes);
+            CHECK(running.total() == measured.total());
+        }
+    }
+}
+
+TEST(overlay_budget_rejects_growth) {
+    Vfs vfs;
+    size_t id = vfs.registerOverlay("budget", std::make_shared<DirNode>("/"));
+    vfs.write("/a/f", std::string(1000, 'a'), id);
+    size_t total = vfs.overlayUsage(id).total();
+    vfs.setOverlayBudget(id, {total + 1024, Vfs::BudgetPolicy::Reject});
+    bool refused = false;
+    try { vfs.write("/big", std::string(4096, 'b'), id); } catch(const std::exception&){ refused = true; }
+    CHECK(refused);
+    CHECK(!vfs.tryResolveForOverlay("/big", id));
+    CHECK(vfs.overlayUsage(id).total() == total);
+    vfs.write("/small", "fits", id);
+    CHECK(vfs.tryResolveForOverlay("/small", id));
+    vfs.setOverlayBudget(id, {});
+}
+
+// ============================================================================
+// Blob store
+// ============================================================================
+
+TEST(blob_store_shares_contents) {
+    Vfs vfs;
+    const std::string body = "#pragma once\n" + std::string(8192, 'h');
+    vfs.write("/a/h.h", body);
+    vfs.write("/b/h.h", body);
+    vfs.write("/c/own.h", std::string(8192, 'o'));
+    CHECK(vfs.readShared("/a/h.h", 0) == vfs.readShared("/b/h.h", 0));
+    auto st = vfs.blobs.stats();
+    CHECK(st.blobs == 2);
+    CHECK(st.savedBytes() == body.size());
+
+    // A saved overlay writes the content once and loads it as one buffer
+    auto file = (std::filesystem::temp_directory_path() / ("vfs_core_test_" + std::to_string(::getpid()) + ".vfs")).string();
+    save_overlay_to_file(vfs, 0, file);
+    CHECK(std::filesystem::file_size(file) < 3 * body.size());
+    Vfs loaded;
+    size_t id = mount_overlay_from_file(loaded, "copy", file);
+    auto a = loaded.readShared("/a/h.h", id);
+    CHECK(*a == body);
+    CHECK(a == loaded.readShared("/b/h.h", id));
+    std::filesystem::remove(file);
+}
+
+TEST(blob_store_buffers_never_change) {
+    Vfs vfs;
+    const std::string body(4096, 'x');
+    CHECK(BlobStore::interned(vfs.blobs.intern(std::string_view(body))));
+    CHECK(!BlobStore::interned(std::make_shared<std::string>(body)));
+
+    vfs.write("/a", body);
+    std::weak_ptr<const std::string> stored = vfs.readShared("/a", 0);
+    // /a is the buffer's only holder, and still writes a copy; the store may
+    // be comparing the original on another thread
+    vfs.append("/a", "tail");
+    CHECK(stored.expired());
+    vfs.writeRange("/a", 0, "head");
+    CHECK(vfs.read("/a", 0) == "head" + body.substr(4) + "tail");
+    vfs.write("/b", body);
+    CHECK(vfs.read("/b", 0) == body);
+}
+
+// ============================================================================
+// Locking
+// ============================================================================
+
+TEST(lock_guards_nest) {
+    Vfs vfs;
+    vfs.write("/a", "1");
+    {
+        auto w = vfs.writeLock();
+        auto r = vfs.readLock();  // a write guard covers reads
+        vfs.write("/b", "2");     // and nests
+        CHECK(vfs.read("/a", 0) == "1");
+    }
+    {
+        auto r = vfs.readLock();
+        auto r2 = vfs.readLock();
+        CHECK(vfs.read("/b", 0) == "2");
+    }
+}
+
+TEST(lock_sleepers_wake) {
+    // A writer held past the readers' spin, then readers held past the writer's
+    Vfs vfs;
+    vfs.write("/f", "0");
+    std::atomic<int> done{0};
+    std::vector<std::thread> readers;
+    {
+        auto w = vfs.writeLock();
+        for(int i = 0; i < 4; ++i) readers.emplace_back([&]{
+            if(vfs.read("/f", 0) == "1") ++done;  // only after the write
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK(done.load() == 0);
+        vfs.write("/f", "1");
+    }
+    for(auto& t : readers) t.join();
+    CHECK(done.load() == 4);
+
+    std::atomic<bool> wrote{false};
+    std::thread writer;
+    {
+        auto r = vfs.readLock();
+        writer = std::thread([&]{
+            vfs.write("/f", "2");
+            wrote = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK(!wrote.load());
+    }
+    writer.join();
+    CHECK(vfs.read("/f", 0) == "2");
+}
+
+TEST(lock_readers_and_writer) {
+    Vfs vfs;
+    std::vector<std::string> paths;
+    for(int i = 0; i < 128; ++i){
+        paths.push_back("/c/d" + std::to_string(i % 8) + "/" + test_name(i));
+        vfs.write(paths.back(), paths.back());
+    }
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> errors{0};
+    std::thread writer([&]{
+        for(size_t i = 0; !stop.load(); ++i){
+            const auto& p = paths[i * 31 % paths.size()];
+            try{
+                if(i % 7 == 0) vfs.rm(p, 0);
+                else vfs.write(p, p, 0);
+                if(i % 97 == 0) vfs.snapshotOverlay(0);
+            } catch(const std::exception&){
+                // already removed
+            }
+        }
+    });
+    std::vector<std::thread> pool;
+    for(size_t t = 0; t < 4; ++t){
+        pool.emplace_back([&, t]{
+            for(size_t i = 0; i < 20000; ++i){
+                const auto& p = paths[(i * 13 + t * 101) % paths.size()];
+                try{
+                    if(vfs.read(p, 0) != p) ++errors;
+                } catch(const std::runtime_error&){
+                    // removed by the writer
+                }
+                if(vfs.listDir(p.substr(0, p.rfind('/')), {0}).size() > 16) ++errors;
+                if(auto node = vfs.tryResolveForOverlay(p, 0); node && node->name != p.substr(p.rfind('/') + 1)) ++errors;
+            }
+        });
+    }
+    for(auto& th : pool) th.join();
+    stop = true;
+    writer.join();
+    CHECK(errors.load() == 0);
+}
+
+// ============================================================================
+// Atoms
+// ============================================================================
+
+TEST(atom_pin_released_with_last_pin) {
+    const std::string text = "pinned_" + std::to_string(::getpid()) + "_a";
+    size_t live = Atom::pinned();
+    Atom a = Atom::pin(text);
+    CHECK(a.transient() && a == text);
+    CHECK(Atom::pin(text) == a);
+    CHECK(Atom::pinned() == live + 1);
+    auto found = Atom::lookup(text);
+    CHECK(found && *found == a);
+    Atom::unpin(a);
+    CHECK(Atom::lookup(text));  // still pinned once
+    Atom::unpin(a);
+    CHECK(!Atom::lookup(text));
+    CHECK(Atom::pinned() == live);
+
+    // The next name in the slot does not match the stale id
+    Atom b = Atom::pin(text + "_b");
+    CHECK(b != a);
+    Atom::unpin(b);
+}
+
+TEST(atom_intern_keeps_pinned_id) {
+    const std::string text = "pinned_" + std::to_string(::getpid()) + "_c";
+    Atom a = Atom::pin(text);
+    Atom b(text);
+    CHECK(b == a);
+    Atom::unpin(a);
+    CHECK(Atom::lookup(text) && *Atom::lookup(text) == b);
+    CHECK(b.str() == text);
+    Atom again = Atom::pin(text);
+    CHECK(again == b);
+    Atom::unpin(again);  // a no-op on an interned atom
+    CHECK(Atom::lookup(text));
+}
+
+TEST(mount_listing_does_not_intern) {
+    char tmpl[] = "/tmp/vfs_core_test_XXXXXX";
+    CHECK(::mkdtemp(tmpl));
+    std::string dir = tmpl;
+    std::string unique = "listed_" + std::to_string(::getpid()) + "_";
+    for(int i = 0; i < 50; ++i) std::ofstream(dir + "/" + unique + std::to_string(i)) << i;
+    size_t interned = Atom::count();
+    size_t live = Atom::pinned();
+    {
+        auto mount = std::make_shared<MountNode>("mnt", dir);
+        CHECK(mount->children().size() == 50);
+        CHECK(Atom::pinned() == live + 50);
+        auto it = mount->children().find(unique + "7");
+        CHECK(it != mount->children().end() && it->second->read() == "7");
+    }
+    CHECK(Atom::pinned() == live);
+    CHECK(!Atom::lookup(unique + "7"));
+    CHECK(Atom::count() <= interned + 1);  // at most "mnt"
+    std::filesystem::remove_all(dir);
+}
+
+// ============================================================================
+// Tree walks
+// ============================================================================
+
+TEST(tree_walk_prunes_and_stops) {
+    auto root = std::make_shared<DirNode>("/");
+    for(int a = 0; a < 3; ++a){
+        auto da = std::make_shared<DirNode>("a" + std::to_string(a));
+        root->children()[da->name] = da;
+        for(int b = 0; b < 3; ++b){
+            auto db = std::make_shared<DirNode>("b" + std::to_string(b));
+            da->children()[db->name] = db;
+            for(int c = 0; c < 3; ++c) db->children()["f" + std::to_string(c)] = std::make_shared<FileNode>("f", "x");
+        }
+    }
+    // Only /a0 is entered
+    size_t pruned = 0;
+    TreeWalker().walk(root, "/", [&](const TreeWalker::Item& item){
+        ++pruned;
+        return item.depth == 1 && item.path != "/a0" ? TreeWalker::Action::Skip : TreeWalker::Action::Descend;
+    });
+    CHECK(pruned == 1 + 3 + 3 + 3 * 3);
+    // Stops at the first file, /a0/b0/f0
+    std::vector<std::string> stopped;
+    CHECK(!TreeWalker().walk(root, "/", [&](const TreeWalker::Item& item){
+        stopped.push_back(item.path);
+        return item.node->isDir() ? TreeWalker::Action::Descend : TreeWalker::Action::Stop;
+    }));
+    CHECK((stopped == std::vector<std::string>{"/", "/a0", "/a0/b0", "/a0/b0/f0"}));
+}
+
+TEST(tree_walk_deeper_than_stack) {
+    const size_t depth = 200000;
+    auto chain = std::make_shared<DirNode>("/");
+    auto cur = chain;
+    for(size_t i = 0; i < depth; ++i){
+        auto next = std::make_shared<DirNode>("d");
+        cur->children()[next->name] = next;
+        cur = next;
+    }
+    size_t deepest = 0;
+    TreeWalker::Options no_paths;
+    no_paths.paths = false;
+    TreeWalker(no_paths).walk(chain, std::string(), [&](const TreeWalker::Item& item){
+        deepest = std::max(deepest, item.depth);
+        return TreeWalker::Action::Descend;
+    });
+    CHECK(deepest == depth);
+    // Taken apart top down: dropping the root would recurse as deep
+    for(std::shared_ptr<VfsNode> n = chain; n && !n->children().empty();){
+        auto child = n->children().begin()->second;
+        n->children().clear();
+        n = child;
+    }
+}
+
+// A directory listed like a mount: unstable, and noting the listing threads
+struct ListedDir : DirNode {
+    std::mutex* mtx;
+    std::set<std::thread::id>* threads;
+    ListedDir(std::string n, std::mutex* m, std::set<std::thread::id>* t)
+        : DirNode(std::move(n)), mtx(m), threads(t) {}
+    ChildIndex& children() override {
+        std::lock_guard<std::mutex> lk(*mtx);
+        threads->insert(std::this_thread::get_id());
+        return ch;
+    }
+    bool stableChildren() const override { return false; }
+};
+
+TEST(parallel_walk_lists_mounts_on_caller) {
+    std::mutex mtx;
+    std::set<std::thread::id> threads;
+    auto root = std::make_shared<DirNode>("root");
+    for(int i = 0; i < 8; ++i){
+        auto dir = std::make_shared<DirNode>("d" + std::to_string(i));
+        auto mnt = std::make_shared<ListedDir>("mnt", &mtx, &threads);
+        for(int j = 0; j < 3; ++j){
+            auto sub = std::make_shared<ListedDir>("s" + std::to_string(j), &mtx, &threads);
+            sub->children()[Atom("f")] = std::make_shared<FileNode>("f", "x");
+            mnt->children()[Atom("s" + std::to_string(j))] = sub;
+        }
+        dir->children()[Atom("mnt")] = mnt;
+        root->children()[Atom(dir->name)] = dir;
+    }
+
+    std::vector<std::string> expected;
+    TreeWalker().walk(root, "/", [&](const TreeWalker::Item& item){
+        expected.push_back(item.path);
+        return TreeWalker::Action::Descend;
+    });
+    CHECK(expected.size() == 1 + 8 * (1 + 1 + 3 * 2));
+
+    threads.clear();
+    WorkerPool pool(4);
+    ParallelWalk walk(root, "/", TreeWalker::Options(), pool);
+    CHECK(walk.lanes() > 1);
+    std::vector<std::vector<std::string>> lanes(walk.lanes());
+    CHECK(walk.run([&](const TreeWalker::Item& item){
+        lanes[item.lane].push_back(item.path);
+        return TreeWalker::Action::Descend;
+    }));
+    std::vector<std::string> got;
+    for(auto& lane : lanes) got.insert(got.end(), lane.begin(), lane.end());
+    CHECK(got == expected);
+    CHECK((threads == std::set<std::thread::id>{std::this_thread::get_id()}));
+}
+
+// ============================================================================
+// Tags
+// ============================================================================
+
+// Paths in every overlay whose node carries the tag, by walking them all
+static std::vector<std::string> tagged_by_walk(Vfs& vfs, const std::string& tag){
+    auto guard = vfs.readLock();
+    TagId id = vfs.getTagId(tag);
+    std::vector<std::string> out;
+    TreeWalker::Options opts;
+    opts.mounts = false;
+    for(size_t overlay = 0; overlay < vfs.overlayCount(); ++overlay){
+        TreeWalker(opts).walk(vfs.overlayRoot(overlay), "/", [&](const TreeWalker::Item& item){
+            if(vfs.tag_storage.hasTag(item.node.get(), id)) out.push_back(item.path);
+            return TreeWalker::Action::Descend;
+        });
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+TEST(tag_index_follows_mutations) {
+    Vfs vfs;
+    auto path = [](size_t i){ return "/src/m" + std::to_string(i % 4) + "/d" + std::to_string(i % 13) + "/f" + std::to_string(i); };
+    for(size_t i = 0; i < 400; ++i) vfs.write(path(i), "x");
+    for(size_t i = 0; i < 400; i += 10) vfs.addTag(path(i), "hot");
+    CHECK(vfs.findNodesByTag("hot").size() == 40);
+    CHECK(vfs.findNodesByTag("hot") == tagged_by_walk(vfs, "hot"));
+
+    std::mt19937 rng(11);
+    auto dir = [&]{ return "/src/m" + std::to_string(rng() % 4) + "/d" + std::to_string(rng() % 13); };
+    std::shared_ptr<DirNode> snap = vfs.snapshotOverlay(0);
+    for(size_t i = 0; i < 300; ++i){
+        try{
+            switch(rng() % 8){
+            case 0: vfs.mv(dir(), "/moved/x" + std::to_string(i), 0); break;
+            case 1: vfs.rm(rng() % 4 ? dir() : "/moved", 0); break;
+            case 2: vfs.link(dir(), "/linked/l" + std::to_string(i % 10), 0); break;
+            case 3: {
+                // Writes next to tagged files copy their snapshot-shared directory
+                std::string d = dir();
+                for(const auto& kv : vfs.listDir(d, {0})){
+                    vfs.write(d + "/" + kv.first, "changed", 0);
+                    break;
+                }
+                break;
+            }
+            case 4:
+                if(rng() % 2) vfs.restoreOverlay(0, snap);
+                else snap = vfs.snapshotOverlay(0);
+                break;
+            case 5: {
+                auto tx = vfs.transaction(0);
+                tx.rm(dir());
+                tx.rm("/no/such/path");  // rolls the removal back
+                tx.commit();
+                break;
+            }
+            case 6: {
+                auto extra = std::make_shared<DirNode>("/");
+                extra->children()["copy"] = vfs.resolveForOverlay(dir(), 0);
+                size_t id = vfs.registerOverlay("extra" + std::to_string(i), extra);
+                if(rng() % 2) vfs.unregisterOverlay(id);
+                break;
+            }
+            case 7:
+                if(vfs.overlayCount() > 1) vfs.unregisterOverlay(1 + rng() % (vfs.overlayCount() - 1));
+                break;
+            }
+        } catch(const std::exception&){
+            // moves and removals of paths already gone
+        }
+        CHECK(vfs.findNodesByTag("hot") == tagged_by_walk(vfs, "hot"));
+    }
+}
+
+TEST(tags_not_inherited_by_new_nodes) {
+    Vfs vfs;
+    // New nodes often land where a freed one was; none may pick up its tags
+    for(int i = 0; i < 100; ++i){
+        vfs.write("/t/f", "x");
+        vfs.addTag("/t/f", "hot");
+        vfs.rm("/t/f");
+        vfs.write("/t/f", "y");
+        CHECK(!vfs.nodeHasTag("/t/f", "hot"));
+        CHECK(vfs.getNodeTags("/t/f").empty());
+        CHECK(vfs.findNodesByTag("hot").empty());
+        vfs.rm("/t/f");
+    }
+}
+
+// ============================================================================
+// Glob find
+// ============================================================================
+
+TEST(glob_matcher_cases) {
+    struct Case { const char* pattern; const char* text; bool hit; };
+    const Case cases[] = {
+        {"*.cpp", "main.cpp", true}, {"*.cpp", "main.cpp.orig", false}, {"*.cpp", "src/main.cpp", false},
+        {"main.*", "main.h", true}, {"*ai*", "ai_bridge.h", true}, {"Makefile", "Makefile", true},
+        {"?at", "cat", true}, {"?at", "at", false}, {"[ch]at", "hat", true}, {"[!ch]at", "hat", false},
+        {"[a-c]*.[ch]", "build.c", true}, {"[a-c]*.[ch]", "dbuild.c", false}, {"*_test.c*", "a_test.cpp", true},
+        {"a*b*c", "aXbYbZc", true}, {"a*b*c", "aXbYbZ", false}, {"**/*.h", "vfs.h", true},
+        {"**/*.h", "src/sub/vfs.h", true}, {"src/**/x", "src/x", true}, {"src/**/x", "src/a/b/x", true},
+        {"src/**", "src/a/b", true}, {"src/*", "src/a/b", false}, {"\\*", "*", true}, {"\\*", "a", false},
+        {"[", "[", true}, {"a[]]b", "a]b", true},
+    };
+    for(const auto& c : cases){
+        if(GlobMatcher(c.pattern).matches(c.text) != c.hit)
+            throw std::runtime_error(std::string("glob ") + c.pattern + " on " + c.text);
+    }
+}
+
+TEST(find_matches_walk) {
+    Vfs vfs;
+    const char* exts[] = {".cpp", ".h", ".txt", ".cc", ".md"};
+    for(int i = 0; i < 500; ++i)
+        vfs.write("/co/m" + std::to_string(i % 4) + "/d" + std::to_string(i % 37) + "/" + test_name(i) + exts[i % 5], "");
+    std::vector<std::shared_ptr<VfsNode>> expected;
+    TreeWalker().walk(vfs.resolve("/co"), "/co", [&](const TreeWalker::Item& item){
+        const std::string& name = item.node->name;
+        if(item.depth > 0 && name.size() > 4 && name.compare(name.size() - 4, 4, ".cpp") == 0) expected.push_back(item.node);
+        return TreeWalker::Action::Descend;
+    });
+    CHECK(expected.size() == 100);
+    VfsVisitor visitor(&vfs);
+    visitor.find("/co", "*.cpp");
+    CHECK(visitor.results == expected);  // in walk order
+    visitor.find("/co", "m1/**/*.h");
+    CHECK(visitor.count() == 25);
+}
+
+TEST(find_in_host_mount) {
+    char tmpl[] = "/tmp/vfs_core_test_XXXXXX";
+    CHECK(::mkdtemp(tmpl));
+    std::filesystem::path host = tmpl;
+    for(int i = 0; i < 60; ++i){
+        auto d = host / ("d" + std::to_string(i % 5));
+        std::filesystem::create_directories(d);
+        std::ofstream(d / (test_name(i) + (i % 3 ? ".cpp" : ".h")));
+    }
+    Vfs vfs;
+    vfs.mountFilesystem(host.string(), "/host");
+    VfsVisitor visitor(&vfs);
+    visitor.find("/host", "*.cpp");
+    CHECK(visitor.count() == 40);
+    vfs.unmount("/host");
+    std::filesystem::remove_all(host);
+}
+
+// ============================================================================
+// Host mounts
+// ============================================================================
+
+TEST(mount_cache_sees_host_changes) {
+    namespace fs = std::filesystem;
+    char tmpl[] = "/tmp/vfs_core_test_XXXXXX";
+    CHECK(::mkdtemp(tmpl));
+    fs::path host = tmpl;
+    for(int i = 0; i < 40; ++i){
+        auto d = host / ("d" + std::to_string(i % 4)) / ("s" + std::to_string(i % 3));
+        fs::create_directories(d);
+        std::ofstream(d / (test_name(i) + ".cpp")) << "x";
+    }
+    auto walk = [](Vfs& vfs){
+        size_t n = 0, bytes = 0;
+        auto guard = vfs.readLock();
+        TreeWalker(TreeWalker::Options()).walk(vfs.resolve("/host"), "/host", [&](const TreeWalker::Item& item){
+            ++n;
+            if(!item.node->isDir()) bytes += item.node->size();
+            return TreeWalker::Action::Descend;
+        });
+        return n + bytes;
+    };
+    Vfs vfs;
+    vfs.mountFilesystem(host.string(), "/host");
+    size_t first = walk(vfs);
+    CHECK(first == 1 + 4 + 4 * 3 + 2 * 40);
+    CHECK(walk(vfs) == first);
+
+    // Host changes show up on the next access; unchanged nodes stay the same
+    auto before = vfs.resolve("/host/d0/s0");
+    vfs.addTag("/host/d0/s0", "watched");
+    std::ofstream(host / "d0" / "s0" / "new.txt") << "hello";
+    CHECK(vfs.read("/host/d0/s0/new.txt") == "hello");
+    CHECK(vfs.resolve("/host/d0/s0") == before);
+    std::ofstream(host / "d0" / "s0" / "new.txt", std::ios::app) << " world";
+    CHECK(vfs.size("/host/d0/s0/new.txt") == 11);
+    fs::remove(host / "d0" / "s0" / "new.txt");
+    CHECK(!vfs.tryResolveForOverlay("/host/d0/s0/new.txt", 0));
+    fs::create_directories(host / "d0" / "fresh");
+    std::ofstream(host / "d0" / "fresh" / "a.h") << "a";
+    CHECK(vfs.read("/host/d0/fresh/a.h") == "a");
+    fs::remove_all(host / "d0" / "fresh");
+    CHECK(vfs.nodeHasTag("/host/d0/s0", "watched"));
+    CHECK(walk(vfs) == first);
+    vfs.unmount("/host");
+    fs::remove_all(host);
+}
+
+TEST(mount_listing_survives_relist) {
+    namespace fs = std::filesystem;
+    char tmpl[] = "/tmp/vfs_core_test_XXXXXX";
+    CHECK(::mkdtemp(tmpl));
+    fs::path host = tmpl;
+    for(int i = 0; i < 10; ++i) std::ofstream(host / test_name(i)) << i;
+    auto mount = std::make_shared<MountNode>("mnt", host.string());
+    auto held = mount->listing();
+    ChildIndex& handed = mount->children();
+    CHECK(held->size() == 10 && handed.size() == 10);
+
+    // Listed again on the next access, into a new index; the old ones stay
+    std::ofstream(host / "new") << "n";
+    CHECK(mount->listing()->size() == 11);
+    CHECK(mount->children().size() == 11);
+    CHECK(held->size() == 10 && handed.size() == 10);
+    CHECK(held->find(test_name(3))->second == mount->listing()->find(test_name(3))->second);
+
+    // Readers holding listings while the host keeps changing them
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> errors{0}, reads{0};
+    std::vector<std::thread> readers;
+    for(int t = 0; t < 4; ++t){
+        readers.emplace_back([&]{
+            while(!stop){
+                auto listing = mount->listing();
+                size_t n = 0;
+                for(const auto& kv : *listing){
+                    if(!kv.second || kv.second->name != kv.first) ++errors;
+                    ++n;
+                }
+                if(n != listing->size()) ++errors;
+                ++reads;
+            }
+        });
+    }
+    for(int i = 0; i < 200; ++i){
+        if(i % 2) fs::remove(host / "churn");
+        else std::ofstream(host / "churn") << i;
+        mount->listing();
+    }
+    stop = true;
+    for(auto& t : readers) t.join();
+    CHECK(errors == 0);
+    CHECK(reads > 0);
+    fs::remove_all(host);
+}
+
+TEST(mount_prefetch_counts) {
+    namespace fs = std::filesystem;
+    char tmpl[] = "/tmp/vfs_core_test_XXXXXX";
+    CHECK(::mkdtemp(tmpl));
+    fs::path host = tmpl;
+    for(int i = 0; i < 60; ++i){
+        auto d = host / ("d" + std::to_string(i % 4)) / ("s" + std::to_string(i % 3));
+        fs::create_directories(d);
+        std::ofstream(d / (test_name(i) + ".h")) << "#pragma once\n";
+    }
+    Vfs vfs;
+    vfs.mountFilesystem(host.string(), "/host");
+    vfs.prefetchMount("/host");
+    auto prefetch = vfs.listMounts().front().prefetch;
+    prefetch->wait();
+    auto p = prefetch->progress();
+    CHECK(p.done && p.errors == 0);
+    CHECK(p.dirs == 1 + 4 + 4 * 3);
+    CHECK(p.files == 60);
+
+    // Depth limits the walk; unmounting stops a running one
+    Vfs shallow;
+    shallow.mountFilesystem(host.string(), "/host");
+    shallow.prefetchMount("/host", 2);
+    auto limited = shallow.listMounts().front().prefetch;
+    limited->wait();
+    CHECK(limited->progress().dirs == 1 + 4);
+    CHECK(limited->progress().files == 0);
+    shallow.prefetchMount("/host");
+    shallow.unmount("/host");
+    CHECK(shallow.listMounts().empty());
+    vfs.unmount("/host");
+    fs::remove_all(host);
+}
+
+TEST(mount_reads_agree) {
+    namespace fs = std::filesystem;
+    char tmpl[] = "/tmp/vfs_core_test_XXXXXX";
+    CHECK(::mkdtemp(tmpl));
+    fs::path host = tmpl;
+    std::string log;
+    for(size_t i = 0; log.size() < 4 * MountNode::MMAP_MIN; ++i) log += "[" + std::to_string(i) + "] compiling\n";
+    std::ofstream(host / "build.log", std::ios::binary) << log;
+    std::ofstream(host / "small.h") << std::string(1000, 's');
+    Vfs vfs;
+    vfs.mountFilesystem(host.string(), "/host");
+    CHECK(vfs.read("/host/build.log") == log);
+    CHECK(vfs.readView("/host/build.log").data == log);  // mapped
+    CHECK(*vfs.readShared("/host/build.log") == log);
+    CHECK(vfs.readRange("/host/build.log", 1000, 64) == log.substr(1000, 64));
+    CHECK(vfs.readRange("/host/build.log", log.size() - 10, 64) == log.substr(log.size() - 10));
+    CHECK(vfs.readView("/host/small.h").data == std::string(1000, 's'));
+
+    // A view outlives its node and the mount
+    ContentView view = vfs.readView("/host/build.log");
+    vfs.unmount("/host");
+    CHECK(view.data == log);
+    view = ContentView();
+    fs::remove_all(host);
+}
+
+TEST(context_survives_host_truncation) {
+    namespace fs = std::filesystem;
+    char tmpl[] = "/tmp/vfs_core_test_XXXXXX";
+    CHECK(::mkdtemp(tmpl));
+    fs::path host = tmpl;
+    const std::string big(4 * MountNode::MMAP_MIN, 'b');
+    std::ofstream(host / "big.log", std::ios::binary) << big;
+    Vfs vfs;
+    vfs.mountFilesystem(host.string(), "/host");
+    ContextBuilder builder(vfs, vfs.tag_storage, vfs.tag_registry);
+    builder.collectFromPath("/host");
+    // Truncated under the collected entry, which must not be a mapping of it
+    std::ofstream(host / "big.log", std::ios::binary | std::ios::trunc);
+    CHECK(fs::file_size(host / "big.log") == 0);
+    bool found = false;
+    for(const auto& entry : builder.entries){
+        if(entry.vfs_path != "/host/big.log") continue;
+        found = true;
+        CHECK(entry.content() == big);
+    }
+    CHECK(found);
+    vfs.unmount("/host");
+    fs::remove_all(host);
+}
+
+// ============================================================================
+// Host I/O
+// ============================================================================
+
+namespace {
+// A leaf that is not a plain file, read as generated text
+struct GeneratedLeaf : VfsNode {
+    std::string text;
+    GeneratedLeaf(std::string n, std::string t) : VfsNode(std::move(n), Kind::Ast), text(std::move(t)) {}
+    std::string read() const override {
+        if(text.empty()) throw std::runtime_error("not generated");
+        return text;
+    }
+};
+
+std::string read_host(const std::filesystem::path& p){
+    std::ifstream in(p, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), {});
+}
+}
+
+TEST(export_tree_writes_every_leaf) {
+    namespace fs = std::filesystem;
+    char tmpl[] = "/tmp/vfs_core_test_XXXXXX";
+    CHECK(::mkdtemp(tmpl));
+    fs::path host = tmpl;
+    Vfs vfs;
+    for(size_t i = 0; i < 300; ++i)
+        vfs.write("/pkg/p" + std::to_string(i % 7) + "/" + test_name(i) + ".cpp", "int f" + std::to_string(i) + "();\n");
+    vfs.addNode("/pkg", std::make_shared<GeneratedLeaf>("gen.h", "#pragma once\n"));
+    auto tree = vfs.resolve("/pkg");
+    for(auto backend : {HostIoBatch::Backend::Uring, HostIoBatch::Backend::Threads}){
+        fs::path dir = host / HostIoBatch::backendName(backend);
+        auto result = export_tree(vfs, tree, dir.string(), backend);
+        CHECK(result.files == 301);
+        if(backend == HostIoBatch::Backend::Threads) CHECK(result.backend == HostIoBatch::Backend::Threads);
+        for(size_t i = 0; i < 300; i += 13){
+            std::string rel = "p" + std::to_string(i % 7) + "/" + test_name(i) + ".cpp";
+            CHECK(read_host(dir / rel) == vfs.read("/pkg/" + rel));
+        }
+        CHECK(read_host(dir / "gen.h") == "#pragma once\n");
+    }
+
+    // An unreadable leaf is named once the rest were written
+    vfs.addNode("/pkg", std::make_shared<GeneratedLeaf>("broken.h", ""));
+    bool threw = false;
+    try {
+        export_tree(vfs, tree, (host / "partial").string());
+    } catch(const std::exception& e){
+        threw = std::string(e.what()).find("partial/broken.h") != std::string::npos;
+    }
+    CHECK(threw);
+    CHECK(read_host(host / "partial" / "gen.h") == "#pragma once\n");
+    CHECK(!fs::exists(host / "partial" / "broken.h"));
+    fs::remove_all(host);
+}
+
+TEST(host_io_batch_names_failed_path) {
+    namespace fs = std::filesystem;
+    char tmpl[] = "/tmp/vfs_core_test_XXXXXX";
+    CHECK(::mkdtemp(tmpl));
+    fs::path host = tmpl;
+    std::ofstream(host / "present.txt") << "present";
+    for(auto backend : {HostIoBatch::Backend::Uring, HostIoBatch::Backend::Threads}){
+        HostIoBatch batch(backend);
+        std::string got;
+        batch.write((host / "missing" / "dir" / "x").string(), std::string_view("x"));
+        batch.read((host / "present.txt").string(), &got);
+        bool threw = false;
+        try {
+            batch.run();
+        } catch(const std::exception& e){
+            threw = std::string(e.what()).find("missing/dir/x") != std::string::npos;
+        }
+        CHECK(threw);
+        CHECK(got == "present");  // the other operations still ran
+        CHECK(batch.size() == 0);
+    }
+    fs::remove_all(host);
+}
+
+// ============================================================================
+// Remote mounts
+// ============================================================================
+
+namespace {
+// The daemon's server behind an ephemeral localhost port
+struct TestRemoteServer {
+    int listen_fd = -1;
+    int port = 0;
+    std::unique_ptr<RemoteServer> server;
+    std::thread loop;
+
+    explicit TestRemoteServer(size_t workers = 0, size_t max_running = 0){
+        listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        ::bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+        ::listen(listen_fd, SOMAXCONN);
+        ::getsockname(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), &len);
+        port = ntohs(addr.sin_port);
+        server = std::make_unique<RemoteServer>(listen_fd, workers, max_running);
+        loop = std::thread([this]{ server->run(); });
+    }
+    ~TestRemoteServer(){
+        server->stop();
+        loop.join();
+        server.reset();
+        ::close(listen_fd);
+    }
+};
+
+// A fresh host directory, removed with the object
+struct TestHostDir {
+    std::filesystem::path path;
+    TestHostDir(){
+        char tmpl[] = "/tmp/vfs_core_test_XXXXXX";
+        if(!::mkdtemp(tmpl)) throw std::runtime_error("mkdtemp failed");
+        path = tmpl;
+    }
+    ~TestHostDir(){
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+    std::string operator/(const std::string& rel) const { return (path / rel).string(); }
+};
+}
+
+TEST(remote_cat_contents_and_errors) {
+    TestHostDir host;
+    auto content = [](size_t i){
+        return "// file " + std::to_string(i) + "\nint f" + std::to_string(i) + "();\n\tstruct S { char c = '\\0'; };\n";
+    };
+    for(size_t i = 0; i < 50; ++i) std::ofstream(host / (test_name(i) + ".h"), std::ios::binary) << content(i);
+    // One byte of each value, including the NULs and newlines EXEC lost
+    std::string binary;
+    for(int c = 0; c < 256; ++c) binary += static_cast<char>(c);
+    std::ofstream(host / "blob.bin", std::ios::binary) << binary;
+    // More lines than one recv() brings in
+    std::string big;
+    for(size_t i = 0; big.size() < (1 << 20); ++i) big += "line " + std::to_string(i) + "\n";
+    std::ofstream(host / "big.txt", std::ios::binary) << big;
+
+    TestRemoteServer server;
+    RemoteSession legacy("127.0.0.1", server.port, false);
+    RemoteSession session("127.0.0.1", server.port);
+    CHECK(legacy.exec("cat " + (host / (test_name(3) + ".h"))) == content(3));
+    CHECK(session.binary());
+    CHECK(!legacy.binary());
+
+    Vfs vfs;
+    vfs.mountRemote("127.0.0.1", server.port, host.path.string(), "/remote");
+    for(size_t i = 0; i < 50; ++i) CHECK(vfs.read("/remote/" + test_name(i) + ".h") == content(i));
+    std::vector<std::future<RemoteSession::Reply>> replies;
+    for(size_t i = 0; i < 50; ++i)
+        replies.push_back(std::static_pointer_cast<RemoteNode>(vfs.resolve("/remote/" + test_name(i) + ".h"))->readAsync());
+    for(size_t i = 0; i < 50; ++i) CHECK(RemoteSession::replyData(std::move(replies[i])) == content(i));
+
+    // Binary-safe payloads, typed stats and listings, errors per request
+    CHECK(vfs.read("/remote/blob.bin") == binary);
+    CHECK(vfs.size("/remote/blob.bin") == 256);
+    CHECK(vfs.read("/remote/big.txt") == big);
+    vfs.resolve("/remote/blob.bin")->write(binary + binary);
+    CHECK(session.read(host / "blob.bin") == binary + binary);
+    CHECK(vfs.resolve("/remote")->children().size() == 52);
+    CHECK(!vfs.resolve("/remote/blob.bin")->isDir());
+    CHECK(session.stat(host / "nope").type == RemoteEntry::Type::Missing);
+    auto missing = session.request(RemoteSession::Op::Read, host / "nope");
+    auto after = session.request(RemoteSession::Op::Read, host / (test_name(0) + ".h"));
+    bool threw = false;
+    try {
+        RemoteSession::replyData(std::move(missing));
+    } catch(const std::runtime_error&){
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(RemoteSession::replyData(std::move(after)) == content(0));
+    vfs.unmount("/remote");
+}
+
+TEST(remote_requests_settle_when_server_hangs_up) {
+    TestHostDir host;
+    std::ofstream(host / "a.txt") << "a";
+    TestRemoteServer server;
+    RemoteSession session("127.0.0.1", server.port);
+    // Requests racing the reader's exit either fail or are answered, none waits
+    // for a reply that cannot come
+    size_t answered = 0, failed = 0;
+    for(int round = 0; round < 200; ++round){
+        std::vector<std::future<RemoteSession::Reply>> replies;
+        std::thread hangup([&]{ server.server->disconnectAll(); });
+        for(int i = 0; i < 8; ++i){
+            try {
+                replies.push_back(session.request(RemoteSession::Op::Read, host / "a.txt"));
+            } catch(const std::runtime_error&){
+                ++failed;
+            }
+        }
+        hangup.join();
+        for(auto& r : replies){
+            CHECK(r.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+            try {
+                answered += RemoteSession::replyData(std::move(r)) == "a";
+            } catch(const std::runtime_error&){
+                ++failed;
+            }
+        }
+    }
+    CHECK(answered + failed == 200 * 8);
+    CHECK(session.read(host / "a.txt") == "a");  // and the session reconnects
+}
+
+TEST(remote_listing_carries_metadata) {
+    TestHostDir host;
+    size_t dirs = 0, bytes = 0;
+    for(size_t i = 0; i < 200; ++i){
+        if(i % 10 == 0){
+            std::filesystem::create_directories(host / test_name(i));
+            ++dirs;
+        } else {
+            std::ofstream(host / (test_name(i) + ".h")) << std::string(i % 100, 'x');
+            bytes += i % 100;
+        }
+    }
+    std::filesystem::create_directories(host.path / "small" / "sub");
+    std::ofstream(host.path / "small" / "a file.txt") << "hello";
+    ++dirs;
+    TestRemoteServer server;
+
+    // Types and sizes come with the listing, and agree with a STAT of each
+    Vfs vfs;
+    vfs.mountRemote("127.0.0.1", server.port, host.path.string(), "/remote");
+    RemoteSession session("127.0.0.1", server.port);
+    size_t listed_dirs = 0, listed_bytes = 0;
+    for(auto& kv : vfs.resolve("/remote")->children()){
+        auto st = session.stat(host / kv.first.str());
+        CHECK(kv.second->isDir() == (st.type == RemoteEntry::Type::Dir));
+        if(kv.second->isDir()) ++listed_dirs;
+        else {
+            CHECK(kv.second->size() == st.size);
+            listed_bytes += kv.second->size();
+        }
+    }
+    CHECK(listed_dirs == dirs);
+    CHECK(listed_bytes == bytes);
+
+    // Metadata came with the listing; a write updates it
+    auto node = std::static_pointer_cast<RemoteNode>(vfs.resolve("/remote/small/a file.txt"));
+    auto meta = node->metadata();
+    struct stat st;
+    CHECK(::stat((host / "small/a file.txt").c_str(), &st) == 0);
+    CHECK(meta.type == RemoteEntry::Type::File);
+    CHECK(meta.size == 5);
+    CHECK(meta.mtime_ns == int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+    node->write("hello world");
+    CHECK(node->size() == 11);
+    CHECK(vfs.read("/remote/small/a file.txt") == "hello world");
+    vfs.unmount("/remote");
+
+    // The EXEC fallback lists with find in one call as well
+    RemoteSession legacy("127.0.0.1", server.port, false);
+    CHECK(legacy.exec("test -d " + (host / "small/sub") + " && echo yes || echo no") == "yes\n");
+    auto dir = std::make_shared<RemoteNode>("small", std::make_shared<RemoteSession>("127.0.0.1", server.port, false),
+                                            host / "small", RemoteEntry{"small", RemoteEntry::Type::Dir});
+    auto& ch = dir->children();
+    CHECK(ch.size() == 2);
+    CHECK(ch.find("sub") != ch.end());
+    CHECK(ch.find("sub")->second->kind == VfsNode::Kind::Dir);
+    CHECK(ch.find("a file.txt") != ch.end());
+    CHECK(ch.find("a file.txt")->second->size() == 11);
+}
+
+namespace {
+// Polls until seen() holds; false after five seconds
+bool eventually(const std::function<bool()>& seen){
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(!seen()){
+        if(std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    return true;
+}
+}
+
+TEST(remote_leases_follow_server_changes) {
+    TestHostDir host;
+    for(size_t i = 0; i < 20; ++i) std::ofstream(host / (test_name(i) + ".h")) << "v0 " << i << "\n";
+    TestRemoteServer server;
+    Vfs vfs;
+    vfs.mountRemote("127.0.0.1", server.port, host.path.string(), "/remote");
+    auto session = std::static_pointer_cast<RemoteNode>(vfs.resolve("/remote"))->session;
+    session->setLeaseTtl(std::chrono::seconds(30));
+    for(size_t i = 0; i < 20; ++i) CHECK(vfs.read("/remote/" + test_name(i) + ".h") == "v0 " + std::to_string(i) + "\n");
+    auto before = session->cacheStats();
+    for(size_t i = 0; i < 20; ++i) vfs.read("/remote/" + test_name(i) + ".h");
+    CHECK(session->cacheStats().hits >= before.hits + 20);
+
+    // Changes on the server reach the cache without waiting out the TTL
+    std::string first = "/remote/" + test_name(0) + ".h";
+    std::ofstream(host / (test_name(0) + ".h")) << "v1\n";
+    CHECK(eventually([&]{ return vfs.read(first) == "v1\n"; }));
+    // ...including writes made through another client
+    RemoteSession other("127.0.0.1", server.port);
+    other.write(host / (test_name(1) + ".h"), "v2\n");
+    CHECK(eventually([&]{ return vfs.read("/remote/" + test_name(1) + ".h") == "v2\n"; }));
+    // Listings too; nodes that stayed keep their identity and tags
+    std::string third = "/remote/" + test_name(2) + ".h";
+    auto kept = vfs.resolve(third);
+    vfs.addTag(third, "hot");
+    std::ofstream(host / "new.txt") << "new";
+    CHECK(eventually([&]{ return vfs.resolve("/remote")->children().size() == 21; }));
+    CHECK(vfs.read("/remote/new.txt") == "new");
+    CHECK(vfs.size(first) == 3);
+    CHECK(vfs.resolve(third) == kept);
+    CHECK(vfs.nodeHasTag(third, "hot"));
+
+    // A path that did not exist is asked for again once it does
+    std::string later = host / "later.txt";
+    CHECK(session->stat(later).type == RemoteEntry::Type::Missing);
+    std::ofstream(later) << "here";
+    auto found = session->stat(later);
+    CHECK(found.type == RemoteEntry::Type::File);
+    CHECK(found.size == 4);
+
+    // Without notices the TTL still bounds how long a reply is reused
+    session->setLeaseTtl(std::chrono::milliseconds(20));
+    vfs.read(first);
+    before = session->cacheStats();
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    vfs.read(first);
+    CHECK(session->cacheStats().misses > before.misses);
+    vfs.unmount("/remote");
+}
+
+TEST(remote_pool_shared_by_mounts) {
+    TestHostDir host;
+    std::vector<std::string> paths;
+    for(size_t d = 0; d < 4; ++d){
+        std::filesystem::create_directories(host / ("d" + std::to_string(d)));
+        for(size_t i = 0; i < 16; ++i){
+            paths.push_back(host / ("d" + std::to_string(d) + "/" + test_name(i) + ".h"));
+            std::ofstream(paths.back()) << paths.back();
+        }
+    }
+    TestRemoteServer server;
+    Vfs vfs;
+    for(size_t d = 0; d < 4; ++d)
+        vfs.mountRemote("127.0.0.1", server.port, host / ("d" + std::to_string(d)), "/r" + std::to_string(d));
+    auto session = std::static_pointer_cast<RemoteNode>(vfs.resolve("/r0"))->session;
+    for(size_t d = 1; d < 4; ++d)
+        CHECK(std::static_pointer_cast<RemoteNode>(vfs.resolve("/r" + std::to_string(d)))->session == session);
+
+    // Threads share the pool's connections, each reply reaching its caller
+    session->setLeaseTtl(std::chrono::milliseconds(0));
+    std::atomic<size_t> wrong{0};
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < 8; ++t)
+        threads.emplace_back([&, t]{
+            for(size_t k = 0; k < paths.size(); ++k){
+                size_t i = (k + t * 16) % paths.size();
+                if(session->read(paths[i]) != paths[i]) ++wrong;
+            }
+        });
+    for(auto& t : threads) t.join();
+    CHECK(wrong == 0);
+    auto pool = session->poolStats();
+    CHECK(pool.open >= 1);
+    CHECK(pool.open <= RemoteSession::DEFAULT_POOL);
+
+    // The server going away closes the pool; the next request opens it again
+    session->setLeaseTtl(std::chrono::seconds(10));
+    server.server->disconnectAll();
+    CHECK(eventually([&]{ return session->poolStats().open == 0; }));
+    CHECK(vfs.read("/r1/" + test_name(1) + ".h") == paths[16 + 1]);
+    CHECK(session->poolStats().reconnects > 0);
+
+    // Idle connections are pinged before use, and kept while they answer
+    session->setIdleCheck(std::chrono::milliseconds(5));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto before = session->poolStats();
+    CHECK(vfs.resolve("/r2")->children().size() == 16);
+    pool = session->poolStats();
+    CHECK(pool.failed_checks == 0);
+    CHECK(pool.reconnects == before.reconnects);
+    for(size_t d = 0; d < 4; ++d) vfs.unmount("/r" + std::to_string(d));
+}
+
+TEST(remote_idle_check_redials_stalled_server) {
+    // Takes the handshake, then never answers
+    int stalled = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    ::bind(stalled, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    ::listen(stalled, 4);
+    ::getsockname(stalled, reinterpret_cast<struct sockaddr*>(&addr), &len);
+    std::vector<int> accepted;
+    std::thread mute([&]{
+        for(int fd; (fd = ::accept(stalled, nullptr, nullptr)) >= 0;){
+            accepted.push_back(fd);
+            char c;
+            while(::recv(fd, &c, 1, 0) == 1 && c != '\n'){}
+            ::send(fd, "OK VFSB/1\n", 10, MSG_NOSIGNAL);
+        }
+    });
+    RemoteSession::PoolStats stats;
+    bool binary = false;
+    {
+        RemoteSession session("127.0.0.1", ntohs(addr.sin_port));
+        session.setIdleCheck(std::chrono::milliseconds(5));
+        binary = session.binary();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        auto unanswered = session.request(RemoteSession::Op::Stat, "/");
+        stats = session.poolStats();
+    }
+    ::shutdown(stalled, SHUT_RDWR);
+    ::close(stalled);
+    mute.join();
+    for(int fd : accepted) ::close(fd);
+    CHECK(binary);
+    CHECK(stats.failed_checks == 1);
+    CHECK(stats.reconnects == 1);
+    CHECK(stats.open == 1);
+}
+
+namespace {
+// A bare client socket, to send the daemon what RemoteSession would not
+int raw_client(int port){
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    return fd;
+}
+
+std::string raw_line(int fd){
+    std::string out;
+    char c;
+    while(::recv(fd, &c, 1, 0) == 1 && c != '\n') out += c;
+    return out;
+}
+
+// The payload of the next reply, or "ERR"
+std::string raw_reply(int fd){
+    std::string head(9, '\0');
+    ::recv(fd, head.data(), head.size(), MSG_WAITALL);
+    uint32_t len;
+    std::memcpy(&len, head.data(), 4);
+    std::string payload(ntohl(len), '\0');
+    if(!payload.empty()) ::recv(fd, payload.data(), payload.size(), MSG_WAITALL);
+    return static_cast<uint8_t>(head[8]) == 0 ? payload : std::string("ERR");
+}
+
+std::string raw_u32(uint32_t v){
+    v = htonl(v);
+    return std::string(reinterpret_cast<const char*>(&v), 4);
+}
+
+std::string raw_read_request(uint32_t id, const std::string& path){
+    return raw_u32(static_cast<uint32_t>(4 + path.size())) + raw_u32(id) +
+           static_cast<char>(RemoteSession::Op::Read) + raw_u32(static_cast<uint32_t>(path.size())) + path;
+}
+
+// Whether the server hung up, reading whatever it still sent
+bool raw_closed(int fd){
+    struct timeval tv{5, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char buf[4096];
+    for(ssize_t n; (n = ::recv(fd, buf, sizeof(buf), 0)) != 0;)
+        if(n < 0) return errno == ECONNRESET;
+    return true;
+}
+}
+
+TEST(remote_replies_are_bounded) {
+    TestHostDir host;
+    std::string path = host / "a.h";
+    std::ofstream(path) << path;
+    // Sparse, so it costs no disk
+    std::ofstream(host / "huge.bin").close();
+    std::filesystem::resize_file(host / "huge.bin", RemoteSession::MAX_REPLY + 1);
+    TestRemoteServer server;
+    RemoteSession session("127.0.0.1", server.port);
+    bool threw = false;
+    try {
+        session.read(host / "huge.bin");
+    } catch(const std::runtime_error& e){
+        threw = std::string(e.what()).find("huge.bin") != std::string::npos;
+    }
+    CHECK(threw);
+    CHECK(session.read(path) == path);
+    CHECK(session.poolStats().reconnects == 0);
+
+    // A server announcing a longer reply loses the connection, and the
+    // request fails instead of the client allocating it
+    int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    ::bind(listener, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    ::listen(listener, 4);
+    ::getsockname(listener, reinterpret_cast<struct sockaddr*>(&addr), &len);
+    std::thread liar([&]{
+        int fd = ::accept(listener, nullptr, nullptr);
+        raw_line(fd);
+        ::send(fd, "OK VFSB/1\n", 10, MSG_NOSIGNAL);
+        std::string head(9, '\0');
+        ::recv(fd, head.data(), head.size(), MSG_WAITALL);
+        std::string reply = raw_u32(static_cast<uint32_t>(RemoteSession::MAX_REPLY + 1)) + head.substr(4, 4) + '\0';
+        ::send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+        raw_closed(fd);
+        ::close(fd);
+    });
+    {
+        RemoteSession lied_to("127.0.0.1", ntohs(addr.sin_port));
+        auto reply = lied_to.request(RemoteSession::Op::Read, "/x");
+        threw = false;
+        try {
+            RemoteSession::replyData(std::move(reply));
+        } catch(const std::runtime_error&){
+            threw = true;
+        }
+        CHECK(threw);
+    }
+    liar.join();
+    ::close(listener);
+}
+
+TEST(remote_idle_check_keeps_connection_with_data_waiting) {
+    // Answers the first EXEC twice, the second time late, so that bytes wait
+    // on the idle connection
+    int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    ::bind(listener, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    ::listen(listener, 4);
+    ::getsockname(listener, reinterpret_cast<struct sockaddr*>(&addr), &len);
+    std::vector<int> accepted;
+    std::thread chatty([&]{
+        for(int fd; (fd = ::accept(listener, nullptr, nullptr)) >= 0;){
+            accepted.push_back(fd);
+            raw_line(fd);
+            ::send(fd, "OK one\n", 7, MSG_NOSIGNAL);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            ::send(fd, "OK late\n", 8, MSG_NOSIGNAL);
+            while(!raw_line(fd).empty()) ::send(fd, "OK more\n", 8, MSG_NOSIGNAL);
+        }
+    });
+    RemoteSession::PoolStats stats;
+    {
+        RemoteSession session("127.0.0.1", ntohs(addr.sin_port), false);
+        session.setIdleCheck(std::chrono::milliseconds(5));
+        CHECK(session.exec("first") == "one");
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        session.exec("second");
+        stats = session.poolStats();
+    }
+    ::shutdown(listener, SHUT_RDWR);
+    ::close(listener);
+    chatty.join();
+    for(int fd : accepted) ::close(fd);
+    CHECK(stats.failed_checks == 0);
+    CHECK(stats.reconnects == 0);
+}
+
+TEST(remote_daemon_takes_split_and_large_requests) {
+    TestHostDir host;
+    std::string path = host / "a.h";
+    std::ofstream(path) << path;
+    TestRemoteServer server;
+
+    // Requests arrive in pieces
+    int fd = raw_client(server.port);
+    std::string hello = "HELLO VFSB/1\n";
+    ::send(fd, hello.data(), 5, MSG_NOSIGNAL);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ::send(fd, hello.data() + 5, hello.size() - 5, MSG_NOSIGNAL);
+    CHECK(raw_line(fd) == "OK VFSB/1");
+    for(char c : raw_read_request(7, path)){
+        ::send(fd, &c, 1, MSG_NOSIGNAL);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    CHECK(raw_reply(fd) == path);
+    ::close(fd);
+
+    fd = raw_client(server.port);
+    ::send(fd, "EXEC ec", 7, MSG_NOSIGNAL);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ::send(fd, "ho split\n", 9, MSG_NOSIGNAL);
+    CHECK(raw_line(fd) == "OK split");
+    ::close(fd);
+
+    // ...and larger than one read
+    RemoteSession session("127.0.0.1", server.port);
+    std::string big(4 << 20, 'x');
+    for(size_t i = 0; i < big.size(); i += 4096) big[i] = static_cast<char>(i >> 12);
+    session.write(host / "big.bin", big);
+    CHECK(session.read(host / "big.bin") == big);
+}
+
+TEST(remote_daemon_bounds_connection_input) {
+    TestHostDir host;
+    std::string path = host / "a.h";
+    std::ofstream(path) << path;
+    TestRemoteServer server;
+
+    // A frame longer than MAX_FRAME closes the connection, even when it comes
+    // with the HELLO in one packet
+    int fd = raw_client(server.port);
+    std::string request = "HELLO VFSB/1\n" + raw_u32(static_cast<uint32_t>(RemoteServer::MAX_FRAME + 1)) + raw_u32(1) +
+                          static_cast<char>(RemoteSession::Op::Write);
+    ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    CHECK(raw_closed(fd));
+    ::close(fd);
+
+    // So does an EXEC line that does not end
+    fd = raw_client(server.port);
+    std::string chunk(1 << 20, 'x');
+    chunk.replace(0, 5, "EXEC ");
+    size_t sent = 0;
+    for(ssize_t n; sent <= RemoteServer::MAX_FRAME + chunk.size() &&
+                   (n = ::send(fd, chunk.data(), chunk.size(), MSG_NOSIGNAL)) > 0;){
+        sent += static_cast<size_t>(n);
+        chunk[0] = 'x';
+    }
+    CHECK(raw_closed(fd));
+    ::close(fd);
+
+    // The client refuses such a request instead of losing its connection
+    RemoteSession session("127.0.0.1", server.port);
+    bool threw = false;
+    try {
+        session.write(host / "huge.bin", std::string(RemoteServer::MAX_FRAME, 'x'));
+    } catch(const std::runtime_error& e){
+        threw = std::string(e.what()).find("too large") != std::string::npos;
+    }
+    CHECK(threw);
+    CHECK(session.read(path) == path);
+    CHECK(session.poolStats().reconnects == 0);
+}
+
+TEST(remote_daemon_stalled_readers_hold_up_no_one) {
+    TestHostDir host;
+    std::string big(4 << 20, 'x');
+    std::ofstream(host / "big.bin", std::ios::binary) << big;
+    std::string small = host / "small.h";
+    std::ofstream(small) << small;
+    TestRemoteServer server;
+    RemoteSession session("127.0.0.1", server.port);
+    session.setLeaseTtl(std::chrono::milliseconds(0));
+    CHECK(session.read(small) == small);
+
+    // A client that sends and never reads
+    int fd = raw_client(server.port);
+    ::send(fd, "HELLO VFSB/1\n", 13, MSG_NOSIGNAL);
+    CHECK(raw_line(fd) == "OK VFSB/1");
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    std::string request = raw_read_request(1, host / "big.bin");
+    for(size_t i = 0; i < 256 && ::send(fd, request.data(), request.size(), MSG_NOSIGNAL) > 0; ++i){}
+    auto start = std::chrono::steady_clock::now();
+    CHECK(session.read(small) == small);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    ::close(fd);
+
+    // Fewer workers than clients: the rest wait their turn and all get answers
+    TestRemoteServer narrow(1, 1);
+    std::vector<std::unique_ptr<RemoteSession>> clients;
+    std::vector<std::future<RemoteSession::Reply>> replies;
+    for(size_t i = 0; i < 32; ++i){
+        clients.push_back(std::make_unique<RemoteSession>("127.0.0.1", narrow.port));
+        clients.back()->setLeaseTtl(std::chrono::milliseconds(0));
+        for(size_t k = 0; k < 16; ++k) replies.push_back(clients.back()->request(RemoteSession::Op::Read, small));
+    }
+    for(auto& r : replies) CHECK(RemoteSession::replyData(std::move(r)) == small);
+    auto stats = narrow.server->stats();
+    CHECK(stats.requests == replies.size());
+    CHECK(stats.stalls > 0);
+}
+
+// ============================================================================
+// Main Test Runner
+// ============================================================================
+
+int vfs_core_tests() {
+    std::cout << "=== VFS Core Tests ===\n\n";
+
+    RUN_TEST(child_index_matches_map);
+    RUN_TEST(child_index_generation);
+    RUN_TEST(resolve_cache_follows_mutations);
+    RUN_TEST(resolve_cache_invalidates_only_below);
+    RUN_TEST(overlay_index_matches_every_overlay);
+    RUN_TEST(node_arena_reuses_blocks_freed_elsewhere);
+    RUN_TEST(node_arena_outlives_its_overlay);
+    RUN_TEST(file_chunks_match_string);
+    RUN_TEST(context_entries_share_content);
+    RUN_TEST(snapshot_restore_files);
+    RUN_TEST(snapshot_restore_cpp_ast);
+    RUN_TEST(transaction_commits_once);
+    RUN_TEST(transaction_rolls_back_on_failure);
+    RUN_TEST(journal_watch_sees_its_prefix);
+    RUN_TEST(journal_transaction_events);
+    RUN_TEST(overlay_usage_matches_recount);
+    RUN_TEST(overlay_budget_rejects_growth);
+    RUN_TEST(blob_store_shares_contents);
+    RUN_TEST(blob_store_buffers_never_change);
+    RUN_TEST(lock_guards_nest);
+    RUN_TEST(lock_sleepers_wake);
+    RUN_TEST(lock_readers_and_writer);
+    RUN_TEST(atom_pin_released_with_last_pin);
+    RUN_TEST(atom_intern_keeps_pinned_id);
+    RUN_TEST(mount_listing_does_not_intern);
+    RUN_TEST(tree_walk_prunes_and_stops);
+    RUN_TEST(tree_walk_deeper_than_stack);
+    RUN_TEST(parallel_walk_lists_mounts_on_caller);
+    RUN_TEST(tag_index_follows_mutations);
+    RUN_TEST(tags_not_inherited_by_new_nodes);
+    RUN_TEST(glob_matcher_cases);
+    RUN_TEST(find_matches_walk);
+    RUN_TEST(find_in_host_mount);
+    RUN_TEST(mount_cache_sees_host_changes);
+    RUN_TEST(mount_listing_survives_relist);
+    RUN_TEST(mount_prefetch_counts);
+    RUN_TEST(mount_reads_agree);
+    RUN_TEST(context_survives_host_truncation);
+    RUN_TEST(export_tree_writes_every_leaf);
+    RUN_TEST(host_io_batch_names_failed_path);
+    RUN_TEST(remote_cat_contents_and_errors);
+    RUN_TEST(remote_requests_settle_when_server_hangs_up);
+    RUN_TEST(remote_listing_carries_metadata);
+    RUN_TEST(remote_leases_follow_server_changes);
+    RUN_TEST(remote_pool_shared_by_mounts);
+    RUN_TEST(remote_idle_check_redials_stalled_server);
+    RUN_TEST(remote_idle_check_keeps_connection_with_data_waiting);
+    RUN_TEST(remote_replies_are_bounded);
+    RUN_TEST(remote_daemon_takes_split_and_large_requests);
+    RUN_TEST(remote_daemon_bounds_connection_input);
+    RUN_TEST(remote_daemon_stalled_readers_hold_up_no_one);
+
+    std::cout << "\n=== Test Summary ===\n";
+    std::cout << "Total:  " << total << "\n";
+    std::cout << "Passed: " << passed << "\n";
+    std::cout << "Failed: " << failed << "\n";
+
+    return (failed == 0) ? 0 : 1;
+}
+
+#endif // VFS_TESTS_ENABLED
@@ -0,0 +1,155 @@
+#include "VfsShell.h"
+
+// ====== GlobMatcher ======
+
+namespace {
+
+struct GlobToken {
+    enum Kind { Char, Any, Set, Star, Globstar } kind;
+    std::bitset<256> chars;  // the characters it consumes (Char, Set)
+    bool dir = false;        // Globstar written as a whole component followed by '/'
+    char ch = 0;             // Char
+};
+
+std::vector<GlobToken> parse_glob(std::string_view p){
+    std::vector<GlobToken> out;
+    auto literal = [&](unsigned char c){
+        GlobToken t{GlobToken::Char, {}, false, static_cast<char>(c)};
+        t.chars.set(c);
+        out.push_back(t);
+    };
+    for(size_t i = 0; i < p.size(); ++i){
+        char c = p[i];
+        if(c == '\\' && i + 1 < p.size()){
+            literal(static_cast<unsigned char>(p[++i]));
+        } else if(c == '?'){
+            out.push_back(GlobToken{GlobToken::Any, {}, false, 0});
+        } else if(c == '*'){
+            if(i + 1 < p.size() && p[i + 1] == '*'){
+                while(i + 1 < p.size() && p[i + 1] == '*') ++i;
+                bool starts = out.empty() || (out.back().kind == GlobToken::Char && out.back().ch == '/');
+                bool dir = starts && i + 1 < p.size() && p[i + 1] == '/';
+                out.push_back(GlobToken{GlobToken::Globstar, {}, dir, 0});
+            } else {
+                out.push_back(GlobToken{GlobToken::Star, {}, false, 0});
+            }
+        } else if(c == '['){
+            size_t j = i + 1;
+            bool negate = j < p.size() && (p[j] == '!' || p[j] == '^');
+            if(negate) ++j;
+            std::bitset<256> set;
+            bool closed = false;
+            for(bool first = true; j < p.size(); first = false){
+                if(p[j] == ']' && !first){
+                    closed = true;
+                    break;
+                }
+                if(p[j] == '\\' && j + 1 < p.size()) ++j;
+                auto lo = static_cast<unsigned char>(p[j++]);
+                auto hi = lo;
+                if(j + 1 < p.size() && p[j] == '-' && p[j + 1] != ']'){
+                    if(p[j + 1] == '\\' && j + 2 < p.size()) ++j;
+                    hi = static_cast<unsigned char>(p[j + 1]);
+                    j += 2;
+                }
+                for(unsigned v = lo; v <= hi; ++v) set.set(v);
+            }
+            if(!closed){
+                literal('[');  // no closing bracket: an ordinary character
+                continue;
+            }
+            if(negate) set.flip();
+            set.reset('/');
+            out.push_back(GlobToken{GlobToken::Set, set, false, 0});
+            i = j;
+        } else {
+            literal(static_cast<unsigned char>(c));
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+GlobMatcher::GlobMatcher(std::string_view pattern) : source(pattern) {
+    auto tokens = parse_glob(pattern);
+
+    // A literal between optional single stars compares as a string
+    size_t b = 0, e = tokens.size();
+    bool lead = b < e && tokens[b].kind == GlobToken::Star;
+    if(lead) ++b;
+    bool trail = b < e && tokens[e - 1].kind == GlobToken::Star;
+    if(trail) --e;
+    bool plain = true;
+    for(size_t i = b; i < e && plain; ++i){
+        if(tokens[i].kind == GlobToken::Char) literal += tokens[i].ch;
+        else plain = false;
+    }
+    if(plain && (!(lead || trail) || hasNoSlash(literal))){
+        mode = lead && trail ? Mode::Contains : lead ? Mode::Suffix : trail ? Mode::Prefix : Mode::Exact;
+        return;
+    }
+    literal.clear();
+
+    mode = Mode::Nfa;
+    if(tokens.size() >= 64) throw std::runtime_error("glob pattern too complex: " + source);
+    accept = uint64_t(1) << tokens.size();
+    for(size_t i = 0; i < tokens.size(); ++i){
+        const uint64_t bit = uint64_t(1) << i;
+        const GlobToken& t = tokens[i];
+        for(unsigned c = 0; c < 256; ++c){
+            switch(t.kind){
+            case GlobToken::Char:
+            case GlobToken::Set:
+                if(t.chars.test(c)) advance[c] |= bit;
+                break;
+            case GlobToken::Any:
+                if(c != '/') advance[c] |= bit;
+                break;
+            case GlobToken::Star:
+                if(c != '/') stay[c] |= bit;
+                break;
+            case GlobToken::Globstar:
+                stay[c] |= bit;
+                break;
+            }
+        }
+        if(t.kind == GlobToken::Star || t.kind == GlobToken::Globstar) loops |= bit;
+        if(t.dir) dir_star |= bit;
+    }
+}
+
+uint64_t GlobMatcher::closure(uint64_t entered) const {
+    // Entering a star also enters what follows it; entering a **/ also enters
+    // what follows its slash
+    for(;;){
+        uint64_t next = entered | (entered & loops) << 1 | (entered & dir_star) << 2;
+        if(next == entered) return entered;
+        entered = next;
+    }
+}
+
+bool GlobMatcher::matches(std::string_view s) const {
+    switch(mode){
+    case Mode::Exact:
+        return s == literal;
+    case Mode::Prefix:
+        return s.size() >= literal.size() && s.compare(0, literal.size(), literal) == 0 &&
+               hasNoSlash(s.substr(literal.size()));
+    case Mode::Suffix:
+        return s.size() >= literal.size() && s.compare(s.size() - literal.size(), literal.size(), literal) == 0 &&
+               hasNoSlash(s.substr(0, s.size() - literal.size()));
+    case Mode::Contains:
+        return hasNoSlash(s) && s.find(literal) != std::string_view::npos;
+    case Mode::Nfa:
+        break;
+    }
+    uint64_t cur = closure(1);
+    for(char ch : s){
+        auto c = static_cast<unsigned char>(ch);
+        uint64_t kept = cur & stay[c];
+        cur = kept | closure((cur & advance[c]) << 1 | (kept & loops) << 1);
+        if(!cur) return false;
+    }
+    return (cur & accept) != 0;
+}
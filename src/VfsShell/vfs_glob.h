@@ -0,0 +1,41 @@
+#pragma once
+
+//
+// Compiled glob patterns
+//
+// A pattern is compiled once and matched against many names. `*` and `?`
+// stay within one path component, `**` crosses them (and `**/` also matches
+// no directory at all), `[...]` matches one character of a set (`[a-z]`,
+// `[!...]` or `[^...]` negated) and `\` quotes the next character.
+//
+// A literal with at most one `*` at either end (`Makefile`, `*.cpp`, `test_*`,
+// `*util*`) is matched by plain string comparison. Everything else runs as a
+// bit-parallel NFA: one table lookup and a few mask operations per character,
+// no backtracking.
+//
+class GlobMatcher {
+public:
+    GlobMatcher() = default;
+    explicit GlobMatcher(std::string_view pattern);
+
+    bool matches(std::string_view s) const;
+    const std::string& pattern() const { return source; }
+    // Whether the pattern names a path below the start rather than a name
+    bool hasSlash() const { return source.find('/') != std::string::npos; }
+
+private:
+    enum class Mode { Exact, Prefix, Suffix, Contains, Nfa };
+    std::string source;
+    Mode mode = Mode::Exact;
+    std::string literal;  // the non-* part in the string comparison modes
+
+    // NFA state i is "token i comes next"; the bit past the last token accepts
+    uint64_t accept = 0;
+    uint64_t loops = 0;     // * and ** states, which may also be left without consuming
+    uint64_t dir_star = 0;  // **/ states, which may be skipped along with their '/'
+    std::array<uint64_t, 256> advance{};  // states a character moves on from
+    std::array<uint64_t, 256> stay{};     // states a character keeps
+
+    uint64_t closure(uint64_t entered) const;
+    static bool hasNoSlash(std::string_view s) { return s.find('/') == std::string_view::npos; }
+};
@@ -0,0 +1,324 @@
+#include "VfsShell.h"
+
+// ====== HostIoBatch ======
+
+namespace {
+
+// A minimal io_uring: one submission and one completion ring, used a batch of
+// entries at a time
+class Uring {
+public:
+    explicit Uring(unsigned entries){
+        io_uring_params p{};
+        fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+        if(fd < 0) return;
+        // open/close/statx and plain read/write arrived with the 5.6 kernel,
+        // which is also the first to report this feature
+        if(!(p.features & IORING_FEAT_RW_CUR_POS)){
+            release();
+            return;
+        }
+        sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if(single) sq_len = cq_len = std::max(sq_len, cq_len);
+        sq_map = ::mmap(nullptr, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        cq_map = single ? sq_map
+                        : ::mmap(nullptr, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+        void* s = ::mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if(sq_map == MAP_FAILED || cq_map == MAP_FAILED || s == MAP_FAILED){
+            if(s != MAP_FAILED) ::munmap(s, sqes_len);
+            release();
+            return;
+        }
+        sqes = static_cast<io_uring_sqe*>(s);
+        auto* sq = static_cast<char*>(sq_map);
+        auto* cq = static_cast<char*>(cq_map);
+        sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        sq_entries = p.sq_entries;
+    }
+    ~Uring(){
+        if(sqes) ::munmap(sqes, sqes_len);
+        release();
+    }
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    bool ok() const { return sqes != nullptr; }
+
+    // Fills count entries with prep(i, sqe), submitting as many at a time as
+    // the ring holds, and hands each result to done(i, res)
+    template<typename Prep, typename Done>
+    void run(size_t count, Prep prep, Done done){
+        for(size_t base = 0; base < count; base += sq_entries){
+            unsigned n = static_cast<unsigned>(std::min<size_t>(sq_entries, count - base));
+            unsigned tail = *sq_tail;  // only this thread submits
+            for(unsigned i = 0; i < n; ++i, ++tail){
+                unsigned idx = tail & sq_mask;
+                io_uring_sqe* sqe = &sqes[idx];
+                std::memset(sqe, 0, sizeof(*sqe));
+                prep(base + i, sqe);
+                sqe->user_data = base + i;
+                sq_array[idx] = idx;
+            }
+            __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+            unsigned submitted = 0, reaped = 0;
+            while(reaped < n){
+                int r = static_cast<int>(::syscall(__NR_io_uring_enter, fd, n - submitted, n - reaped,
+                                                   IORING_ENTER_GETEVENTS, nullptr, 0));
+                if(r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                    throw std::runtime_error(std::string("io_uring_enter: ") + std::strerror(errno));
+                if(r > 0) submitted += static_cast<unsigned>(r);
+                unsigned head = *cq_head;
+                unsigned ctail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+                for(; head != ctail; ++head, ++reaped){
+                    const io_uring_cqe& cqe = cqes[head & cq_mask];
+                    done(static_cast<size_t>(cqe.user_data), cqe.res);
+                }
+                __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            }
+        }
+    }
+
+private:
+    int fd = -1;
+    void* sq_map = MAP_FAILED;
+    void* cq_map = MAP_FAILED;
+    size_t sq_len = 0, cq_len = 0, sqes_len = 0;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned sq_mask = 0, cq_mask = 0, sq_entries = 0;
+
+    void release(){
+        if(cq_map != MAP_FAILED && cq_map != sq_map) ::munmap(cq_map, cq_len);
+        if(sq_map != MAP_FAILED) ::munmap(sq_map, sq_len);
+        sq_map = cq_map = MAP_FAILED;
+        if(fd >= 0) ::close(fd);
+        fd = -1;
+    }
+};
+
+constexpr unsigned RING_ENTRIES = 256;
+constexpr size_t MAX_TRANSFER = size_t(1) << 30;  // one read or write; its length is 32 bits
+constexpr size_t THREAD_CHUNK = 64;               // files per worker pool task
+
+} // namespace
+
+HostIoBatch::Backend HostIoBatch::defaultBackend(){
+    static const Backend b = Uring(1).ok() ? Backend::Uring : Backend::Threads;
+    return b;
+}
+
+const char* HostIoBatch::backendName(Backend b){
+    return b == Backend::Uring ? "io_uring" : "threads";
+}
+
+void HostIoBatch::write(std::string path, std::string_view data){
+    Op op;
+    op.path = std::move(path);
+    op.data = data;
+    ops.push_back(std::move(op));
+}
+
+void HostIoBatch::write(std::string path, ContentView data){
+    write(std::move(path), data.data);
+    if(data.owner) owners.push_back(std::move(data.owner));
+}
+
+void HostIoBatch::read(std::string path, std::string* out){
+    Op op;
+    op.path = std::move(path);
+    op.out = out;
+    ops.push_back(std::move(op));
+}
+
+void HostIoBatch::run(){
+    if(ops.empty()) return;
+    if(backend == Backend::Uring && !runUring()) backend = Backend::Threads;
+    if(backend == Backend::Threads) runThreads();
+
+    auto failed = std::find_if(ops.begin(), ops.end(), [](const Op& op){ return op.error != 0; });
+    std::string error;
+    if(failed != ops.end())
+        error = std::string("host io: cannot ") + (failed->out ? "read " : "write ") + failed->path + ": " +
+                std::strerror(failed->error);
+    ops.clear();
+    owners.clear();
+    if(!error.empty()) throw std::runtime_error(error);
+}
+
+bool HostIoBatch::runUring(){
+    Uring ring(RING_ENTRIES);
+    if(!ring.ok()) return false;
+
+    // Files are taken a ring's worth at a time, which bounds the descriptors
+    // held open; each step runs over the operations of the wave still going
+    for(size_t begin = 0; begin < ops.size(); begin += RING_ENTRIES){
+        size_t end = std::min(ops.size(), begin + RING_ENTRIES);
+        std::vector<size_t> sel;
+        auto select = [&](auto pred){
+            sel.clear();
+            for(size_t i = begin; i < end; ++i)
+                if(pred(ops[i])) sel.push_back(i);
+            return !sel.empty();
+        };
+        auto step = [&](auto prep, auto done){
+            ring.run(sel.size(), [&](size_t i, io_uring_sqe* sqe){ prep(ops[sel[i]], sqe); },
+                     [&](size_t i, int res){ done(ops[sel[i]], res); });
+        };
+        auto open_ok = [](const Op& op){ return op.fd >= 0 && op.error == 0; };
+
+        select([](const Op&){ return true; });
+        step([](Op& op, io_uring_sqe* sqe){
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uint64_t>(op.path.c_str());
+            sqe->len = 0644;
+            sqe->open_flags = op.out ? O_RDONLY | O_CLOEXEC : O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        }, [](Op& op, int res){
+            if(res < 0) op.error = -res;
+            else op.fd = res;
+        });
+
+        // Reads are sized from the file, so their buffers are allocated once
+        std::vector<struct statx> stx(end - begin);
+        if(select([&](const Op& op){ return op.out && open_ok(op); })){
+            step([&](Op& op, io_uring_sqe* sqe){
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = op.fd;
+                sqe->addr = reinterpret_cast<uint64_t>("");
+                sqe->len = STATX_SIZE;
+                sqe->off = reinterpret_cast<uint64_t>(&stx[&op - &ops[begin]]);
+                sqe->statx_flags = AT_EMPTY_PATH;
+            }, [&](Op& op, int res){
+                if(res < 0) op.error = -res;
+                else op.out->assign(static_cast<size_t>(stx[&op - &ops[begin]].stx_size), '\0');
+            });
+        }
+
+        auto target = [](const Op& op){ return op.out ? op.out->size() : op.data.size(); };
+        while(select([&](const Op& op){ return open_ok(op) && op.done < target(op); })){
+            step([&](Op& op, io_uring_sqe* sqe){
+                sqe->opcode = op.out ? IORING_OP_READ : IORING_OP_WRITE;
+                sqe->fd = op.fd;
+                sqe->addr = reinterpret_cast<uint64_t>(op.out ? op.out->data() + op.done : op.data.data() + op.done);
+                sqe->len = static_cast<uint32_t>(std::min(target(op) - op.done, MAX_TRANSFER));
+                sqe->off = op.done;
+            }, [](Op& op, int res){
+                if(res == -EINTR || res == -EAGAIN) return;  // tried again in the next round
+                if(res < 0) op.error = -res;
+                else if(res > 0) op.done += static_cast<size_t>(res);
+                else if(op.out) op.out->resize(op.done);  // the file shrank
+                else op.error = EIO;
+            });
+        }
+
+        if(sync && select([&](const Op& op){ return !op.out && open_ok(op); })){
+            step([](Op& op, io_uring_sqe* sqe){
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fd = op.fd;
+            }, [](Op& op, int res){
+                if(res < 0) op.error = -res;
+            });
+        }
+
+        if(select([](const Op& op){ return op.fd >= 0; })){
+            step([](Op& op, io_uring_sqe* sqe){
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = op.fd;
+            }, [](Op& op, int res){
+                op.fd = -1;
+                if(res < 0 && !op.out && op.error == 0) op.error = -res;
+            });
+        }
+    }
+    return true;
+}
+
+void HostIoBatch::runThreads(){
+    WorkerPool::Group group(WorkerPool::shared());
+    for(size_t b = 0; b < ops.size(); b += THREAD_CHUNK){
+        group.run([this, b]{
+            size_t e = std::min(ops.size(), b + THREAD_CHUNK);
+            for(size_t i = b; i < e; ++i) runOne(ops[i], sync);
+        });
+    }
+    group.wait();
+}
+
+void HostIoBatch::runOne(Op& op, bool sync){
+    int fd = ::open(op.path.c_str(), op.out ? O_RDONLY | O_CLOEXEC : O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0){
+        op.error = errno;
+        return;
+    }
+    struct stat st;
+    if(op.out){
+        if(::fstat(fd, &st) != 0) op.error = errno;
+        else op.out->assign(static_cast<size_t>(st.st_size), '\0');
+    }
+    size_t target = op.out ? op.out->size() : op.data.size();
+    while(op.error == 0 && op.done < target){
+        size_t len = std::min(target - op.done, MAX_TRANSFER);
+        auto off = static_cast<off_t>(op.done);
+        ssize_t n = op.out ? ::pread(fd, op.out->data() + op.done, len, off)
+                           : ::pwrite(fd, op.data.data() + op.done, len, off);
+        if(n < 0 && errno == EINTR) continue;
+        if(n < 0) op.error = errno;
+        else if(n > 0) op.done += static_cast<size_t>(n);
+        else if(op.out) op.out->resize(op.done);
+        else op.error = EIO;
+    }
+    if(sync && !op.out && op.error == 0 && ::fsync(fd) != 0) op.error = errno;
+    if(::close(fd) != 0 && !op.out && op.error == 0) op.error = errno;
+}
+
+ExportResult export_tree(Vfs& vfs, const std::shared_ptr<VfsNode>& dir, const std::string& host_dir,
+                         HostIoBatch::Backend backend){
+    TRACE_FN("host=", host_dir);
+    std::string root = host_dir;
+    while(root.size() > 1 && root.back() == '/') root.pop_back();
+    std::vector<std::string> dirs;
+    std::string unreadable;  // first leaf whose read() threw
+    HostIoBatch batch(backend);
+    {
+        // The contents are owned by the batch once the lock is gone, so no
+        // view into a host mapping outlives it
+        auto guard = vfs.readLock();
+        TreeWalker().walk(dir, root, [&](const TreeWalker::Item& item){
+            if(item.node->isDir()){
+                dirs.push_back(item.path);
+                return TreeWalker::Action::Descend;
+            }
+            try {
+                batch.write(item.path, item.node->readShared());
+            } catch(const std::exception& e){
+                if(unreadable.empty()) unreadable = item.path + ": " + e.what();
+            }
+            return TreeWalker::Action::Skip;
+        });
+    }
+    for(const auto& d : dirs){
+        std::error_code ec;
+        std::filesystem::create_directories(d, ec);
+        if(ec) throw std::runtime_error("export: cannot create directory " + d + ": " + ec.message());
+    }
+    ExportResult result;
+    result.files = batch.size();
+    batch.run();
+    result.backend = batch.usedBackend();
+    if(!unreadable.empty()) throw std::runtime_error("export: cannot read " + unreadable);
+    return result;
+}
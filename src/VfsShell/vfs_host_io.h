@@ -0,0 +1,66 @@
+#pragma once
+
+//
+// Batched host file I/O
+//
+// Whole-file reads and writes of many host files, queued and then run
+// together. On Linux each step (open, stat, read or write, fsync, close) is
+// submitted for the whole batch at once through io_uring, so thousands of
+// files cost a few system calls per step instead of several per file. Where
+// io_uring is unavailable (old kernels, seccomp filters) the batch runs on
+// the worker pool instead, a chunk of files per task.
+//
+class HostIoBatch {
+public:
+    enum class Backend { Uring, Threads };
+    // io_uring when the kernel provides it, probed once
+    static Backend defaultBackend();
+    static const char* backendName(Backend b);
+
+    explicit HostIoBatch(Backend b = defaultBackend()) : backend(b) {}
+
+    // Creates or truncates path with data, which must stay valid until run()
+    void write(std::string path, std::string_view data);
+    // Holds on to the view's owner until the batch ran
+    void write(std::string path, ContentView data);
+    // Reads the whole of path into *out
+    void read(std::string path, std::string* out);
+    // Written files are flushed to the disk before run() returns
+    void setSync(bool s) { sync = s; }
+
+    size_t size() const { return ops.size(); }
+    Backend usedBackend() const { return backend; }
+    // Runs and clears the queue; throws naming the first path that failed,
+    // after every other operation ran
+    void run();
+
+private:
+    struct Op {
+        std::string path;
+        std::string_view data;  // to write
+        std::string* out = nullptr;  // read into, or nullptr for a write
+        int fd = -1;
+        size_t done = 0;  // bytes moved so far
+        int error = 0;
+    };
+    Backend backend;
+    bool sync = false;
+    std::vector<Op> ops;
+    std::vector<std::shared_ptr<const void>> owners;
+
+    bool runUring();  // false when no ring could be set up
+    void runThreads();
+    static void runOne(Op& op, bool sync);
+};
+
+struct ExportResult {
+    size_t files = 0;  // files written
+    HostIoBatch::Backend backend = HostIoBatch::Backend::Threads;  // the batch ran on
+};
+
+// Writes the tree below dir to the host directory host_dir as one batch,
+// creating its directories first. Every leaf is written with its read() text,
+// so AST and mounted nodes export like a plain file does. A leaf that cannot
+// be read is reported after the others were written, as run() does.
+ExportResult export_tree(Vfs& vfs, const std::shared_ptr<VfsNode>& dir, const std::string& host_dir,
+                   HostIoBatch::Backend backend = HostIoBatch::defaultBackend());
@@ -0,0 +1,95 @@
+#include "VfsShell.h"
+
+// ====== VfsJournal ======
+
+const char* VfsEvent::kindName(Kind kind){
+    switch(kind){
+    case Kind::Create: return "create";
+    case Kind::Write: return "write";
+    case Kind::Remove: return "remove";
+    case Kind::Move: return "move";
+    }
+    return "?";
+}
+
+bool VfsJournal::underPrefix(std::string_view path, std::string_view prefix){
+    while(prefix.size() > 1 && prefix.back() == '/') prefix.remove_suffix(1);
+    if(prefix.empty() || prefix == "/") return true;
+    if(path.size() < prefix.size() || path.compare(0, prefix.size(), prefix) != 0) return false;
+    return path.size() == prefix.size() || path[prefix.size()] == '/';
+}
+
+namespace {
+
+// An event concerns a watch below its path too: removing /a removes /a/b
+bool related(const VfsEvent& ev, std::string_view prefix){
+    if(VfsJournal::underPrefix(ev.path, prefix) || VfsJournal::underPrefix(prefix, ev.path)) return true;
+    return !ev.to.empty() && (VfsJournal::underPrefix(ev.to, prefix) || VfsJournal::underPrefix(prefix, ev.to));
+}
+
+} // namespace
+
+void VfsJournal::record(VfsEvent ev){
+    std::vector<std::shared_ptr<Callback>> targets;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        ev.seq = next_seq++;
+        for(const auto& w : watches){
+            if(related(ev, w.prefix)) targets.push_back(w.cb);
+        }
+        if(ring.size() == CAPACITY) ring.pop_front();
+        ring.push_back(ev);
+    }
+    cv.notify_all();
+    // Outside the journal lock so a callback may watch/unwatch
+    for(const auto& cb : targets) (*cb)(ev);
+}
+
+uint64_t VfsJournal::lastSeq() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return next_seq - 1;
+}
+
+uint64_t VfsJournal::firstSeq() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return ring.empty() ? next_seq : ring.front().seq;
+}
+
+std::vector<VfsEvent> VfsJournal::since(uint64_t seq, const std::string& prefix) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<VfsEvent> out;
+    if(ring.empty() || seq >= ring.back().seq) return out;
+    // Sequence numbers are contiguous in the ring
+    size_t start = seq < ring.front().seq ? 0 : static_cast<size_t>(seq - ring.front().seq + 1);
+    for(size_t i = start; i < ring.size(); ++i){
+        const VfsEvent& ev = ring[i];
+        if(related(ev, prefix)) out.push_back(ev);
+    }
+    return out;
+}
+
+uint64_t VfsJournal::wait(uint64_t seq, std::chrono::milliseconds timeout) const {
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait_for(lock, timeout, [&]{ return next_seq - 1 > seq; });
+    return next_seq - 1;
+}
+
+VfsJournal::WatchId VfsJournal::watch(std::string prefix, Callback cb){
+    if(!cb) throw std::runtime_error("watch: null callback");
+    std::lock_guard<std::mutex> lock(mtx);
+    WatchId id = next_watch++;
+    watches.push_back(Watch{id, std::move(prefix), std::make_shared<Callback>(std::move(cb))});
+    return id;
+}
+
+void VfsJournal::unwatch(WatchId id){
+    std::lock_guard<std::mutex> lock(mtx);
+    watches.erase(std::remove_if(watches.begin(), watches.end(),
+                                 [&](const Watch& w){ return w.id == id; }),
+                  watches.end());
+}
+
+size_t VfsJournal::watchCount() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return watches.size();
+}
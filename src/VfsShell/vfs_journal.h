@@ -0,0 +1,64 @@
+#pragma once
+
+//
+// Vfs change journal
+//
+// Every mutation of the tree appends an event with a sequence number to a
+// bounded in-memory ring, so consumers can ask "what changed under this path
+// since sequence N" instead of rereading and comparing. Watches subscribe a
+// callback to a path prefix and also see events on its ancestors (a removed
+// or restored parent). Callbacks run synchronously on the mutating thread
+// while it still holds the Vfs write lock, so they may read the Vfs but must
+// not wait on another thread that uses it.
+//
+struct VfsEvent {
+    enum class Kind { Create, Write, Remove, Move };
+    uint64_t seq = 0;
+    Kind kind = Kind::Write;
+    size_t overlay = 0;
+    std::string path;
+    std::string to;  // destination of a Move
+
+    static const char* kindName(Kind kind);
+};
+
+class VfsJournal {
+public:
+    static constexpr size_t CAPACITY = 4096;
+    using WatchId = uint64_t;
+    using Callback = std::function<void(const VfsEvent&)>;
+
+    VfsJournal() = default;
+    // Copies start with an empty journal of their own
+    VfsJournal(const VfsJournal&) : VfsJournal() {}
+    VfsJournal& operator=(const VfsJournal&) { return *this; }
+
+    void record(VfsEvent ev);
+    uint64_t lastSeq() const;
+    // Oldest sequence still held; events before it were dropped from the ring
+    uint64_t firstSeq() const;
+    std::vector<VfsEvent> since(uint64_t seq, const std::string& prefix = "/") const;
+    // Blocks until an event newer than seq is recorded or the timeout passes;
+    // returns the last sequence number either way
+    uint64_t wait(uint64_t seq, std::chrono::milliseconds timeout) const;
+
+    WatchId watch(std::string prefix, Callback cb);
+    void unwatch(WatchId id);
+    size_t watchCount() const;
+
+    // True when path is prefix or lies below it
+    static bool underPrefix(std::string_view path, std::string_view prefix);
+
+private:
+    struct Watch {
+        WatchId id;
+        std::string prefix;
+        std::shared_ptr<Callback> cb;
+    };
+    mutable std::mutex mtx;
+    mutable std::condition_variable cv;
+    std::deque<VfsEvent> ring;
+    uint64_t next_seq = 1;
+    WatchId next_watch = 1;
+    std::vector<Watch> watches;
+};
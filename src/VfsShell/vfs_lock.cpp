@@ -0,0 +1,125 @@
+#include "VfsShell.h"
+
+// ====== VfsRwLock ======
+
+namespace {
+
+// Locks this thread holds, with their nesting depth; rarely more than one
+struct HeldLock {
+    VfsRwLock* lock;
+    bool exclusive;
+    size_t shard;
+    uint32_t depth;
+};
+thread_local std::vector<HeldLock> g_held_locks;
+
+HeldLock* find_held(VfsRwLock* lock){
+    for(auto& h : g_held_locks){
+        if(h.lock == lock) return &h;
+    }
+    return nullptr;
+}
+
+size_t thread_shard(){
+    static std::atomic<size_t> next{0};
+    thread_local size_t shard = next.fetch_add(1, std::memory_order_relaxed) % VfsRwLock::SHARDS;
+    return shard;
+}
+
+} // namespace
+
+VfsRwLock::Shared::Shared(VfsRwLock& l) : lock(&l) {
+    if(HeldLock* h = find_held(&l)){
+        ++h->depth;
+        return;
+    }
+    size_t shard = thread_shard();
+    l.lockShared(shard);
+    g_held_locks.push_back(HeldLock{&l, false, shard, 1});
+}
+
+VfsRwLock::Shared::~Shared(){
+    if(lock) lock->release();
+}
+
+VfsRwLock::Exclusive::Exclusive(VfsRwLock& l) : lock(&l) {
+    if(HeldLock* h = find_held(&l)){
+        if(!h->exclusive){
+            lock = nullptr;
+            assert(!"vfs: write attempted while holding a read lock");
+            throw std::runtime_error("vfs: write attempted while holding a read lock");
+        }
+        ++h->depth;
+        return;
+    }
+    l.lockExclusive();
+    g_held_locks.push_back(HeldLock{&l, true, 0, 1});
+}
+
+VfsRwLock::Exclusive::~Exclusive(){
+    if(lock) lock->release();
+}
+
+void VfsRwLock::release(){
+    for(size_t i = 0; i < g_held_locks.size(); ++i){
+        HeldLock& h = g_held_locks[i];
+        if(h.lock != this) continue;
+        if(--h.depth == 0){
+            const bool exclusive = h.exclusive;
+            const size_t shard = h.shard;
+            g_held_locks.erase(g_held_locks.begin() + static_cast<std::ptrdiff_t>(i));
+            if(exclusive) unlockExclusive();
+            else unlockShared(shard);
+        }
+        return;
+    }
+}
+
+void VfsRwLock::lockShared(size_t shard){
+    auto& readers = shards[shard].readers;
+    for(;;){
+        // seq_cst pairs with the writer's flag store: one of the two sees the other
+        readers.fetch_add(1, std::memory_order_seq_cst);
+        if(!writer.load(std::memory_order_seq_cst)) return;
+        unlockShared(shard);
+        for(int i = 0; i < SPINS && writer.load(std::memory_order_acquire); ++i) std::this_thread::yield();
+        if(!writer.load(std::memory_order_acquire)) continue;
+        // Counted before the flag is checked under the mutex, and the writer
+        // reads the count after clearing the flag, so it cannot miss us
+        std::unique_lock<std::mutex> lk(sleep_mtx);
+        sleeping_readers.fetch_add(1, std::memory_order_seq_cst);
+        writer_done.wait(lk, [&]{ return !writer.load(std::memory_order_seq_cst); });
+        sleeping_readers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void VfsRwLock::unlockShared(size_t shard){
+    // The last reader out wakes a writer that gave up spinning
+    if(shards[shard].readers.fetch_sub(1, std::memory_order_seq_cst) == 1 &&
+       writer_sleeping.load(std::memory_order_seq_cst)){
+        std::lock_guard<std::mutex> lk(sleep_mtx);
+        readers_drained.notify_one();
+    }
+}
+
+void VfsRwLock::lockExclusive(){
+    writer_mtx.lock();
+    writer.store(true, std::memory_order_seq_cst);
+    for(auto& s : shards){
+        for(int i = 0; i < SPINS && s.readers.load(std::memory_order_acquire) != 0; ++i) std::this_thread::yield();
+        if(s.readers.load(std::memory_order_acquire) == 0) continue;
+        std::unique_lock<std::mutex> lk(sleep_mtx);
+        writer_sleeping.store(true, std::memory_order_seq_cst);
+        readers_drained.wait(lk, [&]{ return s.readers.load(std::memory_order_seq_cst) == 0; });
+        writer_sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+void VfsRwLock::unlockExclusive(){
+    writer.store(false, std::memory_order_seq_cst);
+    if(sleeping_readers.load(std::memory_order_seq_cst) != 0){
+        std::lock_guard<std::mutex> lk(sleep_mtx);
+        writer_done.notify_all();
+    }
+    writer_mtx.unlock();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+//
+// Vfs reader-writer lock
+//
+// Readers announce themselves on one of SHARDS cache-line sized counters picked
+// per thread, so concurrent readers on different cores never write the same
+// line. A writer takes the writer mutex (writers are serialized), raises the
+// writer flag and waits for every shard to drain; readers arriving meanwhile
+// back off until it is done, so writers are not starved. Either side spins
+// for a few rounds and then sleeps on a condition variable, which the other
+// side signals only when someone is asleep, so the uncontended paths never
+// touch the mutex.
+//
+// Guards are reentrant per thread: a Vfs entry point called from another one,
+// or from code already holding a guard, does not lock again. A write guard
+// covers reads. Asking for a write guard while the thread holds only a read
+// guard cannot be granted (two such threads would wait on each other): it
+// asserts in debug builds and throws otherwise. See Vfs::readLock() for the
+// entry points that take a write guard.
+//
+class VfsRwLock {
+public:
+    static constexpr size_t SHARDS = 64;
+
+    class Shared {
+        VfsRwLock* lock = nullptr;
+    public:
+        explicit Shared(VfsRwLock& l);
+        Shared(Shared&& o) noexcept : lock(o.lock) { o.lock = nullptr; }
+        Shared& operator=(Shared&&) = delete;
+        ~Shared();
+    };
+
+    class Exclusive {
+        VfsRwLock* lock = nullptr;
+    public:
+        explicit Exclusive(VfsRwLock& l);
+        Exclusive(Exclusive&& o) noexcept : lock(o.lock) { o.lock = nullptr; }
+        Exclusive& operator=(Exclusive&&) = delete;
+        ~Exclusive();
+    };
+
+    VfsRwLock() = default;
+    // Copies get their own, unlocked state
+    VfsRwLock(const VfsRwLock&) : VfsRwLock() {}
+    VfsRwLock& operator=(const VfsRwLock&) { return *this; }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint32_t> readers{0};
+    };
+    static constexpr int SPINS = 64;  // rounds before sleeping
+    std::array<Shard, SHARDS> shards;
+    std::atomic<bool> writer{false};
+    std::mutex writer_mtx;
+    // Sleepers: readers waiting for the writer to finish, the writer waiting
+    // for the readers to drain
+    std::mutex sleep_mtx;
+    std::condition_variable writer_done;
+    std::condition_variable readers_drained;
+    std::atomic<uint32_t> sleeping_readers{0};
+    std::atomic<bool> writer_sleeping{false};
+
+    void lockShared(size_t shard);
+    void unlockShared(size_t shard);
+    void lockExclusive();
+    void unlockExclusive();
+    void release();  // drops one nesting level of this thread's hold
+};
@@ -18,59 +18,290 @@ VfsNode::Kind determineMountNodeKind(const std::string& host_path) {
     }
 }
 
+// ====== MountWatch ======
+
+MountWatch::MountWatch(){
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+MountWatch::~MountWatch(){
+    if(fd >= 0) close(fd);
+}
+
+int MountWatch::watch(const std::shared_ptr<MountNode>& dir){
+    if(fd < 0) return -1;
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_ATTRIB |
+                          IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+    int wd = inotify_add_watch(fd, dir->host_path.c_str(), mask);
+    if(wd < 0) return -1;
+    std::lock_guard<std::mutex> lock(mtx);
+    dirs[wd].push_back(dir);  // the same wd again when a directory is reached twice
+    return wd;
+}
+
+void MountWatch::forget(int wd){
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = dirs.find(wd);
+    if(it == dirs.end()) return;
+    auto& nodes = it->second;
+    nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+                               [](const std::weak_ptr<MountNode>& w){ return w.expired(); }),
+                nodes.end());
+    if(!nodes.empty()) return;
+    inotify_rm_watch(fd, wd);
+    dirs.erase(it);
+}
+
+void MountWatch::drain(){
+    if(fd < 0) return;
+    struct Change {
+        std::shared_ptr<MountNode> node;
+        uint32_t mask;
+        std::string name;
+    };
+    std::vector<Change> changes;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        alignas(inotify_event) char buf[16 * 1024];
+        for(;;){
+            ssize_t n = ::read(fd, buf, sizeof(buf));
+            if(n <= 0) break;  // EAGAIN: nothing more queued
+            for(char* p = buf; p < buf + n;){
+                auto* ev = reinterpret_cast<inotify_event*>(p);
+                p += sizeof(inotify_event) + ev->len;
+                if(ev->mask & IN_Q_OVERFLOW){
+                    // Events were dropped, so anything may have changed
+                    for(auto& kv : dirs){
+                        for(auto& w : kv.second){
+                            if(auto node = w.lock()) changes.push_back(Change{node, ev->mask, std::string()});
+                        }
+                    }
+                    continue;
+                }
+                auto it = dirs.find(ev->wd);
+                if(it == dirs.end()) continue;
+                std::string name = ev->len ? std::string(ev->name) : std::string();
+                for(auto& w : it->second){
+                    if(auto node = w.lock()) changes.push_back(Change{node, ev->mask, name});
+                }
+                if(ev->mask & IN_IGNORED) dirs.erase(it);  // the kernel dropped the watch
+            }
+        }
+    }
+    // Applied without the lock: nodes take their own, and may watch again
+    for(auto& c : changes) c.node->hostChanged(c.mask, c.name);
+}
+
+// ====== MountNode ======
+
 MountNode::MountNode(std::string n, std::string hp)
-    : VfsNode(std::move(n), determineMountNodeKind(hp)), host_path(std::move(hp)) {}
+    : VfsNode(std::move(n), determineMountNodeKind(hp)), host_path(std::move(hp)),
+      watcher(std::make_shared<MountWatch>()), is_dir(kind == Kind::Dir), stat_cached(false) {}
 
-bool MountNode::isDir() const {
-    namespace fs = std::filesystem;
-    try {
-        return fs::is_directory(host_path);
-    } catch(...) {
-        return false;
+MountNode::MountNode(std::string_view n, std::string hp, std::shared_ptr<MountWatch> w, Kind k, bool dir)
+    : VfsNode(Atom::pin(n), k), host_path(std::move(hp)), watcher(std::move(w)), pinned_name(name),
+      is_dir(dir), stat_cached(true) {}
+
+MountNode::~MountNode(){
+    if(wd >= 0) watcher->forget(wd);
+    Atom::unpin(pinned_name);
+}
+
+namespace {
+
+// Open host file, closed on scope exit
+struct HostFile {
+    int fd;
+    explicit HostFile(const std::string& path) : fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+        if(fd < 0) throw std::runtime_error("mount: cannot read file " + path);
+    }
+    ~HostFile() { ::close(fd); }
+    HostFile(const HostFile&) = delete;
+    HostFile& operator=(const HostFile&) = delete;
+};
+
+struct HostMapping {
+    void* addr;
+    size_t len;
+    HostMapping(void* a, size_t n) : addr(a), len(n) {}
+    ~HostMapping() { ::munmap(addr, len); }
+    HostMapping(const HostMapping&) = delete;
+    HostMapping& operator=(const HostMapping&) = delete;
+};
+
+// Reads len bytes from offset, or up to the end, into a buffer sized from the
+// file size; one byte more is asked for to see the end in the same call, and
+// a file that grew meanwhile (or has no size, like /proc files) is read on
+std::string pread_host(const HostFile& f, const std::string& path, size_t size_hint,
+                       size_t offset = 0, size_t len = std::string::npos){
+    size_t expected = size_hint > offset ? size_hint - offset : 0;
+    std::string out(std::min(len, expected + 1), '\0');
+    size_t got = 0;
+    for(;;){
+        if(got == out.size()){
+            if(out.size() >= len) break;
+            out.resize(std::min(len, std::max<size_t>(out.size() * 2, 4096)));
+        }
+        ssize_t n = ::pread(f.fd, out.data() + got, out.size() - got, static_cast<off_t>(offset + got));
+        if(n < 0){
+            if(errno == EINTR) continue;
+            throw std::runtime_error("mount: cannot read file " + path);
+        }
+        if(n == 0) break;
+        got += static_cast<size_t>(n);
     }
+    out.resize(got);
+    return out;
+}
+
+size_t host_file_size(const HostFile& f, const std::string& path){
+    struct stat st;
+    if(::fstat(f.fd, &st) != 0) throw std::runtime_error("mount: cannot stat file " + path);
+    return S_ISREG(st.st_mode) ? static_cast<size_t>(st.st_size) : 0;
 }
 
+} // namespace
+
 std::string MountNode::read() const {
-    namespace fs = std::filesystem;
-    if(fs::is_directory(host_path)){
-        return "";
+    if(is_dir) return "";
+    HostFile f(host_path);
+    return pread_host(f, host_path, host_file_size(f, host_path));
+}
+
+ContentView MountNode::readView() const {
+    if(is_dir) return ContentView();
+    HostFile f(host_path);
+    size_t n = host_file_size(f, host_path);
+    if(n >= MMAP_MIN){
+        void* addr = ::mmap(nullptr, n, PROT_READ, MAP_PRIVATE, f.fd, 0);
+        if(addr != MAP_FAILED){
+            ::madvise(addr, n, MADV_SEQUENTIAL);
+            auto map = std::make_shared<const HostMapping>(addr, n);
+            return ContentView(std::string_view(static_cast<const char*>(addr), n), std::move(map));
+        }
     }
-    std::ifstream ifs(host_path, std::ios::binary);
-    if(!ifs) throw std::runtime_error("mount: cannot read file " + host_path);
-    std::ostringstream oss;
-    oss << ifs.rdbuf();
-    return oss.str();
+    return std::make_shared<const std::string>(pread_host(f, host_path, n));
 }
 
 void MountNode::write(const std::string& s) {
-    namespace fs = std::filesystem;
-    if(fs::is_directory(host_path)){
-        throw std::runtime_error("mount: cannot write to directory");
-    }
+    if(is_dir) throw std::runtime_error("mount: cannot write to directory");
     std::ofstream ofs(host_path, std::ios::binary | std::ios::trunc);
     if(!ofs) throw std::runtime_error("mount: cannot write file " + host_path);
     ofs << s;
+    stat_fresh = false;
+}
+
+size_t MountNode::size() const {
+    if(is_dir) return 0;
+    watcher->drain();
+    if(stat_cached && stat_fresh.load()) return static_cast<size_t>(cached_size.load());
+    // Marked fresh first, so a change reported during the stat marks it stale again
+    stat_fresh = true;
+    std::error_code ec;
+    auto n = std::filesystem::file_size(host_path, ec);
+    if(ec){
+        stat_fresh = false;
+        throw std::runtime_error("mount: cannot stat file " + host_path);
+    }
+    cached_size = n;
+    return static_cast<size_t>(n);
+}
+
+std::string MountNode::readRange(size_t offset, size_t len) const {
+    if(is_dir) return "";
+    HostFile f(host_path);
+    return pread_host(f, host_path, host_file_size(f, host_path), offset, len);
+}
+
+void MountNode::append(const std::string& s) {
+    if(is_dir) throw std::runtime_error("mount: cannot write to directory");
+    std::ofstream ofs(host_path, std::ios::binary | std::ios::app);
+    if(!ofs) throw std::runtime_error("mount: cannot write file " + host_path);
+    ofs << s;
+    stat_fresh = false;
 }
 
-void MountNode::populateCache() const {
+void MountNode::populateCache() {
     namespace fs = std::filesystem;
-    if(!fs::is_directory(host_path)) return;
+    if(wd < 0) wd = watcher->watch(std::static_pointer_cast<MountNode>(shared_from_this()));
+    // Unwatched directories are listed again on every access; marked before
+    // listing so a change made meanwhile is not missed
+    listed = wd >= 0;
 
-    cache.clear();
+    const ChildIndex* old = cache.current().get();
+    auto fresh = std::make_shared<ChildIndex>();
     try {
         for(const auto& entry : fs::directory_iterator(host_path)){
             auto filename = entry.path().filename().string();
-            auto node = std::make_shared<MountNode>(filename, entry.path().string());
-            cache[filename] = node;
+            std::error_code ec;
+            bool dir = entry.is_directory(ec);  // the directory entry's type: no stat unless a symlink
+            Kind k = dir ? Kind::Dir : entry.is_regular_file(ec) ? Kind::File : Kind::Mount;
+            if(old){
+                auto it = old->find(filename);
+                if(it != old->end() && it->second->kind == k){
+                    // The same node as before, so tags and cached listings below it stay
+                    auto child = std::static_pointer_cast<MountNode>(it->second);
+                    if(wd < 0) child->stat_fresh = false;
+                    (*fresh)[it->first] = child;
+                    continue;
+                }
+            }
+            // Keyed by the child's pinned name; a string key would intern it
+            auto child = std::make_shared<MountNode>(filename, entry.path().string(), watcher, k, dir);
+            (*fresh)[child->pinned_name] = child;
         }
     } catch(const std::exception& e){
+        listed = false;
         throw std::runtime_error(std::string("mount: directory iteration failed: ") + e.what());
     }
+    cache.replace(std::move(fresh));
 }
 
-std::map<std::string, std::shared_ptr<VfsNode>>& MountNode::children() {
-    populateCache();
-    return cache;
+void MountNode::refresh() {
+    if(!listed.load() || !cache.current()) populateCache();
+}
+
+ChildIndex& MountNode::children() {
+    if(!is_dir) return VfsNode::children();
+    watcher->drain();
+    std::lock_guard<std::mutex> lock(list_mtx);
+    refresh();
+    return cache.handOut();
+}
+
+std::shared_ptr<const ChildIndex> MountNode::listing() {
+    if(!is_dir) return VfsNode::listing();
+    watcher->drain();
+    std::lock_guard<std::mutex> lock(list_mtx);
+    refresh();
+    return cache.current();
+}
+
+std::vector<std::shared_ptr<MountNode>> MountNode::childNodes() {
+    std::vector<std::shared_ptr<MountNode>> out;
+    if(!is_dir) return out;
+    auto held = listing();
+    out.reserve(held->size());
+    for(const auto& kv : *held) out.push_back(std::static_pointer_cast<MountNode>(kv.second));
+    return out;
+}
+
+void MountNode::hostChanged(uint32_t mask, const std::string& name){
+    if(mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+               IN_IGNORED | IN_Q_OVERFLOW))
+        listed = false;
+    std::lock_guard<std::mutex> lock(list_mtx);
+    if(mask & IN_IGNORED) wd = -1;  // watched again on the next listing
+    const ChildIndex* listed_children = cache.current().get();
+    if(name.empty()){
+        stat_fresh = false;
+        if(listed_children)
+            for(const auto& kv : *listed_children) std::static_pointer_cast<MountNode>(kv.second)->stat_fresh = false;
+        return;
+    }
+    if(!listed_children) return;
+    auto it = listed_children->find(std::string_view(name));
+    if(it != listed_children->end()) std::static_pointer_cast<MountNode>(it->second)->stat_fresh = false;
 }
 
 LibrarySymbolNode::LibrarySymbolNode(std::string n, void* ptr, std::string sig)
@@ -99,115 +330,66 @@ LibraryNode::~LibraryNode() {
     }
 }
 
-// RemoteNode implementation
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-#include <netdb.h>
+// ====== RemoteNode ======
+// Typed VFSB requests when the server negotiates them, else the shell
+// commands of the EXEC protocol
 
 RemoteNode::RemoteNode(std::string n, std::string h, int p, std::string rp)
-    : VfsNode(std::move(n), Kind::Mount), host(std::move(h)), port(p),
-      remote_path(std::move(rp)), sock_fd(-1), cache_valid(false) {}
-
-RemoteNode::~RemoteNode() {
-    disconnect();
-}
-
-void RemoteNode::ensureConnected() const {
-    std::lock_guard<std::mutex> lock(conn_mutex);
-    if(sock_fd >= 0) return;
-
-    sock_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if(sock_fd < 0){
-        throw std::runtime_error("remote: failed to create socket");
-    }
-
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-
-    // Try to resolve hostname
-    struct hostent* he = gethostbyname(host.c_str());
-    if(he == nullptr){
-        close(sock_fd);
-        sock_fd = -1;
-        throw std::runtime_error("remote: cannot resolve host " + host);
-    }
+    : VfsNode(std::move(n), Kind::Mount), host(h), port(p), remote_path(std::move(rp)),
+      session(RemoteSession::shared(h, p)) {}
 
-    memcpy(&server_addr.sin_addr, he->h_addr_list[0], he->h_length);
+// Typed like MountNode's children, so that path reads take them for files
+RemoteNode::RemoteNode(std::string_view n, std::shared_ptr<RemoteSession> s, std::string rp, const RemoteEntry& m)
+    : VfsNode(Atom::pin(n), m.type == RemoteEntry::Type::File ? Kind::File : m.type == RemoteEntry::Type::Dir ? Kind::Dir : Kind::Mount),
+      host(s->host()), port(s->port()), remote_path(std::move(rp)), session(std::move(s)),
+      pinned_name(name), meta(m) {}
 
-    if(connect(sock_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0){
-        close(sock_fd);
-        sock_fd = -1;
-        throw std::runtime_error("remote: failed to connect to " + host + ":" + std::to_string(port));
-    }
-
-    TRACE_MSG("RemoteNode connected to ", host, ":", port);
-}
-
-void RemoteNode::disconnect() const {
-    std::lock_guard<std::mutex> lock(conn_mutex);
-    if(sock_fd >= 0){
-        close(sock_fd);
-        sock_fd = -1;
-    }
+RemoteNode::~RemoteNode(){
+    Atom::unpin(pinned_name);
 }
 
-std::string RemoteNode::execRemote(const std::string& command) const {
-    ensureConnected();
-
-    std::lock_guard<std::mutex> lock(conn_mutex);
-
-    // Send: EXEC <command>\n
-    std::string request = "EXEC " + command + "\n";
-    ssize_t sent = send(sock_fd, request.c_str(), request.size(), 0);
-    if(sent < 0 || static_cast<size_t>(sent) != request.size()){
-        disconnect();
-        throw std::runtime_error("remote: failed to send command");
-    }
-
-    // Receive response: OK <output>\n or ERR <message>\n
-    std::string response;
-    char buf[4096];
-    while(true){
-        ssize_t n = recv(sock_fd, buf, sizeof(buf)-1, 0);
-        if(n <= 0){
-            disconnect();
-            throw std::runtime_error("remote: connection closed");
-        }
-        buf[n] = '\0';
-        response += buf;
-        if(response.find('\n') != std::string::npos) break;
-    }
-
-    // Parse response
-    if(response.substr(0, 3) == "OK "){
-        return response.substr(3, response.size() - 4); // strip "OK " and trailing \n
-    } else if(response.substr(0, 4) == "ERR "){
-        throw std::runtime_error("remote error: " + response.substr(4, response.size() - 5));
-    } else {
-        throw std::runtime_error("remote: invalid response format");
-    }
+RemoteEntry RemoteNode::metadata() const {
+    if(session->binary()) return session->stat(remote_path);
+    std::lock_guard<std::mutex> lock(meta_mtx);
+    return meta;
 }
 
 bool RemoteNode::isDir() const {
     try {
+        if(session->binary()) return session->stat(remote_path).type == RemoteEntry::Type::Dir;
+        RemoteEntry e = metadata();
+        if(e.type != RemoteEntry::Type::Missing) return e.type == RemoteEntry::Type::Dir;
         std::string cmd = "test -d " + remote_path + " && echo yes || echo no";
-        std::string result = execRemote(cmd);
-        return result == "yes";
+        std::string result = session->exec(cmd);
+        return result == "yes\n";  // the output keeps echo's newline
     } catch(...) {
         return false;
     }
 }
 
 std::string RemoteNode::read() const {
+    if(session->binary()) return session->read(remote_path);
     std::string cmd = "cat " + remote_path;
-    return execRemote(cmd);
+    return session->exec(cmd);
+}
+
+std::future<RemoteSession::Reply> RemoteNode::readAsync() const {
+    if(!session->binary()) return {};
+    return session->fetch(RemoteSession::Op::Read, remote_path);
+}
+
+size_t RemoteNode::size() const {
+    RemoteEntry e = metadata();
+    if(e.type != RemoteEntry::Type::Missing || session->binary()) return static_cast<size_t>(e.size);
+    return read().size();
 }
 
 void RemoteNode::write(const std::string& s) {
+    if(session->binary()){
+        session->write(remote_path, s);
+        wrote(s.size());
+        return;
+    }
     // Escape single quotes in content
     std::string escaped = s;
     size_t pos = 0;
@@ -216,39 +398,201 @@ void RemoteNode::write(const std::string& s) {
         pos += 4;
     }
     std::string cmd = "echo '" + escaped + "' > " + remote_path;
-    execRemote(cmd);
-    cache_valid = false;
+    session->exec(cmd);
+    wrote(s.size() + 1);  // echo's newline
 }
 
-void RemoteNode::populateCache() const {
-    cache.clear();
-    std::string cmd = "ls " + remote_path;
-    std::string output = execRemote(cmd);
+void RemoteNode::wrote(size_t n) const {
+    cache_valid = false;
+    std::lock_guard<std::mutex> lock(meta_mtx);
+    meta.type = RemoteEntry::Type::File;
+    meta.size = n;
+    meta.mtime_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
 
+void RemoteNode::populateCache() {
+    auto fresh = std::make_shared<ChildIndex>();
+    auto child_path = [&](const std::string& name){
+        auto p = remote_path;
+        if(p.back() != '/') p += '/';
+        return p + name;
+    };
+    std::string output;
+    try {
+        // %Y is the type of a symlink's target, %T@ the mtime as seconds.fraction
+        output = session->exec("find " + remote_path + " -mindepth 1 -maxdepth 1 -printf '%Y %s %T@ %f\\n'");
+    } catch(const std::runtime_error&) {
+        output.clear();  // no GNU find on the server: names only, as ls gives them
+        std::istringstream iss(session->exec("ls " + remote_path));
+        std::string line;
+        while(std::getline(iss, line)){
+            if(line.empty()) continue;
+            auto child = std::make_shared<RemoteNode>(line, session, child_path(line), RemoteEntry());
+            (*fresh)[child->name] = child;
+        }
+        cache.replace(std::move(fresh));
+        return;
+    }
     std::istringstream iss(output);
     std::string line;
     while(std::getline(iss, line)){
-        if(line.empty()) continue;
-        auto child_path = remote_path;
-        if(child_path.back() != '/') child_path += '/';
-        child_path += line;
-        auto child = std::make_shared<RemoteNode>(line, host, port, child_path);
-        cache[line] = child;
+        RemoteEntry e;
+        char type = 0;
+        double mtime = 0;
+        std::istringstream fields(line);
+        if(!(fields >> type >> e.size >> mtime) || fields.get() != ' ' || !std::getline(fields, e.name)) continue;
+        e.type = type == 'd' ? RemoteEntry::Type::Dir : RemoteEntry::Type::File;
+        e.mtime_ns = static_cast<int64_t>(mtime * 1e9);
+        auto child = std::make_shared<RemoteNode>(e.name, session, child_path(e.name), e);
+        (*fresh)[child->name] = child;
+    }
+    cache.replace(std::move(fresh));
+}
+
+// Names, types, sizes and mtimes of the whole directory in one READDIRPLUS
+void RemoteNode::relist(const std::shared_ptr<const std::string>& listing){
+    std::string dir = remote_path.back() == '/' ? remote_path : remote_path + "/";
+    const ChildIndex* old = cache.current().get();
+    auto fresh = std::make_shared<ChildIndex>();
+    for(auto& e : RemoteSession::parseListing(*listing)){
+        Kind k = e.type == RemoteEntry::Type::File ? Kind::File : e.type == RemoteEntry::Type::Dir ? Kind::Dir : Kind::Mount;
+        if(old){
+            auto it = old->find(e.name);
+            if(it != old->end() && it->second->kind == k){
+                // The same node as before, so tags and listings below it stay
+                (*fresh)[it->first] = it->second;
+                continue;
+            }
+        }
+        auto child = std::make_shared<RemoteNode>(e.name, session, dir + e.name, e);
+        (*fresh)[child->name] = child;
     }
+    cache.replace(std::move(fresh));
+    listed_from = listing;
 }
 
-std::map<std::string, std::shared_ptr<VfsNode>>& RemoteNode::children() {
-    if(!cache_valid){
+void RemoteNode::refresh(const std::shared_ptr<const std::string>& leased) {
+    if(leased){
+        // Listed again once the session's lease on the listing ended
+        if(leased != listed_from || !cache.current()) relist(leased);
+        return;
+    }
+    // Marked valid before listing, so a write made meanwhile is not missed
+    if(cache_valid.exchange(true) && cache.current()) return;
+    try {
         populateCache();
-        cache_valid = true;
+    } catch(...) {
+        cache_valid = false;
+        throw;
     }
-    return cache;
+}
+
+ChildIndex& RemoteNode::children() {
+    auto leased = session->binary() ? session->listing(remote_path) : nullptr;
+    std::lock_guard<std::mutex> lock(list_mtx);
+    refresh(leased);
+    return cache.handOut();
+}
+
+std::shared_ptr<const ChildIndex> RemoteNode::listing() {
+    auto leased = session->binary() ? session->listing(remote_path) : nullptr;
+    std::lock_guard<std::mutex> lock(list_mtx);
+    refresh(leased);
+    return cache.current();
+}
+
+// ====== MountPrefetch ======
+
+MountPrefetch::MountPrefetch(std::shared_ptr<MountNode> r, size_t depth, size_t threads)
+    : root(std::move(r)), max_depth(depth),
+      pool(threads ? threads : std::max<size_t>(4, std::thread::hardware_concurrency())),
+      started(std::chrono::steady_clock::now()) {
+    runner = std::thread([this]{
+        {
+            WorkerPool::Group group(pool);
+            group.run([this, &group]{ visit(group, root, 1); });
+            group.wait();
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        finished = std::chrono::steady_clock::now();
+        done = true;
+        done_cv.notify_all();
+    });
+}
+
+MountPrefetch::~MountPrefetch(){
+    stopping = true;
+    if(runner.joinable()) runner.join();
+}
+
+void MountPrefetch::visit(WorkerPool::Group& group, const std::shared_ptr<MountNode>& dir, size_t level){
+    if(stopping) return;
+    struct stat st;
+    if(::stat(dir->host_path.c_str(), &st) == 0){
+        std::lock_guard<std::mutex> lock(seen_mtx);
+        if(!seen.emplace(st.st_dev, st.st_ino).second) return;
+    }
+    std::vector<std::shared_ptr<MountNode>> children;
+    try {
+        children = dir->childNodes();
+    } catch(const std::exception&){
+        ++errors;
+        return;
+    }
+    ++dirs;
+    for(auto& child : children){
+        if(stopping) return;
+        if(child->isDir()){
+            if(max_depth == 0 || level < max_depth)
+                group.run([this, &group, child, level]{ visit(group, child, level + 1); });
+        } else if(child->kind == VfsNode::Kind::File){
+            warm(*child);
+        }
+    }
+}
+
+void MountPrefetch::warm(MountNode& file){
+    try {
+        uint64_t n = file.size();  // cached on the node from now on
+        ++files;
+        if(n == 0 || n >= SMALL_FILE) return;
+        int fd = ::open(file.host_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0){
+            ++errors;
+            return;
+        }
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        ::close(fd);
+        bytes += n;
+    } catch(const std::exception&){
+        ++errors;
+    }
+}
+
+MountPrefetch::Progress MountPrefetch::progress() const {
+    Progress p;
+    p.dirs = dirs;
+    p.files = files;
+    p.bytes = bytes;
+    p.errors = errors;
+    std::lock_guard<std::mutex> lock(mtx);
+    p.done = done;
+    auto until = done ? finished : std::chrono::steady_clock::now();
+    p.seconds = std::chrono::duration<double>(until - started).count();
+    return p;
+}
+
+void MountPrefetch::wait(){
+    std::unique_lock<std::mutex> lock(mtx);
+    done_cv.wait(lock, [this]{ return done; });
 }
 
 // ====== Mount Management ======
 
 void Vfs::mountFilesystem(const std::string& host_path, const std::string& vfs_path, size_t overlayId) {
     TRACE_FN("host=", host_path, ", vfs=", vfs_path, ", overlay=", overlayId);
+    auto guard = writeLock();
 
     if(!mount_allowed){
         throw std::runtime_error("mount: mounting is currently disabled (use mount.allow)");
@@ -284,6 +628,7 @@ void Vfs::mountFilesystem(const std::string& host_path, const std::string& vfs_p
 
 void Vfs::mountLibrary(const std::string& lib_path, const std::string& vfs_path, size_t overlayId) {
     TRACE_FN("lib=", lib_path, ", vfs=", vfs_path, ", overlay=", overlayId);
+    auto guard = writeLock();
 
     if(!mount_allowed){
         throw std::runtime_error("mount.lib: mounting is currently disabled (use mount.allow)");
@@ -319,6 +664,7 @@ void Vfs::mountLibrary(const std::string& lib_path, const std::string& vfs_path,
 
 void Vfs::mountRemote(const std::string& host, int port, const std::string& remote_path, const std::string& vfs_path, size_t overlayId) {
     TRACE_FN("host=", host, ", port=", port, ", remote=", remote_path, ", vfs=", vfs_path, ", overlay=", overlayId);
+    auto guard = writeLock();
 
     if(!mount_allowed){
         throw std::runtime_error("mount.remote: mounting is currently disabled (use mount.allow)");
@@ -346,6 +692,7 @@ void Vfs::mountRemote(const std::string& host, int port, const std::string& remo
 
 void Vfs::unmount(const std::string& vfs_path) {
     TRACE_FN("vfs=", vfs_path);
+    auto guard = writeLock();
 
     auto it = std::find_if(mounts.begin(), mounts.end(),
         [&](const MountInfo& m){ return m.vfs_path == vfs_path; });
@@ -360,19 +707,36 @@ void Vfs::unmount(const std::string& vfs_path) {
     mounts.erase(it);
 }
 
+void Vfs::prefetchMount(const std::string& vfs_path, size_t depth) {
+    TRACE_FN("vfs=", vfs_path, ", depth=", depth);
+    auto guard = writeLock();
+    auto it = std::find_if(mounts.begin(), mounts.end(),
+        [&](const MountInfo& m){ return m.vfs_path == vfs_path; });
+    if(it == mounts.end() || it->type != MountType::Filesystem){
+        throw std::runtime_error("mount: no filesystem mount at path: " + vfs_path);
+    }
+    auto root = std::dynamic_pointer_cast<MountNode>(it->mount_node);
+    if(!root || !root->isDir()) return;  // a single mounted file has nothing to walk
+    it->prefetch = std::make_shared<MountPrefetch>(root, depth);
+}
+
 std::vector<Vfs::MountInfo> Vfs::listMounts() const {
+    auto guard = readLock();
     return mounts;
 }
 
 void Vfs::setMountAllowed(bool allowed) {
+    auto guard = writeLock();
     mount_allowed = allowed;
 }
 
 bool Vfs::isMountAllowed() const {
+    auto guard = readLock();
     return mount_allowed;
 }
 
 std::optional<std::string> Vfs::mapToHostPath(const std::string& vfs_path) const {
+    auto guard = readLock();
     if(vfs_path.empty() || vfs_path.front() != '/') {
         return std::nullopt;
     }
@@ -410,6 +774,7 @@ std::optional<std::string> Vfs::mapToHostPath(const std::string& vfs_path) const
 }
 
 std::optional<std::string> Vfs::mapFromHostPath(const std::string& host_path) const {
+    auto guard = readLock();
     if(host_path.empty()) {
         return std::nullopt;
     }
@@ -1,26 +1,174 @@
 #pragma once
 
 
+struct MountNode;
+
+//
+// Host change notifications for one mounted tree
+//
+// Mount directories keep their listing and their children's stat results
+// until the host changes them. Each listed directory is watched with
+// inotify, and the queued events are read, without blocking, whenever a
+// listing or a size is asked for, so changes made on the host show up on the
+// next access. A directory that cannot be watched (no inotify, or out of
+// watches) is listed again on every access, like an uncached one.
+//
+class MountWatch {
+public:
+    MountWatch();
+    ~MountWatch();
+    MountWatch(const MountWatch&) = delete;
+    MountWatch& operator=(const MountWatch&) = delete;
+
+    // Starts watching dir's host directory; the watch descriptor, or -1
+    int watch(const std::shared_ptr<MountNode>& dir);
+    void forget(int wd);
+    // Marks the nodes the queued host changes concern as stale
+    void drain();
+
+private:
+    int fd = -1;
+    std::mutex mtx;
+    std::unordered_map<int, std::vector<std::weak_ptr<MountNode>>> dirs;
+};
+
+//
+// Listing of a mount or remote directory, rebuilt from outside
+//
+// A new listing replaces the current one rather than changing it, so a
+// reader holding it (VfsNode::listing()) never sees it change or go away.
+// children() returns a plain reference; a listing handed out that way is
+// kept until its node goes, as there is no telling when the reference ends.
+// The owning node serializes access.
+//
+class RebuiltListing {
+public:
+    const std::shared_ptr<ChildIndex>& current() const { return cur; }
+    ChildIndex& handOut(){
+        handed_out = true;
+        return *cur;
+    }
+    void replace(std::shared_ptr<ChildIndex> fresh){
+        if(cur && handed_out) retired.push_back(std::move(cur));
+        cur = std::move(fresh);
+        handed_out = false;
+    }
+
+private:
+    std::shared_ptr<ChildIndex> cur;
+    bool handed_out = false;
+    std::vector<std::shared_ptr<ChildIndex>> retired;
+};
+
+//
+// Host file contents are read with pread into a buffer sized from fstat.
+// Files of MMAP_MIN bytes or more are mapped instead when read through
+// readView(), and the view keeps the mapping alive. Truncating the host file
+// while a view of it is held makes touching the lost pages fault, so a view
+// is only taken for one pass over the contents; whatever keeps them beyond
+// that (context entries, export batches) takes readShared(), which preads.
+//
 struct MountNode : VfsNode {
+    static constexpr size_t MMAP_MIN = 64 * 1024;
     std::string host_path;
-    mutable std::map<std::string, std::shared_ptr<VfsNode>> cache;
     MountNode(std::string n, std::string hp);
-    bool isDir() const override;
+    // A child found while listing a directory; its type is already known, and
+    // its name is pinned (see Atom) rather than interned
+    MountNode(std::string_view n, std::string hp, std::shared_ptr<MountWatch> w, Kind k, bool dir);
+    ~MountNode() override;
+    bool isDir() const override { return is_dir; }
     std::string read() const override;
     void write(const std::string& s) override;
-    std::map<std::string, std::shared_ptr<VfsNode>>& children() override;
+    ContentView readView() const override;
+    size_t size() const override;
+    std::string readRange(size_t offset, size_t len) const override;
+    void append(const std::string& s) override;
+    ChildIndex& children() override;
+    std::shared_ptr<const ChildIndex> listing() override;
+    bool stableChildren() const override { return false; }
+    // The listed children, typed
+    std::vector<std::shared_ptr<MountNode>> childNodes();
+
+    // Called by MountWatch: the listing, or the stat of the child name
+    // (empty for the directory itself), no longer matches the host
+    void hostChanged(uint32_t mask, const std::string& name);
+
+private:
+    std::shared_ptr<MountWatch> watcher;
+    const Atom pinned_name;  // unpinned on destruction; name may be changed by mv
+    const bool is_dir;
+    int wd = -1;
+    std::atomic<bool> listed{false};
+    const bool stat_cached;  // a watched parent reports changes to it
+    mutable std::atomic<bool> stat_fresh{false};
+    mutable std::atomic<uint64_t> cached_size{0};
+    std::mutex list_mtx;
+    RebuiltListing cache;  // under list_mtx
+    // Lists the directory again when the host changed it; under list_mtx
+    void refresh();
+    void populateCache();
+};
+
+//
+// Background warm-up of a mounted host tree
+//
+// Lists the mount's directories down to a depth on a pool of its own, which
+// fills the listing and stat caches of the mount nodes, and has the kernel
+// read files below SMALL_FILE bytes into the page cache, so the first
+// interactive walk or read over the mount finds the data warm. Progress can
+// be read while it runs; destroying it stops the walk and waits for it.
+//
+class MountPrefetch {
+public:
+    static constexpr uint64_t SMALL_FILE = 256 * 1024;
+    struct Progress {
+        size_t dirs = 0;
+        size_t files = 0;
+        uint64_t bytes = 0;  // of the files read ahead
+        size_t errors = 0;
+        bool done = false;
+        double seconds = 0;
+    };
+
+    // depth 0 walks the whole tree, 1 only the mount directory; threads 0
+    // uses at least four, as the walk waits on the disk more than the CPU
+    MountPrefetch(std::shared_ptr<MountNode> root, size_t depth = 0, size_t threads = 0);
+    ~MountPrefetch();
+    MountPrefetch(const MountPrefetch&) = delete;
+    MountPrefetch& operator=(const MountPrefetch&) = delete;
+
+    size_t depth() const { return max_depth; }
+    Progress progress() const;
+    void wait();
+
 private:
-    void populateCache() const;
+    std::shared_ptr<MountNode> root;
+    size_t max_depth;
+    WorkerPool pool;
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> dirs{0}, files{0}, errors{0};
+    std::atomic<uint64_t> bytes{0};
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point finished;
+    bool done = false;
+    mutable std::mutex mtx;
+    std::condition_variable done_cv;
+    std::thread runner;
+    std::set<std::pair<dev_t, ino_t>> seen;  // host directories listed, so symlink loops end
+    std::mutex seen_mtx;
+
+    void visit(WorkerPool::Group& group, const std::shared_ptr<MountNode>& dir, size_t level);
+    void warm(MountNode& file);
 };
 
 struct LibraryNode : VfsNode {
     std::string lib_path;
     void* handle;
-    std::map<std::string, std::shared_ptr<VfsNode>> symbols;
+    ChildIndex symbols;
     LibraryNode(std::string n, std::string lp);
     ~LibraryNode() override;
     bool isDir() const override { return true; }
-    std::map<std::string, std::shared_ptr<VfsNode>>& children() override { return symbols; }
+    ChildIndex& children() override { return symbols; }
 };
 
 struct LibrarySymbolNode : VfsNode {
@@ -33,23 +181,42 @@ struct LibrarySymbolNode : VfsNode {
 struct RemoteNode : VfsNode {
     std::string host;
     int port;
-    std::string remote_path;  // VFS path on remote server
-    mutable int sock_fd;
-    mutable std::map<std::string, std::shared_ptr<VfsNode>> cache;
-    mutable bool cache_valid;
-    mutable std::mutex conn_mutex;
+    std::string remote_path;  // path on the remote server
+    std::shared_ptr<RemoteSession> session;  // shared by every node of the mounts of one server
 
     RemoteNode(std::string n, std::string h, int p, std::string rp);
+    // A child listed by its parent, its name pinned; meta is what the listing
+    // said of it, type Missing when it said nothing
+    RemoteNode(std::string_view n, std::shared_ptr<RemoteSession> s, std::string rp, const RemoteEntry& meta);
     ~RemoteNode() override;
 
     bool isDir() const override;
     std::string read() const override;
     void write(const std::string& s) override;
-    std::map<std::string, std::shared_ptr<VfsNode>>& children() override;
+    size_t size() const override;
+    ChildIndex& children() override;
+    std::shared_ptr<const ChildIndex> listing() override;
+    bool stableChildren() const override { return false; }
+
+    // Sends the READ without waiting, so that reads of several files overlap;
+    // an invalid future when the server only speaks EXEC
+    std::future<RemoteSession::Reply> readAsync() const;
+    // Type, size and mtime: the leased STAT over VFSB, which the parent's
+    // listing seeds; over EXEC what the listing said, type Missing if nothing
+    RemoteEntry metadata() const;
 
 private:
-    void ensureConnected() const;
-    void disconnect() const;
-    std::string execRemote(const std::string& command) const;
-    void populateCache() const;
+    const Atom pinned_name;
+    mutable std::mutex meta_mtx;
+    mutable RemoteEntry meta;
+    std::mutex list_mtx;
+    RebuiltListing cache;  // under list_mtx
+    mutable std::atomic<bool> cache_valid{false};  // over EXEC; VFSB listings are leased by the session
+    std::shared_ptr<const std::string> listed_from;  // the leased listing cache was built from
+    void wrote(size_t n) const;  // meta after a write of n bytes
+    // Lists the directory again when stale: from the leased VFSB listing
+    // when there is one, else over EXEC; under list_mtx
+    void refresh(const std::shared_ptr<const std::string>& leased);
+    void populateCache();
+    void relist(const std::shared_ptr<const std::string>& listing);
 };
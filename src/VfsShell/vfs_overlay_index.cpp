@@ -0,0 +1,178 @@
+#include "VfsShell.h"
+
+// ====== OverlayIndex ======
+
+OverlayIndex::OverlayIndex(const OverlayIndex& o){
+    copyDir(root, o.root);
+}
+
+OverlayIndex& OverlayIndex::operator=(const OverlayIndex& o){
+    if(this != &o){
+        root.children.clear();
+        copyDir(root, o.root);
+    }
+    return *this;
+}
+
+void OverlayIndex::copyDir(Dir& dst, const Dir& src){
+    for(const auto& [name, e] : src.children){
+        Entry& copy = dst.children[name];
+        copy.present = e.present;
+        copy.opaque = e.opaque;
+        if(e.dir){
+            copy.dir = std::make_unique<Dir>();
+            copyDir(*copy.dir, *e.dir);
+        }
+    }
+}
+
+OverlayIndex::Entry* OverlayIndex::entryFor(std::string_view path, Mask bit){
+    Dir* d = &root;
+    Entry* e = nullptr;
+    for(std::string_view part : PathParts(path)){
+        if(e){
+            if(!e->dir) e->dir = std::make_unique<Dir>();
+            d = e->dir.get();
+        }
+        // Names in the tree are interned already, so this rarely takes the atom lock
+        auto atom = Atom::lookup(part);
+        e = &d->children[atom ? *atom : Atom(part)];
+        e->present |= bit;  // every directory on the way exists in the overlay
+    }
+    return e;
+}
+
+void OverlayIndex::fill(Entry& e, const std::shared_ptr<VfsNode>& node, Mask bit,
+                        std::unordered_map<const VfsNode*, Entry*>& seen){
+    e.present |= bit;
+    if(!node->isDir()) return;
+    if(!node->stableChildren()){
+        e.opaque |= bit;
+        return;
+    }
+    auto [it, fresh] = seen.emplace(node.get(), &e);
+    if(!fresh){
+        // Second path to the same directory (or a cycle): both names are opaque
+        e.opaque |= bit;
+        if(it->second) it->second->opaque |= bit;
+        return;
+    }
+    auto& ch = node->children();
+    if(ch.empty()) return;
+    if(!e.dir) e.dir = std::make_unique<Dir>();
+    for(auto& [name, child] : ch) fill(e.dir->children[name], child, bit, seen);
+}
+
+void OverlayIndex::addTree(size_t overlayId, std::string_view path, const std::shared_ptr<VfsNode>& node){
+    if(!indexed(overlayId) || !node) return;
+    const Mask bit = Mask(1) << overlayId;
+    std::unordered_map<const VfsNode*, Entry*> seen;
+    Entry* e = entryFor(path, bit);
+    if(e){
+        // Replaces whatever the overlay had at path
+        e->opaque &= ~bit;
+        if(e->dir){
+            clearDir(*e->dir, bit);
+            if(e->dir->children.empty()) e->dir.reset();
+        }
+        fill(*e, node, bit, seen);
+        return;
+    }
+    // The overlay root itself
+    if(!node->isDir()) return;
+    seen.emplace(node.get(), nullptr);
+    for(auto& [name, child] : node->children()) fill(root.children[name], child, bit, seen);
+}
+
+void OverlayIndex::clearBit(Entry& e, Mask bit){
+    e.present &= ~bit;
+    e.opaque &= ~bit;
+    if(!e.dir) return;
+    clearDir(*e.dir, bit);
+    if(e.dir->children.empty()) e.dir.reset();
+}
+
+void OverlayIndex::clearDir(Dir& d, Mask bit){
+    for(auto it = d.children.begin(); it != d.children.end();){
+        Entry& c = it->second;
+        if((c.present | c.opaque) & bit) clearBit(c, bit);
+        if(!c.present && !c.opaque) it = d.children.erase(it);
+        else ++it;
+    }
+}
+
+void OverlayIndex::removeTree(size_t overlayId, std::string_view path){
+    if(!indexed(overlayId)) return;
+    const Mask bit = Mask(1) << overlayId;
+    Dir* d = &root;
+    Dir* parent = nullptr;
+    std::unordered_map<Atom, Entry>::iterator it;
+    for(std::string_view part : PathParts(path)){
+        if(!d) return;
+        auto atom = Atom::lookup(part);
+        if(!atom) return;
+        it = d->children.find(*atom);
+        if(it == d->children.end()) return;
+        parent = d;
+        d = it->second.dir.get();
+    }
+    if(!parent){
+        clearDir(root, bit);
+        return;
+    }
+    clearBit(it->second, bit);
+    if(!it->second.present && !it->second.opaque) parent->children.erase(it);
+}
+
+void OverlayIndex::markOpaque(size_t overlayId, std::string_view path){
+    if(!indexed(overlayId)) return;
+    if(Entry* e = entryFor(path, Mask(1) << overlayId)) e->opaque |= Mask(1) << overlayId;
+}
+
+void OverlayIndex::eraseOverlay(size_t overlayId){
+    if(!indexed(overlayId)) return;
+    const Mask below = (Mask(1) << overlayId) - 1;
+    auto shift = [&](Mask m){ return (m & below) | ((m >> 1) & ~below); };
+    std::function<void(Dir&)> walk = [&](Dir& d){
+        for(auto it = d.children.begin(); it != d.children.end();){
+            Entry& e = it->second;
+            e.present = shift(e.present);
+            e.opaque = shift(e.opaque);
+            if(e.dir){
+                walk(*e.dir);
+                if(e.dir->children.empty()) e.dir.reset();
+            }
+            if(!e.present && !e.opaque) it = d.children.erase(it);
+            else ++it;
+        }
+    };
+    walk(root);
+}
+
+OverlayIndex::Mask OverlayIndex::candidates(std::string_view path) const {
+    const Dir* d = &root;
+    Mask opaque = 0;
+    Mask present = ~Mask(0);  // "/" is in every overlay
+    for(std::string_view part : PathParts(path)){
+        if(!d) return opaque;
+        auto atom = Atom::lookup(part);
+        if(!atom) return opaque;
+        auto it = d->children.find(*atom);
+        if(it == d->children.end()) return opaque;
+        opaque |= it->second.opaque;
+        present = it->second.present;
+        d = it->second.dir.get();
+    }
+    return present | opaque;
+}
+
+size_t OverlayIndex::entryCount() const {
+    std::function<size_t(const Dir&)> count = [&](const Dir& d){
+        size_t n = d.children.size();
+        for(const auto& kv : d.children){
+            if(kv.second.dir) n += count(*kv.second.dir);
+        }
+        return n;
+    };
+    return count(root);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+//
+// Merged multi-overlay index
+//
+// One trie over the union of all overlay trees: every name records a bitmap of
+// the overlays holding it, so the overlays that may contain a path are found
+// with one walk down the trie instead of one walk per overlay. Vfs keeps it in
+// step with registerOverlay/unregisterOverlay and every mutation it performs.
+//
+// The index only narrows the search; callers still resolve the path in each
+// candidate overlay. Places it cannot follow are marked opaque and always
+// count as candidates for anything below them: mount nodes (contents live on
+// the host) and directories reachable by more than one path (links), which
+// can change under the other name.
+//
+// Overlay ids from MAX_OVERLAYS up are not indexed and are always candidates.
+//
+class OverlayIndex {
+public:
+    static constexpr size_t MAX_OVERLAYS = 64;
+    using Mask = uint64_t;
+
+    OverlayIndex() = default;
+    OverlayIndex(const OverlayIndex& o);
+    OverlayIndex& operator=(const OverlayIndex& o);
+    OverlayIndex(OverlayIndex&&) = default;
+    OverlayIndex& operator=(OverlayIndex&&) = default;
+
+    static bool indexed(size_t overlayId) { return overlayId < MAX_OVERLAYS; }
+
+    // Records node, and everything below it, at path in the overlay, replacing
+    // what the overlay had there
+    void addTree(size_t overlayId, std::string_view path, const std::shared_ptr<VfsNode>& node);
+    // Forgets path and everything below it in the overlay ("/" empties it)
+    void removeTree(size_t overlayId, std::string_view path);
+    void markOpaque(size_t overlayId, std::string_view path);
+    // Drops an overlay; the ids above it move down by one like overlay_stack
+    void eraseOverlay(size_t overlayId);
+
+    // Indexed overlays that may hold path
+    Mask candidates(std::string_view path) const;
+    size_t entryCount() const;
+
+private:
+    struct Dir;
+    struct Entry {
+        Mask present = 0;
+        Mask opaque = 0;
+        std::unique_ptr<Dir> dir;
+    };
+    struct Dir {
+        std::unordered_map<Atom, Entry> children;
+    };
+    Dir root;
+
+    Entry* entryFor(std::string_view path, Mask bit);
+    void fill(Entry& e, const std::shared_ptr<VfsNode>& node, Mask bit,
+              std::unordered_map<const VfsNode*, Entry*>& seen);
+    static void clearBit(Entry& e, Mask bit);
+    static void clearDir(Dir& d, Mask bit);
+    static void copyDir(Dir& dst, const Dir& src);
+};
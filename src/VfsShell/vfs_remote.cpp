@@ -0,0 +1,1282 @@
+#include "VfsShell.h"
+
+// ====== Remote protocol ======
+
+namespace {
+
+constexpr size_t HEADER = 9;
+const char* const HELLO = "HELLO VFSB/1\n";
+const char* const HELLO_OK = "OK VFSB/1\n";
+
+bool send_all(int fd, const char* p, size_t n){
+    while(n){
+        ssize_t w = ::send(fd, p, n, MSG_NOSIGNAL);
+        if(w < 0 && errno == EINTR) continue;
+        if(w <= 0) return false;
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+bool recv_all(int fd, char* p, size_t n){
+    while(n){
+        ssize_t r = ::recv(fd, p, n, 0);
+        if(r < 0 && errno == EINTR) continue;
+        if(r <= 0) return false;
+        p += r;
+        n -= static_cast<size_t>(r);
+    }
+    return true;
+}
+
+void put_u32(std::string& out, uint32_t v){
+    v = htonl(v);
+    out.append(reinterpret_cast<const char*>(&v), 4);
+}
+
+uint32_t get_u32(const char* p){
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+void put_u64(std::string& out, uint64_t v){
+    put_u32(out, static_cast<uint32_t>(v >> 32));
+    put_u32(out, static_cast<uint32_t>(v));
+}
+
+uint64_t get_u64(const char* p){
+    return uint64_t(get_u32(p)) << 32 | get_u32(p + 4);
+}
+
+// type (u8), size (u64), mtime in ns (u64): STAT replies and READDIRPLUS entries
+constexpr size_t ATTRS = 17;
+
+void put_attrs(std::string& out, const struct stat& st){
+    out += static_cast<char>(S_ISDIR(st.st_mode) ? RemoteEntry::Type::Dir : RemoteEntry::Type::File);
+    put_u64(out, static_cast<uint64_t>(st.st_size));
+    put_u64(out, static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000u + static_cast<uint64_t>(st.st_mtim.tv_nsec));
+}
+
+void get_attrs(const char* p, RemoteEntry& e){
+    e.type = static_cast<RemoteEntry::Type>(p[0]);
+    e.size = get_u64(p + 1);
+    e.mtime_ns = static_cast<int64_t>(get_u64(p + 9));
+}
+
+std::string frame(uint32_t id, uint8_t code, std::string_view payload_head, std::string_view payload_tail = {}){
+    std::string out;
+    out.reserve(HEADER + payload_head.size() + payload_tail.size());
+    put_u32(out, static_cast<uint32_t>(payload_head.size() + payload_tail.size()));
+    put_u32(out, id);
+    out += static_cast<char>(code);
+    out.append(payload_head);
+    out.append(payload_tail);
+    return out;
+}
+
+// Reads one frame; false when the connection ended
+bool read_frame(int fd, uint32_t& id, uint8_t& code, std::string& payload){
+    char head[HEADER];
+    if(!recv_all(fd, head, HEADER)) return false;
+    id = get_u32(head + 4);
+    code = static_cast<uint8_t>(head[8]);
+    size_t len = get_u32(head);
+    if(len > RemoteSession::MAX_REPLY) return false;
+    payload.resize(len);
+    return recv_all(fd, payload.data(), payload.size());
+}
+
+} // namespace
+
+// ====== RemoteSession ======
+
+// One socket of the pool, its protocol and its requests in flight
+struct RemoteSession::Connection {
+    struct Pending {
+        std::promise<Reply> promise;
+        Op op;
+        std::string path;  // set when the reply is to be cached
+        std::chrono::steady_clock::time_point sent;
+    };
+
+    RemoteSession& owner;
+    std::mutex mtx;  // connecting, sending a frame, EXEC round trips
+    int fd = -1;
+    bool is_binary = false;
+    bool was_open = false;
+    std::atomic<bool> connected{false};  // cleared as well when the reader saw the end
+    std::atomic<size_t> in_flight{0};
+    std::atomic<int64_t> last_used{0};  // steady clock, ns
+    uint32_t next_id = 1;
+    std::mutex pending_mtx;
+    std::unordered_map<uint32_t, Pending> pending;
+    bool reader_done = false;  // under pending_mtx: nothing registered now is answered
+    std::thread reader;
+
+    explicit Connection(RemoteSession& o) : owner(o) {}
+    ~Connection(){
+        std::lock_guard<std::mutex> lock(mtx);
+        close();
+    }
+
+    static int64_t now(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void connect();
+    void close();
+    void readReplies(int sock);
+    void failPending(const std::string& why);
+    std::future<Reply> send(uint8_t code, std::string_view path, std::string_view data, bool lease);
+    std::string exec(const std::string& command);
+    void check();
+};
+
+void RemoteSession::Connection::connect(){
+    close();
+    fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0) throw std::runtime_error("remote: failed to create socket");
+
+    struct sockaddr_in server_addr;
+    std::memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(owner.port_num);
+    // Not gethostbyname: connections of the pool may open at the same time
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* found = nullptr;
+    if(::getaddrinfo(owner.host_name.c_str(), nullptr, &hints, &found) != 0 || found == nullptr){
+        close();
+        throw std::runtime_error("remote: cannot resolve host " + owner.host_name);
+    }
+    server_addr.sin_addr = reinterpret_cast<struct sockaddr_in*>(found->ai_addr)->sin_addr;
+    ::freeaddrinfo(found);
+    if(::connect(fd, reinterpret_cast<struct sockaddr*>(&server_addr), sizeof(server_addr)) < 0){
+        close();
+        throw std::runtime_error("remote: failed to connect to " + owner.host_name + ":" + std::to_string(owner.port_num));
+    }
+    // Requests are small frames sent back to back; don't hold them for coalescing
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    is_binary = false;
+    if(owner.want_binary){
+        if(!send_all(fd, HELLO, std::strlen(HELLO))){
+            close();
+            throw std::runtime_error("remote: failed to send command");
+        }
+        // Either server answers with one line and then waits for the next request
+        std::string line;
+        char c;
+        while(line.size() < 4096 && recv_all(fd, &c, 1) && c != '\n') line += c;
+        if(line + "\n" == HELLO_OK){
+            is_binary = true;
+        } else if(line.compare(0, 4, "ERR ") != 0){
+            close();
+            throw std::runtime_error("remote: invalid response format");
+        }
+    }
+    if(was_open) ++owner.reconnects;
+    was_open = true;
+    owner.negotiated = is_binary;
+    last_used = now();
+    connected = true;
+    {
+        std::lock_guard<std::mutex> plock(pending_mtx);
+        reader_done = false;
+    }
+    if(is_binary) reader = std::thread([this, sock = fd]{ readReplies(sock); });
+    TRACE_MSG("RemoteSession connected to ", owner.host_name, ":", owner.port_num, is_binary ? " (VFSB)" : " (EXEC)");
+}
+
+void RemoteSession::Connection::close(){
+    if(fd < 0) return;
+    connected = false;
+    ::shutdown(fd, SHUT_RDWR);  // wakes the reader
+    if(reader.joinable()) reader.join();
+    ::close(fd);
+    fd = -1;
+    failPending("remote: connection closed");
+    owner.dropCache();
+}
+
+void RemoteSession::Connection::readReplies(int sock){
+    uint32_t id;
+    uint8_t code;
+    std::string payload;
+    while(read_frame(sock, id, code, payload)){
+        if(id == 0 && static_cast<Status>(code) == Status::Invalidate){
+            owner.invalidate(payload);
+            continue;
+        }
+        Pending p;
+        {
+            std::lock_guard<std::mutex> lock(pending_mtx);
+            auto it = pending.find(id);
+            if(it == pending.end()) continue;
+            p = std::move(it->second);
+            pending.erase(it);
+        }
+        --in_flight;
+        last_used = now();
+        // Cached before the waiter wakes, so that its next fetch hits
+        if(static_cast<Status>(code) == Status::Ok && !p.path.empty()) owner.store(p.op, p.path, payload, p.sent);
+        p.promise.set_value(Reply{static_cast<Status>(code), std::move(payload)});
+        payload = std::string();
+    }
+    {
+        // Together with send()'s registration, so a request either is failed
+        // here or sees the reader gone
+        std::lock_guard<std::mutex> lock(pending_mtx);
+        reader_done = true;
+        connected = false;
+    }
+    failPending("remote: connection closed");
+    owner.dropCache();
+}
+
+void RemoteSession::Connection::failPending(const std::string& why){
+    std::unordered_map<uint32_t, Pending> failed;
+    {
+        std::lock_guard<std::mutex> lock(pending_mtx);
+        failed.swap(pending);
+        in_flight -= failed.size();
+    }
+    for(auto& kv : failed) kv.second.promise.set_exception(std::make_exception_ptr(std::runtime_error(why)));
+}
+
+std::future<RemoteSession::Reply> RemoteSession::Connection::send(uint8_t code, std::string_view path,
+                                                                  std::string_view data, bool lease){
+    // The server would close the connection on it, and the requests with it
+    if(4 + path.size() + data.size() > RemoteServer::MAX_FRAME) throw std::runtime_error("remote: request too large");
+    std::string head;
+    put_u32(head, static_cast<uint32_t>(path.size()));
+    head.append(path);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if(!connected) connect();
+    if(!is_binary) throw std::runtime_error("remote: server does not speak VFSB");
+    uint32_t id = next_id++;
+    if(next_id == 0) next_id = 1;  // 0 carries server notifications
+    std::future<Reply> reply;
+    {
+        // Registered first: the reply can arrive before send() returns
+        std::lock_guard<std::mutex> plock(pending_mtx);
+        if(reader_done) throw std::runtime_error("remote: connection closed");
+        auto& p = pending[id];
+        p.op = static_cast<Op>(code);
+        if(lease) p.path = std::string(path);
+        p.sent = std::chrono::steady_clock::now();
+        reply = p.promise.get_future();
+        ++in_flight;
+    }
+    last_used = now();
+    if(lease) code |= LEASE;
+    if(!send_all(fd, frame(id, code, head, data).data(), HEADER + head.size() + data.size())){
+        close();  // fails the request with the others in flight
+        throw std::runtime_error("remote: failed to send command");
+    }
+    return reply;
+}
+
+std::string RemoteSession::Connection::exec(const std::string& command){
+    std::lock_guard<std::mutex> lock(mtx);
+    if(!connected) connect();
+    if(is_binary) throw std::runtime_error("remote: EXEC is not available on a VFSB connection");
+    ++in_flight;
+    struct Done {
+        Connection& c;
+        ~Done(){ --c.in_flight; c.last_used = now(); }
+    } done{*this};
+
+    // Send: EXEC <command>\n
+    std::string request = "EXEC " + command + "\n";
+    if(!send_all(fd, request.data(), request.size())){
+        close();
+        throw std::runtime_error("remote: failed to send command");
+    }
+
+    // Receive response: OK <output>\n or ERR <message>\n
+    std::string response;
+    char buf[4096];
+    while(true){
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if(n <= 0){
+            close();
+            throw std::runtime_error("remote: connection closed");
+        }
+        response.append(buf, static_cast<size_t>(n));
+        if(response.find('\n') != std::string::npos) break;
+    }
+
+    if(response.substr(0, 3) == "OK "){
+        return response.substr(3, response.size() - 4); // strip "OK " and trailing \n
+    } else if(response.substr(0, 4) == "ERR "){
+        throw std::runtime_error("remote error: " + response.substr(4, response.size() - 5));
+    } else {
+        throw std::runtime_error("remote: invalid response format");
+    }
+}
+
+// Before a connection idle for a while is used again: the server may have
+// closed it, or stopped answering, meanwhile
+void RemoteSession::Connection::check(){
+    if(!connected || in_flight > 0 || now() - last_used < owner.idle_check_ns) return;
+    bool alive, binary;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(fd < 0) return;
+        char c;
+        // Bytes waiting are a live peer: on VFSB the reader may not have
+        // taken an INVALIDATE or a late reply yet. Only the end of the
+        // stream or an error means the server is gone.
+        ssize_t n = ::recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        alive = n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+        binary = is_binary;
+    }
+    if(alive && binary){
+        try {
+            auto pong = send(static_cast<uint8_t>(Op::Ping), {}, {}, false);
+            alive = pong.wait_for(std::chrono::seconds(1)) == std::future_status::ready && pong.get().status == Status::Ok;
+        } catch(const std::exception&) {
+            alive = false;
+        }
+    }
+    if(alive) return;
+    ++owner.failed_checks;
+    std::lock_guard<std::mutex> lock(mtx);
+    close();
+}
+
+RemoteSession::RemoteSession(std::string host, int port, bool binary)
+    : host_name(std::move(host)), port_num(port), want_binary(binary) {}
+
+RemoteSession::~RemoteSession(){
+    conns.clear();  // their readers still use the cache
+}
+
+std::shared_ptr<RemoteSession> RemoteSession::shared(const std::string& host, int port){
+    static std::mutex mtx;
+    static std::map<std::pair<std::string, int>, std::weak_ptr<RemoteSession>> sessions;
+    std::lock_guard<std::mutex> lock(mtx);
+    auto& slot = sessions[{host, port}];
+    auto s = slot.lock();
+    if(!s){
+        s = std::make_shared<RemoteSession>(host, port);
+        slot = s;
+    }
+    return s;
+}
+
+RemoteSession::Connection& RemoteSession::pick(){
+    std::lock_guard<std::mutex> lock(pool_mtx);
+    Connection* best = nullptr;
+    Connection* closed = nullptr;
+    for(auto& c : conns){
+        if(!c->connected){
+            if(!closed || c->in_flight < closed->in_flight) closed = c.get();
+        } else if(!best || c->in_flight < best->in_flight){
+            best = c.get();
+        }
+    }
+    if(best && best->in_flight == 0) return *best;
+    // All busy: a closed connection is opened again before the pool grows
+    if(closed) return *closed;
+    if(!best || conns.size() < pool_size){
+        conns.push_back(std::make_unique<Connection>(*this));
+        return *conns.back();
+    }
+    return *best;
+}
+
+bool RemoteSession::binary(){
+    int n = negotiated;
+    if(n >= 0) return n;
+    Connection& c = pick();
+    std::lock_guard<std::mutex> lock(c.mtx);
+    if(!c.connected) c.connect();
+    return c.is_binary;
+}
+
+void RemoteSession::setPoolSize(size_t n){
+    std::lock_guard<std::mutex> lock(pool_mtx);
+    pool_size = std::max<size_t>(1, n);
+}
+
+void RemoteSession::setIdleCheck(std::chrono::milliseconds after){
+    idle_check_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(after).count();
+}
+
+RemoteSession::PoolStats RemoteSession::poolStats(){
+    PoolStats s;
+    std::lock_guard<std::mutex> lock(pool_mtx);
+    for(auto& c : conns) s.open += c->connected;
+    s.size = pool_size;
+    s.requests = requests;
+    s.reconnects = reconnects;
+    s.failed_checks = failed_checks;
+    return s;
+}
+
+std::future<RemoteSession::Reply> RemoteSession::request(Op op, std::string_view path, std::string_view data){
+    return send(op, path, data, false);
+}
+
+std::future<RemoteSession::Reply> RemoteSession::send(Op op, std::string_view path, std::string_view data, bool lease){
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx);
+        lease = lease && lease_ttl.count() > 0;
+    }
+    ++requests;
+    for(int attempt = 0;; ++attempt){
+        Connection& c = pick();
+        c.check();
+        try {
+            return c.send(static_cast<uint8_t>(op), path, data, lease);
+        } catch(const std::runtime_error&){
+            // Not sent: once more, on a connection opened again
+            if(attempt > 0) throw;
+        }
+    }
+}
+
+std::string RemoteSession::exec(const std::string& command){
+    ++requests;
+    Connection& c = pick();
+    c.check();
+    return c.exec(command);
+}
+
+std::string RemoteSession::replyData(std::future<Reply> reply){
+    Reply r = reply.get();
+    if(r.status != Status::Ok) throw std::runtime_error("remote error: " + r.payload);
+    return std::move(r.payload);
+}
+
+// ====== Lease cache ======
+
+std::string RemoteSession::cacheKey(Op op, std::string_view path){
+    std::string key(1, static_cast<char>(op));
+    key.append(path);
+    return key;
+}
+
+std::shared_ptr<const std::string> RemoteSession::cached(Op op, const std::string& path){
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    auto it = cache.find(cacheKey(op, path));
+    if(it != cache.end() && it->second.expires <= std::chrono::steady_clock::now()){
+        eraseLocked(it->first);
+        it = cache.end();
+    }
+    if(it == cache.end()){
+        ++stats.misses;
+        return nullptr;
+    }
+    ++stats.hits;
+    return it->second.payload;
+}
+
+void RemoteSession::store(Op op, const std::string& path, const std::string& payload,
+                          std::chrono::steady_clock::time_point sent){
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    // The lease began when the request went out
+    auto expires = sent + lease_ttl;
+    if(expires <= std::chrono::steady_clock::now()) return;
+    std::string key = cacheKey(op, path);
+    eraseLocked(key);
+    // The server has nothing to watch for a path that does not exist, so
+    // nothing would tell that it was created
+    if(op == Op::Stat && !payload.empty() && static_cast<RemoteEntry::Type>(payload[0]) == RemoteEntry::Type::Missing)
+        return;
+    Cached entry{std::make_shared<const std::string>(payload), expires, {}};
+    if(op == Op::ReadDirPlus){
+        // Each entry's attributes are its STAT reply
+        std::string dir = path.empty() || path.back() == '/' ? path : path + "/";
+        for(size_t pos = 0; pos + ATTRS + 4 <= payload.size();){
+            size_t len = get_u32(payload.data() + pos + ATTRS);
+            if(pos + ATTRS + 4 + len > payload.size()) break;
+            std::string child = cacheKey(Op::Stat, dir + payload.substr(pos + ATTRS + 4, len));
+            eraseLocked(child);
+            cache[child] = Cached{std::make_shared<const std::string>(payload.substr(pos, ATTRS)), expires, {}};
+            entry.seeded.push_back(std::move(child));
+            pos += ATTRS + 4 + len;
+        }
+    }
+    cache[key] = std::move(entry);
+}
+
+void RemoteSession::eraseLocked(const std::string& key){
+    auto it = cache.find(key);
+    if(it == cache.end()) return;
+    auto seeded = std::move(it->second.seeded);
+    cache.erase(it);
+    for(const auto& s : seeded) cache.erase(s);
+}
+
+void RemoteSession::invalidate(const std::string& path){
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    ++stats.invalidations;
+    for(Op op : {Op::Read, Op::Stat, Op::ReadDirPlus}) eraseLocked(cacheKey(op, path));
+}
+
+void RemoteSession::dropCache(){
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    cache.clear();
+}
+
+void RemoteSession::setLeaseTtl(std::chrono::milliseconds ttl){
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    lease_ttl = ttl;
+    cache.clear();  // leased for the old term
+}
+
+RemoteSession::CacheStats RemoteSession::cacheStats(){
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    stats.entries = cache.size();
+    return stats;
+}
+
+std::future<RemoteSession::Reply> RemoteSession::fetch(Op op, const std::string& path){
+    if(auto hit = cached(op, path)){
+        std::promise<Reply> ready;
+        ready.set_value(Reply{Status::Ok, *hit});
+        return ready.get_future();
+    }
+    return send(op, path, {}, true);
+}
+
+std::shared_ptr<const std::string> RemoteSession::listing(const std::string& path){
+    if(auto hit = cached(Op::ReadDirPlus, path)) return hit;
+    std::string data = replyData(send(Op::ReadDirPlus, path, {}, true));
+    {
+        // The object store() made, unless an invalidation beat us to it
+        std::lock_guard<std::mutex> lock(cache_mtx);
+        auto it = cache.find(cacheKey(Op::ReadDirPlus, path));
+        if(it != cache.end() && *it->second.payload == data) return it->second.payload;
+    }
+    return std::make_shared<const std::string>(std::move(data));
+}
+
+std::string RemoteSession::read(const std::string& path){
+    return replyData(fetch(Op::Read, path));
+}
+
+void RemoteSession::write(const std::string& path, std::string_view data){
+    replyData(request(Op::Write, path, data));
+    // Ours to drop at once; the server's notice follows
+    invalidate(path);
+    auto slash = path.find_last_of('/');
+    if(slash != std::string::npos) invalidate(slash == 0 ? "/" : path.substr(0, slash));
+}
+
+RemoteEntry RemoteSession::stat(const std::string& path){
+    std::string data = replyData(fetch(Op::Stat, path));
+    if(data.size() < ATTRS) throw std::runtime_error("remote: invalid response format");
+    RemoteEntry e;
+    get_attrs(data.data(), e);
+    return e;
+}
+
+std::vector<RemoteEntry> RemoteSession::readDir(const std::string& path){
+    std::string data = replyData(request(Op::ReadDir, path));
+    std::vector<RemoteEntry> out;
+    for(size_t pos = 0; pos < data.size();){
+        if(pos + 5 > data.size()) throw std::runtime_error("remote: invalid response format");
+        RemoteEntry e;
+        e.type = static_cast<RemoteEntry::Type>(data[pos]);
+        size_t len = get_u32(data.data() + pos + 1);
+        pos += 5;
+        if(pos + len > data.size()) throw std::runtime_error("remote: invalid response format");
+        e.name = data.substr(pos, len);
+        pos += len;
+        out.push_back(std::move(e));
+    }
+    return out;
+}
+
+std::vector<RemoteEntry> RemoteSession::readDirPlus(const std::string& path){
+    return parseListing(*listing(path));
+}
+
+std::vector<RemoteEntry> RemoteSession::parseListing(const std::string& data){
+    std::vector<RemoteEntry> out;
+    for(size_t pos = 0; pos < data.size();){
+        if(pos + ATTRS + 4 > data.size()) throw std::runtime_error("remote: invalid response format");
+        RemoteEntry e;
+        get_attrs(data.data() + pos, e);
+        size_t len = get_u32(data.data() + pos + ATTRS);
+        pos += ATTRS + 4;
+        if(pos + len > data.size()) throw std::runtime_error("remote: invalid response format");
+        e.name = data.substr(pos, len);
+        pos += len;
+        out.push_back(std::move(e));
+    }
+    return out;
+}
+
+// ====== Remote server ======
+
+namespace {
+
+std::string errno_text(const std::string& path){
+    return path + ": " + std::strerror(errno);
+}
+
+// The reply payload for one request; throws the ERR message
+std::string handle_binary(RemoteSession::Op op, const std::string& path, std::string_view data){
+    switch(op){
+    case RemoteSession::Op::Read: {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0) throw std::runtime_error(errno_text(path));
+        struct stat st;
+        std::string out;
+        int bad = ::fstat(fd, &st) != 0 ? errno
+                : S_ISDIR(st.st_mode) ? EISDIR
+                : S_ISREG(st.st_mode) && static_cast<uint64_t>(st.st_size) > RemoteSession::MAX_REPLY ? EFBIG
+                : 0;
+        if(bad){
+            ::close(fd);
+            errno = bad;
+            throw std::runtime_error(errno_text(path));
+        }
+        out.resize(S_ISREG(st.st_mode) ? static_cast<size_t>(st.st_size) + 1 : 4096);
+        size_t got = 0;
+        for(;;){
+            if(got > RemoteSession::MAX_REPLY){  // grew, or a stream
+                ::close(fd);
+                errno = EFBIG;
+                throw std::runtime_error(errno_text(path));
+            }
+            if(got == out.size()) out.resize(out.size() * 2);
+            ssize_t n = ::read(fd, out.data() + got, out.size() - got);
+            if(n < 0 && errno == EINTR) continue;
+            if(n < 0){
+                std::string msg = errno_text(path);
+                ::close(fd);
+                throw std::runtime_error(msg);
+            }
+            if(n == 0) break;
+            got += static_cast<size_t>(n);
+        }
+        ::close(fd);
+        out.resize(got);
+        return out;
+    }
+    case RemoteSession::Op::Write: {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if(fd < 0) throw std::runtime_error(errno_text(path));
+        for(size_t done = 0; done < data.size();){
+            ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+            if(n < 0 && errno == EINTR) continue;
+            if(n < 0){
+                std::string msg = errno_text(path);
+                ::close(fd);
+                throw std::runtime_error(msg);
+            }
+            done += static_cast<size_t>(n);
+        }
+        if(::close(fd) != 0) throw std::runtime_error(errno_text(path));
+        return std::string();
+    }
+    case RemoteSession::Op::Stat: {
+        struct stat st;
+        std::string out;
+        if(::stat(path.c_str(), &st) == 0){
+            put_attrs(out, st);
+        } else if(errno == ENOENT || errno == ENOTDIR){
+            out.assign(ATTRS, '\0');  // Missing
+        } else {
+            throw std::runtime_error(errno_text(path));
+        }
+        return out;
+    }
+    case RemoteSession::Op::ReadDir: {
+        DIR* dir = ::opendir(path.c_str());
+        if(!dir) throw std::runtime_error(errno_text(path));
+        std::string out;
+        while(struct dirent* de = ::readdir(dir)){
+            std::string_view name(de->d_name);
+            if(name == "." || name == "..") continue;
+            bool is_dir = de->d_type == DT_DIR;
+            if(de->d_type == DT_UNKNOWN || de->d_type == DT_LNK){
+                struct stat st;
+                std::string child = path + (path.empty() || path.back() != '/' ? "/" : "") + std::string(name);
+                is_dir = ::stat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+            }
+            out += static_cast<char>(is_dir ? RemoteEntry::Type::Dir : RemoteEntry::Type::File);
+            put_u32(out, static_cast<uint32_t>(name.size()));
+            out.append(name);
+        }
+        ::closedir(dir);
+        return out;
+    }
+    case RemoteSession::Op::Ping:
+        return {};
+    case RemoteSession::Op::ReadDirPlus: {
+        DIR* dir = ::opendir(path.c_str());
+        if(!dir) throw std::runtime_error(errno_text(path));
+        std::string out;
+        while(struct dirent* de = ::readdir(dir)){
+            std::string_view name(de->d_name);
+            if(name == "." || name == "..") continue;
+            // Symlinks as their targets, dangling ones as themselves
+            struct stat st;
+            if(::fstatat(::dirfd(dir), de->d_name, &st, 0) != 0 &&
+               ::fstatat(::dirfd(dir), de->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+            put_attrs(out, st);
+            put_u32(out, static_cast<uint32_t>(name.size()));
+            out.append(name);
+        }
+        ::closedir(dir);
+        return out;
+    }
+    }
+    throw std::runtime_error("unknown op " + std::to_string(static_cast<int>(op)));
+}
+
+std::string handle_exec(const std::string& request){
+    try {
+        // Parse: EXEC <command>\n
+        if(request.substr(0, 5) != "EXEC "){
+            return "ERR invalid command format\n";
+        }
+
+        std::string command = request.substr(5);
+        if(!command.empty() && command.back() == '\n'){
+            command.pop_back();
+        }
+
+        // Execute command as shell command and capture output
+        FILE* pipe = popen(command.c_str(), "r");
+        if(!pipe){
+            return "ERR failed to execute command\n";
+        }
+
+        std::string output;
+        char buf[4096];
+        while(fgets(buf, sizeof(buf), pipe) != nullptr){
+            output += buf;
+        }
+
+        int status = pclose(pipe);
+        if(status != 0){
+            return "ERR command failed with status " + std::to_string(status) + "\n";
+        }
+
+        return "OK " + output + "\n";
+    } catch(const std::exception& e){
+        return "ERR " + std::string(e.what()) + "\n";
+    } catch(...){
+        return "ERR internal error\n";
+    }
+}
+
+} // namespace
+
+// ====== RemoteServer ======
+
+namespace {
+
+// epoll keys; connections count up from FIRST_CONN
+constexpr uint64_t LISTEN_KEY = 0, WAKE_KEY = 1, LEASES_KEY = 2, FIRST_CONN = 3;
+
+} // namespace
+
+struct RemoteServer::Connection {
+    enum class Mode { Hello, Exec, Binary };
+    int fd;
+    Mode mode = Mode::Hello;
+    // Unparsed requests and unsent replies, consumed from the offsets
+    std::string in, out;
+    size_t in_pos = 0, out_pos = 0;
+    std::string notes;  // invalidations held back while a request runs
+    bool busy = false;     // a request of it runs on a worker
+    bool waiting = false;  // in the stalled queue
+    bool eof = false;      // the client sent all it will
+    uint32_t events = 0;   // epoll interest
+
+    explicit Connection(int f) : fd(f) {}
+
+    size_t buffered() const { return in.size() - in_pos; }
+    size_t unsent() const { return out.size() - out_pos; }
+
+    // Settles the protocol as soon as the input tells it, so that no more
+    // than the HELLO line is read before the limits of the mode apply
+    void negotiate(){
+        if(mode != Mode::Hello) return;
+        size_t hello = std::strlen(HELLO);
+        size_t n = std::min(buffered(), hello);
+        if(in.compare(in_pos, n, HELLO, n) != 0){
+            mode = Mode::Exec;
+        } else if(n == hello){
+            take(hello);
+            out += HELLO_OK;
+            mode = Mode::Binary;
+        } else if(eof){
+            mode = Mode::Exec;  // a cut-off HELLO, which EXEC will refuse
+        }
+    }
+
+    // Length of the request at the front of the input: 0 while incomplete,
+    // npos when it can never be parsed
+    size_t next() const {
+        const char* p = in.data() + in_pos;
+        size_t n = buffered();
+        switch(mode){
+        case Mode::Hello:
+            return 0;  // shorter than HELLO, see negotiate()
+        case Mode::Exec: {
+            size_t nl = in.find('\n', in_pos);
+            if(nl != std::string::npos) return nl + 1 - in_pos;
+            return n > MAX_FRAME ? std::string::npos : 0;
+        }
+        case Mode::Binary: {
+            if(n < HEADER) return 0;
+            size_t len = get_u32(p);
+            if(len > MAX_FRAME) return std::string::npos;
+            return n < HEADER + len ? 0 : HEADER + len;
+        }
+        }
+        return std::string::npos;
+    }
+    std::string take(size_t n){
+        std::string request = in.substr(in_pos, n);
+        in_pos += n;
+        if(in_pos == in.size()){
+            in.clear();
+            in_pos = 0;
+        }
+        return request;
+    }
+};
+
+// Watches for the paths connections hold leases on, one inotify instance
+// for all of them
+class RemoteServer::Leases {
+public:
+    static constexpr size_t MAX_WATCHES = 4096;  // per connection; beyond it, only the client's TTL bounds staleness
+    int fd;
+
+    Leases() : fd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {}
+    ~Leases(){ if(fd >= 0) ::close(fd); }
+    Leases(const Leases&) = delete;
+    Leases& operator=(const Leases&) = delete;
+
+    // Before the request is answered, so that no change after it is missed
+    void watch(uint64_t conn, const std::string& path){
+        auto& mine = held[conn];
+        if(fd < 0 || mine.size() >= MAX_WATCHES || mine.count(path)) return;
+        int wd = ::inotify_add_watch(fd, path.c_str(), IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE |
+                                     IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+        if(wd < 0) return;
+        watches[wd][conn].push_back(path);
+        mine.emplace(path, wd);
+    }
+
+    // INVALIDATE frames for what changed since the last call, by connection;
+    // the watches that fired are dropped, a client leases again when it asks again.
+    // When the kernel's queue overflowed, events were lost: every lease is
+    // invalidated and every watch dropped.
+    std::unordered_map<uint64_t, std::string> drain(){
+        std::unordered_map<uint64_t, std::string> out;
+        std::unordered_map<uint64_t, std::unordered_set<std::string>> sent;
+        std::vector<int> fired;
+        bool overflow = false;
+        auto notify = [&](uint64_t conn, const std::string& path){
+            if(sent[conn].insert(path).second)
+                out[conn] += frame(0, static_cast<uint8_t>(RemoteSession::Status::Invalidate), path);
+        };
+        alignas(struct inotify_event) char buf[16384];
+        for(ssize_t n; (n = ::read(fd, buf, sizeof(buf))) > 0;){
+            for(char* p = buf; p < buf + n;){
+                auto* ev = reinterpret_cast<struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + ev->len;
+                if(ev->mask & IN_Q_OVERFLOW) overflow = true;
+                auto it = watches.find(ev->wd);
+                if(it == watches.end()) continue;
+                if(!(ev->mask & IN_IGNORED)){
+                    for(const auto& [conn, paths] : it->second){
+                        for(const auto& path : paths){
+                            notify(conn, path);
+                            if(ev->len) notify(conn, path + (path.back() == '/' ? "" : "/") + ev->name);
+                        }
+                    }
+                }
+                fired.push_back(ev->wd);
+            }
+        }
+        if(overflow){
+            fired.clear();
+            for(const auto& [wd, by_conn] : watches){
+                for(const auto& [conn, paths] : by_conn)
+                    for(const auto& path : paths) notify(conn, path);
+                fired.push_back(wd);
+            }
+        }
+        for(int wd : fired) remove(wd);
+        return out;
+    }
+
+    // The connection closed
+    void forget(uint64_t conn){
+        auto it = held.find(conn);
+        if(it == held.end()) return;
+        for(const auto& kv : it->second){
+            auto w = watches.find(kv.second);
+            if(w == watches.end()) continue;
+            w->second.erase(conn);
+            if(w->second.empty()) remove(kv.second);
+        }
+        held.erase(conn);
+    }
+
+private:
+    // by watch descriptor, then by connection: the paths it leased there
+    std::unordered_map<int, std::unordered_map<uint64_t, std::vector<std::string>>> watches;
+    std::unordered_map<uint64_t, std::unordered_map<std::string, int>> held;  // by connection: path to descriptor
+
+    void remove(int wd){
+        auto it = watches.find(wd);
+        if(it == watches.end()) return;
+        ::inotify_rm_watch(fd, wd);
+        for(const auto& kv : it->second){
+            auto h = held.find(kv.first);
+            if(h == held.end()) continue;
+            for(const auto& path : kv.second) h->second.erase(path);
+        }
+        watches.erase(it);
+    }
+};
+
+RemoteServer::RemoteServer(int fd, size_t workers, size_t max)
+    : listen_fd(fd), max_running(0), next_conn(FIRST_CONN), leases(std::make_unique<Leases>()), pool(workers) {
+    max_running = max ? max : 4 * pool.size();
+    epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(epoll_fd < 0 || wake_fd < 0){
+        if(epoll_fd >= 0) ::close(epoll_fd);
+        if(wake_fd >= 0) ::close(wake_fd);
+        throw std::runtime_error("remote server: failed to create epoll instance");
+    }
+    int flags = ::fcntl(listen_fd, F_GETFL);
+    ::fcntl(listen_fd, F_SETFL, flags | O_NONBLOCK);
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = LISTEN_KEY;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+    ev.data.u64 = WAKE_KEY;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+    if(leases->fd >= 0){
+        ev.data.u64 = LEASES_KEY;
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, leases->fd, &ev);
+    }
+}
+
+RemoteServer::~RemoteServer(){
+    jobs.wait();  // their replies go nowhere, but they wake us on the way
+    for(auto& kv : conns) ::close(kv.second->fd);
+    ::close(wake_fd);
+    ::close(epoll_fd);
+}
+
+void RemoteServer::wake(){
+    uint64_t one = 1;
+    ssize_t w = ::write(wake_fd, &one, sizeof(one));
+    (void)w;  // a full counter wakes the loop just as well
+}
+
+void RemoteServer::stop(){
+    stopping = true;
+    wake();
+}
+
+void RemoteServer::disconnectAll(){
+    dropping = true;
+    wake();
+}
+
+RemoteServer::Stats RemoteServer::stats() const {
+    Stats s;
+    s.connections = n_connections;
+    s.accepted = n_accepted;
+    s.requests = n_requests;
+    s.stalls = n_stalls;
+    return s;
+}
+
+void RemoteServer::run(){
+    std::vector<struct epoll_event> events(256);
+    while(!stopping){
+        int n = ::epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            throw std::runtime_error("remote server: epoll_wait failed");
+        }
+        for(int i = 0; i < n; ++i){
+            uint64_t key = events[i].data.u64;
+            if(key == LISTEN_KEY){
+                accept();
+            } else if(key == WAKE_KEY){
+                uint64_t count;
+                while(::read(wake_fd, &count, sizeof(count)) > 0){}
+                complete();
+            } else if(key == LEASES_KEY){
+                notify();
+            } else {
+                auto it = conns.find(key);
+                if(it == conns.end()) continue;  // closed earlier in this batch
+                Connection& c = *it->second;
+                if(events[i].events & (EPOLLERR | EPOLLHUP)){
+                    close(key);
+                    continue;
+                }
+                if(events[i].events & EPOLLIN) receive(key, c);
+                else settle(key, c);  // EPOLLOUT
+            }
+        }
+        if(dropping.exchange(false)){
+            std::vector<uint64_t> ids;
+            for(const auto& kv : conns) ids.push_back(kv.first);
+            for(uint64_t id : ids) close(id);
+        }
+    }
+}
+
+void RemoteServer::accept(){
+    while(true){
+        int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0){
+            if(errno == EINTR || errno == ECONNABORTED) continue;
+            if((errno == EMFILE || errno == ENFILE) && !conns.empty()){
+                // Out of descriptors: take no one else until a connection closes
+                struct epoll_event ev;
+                std::memset(&ev, 0, sizeof(ev));
+                ev.data.u64 = LISTEN_KEY;
+                ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, listen_fd, &ev);
+                accepting = false;
+            }
+            return;
+        }
+        // Replies to pipelined requests are small writes back to back
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        uint64_t id = next_conn++;
+        auto c = std::make_unique<Connection>(fd);
+        c->events = EPOLLIN;
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = c->events;
+        ev.data.u64 = id;
+        if(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0){
+            ::close(fd);
+            continue;
+        }
+        conns.emplace(id, std::move(c));
+        ++n_connections;
+        ++n_accepted;
+        TRACE_MSG("RemoteServer accepted connection ", id);
+    }
+}
+
+void RemoteServer::close(uint64_t id){
+    auto it = conns.find(id);
+    if(it == conns.end()) return;
+    leases->forget(id);
+    ::close(it->second->fd);  // leaves the epoll set with it
+    conns.erase(it);
+    --n_connections;
+    if(!accepting){
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = LISTEN_KEY;
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, listen_fd, &ev);
+        accepting = true;
+    }
+}
+
+void RemoteServer::receive(uint64_t id, Connection& c){
+    char buf[65536];
+    // A request longer than the cap is read whole all the same
+    while(!c.eof && (c.buffered() < MAX_BUFFERED || c.next() == 0)){
+        ssize_t r = ::recv(c.fd, buf, sizeof(buf), 0);
+        if(r > 0){
+            if(c.in_pos > 0 && c.in_pos >= c.in.size() / 2){
+                c.in.erase(0, c.in_pos);
+                c.in_pos = 0;
+            }
+            c.in.append(buf, static_cast<size_t>(r));
+            c.negotiate();
+            continue;
+        }
+        if(r < 0 && errno == EINTR) continue;
+        if(r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if(r < 0){
+            close(id);
+            return;
+        }
+        c.eof = true;  // what it sent before still gets its replies
+    }
+    pump(id, c);
+}
+
+// Starts the connection's next request if it has one and a worker is free;
+// turn is set when it comes from the stalled queue
+void RemoteServer::pump(uint64_t id, Connection& c, bool turn){
+    c.negotiate();
+    while(!c.busy && !(c.waiting && !turn) && c.unsent() < MAX_BUFFERED){
+        size_t n = c.next();
+        if(n == std::string::npos){
+            close(id);
+            return;
+        }
+        if(n == 0) break;
+        // Others waited first
+        if(running >= max_running || (!turn && !stalled.empty())){
+            if(!c.waiting){
+                c.waiting = true;
+                stalled.push_back(id);
+                ++n_stalls;
+            }
+            break;
+        }
+        c.waiting = false;
+        dispatch(id, c);
+    }
+    settle(id, c);
+}
+
+// Takes the request at the front of the input to a worker, or answers a
+// malformed one at once
+void RemoteServer::dispatch(uint64_t id, Connection& c){
+    ++n_requests;
+    std::string request = c.take(c.next());
+    std::function<std::string()> work;
+    if(c.mode == Connection::Mode::Exec){
+        work = [request = std::move(request)]{ return handle_exec(request); };
+    } else {
+        uint32_t rid = get_u32(request.data() + 4);
+        uint8_t code = static_cast<uint8_t>(request[8]);
+        std::string_view payload = std::string_view(request).substr(HEADER);
+        if(payload.size() < 4 || 4 + get_u32(payload.data()) > payload.size()){
+            c.out += frame(rid, static_cast<uint8_t>(RemoteSession::Status::Err), "malformed request");
+            return;
+        }
+        std::string path(payload.substr(4, get_u32(payload.data())));
+        if(code & RemoteSession::LEASE) leases->watch(id, path);
+        auto op = static_cast<RemoteSession::Op>(code & ~RemoteSession::LEASE);
+        work = [request = std::move(request), rid, op, path = std::move(path)]{
+            std::string_view data = std::string_view(request).substr(HEADER + 4 + path.size());
+            try {
+                std::string reply = handle_binary(op, path, data);
+                if(reply.size() > RemoteSession::MAX_REPLY) throw std::runtime_error(path + ": reply too large");
+                return frame(rid, static_cast<uint8_t>(RemoteSession::Status::Ok), reply);
+            } catch(const std::exception& e){
+                return frame(rid, static_cast<uint8_t>(RemoteSession::Status::Err), e.what());
+            }
+        };
+    }
+    c.busy = true;
+    ++running;
+    jobs.run([this, id, work = std::move(work)]{
+        std::string reply = work();  // both handlers answer their errors themselves
+        {
+            std::lock_guard<std::mutex> lock(finished_mtx);
+            finished.push_back(Finished{id, std::move(reply)});
+        }
+        wake();
+    });
+}
+
+// Replies the workers finished go out, and their workers to who waited
+void RemoteServer::complete(){
+    std::vector<Finished> done;
+    {
+        std::lock_guard<std::mutex> lock(finished_mtx);
+        done.swap(finished);
+    }
+    std::vector<uint64_t> ready;
+    for(auto& f : done){
+        --running;
+        auto it = conns.find(f.conn);
+        if(it == conns.end()) continue;
+        Connection& c = *it->second;
+        c.busy = false;
+        c.out += f.reply;
+        c.out += c.notes;
+        c.notes.clear();
+        ready.push_back(f.conn);
+    }
+    while(running < max_running && !stalled.empty()){
+        uint64_t id = stalled.front();
+        stalled.pop_front();
+        auto it = conns.find(id);
+        if(it == conns.end()) continue;
+        it->second->waiting = false;
+        pump(id, *it->second, true);
+    }
+    for(uint64_t id : ready){
+        auto it = conns.find(id);
+        if(it != conns.end()) pump(id, *it->second);
+    }
+}
+
+void RemoteServer::notify(){
+    for(auto& [id, notes] : leases->drain()){
+        auto it = conns.find(id);
+        if(it == conns.end()) continue;
+        Connection& c = *it->second;
+        // After the reply of a request running now, as the client expects
+        if(c.busy){
+            c.notes += notes;
+        } else {
+            c.out += notes;
+            settle(id, c);
+        }
+    }
+}
+
+// Sends what it can, closes a connection that is done, and updates what
+// epoll waits for on it
+void RemoteServer::settle(uint64_t id, Connection& c){
+    while(c.unsent() > 0){
+        ssize_t w = ::send(c.fd, c.out.data() + c.out_pos, c.unsent(), MSG_NOSIGNAL);
+        if(w > 0){
+            c.out_pos += static_cast<size_t>(w);
+            continue;
+        }
+        if(w < 0 && errno == EINTR) continue;
+        if(w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        close(id);
+        return;
+    }
+    if(c.out_pos == c.out.size()){
+        c.out.clear();
+        c.out_pos = 0;
+    } else if(c.out_pos >= MAX_BUFFERED){
+        c.out.erase(0, c.out_pos);
+        c.out_pos = 0;
+    }
+    if(c.eof && !c.busy && !c.waiting && c.unsent() == 0 && c.next() == 0){
+        close(id);
+        return;
+    }
+    // Read while the input has room; the unsent replies hold it back too,
+    // since pump() takes no request past them
+    uint32_t events = 0;
+    if(!c.eof && (c.buffered() < MAX_BUFFERED || c.next() == 0)) events |= EPOLLIN;
+    if(c.unsent() > 0) events |= EPOLLOUT;
+    if(events == c.events) return;
+    c.events = events;
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = id;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.fd, &ev);
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+//
+// Remote VFS protocol
+//
+// A client opens with the line "HELLO VFSB/1". A server speaking the binary
+// protocol answers "OK VFSB/1" and both sides exchange frames from then on;
+// an older server answers with an EXEC error, and the client keeps to
+// "EXEC <command>" lines on that connection.
+//
+// A frame is a 9 byte header, payload length (u32), request id (u32) and op
+// or status (u8), all big-endian, then the payload. Requests carry a path
+// (u32 length and bytes) and, for WRITE, the data as the rest of the payload.
+// Replies echo the request id with status OK or ERR (payload: message):
+//   READ    the file's bytes
+//   WRITE   nothing
+//   STAT    type (u8, RemoteEntry::Type), size (u64), mtime in ns (u64)
+//   READDIR per entry: type (u8), name (u32 length and bytes)
+//   READDIRPLUS per entry: type, size and mtime as for STAT, then the name,
+//           so that one request lists and stats a whole directory
+//   PING    nothing; the path is empty
+// Payloads are binary-safe. A client may send any number of requests before
+// reading replies; the server answers them in order, and the client matches
+// replies to requests by id. A reply carries at most MAX_REPLY bytes: the
+// server answers ERR for a larger file, and a client drops a connection
+// announcing a longer reply.
+//
+// Leases: READ, STAT and READDIRPLUS with the LEASE bit (0x80) set in the op
+// also ask the server to watch the path. When it changes, the server sends
+// an INVALIDATE frame (request id 0) with the path as payload, and for a
+// directory also with the changed entry's path; a watch is dropped once it
+// fired and with the connection. The client keeps leased replies until they
+// are invalidated or their TTL runs out, whichever comes first, so the TTL
+// bounds staleness where the server could not watch. A STAT that found
+// nothing is not kept, as there is nothing to watch. When the server lost
+// events (its inotify queue overflowed) it invalidates every lease.
+//
+struct RemoteEntry {
+    enum class Type : uint8_t { Missing = 0, File = 1, Dir = 2 };
+    std::string name;
+    Type type = Type::Missing;
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+};
+
+// The client side: a small pool of connections to one server, which
+// requests from any number of nodes share, and the lease cache over them.
+// A request goes out on the connection with the fewest replies outstanding,
+// and a new connection opens while every open one is busy, up to the pool
+// size. A connection idle for a while is checked before it is used again,
+// and one found dead is opened again on its next use.
+class RemoteSession {
+public:
+    enum class Op : uint8_t { Read = 1, Write = 2, Stat = 3, ReadDir = 4, ReadDirPlus = 5, Ping = 6 };
+    static constexpr uint8_t LEASE = 0x80;
+    enum class Status : uint8_t { Ok = 0, Err = 1, Invalidate = 2 };
+    struct Reply {
+        Status status = Status::Ok;
+        std::string payload;
+    };
+
+    static constexpr size_t DEFAULT_POOL = 4;
+    static constexpr size_t MAX_REPLY = size_t(1) << 30;  // payload bytes in one reply
+    static constexpr auto IDLE_CHECK = std::chrono::seconds(5);  // default for setIdleCheck
+
+    // binary false sticks to EXEC, as against a server from before VFSB
+    RemoteSession(std::string host, int port, bool binary = true);
+    ~RemoteSession();
+    RemoteSession(const RemoteSession&) = delete;
+    RemoteSession& operator=(const RemoteSession&) = delete;
+    // The session every mount of host:port shares
+    static std::shared_ptr<RemoteSession> shared(const std::string& host, int port);
+
+    const std::string& host() const { return host_name; }
+    int port() const { return port_num; }
+    // Connects if needed; whether the server took the binary protocol
+    bool binary();
+    void setPoolSize(size_t n);
+    // Connections idle longer than this are checked before they are used
+    void setIdleCheck(std::chrono::milliseconds after);
+
+    // Sends one request without waiting for earlier ones to be answered
+    std::future<Reply> request(Op op, std::string_view path, std::string_view data = {});
+    // READ, STAT or READDIRPLUS from the lease cache, else sent with a lease
+    std::future<Reply> fetch(Op op, const std::string& path);
+    // The ops, waiting for their reply; ERR replies throw
+    std::string read(const std::string& path);
+    void write(const std::string& path, std::string_view data);
+    RemoteEntry stat(const std::string& path);
+    std::vector<RemoteEntry> readDir(const std::string& path);
+    std::vector<RemoteEntry> readDirPlus(const std::string& path);
+    // The READDIRPLUS payload, the same object for as long as it is cached
+    std::shared_ptr<const std::string> listing(const std::string& path);
+    static std::vector<RemoteEntry> parseListing(const std::string& payload);
+    // One EXEC round trip on a connection that fell back to it
+    std::string exec(const std::string& command);
+
+    // The payload of a reply, or the error it carries as an exception
+    static std::string replyData(std::future<Reply> reply);
+
+    // How long leased replies are used without asking; zero turns caching off
+    void setLeaseTtl(std::chrono::milliseconds ttl);
+    // Drops what is cached of path, as an INVALIDATE frame does
+    void invalidate(const std::string& path);
+    struct CacheStats {
+        size_t hits = 0, misses = 0, invalidations = 0, entries = 0;
+    };
+    CacheStats cacheStats();
+    struct PoolStats {
+        size_t open = 0, size = 0, requests = 0, reconnects = 0, failed_checks = 0;
+    };
+    PoolStats poolStats();
+
+private:
+    struct Connection;
+    std::string host_name;
+    int port_num;
+    bool want_binary;
+    std::atomic<int> negotiated{-1};  // binary() once a connection found out
+    std::mutex pool_mtx;
+    size_t pool_size = DEFAULT_POOL;
+    std::vector<std::unique_ptr<Connection>> conns;
+    std::atomic<int64_t> idle_check_ns{std::chrono::nanoseconds(IDLE_CHECK).count()};
+    std::atomic<size_t> requests{0}, reconnects{0}, failed_checks{0};
+
+    // Leased replies by op and path; a listing also names the STATs its
+    // entries seeded, which go with it
+    struct Cached {
+        std::shared_ptr<const std::string> payload;
+        std::chrono::steady_clock::time_point expires;
+        std::vector<std::string> seeded;
+    };
+    std::mutex cache_mtx;
+    std::chrono::milliseconds lease_ttl{10000};
+    std::unordered_map<std::string, Cached> cache;
+    CacheStats stats;
+
+    static std::string cacheKey(Op op, std::string_view path);
+    std::shared_ptr<const std::string> cached(Op op, const std::string& path);
+    void store(Op op, const std::string& path, const std::string& payload, std::chrono::steady_clock::time_point sent);
+    void eraseLocked(const std::string& key);
+    void dropCache();  // a connection, and the leases it held, went away
+    std::future<Reply> send(Op op, std::string_view path, std::string_view data, bool lease);
+    Connection& pick();
+};
+
+// The daemon's server side. One thread waits on every connection with epoll
+// and reads into a buffer per connection, so that a request split across
+// packets or larger than one read is taken whole. A connection speaks the
+// binary protocol when it opens with HELLO and EXEC otherwise. Requests run
+// on a fixed pool of workers, one at a time per connection so that its
+// replies keep their order, and at most max_running at once; past that,
+// connections wait their turn. A connection whose client does not read its
+// replies is not read from either, so TCP pushes back on that client. Its
+// unparsed input stays below MAX_BUFFERED plus one request of at most
+// MAX_FRAME bytes. Paths are host paths of the serving machine.
+class RemoteServer {
+public:
+    static constexpr size_t MAX_FRAME = size_t(1) << 26;     // a longer request closes its connection
+    static constexpr size_t MAX_BUFFERED = size_t(1) << 20;  // per connection and direction, past one request
+
+    // listen_fd must be listening. workers == 0 sizes the pool to the machine;
+    // max_running == 0 allows four requests per worker
+    explicit RemoteServer(int listen_fd, size_t workers = 0, size_t max_running = 0);
+    ~RemoteServer();
+    RemoteServer(const RemoteServer&) = delete;
+    RemoteServer& operator=(const RemoteServer&) = delete;
+
+    // Serves until stop()
+    void run();
+    // These two may be called from any thread
+    void stop();
+    void disconnectAll();  // hangs up on every client, as a restart would
+
+    size_t workers() const { return pool.size(); }
+
+    struct Stats {
+        size_t connections = 0, accepted = 0, requests = 0, stalls = 0;
+    };
+    Stats stats() const;
+
+private:
+    struct Connection;
+    class Leases;
+    struct Finished {
+        uint64_t conn;
+        std::string reply;
+    };
+
+    int listen_fd;
+    int epoll_fd = -1;
+    int wake_fd = -1;  // eventfd: requests finished, stop() or disconnectAll()
+    size_t max_running;
+    // The loop thread's
+    size_t running = 0;
+    bool accepting = true;
+    uint64_t next_conn;
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> conns;
+    std::deque<uint64_t> stalled;  // connections with a request waiting for a worker
+    std::unique_ptr<Leases> leases;
+
+    std::mutex finished_mtx;
+    std::vector<Finished> finished;
+    std::atomic<bool> stopping{false}, dropping{false};
+    std::atomic<size_t> n_connections{0}, n_accepted{0}, n_requests{0}, n_stalls{0};
+    WorkerPool pool;
+    WorkerPool::Group jobs{pool};  // last, so that it waits before the rest goes
+
+    void wake();
+    void accept();
+    void receive(uint64_t id, Connection& c);
+    void pump(uint64_t id, Connection& c, bool turn = false);
+    void dispatch(uint64_t id, Connection& c);
+    void complete();
+    void notify();
+    void settle(uint64_t id, Connection& c);
+    void close(uint64_t id);
+};
@@ -0,0 +1,87 @@
+#include "VfsShell.h"
+
+// ====== TagPathIndex ======
+
+void TagPathIndex::add(size_t overlayId, std::string path, const VfsNode* node){
+    if(node) add(overlayId, std::move(path), node->serial);
+}
+
+void TagPathIndex::add(size_t overlayId, std::string path, uint64_t serial){
+    Key key{overlayId, std::move(path)};
+    auto it = by_path.find(key);
+    if(it != by_path.end()){
+        if(it->second == serial) return;
+        erase(key);
+    }
+    by_node[serial].push_back(key);
+    by_path.emplace(std::move(key), serial);
+}
+
+std::vector<TagPathIndex::Key> TagPathIndex::subtree(size_t overlayId, std::string_view path) const {
+    std::vector<Key> keys;
+    std::string base(path);
+    // "/a/b/..." sorts after "/a/b" and its siblings like "/a/b.txt", so the
+    // entries below a directory start at its path plus the slash
+    if(base.empty() || base.back() != '/'){
+        if(by_path.count(Key{overlayId, base})) keys.emplace_back(overlayId, base);
+        base += '/';
+    }
+    for(auto it = by_path.lower_bound(Key{overlayId, base}); it != by_path.end(); ++it){
+        if(it->first.first != overlayId || it->first.second.compare(0, base.size(), base) != 0) break;
+        keys.push_back(it->first);
+    }
+    return keys;
+}
+
+void TagPathIndex::erase(const Key& key){
+    auto it = by_path.find(key);
+    if(it == by_path.end()) return;
+    auto node_it = by_node.find(it->second);
+    if(node_it != by_node.end()){
+        auto& keys = node_it->second;
+        keys.erase(std::remove(keys.begin(), keys.end(), key), keys.end());
+        if(keys.empty()) by_node.erase(node_it);
+    }
+    by_path.erase(it);
+}
+
+void TagPathIndex::removeTree(size_t overlayId, std::string_view path){
+    if(by_path.empty()) return;
+    for(const auto& key : subtree(overlayId, path)) erase(key);
+}
+
+void TagPathIndex::moveTree(size_t overlayId, std::string_view from, std::string_view to){
+    if(by_path.empty()) return;
+    std::vector<std::pair<std::string, uint64_t>> moved;
+    for(const auto& key : subtree(overlayId, from)){
+        moved.emplace_back(std::string(to) + key.second.substr(from.size()), by_path.at(key));
+        erase(key);
+    }
+    removeTree(overlayId, to);  // what the destination held was overwritten
+    for(auto& [path, node] : moved) add(overlayId, std::move(path), node);
+}
+
+void TagPathIndex::forgetNode(const VfsNode* node){
+    if(!node) return;
+    auto it = by_node.find(node->serial);
+    if(it == by_node.end()) return;
+    for(const auto& key : it->second) by_path.erase(key);
+    by_node.erase(it);
+}
+
+void TagPathIndex::eraseOverlay(size_t overlayId){
+    if(by_path.empty()) return;
+    std::map<Key, uint64_t> old;
+    old.swap(by_path);
+    by_node.clear();
+    for(auto& [key, node] : old){
+        if(key.first == overlayId) continue;
+        add(key.first > overlayId ? key.first - 1 : key.first, key.second, node);
+    }
+}
+
+void TagPathIndex::pathsOf(uint64_t serial, std::vector<std::string>& out) const {
+    auto it = by_node.find(serial);
+    if(it == by_node.end()) return;
+    for(const auto& key : it->second) out.push_back(key.second);
+}
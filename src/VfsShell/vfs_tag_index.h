@@ -0,0 +1,41 @@
+#pragma once
+
+//
+// Tagged node paths
+//
+// Tags are keyed by node serial, so a tag query finds nodes; this index maps
+// them back to the paths they sit at, per overlay, without walking the tree. Only
+// tagged nodes are recorded. Vfs keeps it in step with every create, remove
+// and move it performs, with copy-on-write copies of tagged nodes and with
+// overlay registration, so a node's entries are the paths it was tagged at
+// plus those it was linked, moved or loaded to since.
+//
+class TagPathIndex {
+public:
+    bool empty() const { return by_path.empty(); }
+    size_t size() const { return by_path.size(); }
+
+    // Records node at path in the overlay, replacing what was recorded there
+    void add(size_t overlayId, std::string path, const VfsNode* node);
+    // Forgets path and everything below it in the overlay
+    void removeTree(size_t overlayId, std::string_view path);
+    // Renames the entries at from and below to the same places below to
+    void moveTree(size_t overlayId, std::string_view from, std::string_view to);
+    // Forgets every path of a node that is no longer tagged
+    void forgetNode(const VfsNode* node);
+    // Drops an overlay; the ids above it move down by one like overlay_stack
+    void eraseOverlay(size_t overlayId);
+
+    // Appends the paths the node with this serial is recorded at, in any overlay
+    void pathsOf(uint64_t serial, std::vector<std::string>& out) const;
+
+private:
+    using Key = std::pair<size_t, std::string>;
+    std::map<Key, uint64_t> by_path;
+    std::unordered_map<uint64_t, std::vector<Key>> by_node;
+
+    // The keys at path and below it in the overlay
+    std::vector<Key> subtree(size_t overlayId, std::string_view path) const;
+    void erase(const Key& key);
+    void add(size_t overlayId, std::string path, uint64_t serial);
+};
@@ -0,0 +1,219 @@
+#include "VfsShell.h"
+
+// ====== TreeWalker ======
+
+std::string TreeWalker::childPath(const std::string& parent, Atom name){
+    std::string out;
+    out.reserve(parent.size() + name.size() + 1);
+    out = parent;
+    if(out.empty() || out.back() != '/') out += '/';
+    out += name.view();
+    return out;
+}
+
+bool TreeWalker::entersChildren(const Item& item) const {
+    if(!item.node->isDir() || item.depth >= opts.max_depth) return false;
+    return opts.mounts || item.node->stableChildren();
+}
+
+bool TreeWalker::walk(Item root, const Visit& visit) const {
+    return walkUntil(std::move(root), visit, nullptr);
+}
+
+bool TreeWalker::walk(std::shared_ptr<VfsNode> root, std::string path, const Visit& visit) const {
+    Item item;
+    item.node = std::move(root);
+    item.path = std::move(path);
+    return walkUntil(std::move(item), visit, nullptr);
+}
+
+bool TreeWalker::walkUntil(Item root, const Visit& visit, const std::atomic<bool>* stop,
+                           const Lister* lister) const {
+    if(!root.node) return true;
+    const size_t base = root.depth;
+    std::vector<Item> stack;
+    stack.push_back(std::move(root));
+    // Directories entered above the current node, to catch links to an ancestor
+    std::vector<const VfsNode*> chain;
+    std::unordered_set<const VfsNode*> on_chain;
+    while(!stack.empty()){
+        if(stop && stop->load(std::memory_order_relaxed)) return false;
+        Item item = std::move(stack.back());
+        stack.pop_back();
+        if(!stack.empty()) __builtin_prefetch(stack.back().node.get());
+
+        Action action = visit(item);
+        if(action == Action::Stop) return false;
+        if(action == Action::Skip || !entersChildren(item)) continue;
+
+        const size_t level = item.depth - base;
+        while(chain.size() > level){
+            on_chain.erase(chain.back());
+            chain.pop_back();
+        }
+        if(!on_chain.insert(item.node.get()).second) continue;
+        chain.push_back(item.node.get());
+
+        // Pushed in reverse so the first child is popped first
+        const size_t first = stack.size();
+        auto push = [&](Atom name, const std::shared_ptr<VfsNode>& child){
+            Item next;
+            next.node = child;
+            if(opts.paths) next.path = childPath(item.path, name);
+            next.depth = item.depth + 1;
+            next.last = false;
+            next.lane = item.lane;
+            stack.push_back(std::move(next));
+        };
+        if(lister && !item.node->stableChildren()){
+            for(const auto& [name, child] : (*lister)(*item.node)) push(name, child);
+        } else {
+            for(const auto& [name, child] : *item.node->listing()) push(name, child);
+        }
+        if(stack.size() > first) stack.back().last = true;
+        std::reverse(stack.begin() + static_cast<std::ptrdiff_t>(first), stack.end());
+    }
+    return true;
+}
+
+// ====== ParallelWalk ======
+
+ParallelWalk::ParallelWalk(std::shared_ptr<VfsNode> root, std::string path,
+                           TreeWalker::Options opts, WorkerPool& p)
+    : walker(opts), pool(p) {
+    if(!root) return;
+    TreeWalker::Item top;
+    top.node = std::move(root);
+    top.path = std::move(path);
+
+    // Split at the first depth wide enough to keep every worker busy, looking
+    // a few levels down at most
+    const size_t wanted = 4 * pool.size();
+    size_t split = top.depth;
+    {
+        std::vector<TreeWalker::Item> level{top};
+        for(size_t probe = 0; level.size() < wanted && probe < 8; ++probe){
+            std::vector<TreeWalker::Item> next;
+            for(const auto& item : level){
+                if(!walker.entersChildren(item)) continue;
+                for(const auto& kv : *item.node->listing()){
+                    TreeWalker::Item child;
+                    child.node = kv.second;
+                    child.depth = item.depth + 1;
+                    next.push_back(std::move(child));
+                }
+            }
+            if(next.empty()) break;
+            level = std::move(next);
+            ++split;
+        }
+    }
+
+    // Everything above the split is visited by run() itself, in walk order;
+    // each directory at the split becomes a task in a lane of its own
+    std::vector<TreeWalker::Item> stack{std::move(top)};
+    std::vector<size_t> open;  // planned entries whose descendants may follow
+    size_t lane = 0;
+    bool after_task = false;
+    while(!stack.empty()){
+        TreeWalker::Item item = std::move(stack.back());
+        stack.pop_back();
+        while(!open.empty() && plan[open.back()].item.depth >= item.depth){
+            plan[open.back()].end = plan.size();
+            open.pop_back();
+        }
+        const bool enters = walker.entersChildren(item);
+        const bool task = enters && item.depth == split;
+        if(task || after_task) ++lane;
+        after_task = task;
+        item.lane = lane;
+        open.push_back(plan.size());
+        if(enters && !task){
+            const size_t first = stack.size();
+            for(const auto& [name, child] : *item.node->listing()){
+                TreeWalker::Item next;
+                next.node = child;
+                if(walker.opts.paths) next.path = TreeWalker::childPath(item.path, name);
+                next.depth = item.depth + 1;
+                next.last = false;
+                stack.push_back(std::move(next));
+            }
+            if(stack.size() > first) stack.back().last = true;
+            std::reverse(stack.begin() + static_cast<std::ptrdiff_t>(first), stack.end());
+        }
+        plan.push_back(Planned{std::move(item), task, 0});
+    }
+    for(size_t i : open) plan[i].end = plan.size();
+    lane_count = lane + 1;
+}
+
+bool ParallelWalk::run(const TreeWalker::Visit& visit){
+    std::atomic<bool> stop{false};
+    const TreeWalker::Lister lister = [this](VfsNode& dir){ return listOnCaller(dir); };
+    const TreeWalker::Lister* mounts = walker.opts.mounts ? &lister : nullptr;
+    WorkerPool::Group group(pool);
+    try{
+        for(size_t i = 0; i < plan.size() && !stop.load(std::memory_order_relaxed);){
+            const Planned& p = plan[i];
+            if(p.task){
+                {
+                    std::lock_guard<std::mutex> lk(list_mtx);
+                    ++running;
+                }
+                group.run([this, i, &visit, &stop, mounts]{
+                    struct Finished {
+                        ParallelWalk* walk;
+                        ~Finished(){
+                            std::lock_guard<std::mutex> lk(walk->list_mtx);
+                            --walk->running;
+                            walk->list_cv.notify_all();
+                        }
+                    } finished{this};
+                    if(!walker.walkUntil(plan[i].item, visit, &stop, mounts)) stop = true;
+                });
+                i = p.end;
+                continue;
+            }
+            TreeWalker::Action action = visit(p.item);
+            if(action == TreeWalker::Action::Stop) stop = true;
+            i = action == TreeWalker::Action::Descend ? i + 1 : p.end;
+            serveListings(false);
+        }
+    } catch(...){
+        stop = true;
+        serveListings(true);  // the tasks may be waiting on us
+        throw;  // the group still waits for the tasks it started
+    }
+    serveListings(true);
+    group.wait();
+    return !stop.load();
+}
+
+TreeWalker::Listing ParallelWalk::listOnCaller(VfsNode& dir){
+    ListRequest req{&dir, {}, nullptr, false};
+    std::unique_lock<std::mutex> lk(list_mtx);
+    requests.push_back(&req);
+    list_cv.notify_all();
+    list_cv.wait(lk, [&]{ return req.done; });
+    if(req.error) std::rethrow_exception(req.error);
+    return std::move(req.children);
+}
+
+void ParallelWalk::serveListings(bool wait){
+    std::unique_lock<std::mutex> lk(list_mtx);
+    for(;;){
+        if(wait) list_cv.wait(lk, [&]{ return !requests.empty() || running == 0; });
+        if(requests.empty()) return;
+        ListRequest* req = requests.front();
+        requests.pop_front();
+        lk.unlock();
+        try{
+            for(const auto& kv : *req->dir->listing()) req->children.emplace_back(kv.first, kv.second);
+        } catch(...){
+            req->error = std::current_exception();
+        }
+        lk.lock();
+        req->done = true;
+        list_cv.notify_all();
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+//
+// Tree traversal
+//
+// The one depth-first walk behind tree listings, overlay saves, context
+// collection and usage counts. Pending nodes live on an explicit stack, so
+// deep AST trees cannot overflow the call stack, and the node visited next is
+// prefetched while the current one is handled. Children are visited in name
+// order. The visit callback steers the walk: Descend into the node's
+// children, Skip them, or Stop. A directory linked below itself is visited
+// but not entered again.
+//
+class TreeWalker {
+public:
+    enum class Action { Descend, Skip, Stop };
+    struct Item {
+        std::shared_ptr<VfsNode> node;
+        std::string path;   // empty unless Options::paths
+        size_t depth = 0;
+        bool last = true;   // last of its siblings
+        size_t lane = 0;    // see ParallelWalk
+    };
+    using Visit = std::function<Action(const Item&)>;
+    struct Options {
+        size_t max_depth = std::numeric_limits<size_t>::max();  // deeper nodes are not visited
+        bool paths = true;
+        bool mounts = true;  // enter host mounts and remote directories
+    };
+
+    TreeWalker() = default;
+    explicit TreeWalker(Options o) : opts(o) {}
+
+    // False when a visit stopped the walk
+    bool walk(Item root, const Visit& visit) const;
+    bool walk(std::shared_ptr<VfsNode> root, std::string path, const Visit& visit) const;
+
+    const Options& options() const { return opts; }
+    // Whether the walk goes below item once its visit says Descend
+    bool entersChildren(const Item& item) const;
+    static std::string childPath(const std::string& parent, Atom name);
+
+private:
+    friend class ParallelWalk;
+    Options opts;
+
+    using Listing = std::vector<std::pair<Atom, std::shared_ptr<VfsNode>>>;
+    using Lister = std::function<Listing(VfsNode&)>;
+    // lister, when given, lists the directories without stable children
+    bool walkUntil(Item root, const Visit& visit, const std::atomic<bool>* stop,
+                   const Lister* lister = nullptr) const;
+};
+
+//
+// Parallel tree walk
+//
+// Splits the top of a tree into lanes and walks the subtrees below the split
+// as WorkerPool tasks, so the visit callback runs on several threads at once.
+// Lanes are numbered in walk order: results gathered per lane (Item::lane)
+// and concatenated come out exactly as a sequential walk would produce them.
+// The caller holds the Vfs lock for the duration, or walks a frozen snapshot;
+// the workers take no lock of their own.
+//
+// Host mount and remote directories (Options::mounts) are only listed on the
+// thread that builds and runs the walk, so they are never listed from a
+// worker nor two at a time: a worker reaching one asks that thread for a copy
+// of its listing and waits. run() serves these requests between its own
+// visits and until the last task is done.
+//
+class ParallelWalk {
+public:
+    ParallelWalk(std::shared_ptr<VfsNode> root, std::string path,
+                 TreeWalker::Options opts = TreeWalker::Options(),
+                 WorkerPool& pool = WorkerPool::shared());
+
+    size_t lanes() const { return lane_count; }
+    // False when a visit stopped the walk
+    bool run(const TreeWalker::Visit& visit);
+
+private:
+    struct Planned {
+        TreeWalker::Item item;
+        bool task;   // walked, with everything below it, by a worker
+        size_t end;  // index just past its planned descendants
+    };
+    // A worker's request for the listing of a mount directory
+    struct ListRequest {
+        VfsNode* dir;
+        TreeWalker::Listing children;
+        std::exception_ptr error;
+        bool done = false;
+    };
+    TreeWalker walker;
+    WorkerPool& pool;
+    std::vector<Planned> plan;
+    size_t lane_count = 1;
+
+    std::mutex list_mtx;
+    std::condition_variable list_cv;  // a request queued or served, or a task done
+    std::deque<ListRequest*> requests;
+    size_t running = 0;  // tasks not finished yet
+
+    TreeWalker::Listing listOnCaller(VfsNode& dir);
+    // Serves queued requests; with wait, until every task is done
+    void serveListings(bool wait);
+};
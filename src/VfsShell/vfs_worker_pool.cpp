@@ -0,0 +1,108 @@
+#include "VfsShell.h"
+
+// ====== WorkerPool ======
+
+WorkerPool::WorkerPool(size_t threads){
+    if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    workers.reserve(threads);
+    for(size_t i = 0; i < threads; ++i){
+        workers.emplace_back([this]{
+            for(;;){
+                Task task;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    ready.wait(lock, [this]{ return stopping || !queue.empty(); });
+                    if(queue.empty()) return;  // stopping and drained
+                    task = std::move(queue.front());
+                    queue.pop_front();
+                }
+                execute(task);
+            }
+        });
+    }
+}
+
+WorkerPool::~WorkerPool(){
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    ready.notify_all();
+    for(auto& t : workers) t.join();
+}
+
+WorkerPool& WorkerPool::shared(){
+    static WorkerPool pool;
+    return pool;
+}
+
+void WorkerPool::push(Task task){
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        queue.push_back(std::move(task));
+    }
+    ready.notify_one();
+}
+
+bool WorkerPool::runOne(){
+    Task task;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(queue.empty()) return false;
+        task = std::move(queue.front());
+        queue.pop_front();
+    }
+    execute(task);
+    return true;
+}
+
+void WorkerPool::execute(Task& task){
+    std::exception_ptr error;
+    try{
+        task.fn();
+    } catch(...){
+        error = std::current_exception();
+    }
+    task.group->finished(error);
+}
+
+void WorkerPool::Group::run(std::function<void()> task){
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        ++pending;
+    }
+    pool.push(Task{std::move(task), this});
+}
+
+void WorkerPool::Group::finished(std::exception_ptr e){
+    std::lock_guard<std::mutex> lock(mtx);
+    if(e && !error) error = e;
+    if(--pending == 0) done.notify_all();
+}
+
+void WorkerPool::Group::wait(){
+    for(;;){
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if(pending == 0) break;
+        }
+        if(pool.runOne()) continue;
+        // Our remaining tasks are running on workers
+        std::unique_lock<std::mutex> lock(mtx);
+        done.wait(lock, [this]{ return pending == 0; });
+    }
+    std::exception_ptr e;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::swap(e, error);
+    }
+    if(e) std::rethrow_exception(e);
+}
+
+WorkerPool::Group::~Group(){
+    try{
+        wait();
+    } catch(...){
+        // the owner unwinds from an error of its own
+    }
+}
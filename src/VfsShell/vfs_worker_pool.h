@@ -0,0 +1,60 @@
+#pragma once
+
+//
+// Worker thread pool
+//
+// A fixed set of threads taking tasks from one queue. Work is submitted
+// through a Group, which counts its own tasks: wait() returns once all of
+// them ran and rethrows the first exception one of them threw. A thread
+// waiting on a group runs queued tasks itself meanwhile, so groups can be
+// nested inside tasks without tying up the workers.
+//
+class WorkerPool {
+public:
+    // threads == 0 sizes the pool to the machine
+    explicit WorkerPool(size_t threads = 0);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+    // Process-wide pool, started on first use
+    static WorkerPool& shared();
+
+    class Group {
+    public:
+        explicit Group(WorkerPool& pool) : pool(pool) {}
+        ~Group();  // waits, dropping any exception
+        Group(const Group&) = delete;
+        Group& operator=(const Group&) = delete;
+
+        void run(std::function<void()> task);
+        void wait();
+
+    private:
+        friend class WorkerPool;
+        WorkerPool& pool;
+        std::mutex mtx;
+        std::condition_variable done;
+        size_t pending = 0;
+        std::exception_ptr error;
+
+        void finished(std::exception_ptr e);
+    };
+
+private:
+    struct Task {
+        std::function<void()> fn;
+        Group* group;
+    };
+    std::vector<std::thread> workers;
+    std::deque<Task> queue;
+    std::mutex mtx;
+    std::condition_variable ready;
+    bool stopping = false;
+
+    void push(Task task);
+    // Runs one queued task on the calling thread; false when the queue is empty
+    bool runOne();
+    static void execute(Task& task);
+};